@@ -99,6 +99,26 @@ public class AgusMapsFlutterPlugin implements FlutterPlugin, MethodCallHandler {
             }
         }).start();
         
+    } else if (call.method.equals("locateResourcePack")) {
+        String assetPath = call.argument("assetPath");
+        if (assetPath == null) {
+            result.error("INVALID_ARGUMENT", "assetPath is null", null);
+            return;
+        }
+        new Thread(() -> {
+            try {
+                java.util.Map<String, Object> location = locateResourcePack(assetPath);
+                new android.os.Handler(android.os.Looper.getMainLooper()).post(() -> {
+                    result.success(location);
+                });
+            } catch (Exception e) {
+                android.util.Log.e("AgusMapsFlutter", "Error locating resource pack", e);
+                new android.os.Handler(android.os.Looper.getMainLooper()).post(() -> {
+                    result.error("EXTRACTION_FAILED", e.getMessage(), null);
+                });
+            }
+        }).start();
+
     } else if (call.method.equals("getApkPath")) {
         result.success(context.getApplicationInfo().sourceDir);
     } else if (call.method.equals("createMapSurface")) {
@@ -233,6 +253,84 @@ public class AgusMapsFlutterPlugin implements FlutterPlugin, MethodCallHandler {
     return filesDir.getAbsolutePath();
   }
 
+  /**
+   * Finds the resource pack built by scripts/build_resource_pack.py.
+   * An uncompressed asset is mapped straight from the APK; otherwise it is copied
+   * to the files directory, again after every install or update of the app.
+   *
+   * @return {path, offset} of the pack, or null if the app doesn't ship one.
+   */
+  private java.util.Map<String, Object> locateResourcePack(String assetPath) throws IOException {
+    AssetManager assetManager = context.getAssets();
+    String lookupKey = io.flutter.FlutterInjector.instance().flutterLoader().getLookupKeyForAsset(assetPath);
+
+    java.util.Map<String, Object> location = new java.util.HashMap<>();
+    try (android.content.res.AssetFileDescriptor fd = assetManager.openFd(lookupKey)) {
+        location.put("path", context.getApplicationInfo().sourceDir);
+        location.put("offset", fd.getStartOffset());
+        android.util.Log.d("AgusMapsFlutter", "Resource pack mapped from APK at offset " + fd.getStartOffset());
+        return location;
+    } catch (java.io.FileNotFoundException e) {
+        // Compressed asset (no noCompress("pack")) or no pack at all.
+    }
+
+    File outFile = new File(context.getFilesDir(), new File(assetPath).getName());
+    // The copy belongs to the APK it came from: an update may ship a different pack.
+    File stampFile = new File(outFile.getAbsolutePath() + ".stamp");
+    String stamp = getInstallStamp();
+    try (InputStream in = assetManager.open(lookupKey)) {
+        if (!outFile.exists() || !stamp.equals(readStamp(stampFile))) {
+            File tmpFile = new File(outFile.getAbsolutePath() + ".tmp");
+            try (OutputStream out = new FileOutputStream(tmpFile)) {
+                byte[] buffer = new byte[64 * 1024];
+                int read;
+                while ((read = in.read(buffer)) != -1) {
+                    out.write(buffer, 0, read);
+                }
+            }
+            if (!tmpFile.renameTo(outFile)) {
+                throw new IOException("Can't rename " + tmpFile);
+            }
+            try (OutputStream out = new FileOutputStream(stampFile)) {
+                out.write(stamp.getBytes(java.nio.charset.StandardCharsets.UTF_8));
+            }
+        }
+    } catch (java.io.FileNotFoundException e) {
+        android.util.Log.d("AgusMapsFlutter", "No resource pack at " + assetPath);
+        return null;
+    }
+    location.put("path", outFile.getAbsolutePath());
+    location.put("offset", 0L);
+    android.util.Log.d("AgusMapsFlutter", "Resource pack extracted to: " + outFile.getAbsolutePath());
+    return location;
+  }
+
+  /** Changes with every install or update of the app, and with nothing else. */
+  private String getInstallStamp() throws IOException {
+    try {
+        android.content.pm.PackageInfo info =
+            context.getPackageManager().getPackageInfo(context.getPackageName(), 0);
+        return Long.toString(info.lastUpdateTime);
+    } catch (android.content.pm.PackageManager.NameNotFoundException e) {
+        throw new IOException("Can't read package info", e);
+    }
+  }
+
+  /** @return the stamp written with a copied asset, or "" if there is none. */
+  private static String readStamp(File stampFile) {
+    try (InputStream in = new java.io.FileInputStream(stampFile)) {
+        java.io.ByteArrayOutputStream out = new java.io.ByteArrayOutputStream();
+        byte[] buffer = new byte[64];
+        int read;
+        while ((read = in.read(buffer)) != -1) {
+            out.write(buffer, 0, read);
+        }
+        return new String(out.toByteArray(), java.nio.charset.StandardCharsets.UTF_8);
+    } catch (IOException e) {
+        return "";
+    }
+  }
+
   private void extractAssetsRecursive(AssetManager assetManager, String assetPath, File outDir) throws IOException {
     String[] files = assetManager.list(assetPath);
     android.util.Log.d("AgusMapsFlutter", "Listing assets at: " + assetPath + " found: " + (files != null ? files.length : 0) + " items");
@@ -0,0 +1,96 @@
+package app.agus.maps.agus_maps_flutter;
+
+import androidx.annotation.Keep;
+
+import java.io.IOException;
+import java.io.InputStream;
+import java.io.OutputStream;
+import java.net.InetSocketAddress;
+import java.net.Socket;
+
+import javax.net.ssl.HttpsURLConnection;
+import javax.net.ssl.SSLSocket;
+import javax.net.ssl.SSLSocketFactory;
+
+/**
+ * TLS transport for the native HTTP client (agus_http.cpp).
+ * The NDK has no TLS stack, so encrypted connections go through the platform's SSLSocket,
+ * which also gives us the system trust store and hostname verification.
+ */
+@Keep
+@SuppressWarnings("unused")
+public final class TlsSocket {
+    private static final String TAG = "AgusTlsSocket";
+
+    private final SSLSocket mSocket;
+    private final InputStream mInput;
+    private final OutputStream mOutput;
+
+    private TlsSocket(SSLSocket socket) throws IOException {
+        mSocket = socket;
+        mInput = socket.getInputStream();
+        mOutput = socket.getOutputStream();
+    }
+
+    /**
+     * Opens a verified TLS connection.
+     *
+     * @return the connected socket, or null on any failure.
+     */
+    public static TlsSocket open(String host, int port, int timeoutMs) {
+        Socket plain = new Socket();
+        try {
+            plain.connect(new InetSocketAddress(host, port), timeoutMs);
+            plain.setSoTimeout(timeoutMs);
+            plain.setTcpNoDelay(true);
+
+            // Layering over a connected socket sets SNI from |host|.
+            SSLSocketFactory factory = (SSLSocketFactory) SSLSocketFactory.getDefault();
+            SSLSocket socket = (SSLSocket) factory.createSocket(plain, host, port, true);
+            socket.startHandshake();
+
+            if (!HttpsURLConnection.getDefaultHostnameVerifier().verify(host, socket.getSession())) {
+                android.util.Log.w(TAG, "Hostname verification failed for " + host);
+                socket.close();
+                return null;
+            }
+            return new TlsSocket(socket);
+        } catch (IOException | RuntimeException e) {
+            android.util.Log.w(TAG, "Can't open TLS connection to " + host + ":" + port + ": " + e);
+            try {
+                plain.close();
+            } catch (IOException ignored) {
+            }
+            return null;
+        }
+    }
+
+    /**
+     * @return bytes read, 0 on orderly close, -1 on error or timeout.
+     */
+    public int read(byte[] buffer, int size) {
+        try {
+            int n = mInput.read(buffer, 0, size);
+            return n < 0 ? 0 : n;
+        } catch (IOException e) {
+            return -1;
+        }
+    }
+
+    public boolean write(byte[] data, int size) {
+        try {
+            mOutput.write(data, 0, size);
+            mOutput.flush();
+            return true;
+        } catch (IOException e) {
+            return false;
+        }
+    }
+
+    public void close() {
+        try {
+            mSocket.close();
+        } catch (IOException ignored) {
+        }
+    }
+}
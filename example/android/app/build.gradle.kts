@@ -31,7 +31,7 @@ android {
     }
 
     aaptOptions {
-        noCompress("mwm")
+        noCompress("mwm", "pack")
     }
 
 
@@ -47,3 +47,17 @@ android {
 flutter {
     source = "../.."
 }
+
+// Bundles assets/comaps_data into the pack that useResourcePack() maps straight
+// from the APK, before Flutter collects the assets.
+val buildResourcePack by tasks.registering(Exec::class) {
+    val dataDir = file("../../assets/comaps_data")
+    val pack = file("../../assets/packs/comaps_data.pack")
+    inputs.dir(dataDir)
+    outputs.file(pack)
+    commandLine("python3", file("../../../scripts/build_resource_pack.py").path, dataDir.path, pack.path)
+}
+
+tasks.matching { it.name.startsWith("compileFlutterBuild") }.configureEach {
+    dependsOn(buildResourcePack)
+}
@@ -164,9 +164,17 @@ class _MyAppState extends State<MyApp> {
       _log('Extracting icudt75l.dat...');
       await agus_maps_flutter.extractMap('assets/maps/icudt75l.dat');
 
-      // 3. Extract CoMaps data files (classificator.txt, types.txt, etc.)
-      _log('Extracting data files...');
-      String dataPath = await agus_maps_flutter.extractDataFiles();
+      // 3. CoMaps data files (classificator.txt, types.txt, etc.): served from
+      // the resource pack where the build made one, otherwise extracted
+      String dataPath;
+      if (await agus_maps_flutter
+          .useResourcePack('assets/packs/comaps_data.pack')) {
+        _log('Using the resource pack');
+        dataPath = File(worldPath).parent.path;
+      } else {
+        _log('Extracting data files...');
+        dataPath = await agus_maps_flutter.extractDataFiles();
+      }
       _log('Data path: $dataPath');
 
       // 4. Initialize with extracted data files
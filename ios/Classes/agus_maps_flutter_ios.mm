@@ -16,20 +16,44 @@
 #include <memory>
 #include <atomic>
 #include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 // CoMaps Framework includes
 #include "base/logging.hpp"
 #include "map/framework.hpp"
 #include "platform/local_country_file.hpp"
+#include "platform/platform.hpp"
 #include "drape/graphics_context_factory.hpp"
 #include "drape_frontend/visual_params.hpp"
 #include "drape_frontend/user_event_stream.hpp"
 #include "drape_frontend/active_frame_callback.hpp"
+#include "drape_frontend/read_threads.hpp"
 #include "geometry/mercator.hpp"
 
 // Our Metal context factory
 #include "AgusMetalContextFactory.h"
 
+// Shared native helpers (src/)
+#include "agus_memory.hpp"
+#include "agus_threads.hpp"
+#include "agus_downloader.hpp"
+#include "agus_engine_hooks.hpp"
+#include "agus_engine_host.hpp"
+#include "agus_file_hash.hpp"
+#include "agus_frame_stats.hpp"
+#include "agus_lazy_maps.hpp"
+#include "agus_log.hpp"
+#include "agus_map_swap.hpp"
+#include "agus_metrics.hpp"
+#include "agus_mwm_index.hpp"
+#include "agus_mwm_update.hpp"
+#include "agus_startup_trace.hpp"
+#include "agus_style_switch.hpp"
+#include "agus_trace.hpp"
+
 // Forward declarations for AgusPlatformIOS (defined in AgusPlatformIOS.mm)
 extern "C" void AgusPlatformIOS_InitPaths(const char* resourcePath, const char* writablePath);
 extern "C" void* AgusPlatformIOS_GetInstance(void);
@@ -41,7 +65,10 @@ static drape_ptr<dp::ThreadSafeFactory> g_threadSafeFactory;
 static std::string g_resourcePath;
 static std::string g_writablePath;
 static bool g_platformInitialized = false;
+static agus::ThreadConfig g_threadConfig;
 static bool g_drapeEngineCreated = false;
+// Set and cleared on the main thread with the surface; read elsewhere to skip Drape work.
+static std::atomic<bool> g_surfaceAttached{false};
 
 // Surface state
 static int32_t g_surfaceWidth = 0;
@@ -58,8 +85,8 @@ static void notifyFlutterFrameReady(void);
 
 #pragma mark - Logging
 
-// Custom log handler that redirects to NSLog
-static void AgusLogMessage(base::LogLevel level, base::SrcPoint const & src, std::string const & msg) {
+// Writes lines drained from agus_log's rings; runs on its flusher thread
+static void AgusLogSink(base::LogLevel level, char const * tag, char const * line) {
     NSString* levelStr;
     switch (level) {
         case base::LDEBUG: levelStr = @"DEBUG"; break;
@@ -70,8 +97,13 @@ static void AgusLogMessage(base::LogLevel level, base::SrcPoint const & src, std
         default: levelStr = @"???"; break;
     }
     
-    NSLog(@"[CoMaps %@] %s %s", levelStr, 
-          DebugPrint(src).c_str(), msg.c_str());
+    NSLog(@"[%s %@] %s", tag, levelStr, line);
+}
+
+// Custom log handler that queues to agus_log instead of calling NSLog on the
+// logging thread (render threads included)
+static void AgusLogMessage(base::LogLevel level, base::SrcPoint const & src, std::string const & msg) {
+    agus::EnqueueLog(level, src, msg);
     
     // Only abort on CRITICAL, not ERROR
     if (level >= base::LCRITICAL) {
@@ -92,16 +124,27 @@ FFI_PLUGIN_EXPORT int sum_long_running(int a, int b) {
 }
 
 FFI_PLUGIN_EXPORT void comaps_init(const char* apkPath, const char* storagePath) {
+    AGUS_TRACE_FUNCTION("ffi");
     // iOS doesn't use APK paths - redirect to comaps_init_paths
     comaps_init_paths(apkPath, storagePath);
 }
 
 FFI_PLUGIN_EXPORT void comaps_init_paths(const char* resourcePath, const char* writablePath) {
+    // Traced once, by comaps_init_paths_with_config
+    comaps_init_paths_with_config(resourcePath, writablePath, nullptr);
+}
+
+FFI_PLUGIN_EXPORT void comaps_init_paths_with_config(const char* resourcePath, const char* writablePath,
+                                                     const ComapsThreadConfig* config) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] comaps_init_paths: resource=%s, writable=%s", resourcePath, writablePath);
     
     // Set up custom log handler before doing anything else
+    agus::SetLogSink(&AgusLogSink);
     base::SetLogMessageFn(&AgusLogMessage);
     base::g_LogAbortLevel = base::LCRITICAL;
+    // LOG below the compile-time floor isn't even formatted
+    base::g_LogLevel = std::max<base::LogLevel>(base::g_LogLevel, agus::kLogFloor);
     
     // Store paths
     g_resourcePath = resourcePath ? resourcePath : "";
@@ -109,12 +152,60 @@ FFI_PLUGIN_EXPORT void comaps_init_paths(const char* resourcePath, const char* w
     
     // Initialize platform paths via AgusPlatformIOS
     AgusPlatformIOS_InitPaths(resourcePath, writablePath);
+    
+    // Platform worker pools belong to libcomaps here; only the search budget applies
+    agus::ThreadConfig overrides;
+    if (config) {
+        overrides.m_searchThreads = static_cast<unsigned>(std::max(0, config->search_threads));
+        overrides.m_networkThreads = static_cast<unsigned>(std::max(0, config->network_threads));
+        overrides.m_fileThreads = static_cast<unsigned>(std::max(0, config->file_threads));
+        overrides.m_backgroundThreads = static_cast<unsigned>(std::max(0, config->background_threads));
+        overrides.m_readThreads = static_cast<unsigned>(std::max(0, config->read_threads));
+    }
+    g_threadConfig = agus::ResolveThreadConfig(overrides, Platform::CpuCores());
+    df::SetReadThreadsCount(g_threadConfig.m_readThreads);
+    NSLog(@"[AgusMapsFlutter] Threads: %s (cores=%u)", agus::DebugPrint(g_threadConfig).c_str(), Platform::CpuCores());
+    
+    // Tile reads and searches show up in comaps_trace_start recordings
+    agus::InstallEngineHooks();
+    agus::RegisterMetricProviders();
     g_platformInitialized = true;
     
     NSLog(@"[AgusMapsFlutter] Platform initialized, Framework deferred to surface creation");
 }
 
+FFI_PLUGIN_EXPORT void comaps_get_thread_config(ComapsThreadConfig* out_config) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!out_config) {
+        return;
+    }
+    out_config->search_threads = static_cast<int32_t>(g_threadConfig.m_searchThreads);
+    out_config->network_threads = static_cast<int32_t>(g_threadConfig.m_networkThreads);
+    out_config->file_threads = static_cast<int32_t>(g_threadConfig.m_fileThreads);
+    out_config->background_threads = static_cast<int32_t>(g_threadConfig.m_backgroundThreads);
+    out_config->read_threads = static_cast<int32_t>(g_threadConfig.m_readThreads);
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_thread_pool_stats(ComapsThreadPoolStats* out_stats, int max_pools) {
+    AGUS_TRACE_FUNCTION("ffi");
+    auto const pools = agus::GetThreadPoolStats();
+    int const count = out_stats ? std::min(max_pools, static_cast<int>(pools.size())) : 0;
+    for (int i = 0; i < count; ++i) {
+        auto const & pool = pools[i];
+        ComapsThreadPoolStats & out = out_stats[i];
+        memset(out.name, 0, sizeof(out.name));
+        strncpy(out.name, pool.m_name.c_str(), sizeof(out.name) - 1);
+        out.threads = static_cast<int32_t>(pool.m_threads);
+        out.tasks_completed = static_cast<int64_t>(pool.m_tasksCompleted);
+        out.tasks_pending = static_cast<int64_t>(pool.m_tasksPending);
+        out.busy_us = static_cast<int64_t>(pool.m_busyMicros);
+        out.uptime_us = static_cast<int64_t>(pool.m_uptimeMicros);
+    }
+    return static_cast<int>(pools.size());
+}
+
 FFI_PLUGIN_EXPORT void comaps_load_map_path(const char* path) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] comaps_load_map_path: %s", path);
     
     if (g_framework) {
@@ -126,6 +217,7 @@ FFI_PLUGIN_EXPORT void comaps_load_map_path(const char* path) {
 }
 
 FFI_PLUGIN_EXPORT void comaps_set_view(double lat, double lon, int zoom) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] comaps_set_view: lat=%.6f, lon=%.6f, zoom=%d", lat, lon, zoom);
     
     if (g_framework) {
@@ -134,6 +226,7 @@ FFI_PLUGIN_EXPORT void comaps_set_view(double lat, double lon, int zoom) {
 }
 
 FFI_PLUGIN_EXPORT void comaps_touch(int type, int id1, float x1, float y1, int id2, float x2, float y2) {
+    AGUS_TRACE_FUNCTION("ffi");
     if (!g_framework || !g_drapeEngineCreated) {
         return;
     }
@@ -168,6 +261,7 @@ FFI_PLUGIN_EXPORT void comaps_touch(int type, int id1, float x1, float y1, int i
 }
 
 FFI_PLUGIN_EXPORT int comaps_register_single_map(const char* fullPath) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] comaps_register_single_map: %s", fullPath);
     
     if (!g_framework) {
@@ -194,17 +288,109 @@ FFI_PLUGIN_EXPORT int comaps_register_single_map(const char* fullPath) {
     }
 }
 
+FFI_PLUGIN_EXPORT int comaps_register_map_in_archive(const char* archivePath, const char* entryName) {
+    AGUS_TRACE_FUNCTION("ffi");
+    // Bundled maps are plain files in the app bundle here; use comaps_register_single_map.
+    NSLog(@"[AgusMapsFlutter] comaps_register_map_in_archive: not supported (%s in %s)", entryName, archivePath);
+    return -3;
+}
+
+FFI_PLUGIN_EXPORT int comaps_register_map_lazy(const char* fullPath) {
+    AGUS_TRACE_FUNCTION("ffi");
+    NSLog(@"[AgusMapsFlutter] comaps_register_map_lazy: %s", fullPath);
+    return agus::AddLazyMap(fullPath) ? 0 : -2;
+}
+
+FFI_PLUGIN_EXPORT int comaps_register_maps_lazy(const char* const* fullPaths, int count, int use_snapshot,
+                                                ComapsLazyBatchStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::vector<std::string> paths;
+    for (int i = 0; fullPaths && i < count; ++i) {
+        if (fullPaths[i]) {
+            paths.emplace_back(fullPaths[i]);
+        }
+    }
+    
+    agus::LazyBatchStats const stats = agus::AddLazyMaps(paths, use_snapshot != 0);
+    if (out_stats) {
+        out_stats->recorded = static_cast<int32_t>(stats.m_recorded);
+        out_stats->failed = static_cast<int32_t>(stats.m_failed);
+        out_stats->from_snapshot = static_cast<int32_t>(stats.m_fromSnapshot);
+        out_stats->elapsed_us = static_cast<int64_t>(stats.m_elapsedMicros);
+    }
+    NSLog(@"[AgusMapsFlutter] comaps_register_maps_lazy: %s", agus::DebugPrint(stats).c_str());
+    return static_cast<int>(stats.m_recorded);
+}
+
+FFI_PLUGIN_EXPORT int comaps_register_maps_in_rect(double min_lat, double min_lon, double max_lat, double max_lon) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework) {
+        NSLog(@"[AgusMapsFlutter] Framework not initialized");
+        return -1;
+    }
+    m2::RectD const rect(mercator::FromLatLon(min_lat, min_lon), mercator::FromLatLon(max_lat, max_lon));
+    return static_cast<int>(agus::RegisterLazyMapsIn(*g_framework, rect));
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_pending_maps_count(void) {
+    AGUS_TRACE_FUNCTION("ffi");
+    return static_cast<int>(agus::GetPendingLazyMapsCount());
+}
+
 FFI_PLUGIN_EXPORT int comaps_deregister_map(const char* fullPath) {
-    NSLog(@"[AgusMapsFlutter] comaps_deregister_map: %s (not implemented)", fullPath);
+    AGUS_TRACE_FUNCTION("ffi");
+    NSLog(@"[AgusMapsFlutter] comaps_deregister_map: %s", fullPath);
+    
+    if (!g_framework) {
+        NSLog(@"[AgusMapsFlutter] Framework not initialized");
+        return -1;
+    }
+    
+    try {
+        if (!agus::DeregisterMap(*g_framework, fullPath)) {
+            NSLog(@"[AgusMapsFlutter] %s is not registered", fullPath);
+            return -1;
+        }
+        return 0;
+    } catch (std::exception const & e) {
+        NSLog(@"[AgusMapsFlutter] Exception deregistering map: %s", e.what());
+        return -2;
+    }
+}
+
+FFI_PLUGIN_EXPORT int comaps_replace_map(const char* fullPath, ComapsMapReplaceResult* out_result) {
+    AGUS_TRACE_FUNCTION("ffi");
+    NSLog(@"[AgusMapsFlutter] comaps_replace_map: %s", fullPath);
     
-    // TODO: Implement map deregistration when needed
-    // Framework only exposes const DataSource, and DeregisterMap requires non-const
-    // For MVP, maps are registered at startup and not deregistered at runtime
+    if (!g_framework) {
+        NSLog(@"[AgusMapsFlutter] Framework not initialized");
+        return -1;
+    }
     
-    return -1;  // Not implemented
+    try {
+        // ReplaceMap registers the new file while the old one is still open: they can't be one file.
+        if (agus::IsRegisteredMapFile(*g_framework, fullPath)) {
+            NSLog(@"[AgusMapsFlutter] comaps_replace_map: %s is the registered file", fullPath);
+            return -3;
+        }
+        agus::MapReplaceResult const result = agus::ReplaceMap(*g_framework, fullPath);
+        if (out_result) {
+            out_result->result = static_cast<int32_t>(result.m_result);
+            out_result->old_version = result.m_oldVersion;
+            out_result->new_version = result.m_newVersion;
+            out_result->swap_us = static_cast<int64_t>(result.m_swapMicros);
+            out_result->invalidate_us = static_cast<int64_t>(result.m_invalidateMicros);
+        }
+        NSLog(@"[AgusMapsFlutter] comaps_replace_map: %s", agus::DebugPrint(result).c_str());
+        return static_cast<int>(result.m_result);
+    } catch (std::exception const & e) {
+        NSLog(@"[AgusMapsFlutter] Exception replacing map: %s", e.what());
+        return -2;
+    }
 }
 
 FFI_PLUGIN_EXPORT int comaps_get_registered_maps_count(void) {
+    AGUS_TRACE_FUNCTION("ffi");
     if (!g_framework) {
         return 0;
     }
@@ -215,7 +401,326 @@ FFI_PLUGIN_EXPORT int comaps_get_registered_maps_count(void) {
     return static_cast<int>(mwms.size());
 }
 
+FFI_PLUGIN_EXPORT int comaps_get_memory_info(char* buffer, int buffer_size) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::string const info = agus::DebugPrint(agus::GetMemoryStats());
+    if (buffer && buffer_size > 0) {
+        size_t const n = std::min(info.size(), static_cast<size_t>(buffer_size - 1));
+        memcpy(buffer, info.data(), n);
+        buffer[n] = '\0';
+    }
+    return static_cast<int>(info.size());
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_startup_trace(char* buffer, int buffer_size) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::string const trace = agus::GetStartupTraceJson();
+    if (buffer && buffer_size > 0) {
+        size_t const n = std::min(trace.size(), static_cast<size_t>(buffer_size - 1));
+        memcpy(buffer, trace.data(), n);
+        buffer[n] = '\0';
+    }
+    return static_cast<int>(trace.size());
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_startup_mode(int mode) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::SetStartupMode(mode == 1 ? agus::StartupMode::RenderFirst : agus::StartupMode::Full);
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_startup_report(ComapsStartupReport* out_report) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::StartupReport const report = agus::GetStartupReport();
+    if (out_report) {
+        out_report->mode = static_cast<int32_t>(report.m_mode);
+        out_report->deferred_tasks = static_cast<int32_t>(report.m_deferredTasks);
+        out_report->first_frame_us = report.m_firstFrameMicros;
+        out_report->framework_us = report.m_frameworkMicros;
+        out_report->deferred_us = report.m_deferredMicros;
+    }
+    return report.m_firstFrameMicros >= 0 ? 0 : -1;
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_file_pool_limit(int limit) {
+    AGUS_TRACE_FUNCTION("ffi");
+    // MWM readers come from libcomaps' own Platform here; nothing to bound.
+    (void)limit;
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_file_pool_stats(ComapsFilePoolStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    (void)out_stats;
+    return -1;
+}
+
+FFI_PLUGIN_EXPORT int comaps_set_resource_pack(const char* path, int64_t offset) {
+    AGUS_TRACE_FUNCTION("ffi");
+    // Resources come from the bundle through libcomaps' own Platform here.
+    (void)path;
+    (void)offset;
+    return -1;
+}
+
+static int fillFrameStats(agus::FirstFrameStats const & stats, ComapsFirstFrameStats* out_stats) {
+    if (out_stats) {
+        out_stats->first_frame_us = stats.m_firstFrameMicros;
+        out_stats->settled_frame_us = stats.m_settledFrameMicros;
+        out_stats->frames = static_cast<int32_t>(stats.m_frames);
+        out_stats->max_frame_gap_us = stats.m_maxFrameGapMicros;
+    }
+    return stats.m_firstFrameMicros >= 0 ? 0 : -1;
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_first_frame_stats(ComapsFirstFrameStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    return fillFrameStats(agus::GetFirstFrameStats(), out_stats);
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_map_replace_frame_stats(ComapsFirstFrameStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    return fillFrameStats(agus::GetMapReplaceFrameStats(), out_stats);
+}
+
+static void fillStyleSwitchResult(agus::StyleSwitchResult const & result, ComapsStyleSwitchResult* out_result) {
+    if (out_result) {
+        out_result->dark = result.m_dark ? 1 : 0;
+        out_result->mapped = result.m_mapped ? 1 : 0;
+        out_result->changed = result.m_changed ? 1 : 0;
+        out_result->apply_us = static_cast<int64_t>(result.m_applyMicros);
+        out_result->mapped_bytes = static_cast<int64_t>(result.m_mappedBytes);
+    }
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_keep_style_files_mapped(int enabled) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::SetKeepStyleFilesMapped(enabled != 0);
+}
+
+FFI_PLUGIN_EXPORT int comaps_set_map_style(int dark, ComapsStyleSwitchResult* out_result) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework) {
+        NSLog(@"[AgusMapsFlutter] Framework not initialized");
+        return -1;
+    }
+    
+    try {
+        agus::StyleSwitchResult const result = agus::SwitchMapStyle(*g_framework, dark != 0);
+        fillStyleSwitchResult(result, out_result);
+        NSLog(@"[AgusMapsFlutter] comaps_set_map_style: %s", agus::DebugPrint(result).c_str());
+        return 0;
+    } catch (std::exception const & e) {
+        NSLog(@"[AgusMapsFlutter] Exception switching map style: %s", e.what());
+        return -2;
+    }
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_style_switch_stats(int mapped, ComapsStyleSwitchResult* out_result,
+                                                    ComapsFirstFrameStats* out_frames) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::StyleSwitchResult const result = agus::GetLastStyleSwitch(mapped != 0);
+    fillStyleSwitchResult(result, out_result);
+    fillFrameStats(agus::GetStyleSwitchFrameStats(mapped != 0), out_frames);
+    return result.m_changed ? 0 : -1;
+}
+
+FFI_PLUGIN_EXPORT int comaps_hash_files(const char* const* paths, int count, uint8_t* out_digests,
+                                        ComapsHashProgressCallback progress) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!paths || count < 0 || (count > 0 && !out_digests)) {
+        return -1;
+    }
+    std::vector<std::string> files;
+    files.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        files.emplace_back(paths[i] ? paths[i] : "");
+    }
+    
+    auto const digests = agus::HashFiles(files, std::thread::hardware_concurrency(),
+        [progress](size_t index, agus::HashStatus status, uint64_t bytes) {
+            if (progress) {
+                progress(static_cast<int32_t>(index), static_cast<int32_t>(status), static_cast<int64_t>(bytes));
+            }
+        });
+    
+    int failed = 0;
+    for (int i = 0; i < count; ++i) {
+        uint8_t* out = out_digests + static_cast<size_t>(i) * sizeof(agus::Sha256Digest);
+        if (digests[i]) {
+            std::memcpy(out, digests[i]->data(), digests[i]->size());
+        } else {
+            std::memset(out, 0, sizeof(agus::Sha256Digest));
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_font_languages(const char* languages) {
+    AGUS_TRACE_FUNCTION("ffi");
+    // Fonts come from libcomaps' own Platform here; nothing to select.
+    (void)languages;
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_download_file(const char* url, const char* file_path, int64_t file_size,
+                                               int segments) {
+    AGUS_TRACE_FUNCTION("ffi");
+    // Ranges go through libcomaps' own NSURLSession-backed HttpThread here.
+    return agus::StartFileDownload(url, file_path, file_size, static_cast<unsigned>(std::max(segments, 1)));
+}
+
+FFI_PLUGIN_EXPORT int comaps_download_get_progress(int64_t id, ComapsDownloadProgress* out_progress) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::FileDownloadProgress const progress = agus::GetFileDownloadProgress(id);
+    if (progress.m_status == agus::FileDownloadStatus::Unknown)
+        return -1;
+    if (out_progress) {
+        out_progress->status = static_cast<int32_t>(progress.m_status);
+        out_progress->bytes_downloaded = progress.m_bytesDownloaded;
+        out_progress->bytes_total = progress.m_bytesTotal;
+    }
+    return 0;
+}
+
+FFI_PLUGIN_EXPORT void comaps_download_cancel(int64_t id) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::CancelFileDownload(id);
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_update_map(const ComapsMapUpdateRequest* request) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework || !request || !request->old_path || !request->new_path || !request->full_url) {
+        return -1;
+    }
+    agus::MwmUpdateRequest update;
+    update.m_oldPath = request->old_path;
+    update.m_newPath = request->new_path;
+    update.m_diffUrl = request->diff_url ? request->diff_url : "";
+    update.m_diffSize = request->diff_size;
+    update.m_fullUrl = request->full_url;
+    update.m_fullSize = request->full_size;
+    update.m_sha256 = request->sha256 ? request->sha256 : "";
+    return agus::StartMwmUpdate(*g_framework, std::move(update));
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_map_update_progress(int64_t id, ComapsMapUpdateProgress* out_progress) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::MwmUpdateProgress const progress = agus::GetMwmUpdateProgress(id);
+    if (out_progress) {
+        out_progress->status = static_cast<int32_t>(progress.m_status);
+        out_progress->diff_failure = static_cast<int32_t>(progress.m_diffFailure);
+        out_progress->reg_result = progress.m_regResult;
+        out_progress->downloaded_bytes = progress.m_downloadedBytes;
+        out_progress->full_bytes = progress.m_fullBytes;
+        out_progress->bytes_saved = progress.m_bytesSaved;
+        out_progress->apply_us = static_cast<int64_t>(progress.m_applyMicros);
+        out_progress->verify_us = static_cast<int64_t>(progress.m_verifyMicros);
+        out_progress->total_us = static_cast<int64_t>(progress.m_totalMicros);
+    }
+    return progress.m_status == agus::MwmUpdateStatus::Unknown ? -1 : 0;
+}
+
+FFI_PLUGIN_EXPORT void comaps_cancel_map_update(int64_t id) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::CancelMwmUpdate(id);
+}
+
+// Map fetches stream over agus_http, which is only built for Android (TLS comes from
+// the JVM there); on Apple platforms use comaps_download_file and comaps_hash_files.
+FFI_PLUGIN_EXPORT void comaps_set_map_fetch_budget(const ComapsMapFetchBudget* budget) {
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_fetch_map(const char* url, const char* file_path, int64_t file_size,
+                                           const char* sha256, int register_map) {
+    NSLog(@"[AgusMapsFlutter] comaps_fetch_map: not supported (%s)", file_path);
+    return -1;
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_map_fetch_progress(int64_t id, ComapsMapFetchProgress* out_progress) {
+    return -1;
+}
+
+FFI_PLUGIN_EXPORT void comaps_cancel_map_fetch(int64_t id) {
+}
+
+// Also built on agus_http; comaps_download_file fetches segments from a single mirror here.
+FFI_PLUGIN_EXPORT int64_t comaps_download_from_mirrors(const char* const* urls, int url_count,
+                                                       const char* file_path, int64_t file_size,
+                                                       int connections_per_mirror) {
+    NSLog(@"[AgusMapsFlutter] comaps_download_from_mirrors: not supported (%s)", file_path);
+    return -1;
+}
+
+FFI_PLUGIN_EXPORT int comaps_mirror_download_get_progress(int64_t id, ComapsDownloadProgress* out_progress,
+                                                          ComapsMirrorStats* out_mirrors, int mirror_count) {
+    return -1;
+}
+
+FFI_PLUGIN_EXPORT void comaps_mirror_download_cancel(int64_t id) {
+}
+
+FFI_PLUGIN_EXPORT void comaps_trace_start(int max_events_per_thread) {
+    agus::StartTrace(max_events_per_thread > 0 ? static_cast<size_t>(max_events_per_thread)
+                                               : agus::kDefaultTraceEventsPerThread);
+}
+
+FFI_PLUGIN_EXPORT void comaps_trace_stop(void) {
+    agus::StopTrace();
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_trace_dump(const char* path) {
+    if (!path) {
+        return -1;
+    }
+    return agus::WriteTraceJson(path);
+}
+
+FFI_PLUGIN_EXPORT int comaps_metrics_snapshot(char* buffer, int buffer_size) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::string const snapshot = agus::GetMetricsSnapshotJson();
+    if (buffer && buffer_size > 0) {
+        size_t const n = std::min(snapshot.size(), static_cast<size_t>(buffer_size - 1));
+        memcpy(buffer, snapshot.data(), n);
+        buffer[n] = '\0';
+    }
+    return static_cast<int>(snapshot.size());
+}
+
+// Batch point lookup over registered region maps, see agus::FindMwmsAt.
+FFI_PLUGIN_EXPORT int comaps_find_mwms_at(const ComapsLatLon* points, int count, ComapsMwmHit* out_hits) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework) {
+        NSLog(@"[AgusMapsFlutter] Framework not initialized");
+        return -1;
+    }
+    if (!points || !out_hits || count <= 0) {
+        return 0;
+    }
+    
+    std::vector<m2::PointD> mercatorPoints;
+    mercatorPoints.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        mercatorPoints.push_back(mercator::FromLatLon(points[i].lat, points[i].lon));
+    }
+    
+    std::vector<agus::MwmHit> hits;
+    agus::FindMwmsAt(g_framework->GetDataSource(), mercatorPoints, hits);
+    
+    int covered = 0;
+    for (int i = 0; i < count; ++i) {
+        ComapsMwmHit & out = out_hits[i];
+        size_t const n = std::min(hits[i].m_countryName.size(), sizeof(out.country_name) - 1);
+        memcpy(out.country_name, hits[i].m_countryName.data(), n);
+        out.country_name[n] = '\0';
+        out.version = hits[i].m_version;
+        if (n > 0) {
+            ++covered;
+        }
+    }
+    return covered;
+}
+
 FFI_PLUGIN_EXPORT void comaps_debug_list_mwms(void) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] === DEBUG: Listing all registered MWMs ===");
     
     if (!g_framework) {
@@ -240,6 +745,7 @@ FFI_PLUGIN_EXPORT void comaps_debug_list_mwms(void) {
 }
 
 FFI_PLUGIN_EXPORT void comaps_debug_check_point(double lat, double lon) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] comaps_debug_check_point: lat=%.6f, lon=%.6f", lat, lon);
     
     if (!g_framework) {
@@ -271,6 +777,7 @@ static void createDrapeEngineIfNeeded(int width, int height, float density) {
     if (g_drapeEngineCreated || !g_framework || !g_threadSafeFactory) {
         return;
     }
+    AGUS_TRACE_SCOPE("startup", "CreateDrapeEngine");
     
     if (width <= 0 || height <= 0) {
         NSLog(@"[AgusMapsFlutter] createDrapeEngine: Invalid dimensions %dx%d", width, height);
@@ -280,6 +787,8 @@ static void createDrapeEngineIfNeeded(int width, int height, float density) {
     // Register active frame callback BEFORE creating DrapeEngine
     // This callback is invoked only when isActiveFrame is true (Option 3)
     df::SetActiveFrameCallback([]() {
+        agus::OnActiveFrame();
+        agus::OnStartupFrame();
         notifyFlutterFrameReady();
     });
     NSLog(@"[AgusMapsFlutter] Active frame callback registered");
@@ -293,7 +802,11 @@ static void createDrapeEngineIfNeeded(int width, int height, float density) {
     NSLog(@"[AgusMapsFlutter] createDrapeEngine: Creating with %dx%d, scale=%.2f, API=Metal", 
           width, height, density);
     
-    g_framework->CreateDrapeEngine(make_ref(g_threadSafeFactory), std::move(p));
+    agus::OnDrapeEngineCreating();
+    {
+        agus::ScopedStartupPhase phase("CreateDrapeEngine");
+        g_framework->CreateDrapeEngine(make_ref(g_threadSafeFactory), std::move(p));
+    }
     g_drapeEngineCreated = true;
     
     NSLog(@"[AgusMapsFlutter] DrapeEngine created successfully");
@@ -314,6 +827,7 @@ extern "C" FFI_PLUGIN_EXPORT void agus_native_set_surface(
     int32_t height,
     float density
 ) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] agus_native_set_surface: texture=%lld, %dx%d, density=%.2f",
           textureId, width, height, density);
     
@@ -326,21 +840,60 @@ extern "C" FFI_PLUGIN_EXPORT void agus_native_set_surface(
     g_surfaceWidth = width;
     g_surfaceHeight = height;
     g_density = density;
+    agus::SetRenderSurfaceSize(width, height);
     
     // Create Framework on this thread if not already created
     if (!g_framework) {
         NSLog(@"[AgusMapsFlutter] Creating Framework...");
         
         FrameworkParams params;
+        // Storage's own diff pipeline needs CoMaps' map servers; maps downloaded through
+        // the plugin are updated from diffs by agus::StartMwmUpdate instead.
         params.m_enableDiffs = false;
-        params.m_numSearchAPIThreads = 1;
+        params.m_numSearchAPIThreads = g_threadConfig.m_searchThreads;
         
-        g_framework = std::make_unique<Framework>(params, false /* loadMaps */);
+        agus::BeginStartupTrace();
+        {
+            // Data files are read into the page cache while the constructor runs
+            agus::ScopedStartupPhase phase("Framework");
+            agus::StartupPreloader preloader(Platform::CpuCores());
+            g_framework = std::make_unique<Framework>(params, false /* loadMaps */);
+        }
         NSLog(@"[AgusMapsFlutter] Framework created");
         
+        // Lets the shared comaps_on_memory_pressure reach the framework and the surface
+        agus::SetEngineHost({
+            []() { return g_framework.get(); },
+            []() { return g_surfaceAttached && g_drapeEngineCreated; },
+            []() {
+                if (!g_surfaceAttached || !g_framework || !g_threadSafeFactory) {
+                    return false;
+                }
+                g_framework->SetRenderingDisabled(true /* destroySurface */);
+                g_framework->SetRenderingEnabled(make_ref(g_threadSafeFactory));
+                return true;
+            },
+        });
+        
         // Register maps
-        g_framework->RegisterAllMaps();
+        if (agus::GetStartupMode() == agus::StartupMode::RenderFirst) {
+            // World maps draw the first frame; the rest register in view, or once it's up
+            agus::ScopedStartupPhase phase("RegisterWorldMapsOnly");
+            agus::RegisterWorldMapsOnly(*g_framework);
+        } else {
+            agus::ScopedStartupPhase phase("RegisterAllMaps");
+            g_framework->RegisterAllMaps();
+        }
+        // Off the GUI thread: registering hundreds of maps would stall gestures
+        agus::RunInBackgroundAfterFirstFrame("Register deferred maps", []() {
+            if (g_framework) {
+                agus::RegisterLazyMapsIn(*g_framework, mercator::Bounds::FullRect());
+            }
+        });
         NSLog(@"[AgusMapsFlutter] Maps registered");
+        
+        // Maps recorded with comaps_register_map_lazy open on first use: in view, searched or routed through
+        agus::AttachLazyMaps(*g_framework, nullptr);
     }
     
     // Create Metal context factory with the CVPixelBuffer
@@ -362,16 +915,19 @@ extern "C" FFI_PLUGIN_EXPORT void agus_native_set_surface(
     // Enable rendering
     if (g_framework && g_drapeEngineCreated) {
         g_framework->SetRenderingEnabled(make_ref(g_threadSafeFactory));
+        g_surfaceAttached = true;
         NSLog(@"[AgusMapsFlutter] Rendering enabled");
     }
 }
 
 /// Called when Swift resizes the surface
 extern "C" FFI_PLUGIN_EXPORT void agus_native_on_size_changed(int32_t width, int32_t height) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] agus_native_on_size_changed: %dx%d", width, height);
     
     g_surfaceWidth = width;
     g_surfaceHeight = height;
+    agus::SetRenderSurfaceSize(width, height);
     
     if (g_framework && g_drapeEngineCreated) {
         g_framework->OnSize(width, height);
@@ -380,14 +936,17 @@ extern "C" FFI_PLUGIN_EXPORT void agus_native_on_size_changed(int32_t width, int
 
 /// Called when Swift destroys the surface
 extern "C" FFI_PLUGIN_EXPORT void agus_native_on_surface_destroyed(void) {
+    AGUS_TRACE_FUNCTION("ffi");
     NSLog(@"[AgusMapsFlutter] agus_native_on_surface_destroyed");
     
+    g_surfaceAttached = false;
     if (g_framework) {
         g_framework->SetRenderingDisabled(true /* destroySurface */);
     }
     
     g_threadSafeFactory.reset();
     g_drapeEngineCreated = false;
+    agus::SetRenderSurfaceSize(0, 0);
 }
 
 /// Called by native code to notify Swift that a new frame is ready
@@ -456,6 +1015,7 @@ extern "C" void agus_notify_frame_ready(void) {
 
 /// Called to render a single frame - this is triggered by Flutter's texture system
 extern "C" FFI_PLUGIN_EXPORT void agus_render_frame(void) {
+    AGUS_TRACE_FUNCTION("ffi");
     if (!g_framework || !g_drapeEngineCreated) {
         return;
     }
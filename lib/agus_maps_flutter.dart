@@ -1,4 +1,5 @@
 import 'dart:async';
+import 'dart:convert';
 import 'package:flutter/material.dart';
 import 'dart:ffi' hide Size;
 import 'dart:io';
@@ -56,6 +57,33 @@ Future<String> extractDataFiles() async {
   return path!;
 }
 
+/// Serves CoMaps data files from a single pack asset (see
+/// scripts/build_resource_pack.py) instead of extracting them one by one.
+/// Files present in the data directory still take precedence. Call before the
+/// map is created; returns false if the app ships no pack or the platform
+/// doesn't support packs (Android only), in which case use [extractDataFiles].
+Future<bool> useResourcePack([
+  String assetPath = 'assets/comaps_data.pack',
+]) async {
+  if (!Platform.isAndroid) return false;
+  final Map<Object?, Object?>? location = await _channel.invokeMethod(
+    'locateResourcePack',
+    {'assetPath': assetPath},
+  );
+  if (location == null) return false;
+
+  final pathPtr = (location['path'] as String).toNativeUtf8().cast<Char>();
+  try {
+    return _bindings.comaps_set_resource_pack(
+          pathPtr,
+          location['offset'] as int,
+        ) ==
+        0;
+  } finally {
+    malloc.free(pathPtr);
+  }
+}
+
 Future<String> getApkPath() async {
   final String? path = await _channel.invokeMethod('getApkPath');
   return path!;
@@ -69,13 +97,149 @@ void init(String apkPath, String storagePath) {
   malloc.free(storagePathPtr);
 }
 
+/// Thread budget for the engine.
+///
+/// A null field is sized automatically from the number of CPU cores.
+class ThreadConfig {
+  /// Threads used by the search engine.
+  final int? searchThreads;
+
+  /// Platform network pool (Android only).
+  final int? networkThreads;
+
+  /// Platform file pool (Android only). Always 1, other values are ignored:
+  /// the pool serializes bookmark and settings writes.
+  final int? fileThreads;
+
+  /// Platform background pool (Android only).
+  final int? backgroundThreads;
+
+  /// Threads reading tile geometry for the renderer.
+  final int? readThreads;
+
+  const ThreadConfig({
+    this.searchThreads,
+    this.networkThreads,
+    this.fileThreads,
+    this.backgroundThreads,
+    this.readThreads,
+  });
+
+  @override
+  String toString() =>
+      'ThreadConfig(search=$searchThreads, network=$networkThreads, '
+      'file=$fileThreads, background=$backgroundThreads, read=$readThreads)';
+}
+
 /// Initialize CoMaps with separate resource and writable paths
-void initWithPaths(String resourcePath, String writablePath) {
+///
+/// [threads] overrides the automatically sized thread budget.
+void initWithPaths(
+  String resourcePath,
+  String writablePath, {
+  ThreadConfig? threads,
+}) {
   final resourcePathPtr = resourcePath.toNativeUtf8().cast<Char>();
   final writablePathPtr = writablePath.toNativeUtf8().cast<Char>();
-  _bindings.comaps_init_paths(resourcePathPtr, writablePathPtr);
-  malloc.free(resourcePathPtr);
-  malloc.free(writablePathPtr);
+  final configPtr = threads == null
+      ? nullptr
+      : (calloc<ComapsThreadConfig>()
+          ..ref.search_threads = threads.searchThreads ?? 0
+          ..ref.network_threads = threads.networkThreads ?? 0
+          ..ref.file_threads = threads.fileThreads ?? 0
+          ..ref.background_threads = threads.backgroundThreads ?? 0
+          ..ref.read_threads = threads.readThreads ?? 0);
+  try {
+    _bindings.comaps_init_paths_with_config(
+      resourcePathPtr,
+      writablePathPtr,
+      configPtr,
+    );
+  } finally {
+    malloc.free(resourcePathPtr);
+    malloc.free(writablePathPtr);
+    if (configPtr != nullptr) calloc.free(configPtr);
+  }
+}
+
+/// The thread budget in effect after automatic sizing.
+ThreadConfig getThreadConfig() {
+  final config = calloc<ComapsThreadConfig>();
+  try {
+    _bindings.comaps_get_thread_config(config);
+    return ThreadConfig(
+      searchThreads: config.ref.search_threads,
+      networkThreads: config.ref.network_threads,
+      fileThreads: config.ref.file_threads,
+      backgroundThreads: config.ref.background_threads,
+      readThreads: config.ref.read_threads,
+    );
+  } finally {
+    calloc.free(config);
+  }
+}
+
+/// Utilization counters of one native worker pool.
+class ThreadPoolStats {
+  final String name;
+  final int threads;
+  final int tasksCompleted;
+
+  /// Tasks queued or currently running.
+  final int tasksPending;
+  final Duration busy;
+  final Duration uptime;
+
+  const ThreadPoolStats({
+    required this.name,
+    required this.threads,
+    required this.tasksCompleted,
+    required this.tasksPending,
+    required this.busy,
+    required this.uptime,
+  });
+
+  /// Fraction of available thread time spent running tasks, in [0, 1].
+  double get utilization {
+    final available = uptime.inMicroseconds * threads;
+    if (available <= 0) return 0;
+    return (busy.inMicroseconds / available).clamp(0.0, 1.0);
+  }
+
+  @override
+  String toString() =>
+      'ThreadPoolStats($name: threads=$threads, completed=$tasksCompleted, '
+      'pending=$tasksPending, utilization=${(utilization * 100).toStringAsFixed(1)}%)';
+}
+
+/// Per-pool utilization of the native worker pools.
+List<ThreadPoolStats> getThreadPoolStats() {
+  const maxPools = 8;
+  final stats = calloc<ComapsThreadPoolStats>(maxPools);
+  try {
+    final count = _bindings.comaps_get_thread_pool_stats(stats, maxPools);
+    return [
+      for (var i = 0; i < count && i < maxPools; i++)
+        ThreadPoolStats(
+          name: _readFixedString(stats[i].name, 16),
+          threads: stats[i].threads,
+          tasksCompleted: stats[i].tasks_completed,
+          tasksPending: stats[i].tasks_pending,
+          busy: Duration(microseconds: stats[i].busy_us),
+          uptime: Duration(microseconds: stats[i].uptime_us),
+        ),
+    ];
+  } finally {
+    calloc.free(stats);
+  }
+}
+
+String _readFixedString(Array<Char> chars, int length) {
+  final codes = <int>[];
+  for (var i = 0; i < length && chars[i] != 0; i++) {
+    codes.add(chars[i]);
+  }
+  return String.fromCharCodes(codes);
 }
 
 void loadMap(String path) {
@@ -103,6 +267,1314 @@ int registerSingleMap(String fullPath) {
   }
 }
 
+/// Register an MWM stored uncompressed in a zip archive, read in place.
+///
+/// [entryName] is the path inside [archivePath]. The entry must be stored
+/// without compression (`noCompress("mwm")` in the app's build.gradle).
+/// Android only.
+///
+/// Returns the [registerSingleMap] codes, or -3 if the entry is missing or
+/// compressed.
+int registerMapFromArchive(String archivePath, String entryName) {
+  final archivePtr = archivePath.toNativeUtf8().cast<Char>();
+  final entryPtr = entryName.toNativeUtf8().cast<Char>();
+  try {
+    return _bindings.comaps_register_map_in_archive(archivePtr, entryPtr);
+  } finally {
+    malloc.free(archivePtr);
+    malloc.free(entryPtr);
+  }
+}
+
+/// Register an MWM bundled as a Flutter asset (e.g. 'assets/maps/World.mwm').
+///
+/// On Android the map is read straight from the APK instead of being copied
+/// out with [extractMap]; elsewhere it is extracted and registered as a file.
+Future<int> registerBundledMap(String assetPath) async {
+  if (!Platform.isAndroid) {
+    return registerSingleMap(await extractMap(assetPath));
+  }
+  // Flutter stores assets under assets/flutter_assets/ in the APK.
+  return registerMapFromArchive(
+    await getApkPath(),
+    'assets/flutter_assets/$assetPath',
+  );
+}
+
+/// Record an MWM file for lazy registration.
+///
+/// Only the file header (bounds and version) is read now; the map is opened
+/// in the background once the viewport first shows it at a zoom where region
+/// maps are drawn, before a search that reads it, or when a route needs it.
+/// Use this instead of [registerSingleMap] for large sets of regions to keep
+/// startup time and open file handles independent of the region count. May be
+/// called before the map surface exists.
+///
+/// Returns 0 on success, -2 if the file header can't be read.
+int registerMapLazy(String fullPath) {
+  final pathPtr = fullPath.toNativeUtf8().cast<Char>();
+  try {
+    return _bindings.comaps_register_map_lazy(pathPtr);
+  } finally {
+    malloc.free(pathPtr);
+  }
+}
+
+/// Outcome of [registerMapsLazy].
+class LazyRegistrationStats {
+  final int recorded;
+
+  /// Files that are missing or have unreadable headers.
+  final int failed;
+
+  /// Maps recorded from the registration snapshot without opening them.
+  final int fromSnapshot;
+  final Duration elapsed;
+
+  const LazyRegistrationStats({
+    required this.recorded,
+    required this.failed,
+    required this.fromSnapshot,
+    required this.elapsed,
+  });
+
+  @override
+  String toString() =>
+      'LazyRegistrationStats(recorded=$recorded, failed=$failed, '
+      'fromSnapshot=$fromSnapshot, elapsed=${elapsed.inMilliseconds}ms)';
+}
+
+/// [registerMapLazy] for many files in one call.
+///
+/// Bounds and versions of files unchanged since an earlier launch (same path,
+/// size and modification time) come from a snapshot in the writable
+/// directory, so startup does not open them at all. This only moves their
+/// cost: a map is still read in full when it is registered on first use. Set
+/// [useSnapshot] to false to read every header instead, e.g. to compare launch
+/// times.
+LazyRegistrationStats registerMapsLazy(
+  List<String> fullPaths, {
+  bool useSnapshot = true,
+}) {
+  final paths = calloc<Pointer<Char>>(fullPaths.length);
+  final stats = calloc<ComapsLazyBatchStats>();
+  try {
+    for (var i = 0; i < fullPaths.length; i++) {
+      paths[i] = fullPaths[i].toNativeUtf8().cast<Char>();
+    }
+    _bindings.comaps_register_maps_lazy(
+      paths,
+      fullPaths.length,
+      useSnapshot ? 1 : 0,
+      stats,
+    );
+    return LazyRegistrationStats(
+      recorded: stats.ref.recorded,
+      failed: stats.ref.failed,
+      fromSnapshot: stats.ref.from_snapshot,
+      elapsed: Duration(microseconds: stats.ref.elapsed_us),
+    );
+  } finally {
+    for (var i = 0; i < fullPaths.length; i++) {
+      if (paths[i] != nullptr) malloc.free(paths[i]);
+    }
+    calloc.free(paths);
+    calloc.free(stats);
+  }
+}
+
+/// Register the lazily recorded maps intersecting an area, e.g. to have them
+/// open before the viewport moves there. Runs on the calling thread.
+///
+/// Returns the number of maps registered, -1 if the framework is not
+/// initialized.
+int registerMapsInRect(
+  double minLat,
+  double minLon,
+  double maxLat,
+  double maxLon,
+) {
+  return _bindings.comaps_register_maps_in_rect(minLat, minLon, maxLat, maxLon);
+}
+
+/// Number of maps recorded with [registerMapLazy] that were not opened yet.
+int getPendingMapsCount() => _bindings.comaps_get_pending_maps_count();
+
+/// Deregister the map of the country named by [fullPath]'s file name and
+/// re-render its tiles.
+///
+/// Returns 0 on success, -1 if the framework is not initialized or no such
+/// map is registered, -2 on exception.
+int deregisterMap(String fullPath) {
+  final pathPtr = fullPath.toNativeUtf8().cast<Char>();
+  try {
+    return _bindings.comaps_deregister_map(pathPtr);
+  } finally {
+    malloc.free(pathPtr);
+  }
+}
+
+/// Outcome of [replaceMap].
+class MapReplaceResult {
+  /// 0 on success, -1 if the framework is not initialized, -2 on exception,
+  /// -3 if the path is the registered file itself, otherwise the
+  /// MwmSet::RegResult error code.
+  final int result;
+
+  /// Data version of the replaced map, null if none was registered.
+  final int? oldVersion;
+  final int newVersion;
+
+  /// How long map data access was blocked by the swap.
+  final Duration swap;
+
+  /// Time spent invalidating the region's tiles.
+  final Duration invalidate;
+
+  const MapReplaceResult({
+    required this.result,
+    this.oldVersion,
+    required this.newVersion,
+    required this.swap,
+    required this.invalidate,
+  });
+
+  bool get isSuccess => result == 0;
+
+  @override
+  String toString() =>
+      'MapReplaceResult(result=$result, version=$oldVersion->$newVersion, '
+      'swap=${swap.inMicroseconds}us, invalidate=${invalidate.inMicroseconds}us)';
+}
+
+/// Swap in a new version of a registered map without recreating the map.
+///
+/// A newer version replaces the old one in one step. The same or an older
+/// version is registered once the old one is deregistered, and fails while
+/// reads still hold the old file. Reads in flight finish on the old version,
+/// then it is closed. Only tiles inside the region are re-rendered; follow up with [getMapReplaceFrameStats]
+/// to see how long that took. [fullPath] must not be the path of the
+/// registered file: download the update next to it, replace, then delete the
+/// old file.
+MapReplaceResult replaceMap(String fullPath) {
+  final pathPtr = fullPath.toNativeUtf8().cast<Char>();
+  final out = calloc<ComapsMapReplaceResult>();
+  try {
+    final result = _bindings.comaps_replace_map(pathPtr, out);
+    return MapReplaceResult(
+      result: result,
+      oldVersion: out.ref.old_version < 0 ? null : out.ref.old_version,
+      newVersion: out.ref.new_version,
+      swap: Duration(microseconds: out.ref.swap_us),
+      invalidate: Duration(microseconds: out.ref.invalidate_us),
+    );
+  } finally {
+    malloc.free(pathPtr);
+    calloc.free(out);
+  }
+}
+
+/// Memory pressure levels for [onMemoryPressure], ordered by severity.
+enum MemoryPressureLevel {
+  /// Drop search caches.
+  moderate, // 1
+  /// Also drop MWM reader and feature caches.
+  low, // 2
+  /// Also drop Drape tile geometry, then glyph and symbol textures.
+  /// Visible tiles are re-read right away; Drape steps are skipped while
+  /// there is no render surface.
+  critical, // 3
+}
+
+/// Bytes released by each step of [onMemoryPressure]: Drape's own count for
+/// the textures, the resident set delta for the rest.
+class MemoryTrimReport {
+  final int searchCachesFreed;
+  final int readerCachesFreed;
+  final int drapeTilesFreed;
+  final int drapeTexturesFreed;
+  final int allocatorFreed;
+
+  const MemoryTrimReport({
+    required this.searchCachesFreed,
+    required this.readerCachesFreed,
+    required this.drapeTilesFreed,
+    required this.drapeTexturesFreed,
+    required this.allocatorFreed,
+  });
+
+  int get drapeCachesFreed => drapeTilesFreed + drapeTexturesFreed;
+
+  int get totalFreed =>
+      searchCachesFreed + readerCachesFreed + drapeCachesFreed + allocatorFreed;
+
+  @override
+  String toString() =>
+      'MemoryTrimReport(search=$searchCachesFreed, readers=$readerCachesFreed, '
+      'drape_tiles=$drapeTilesFreed, drape_textures=$drapeTexturesFreed, '
+      'allocator=$allocatorFreed, total=$totalFreed)';
+}
+
+/// Trim engine caches in graded steps.
+///
+/// Each step up to [level] runs in order on the engine's threads, so neither
+/// this isolate nor the UI thread waits for the render thread. Completes with
+/// the memory each step released, or null if the framework is not
+/// initialized yet.
+Future<MemoryTrimReport?> onMemoryPressure(MemoryPressureLevel level) {
+  final completer = Completer<MemoryTrimReport?>();
+  late final NativeCallable<ComapsTrimCallbackFunction> callback;
+  callback = NativeCallable<ComapsTrimCallbackFunction>.listener((
+    int searchCachesFreed,
+    int readerCachesFreed,
+    int drapeTilesFreed,
+    int drapeTexturesFreed,
+    int allocatorFreed,
+  ) {
+    callback.close();
+    completer.complete(
+      MemoryTrimReport(
+        searchCachesFreed: searchCachesFreed,
+        readerCachesFreed: readerCachesFreed,
+        drapeTilesFreed: drapeTilesFreed,
+        drapeTexturesFreed: drapeTexturesFreed,
+        allocatorFreed: allocatorFreed,
+      ),
+    );
+  });
+  final started = _bindings.comaps_on_memory_pressure(
+    level.index + 1,
+    callback.nativeFunction,
+  );
+  if (started < 0) {
+    callback.close();
+    completer.complete(null);
+  }
+  return completer.future;
+}
+
+/// Current process memory summary (RSS, PSS, estimated GPU surface memory
+/// and Drape's textures).
+String getMemoryInfo() {
+  const bufferSize = 256;
+  final buffer = calloc<Char>(bufferSize);
+  try {
+    _bindings.comaps_get_memory_info(buffer, bufferSize);
+    return buffer.cast<Utf8>().toDartString();
+  } finally {
+    calloc.free(buffer);
+  }
+}
+
+/// Timeline of the last map engine startup as Chrome trace event JSON.
+///
+/// Covers the steps of Framework construction (classificator and drules,
+/// categories, country info, search, bookmarks and storage, routing, ...),
+/// the reads warming the page cache for them, map registration and drape
+/// engine creation. Save it to a .json file and open it in chrome://tracing or
+/// https://ui.perfetto.dev.
+String getStartupTrace() {
+  final length = _bindings.comaps_get_startup_trace(nullptr, 0);
+  final buffer = calloc<Char>(length + 1);
+  try {
+    _bindings.comaps_get_startup_trace(buffer, length + 1);
+    return buffer.cast<Utf8>().toDartString();
+  } finally {
+    calloc.free(buffer);
+  }
+}
+
+/// Starts recording an engine trace: plugin calls, GUI and worker pool tasks
+/// (file, network, background), frame presents, MWM file reads and
+/// startup phases, each on the thread it ran on. Any previous recording is
+/// dropped. Each thread keeps up to [maxEventsPerThread] events (the native
+/// default if null); later ones are dropped.
+///
+/// Recording costs little, but more than nothing: stop it once the frame drop
+/// or stall of interest was captured.
+void startTrace({int? maxEventsPerThread}) {
+  _bindings.comaps_trace_start(maxEventsPerThread ?? 0);
+}
+
+/// Stops the recording started by [startTrace], keeping it for [dumpTrace].
+void stopTrace() => _bindings.comaps_trace_stop();
+
+/// Writes the recording to [file] as Chrome trace event JSON, to open in
+/// chrome://tracing or https://ui.perfetto.dev. Can be called while recording.
+///
+/// Returns the number of events written.
+int dumpTrace(File file) {
+  final pathPtr = file.path.toNativeUtf8().cast<Char>();
+  try {
+    final count = _bindings.comaps_trace_dump(pathPtr);
+    if (count < 0) {
+      throw FileSystemException('Cannot write trace', file.path);
+    }
+    return count;
+  } finally {
+    malloc.free(pathPtr);
+  }
+}
+
+/// Current engine metrics, decoded from JSON:
+/// `{"uptime_us": N, "counters": {...}, "gauges": {...}, "histograms": {...}}`.
+///
+/// Counters (e.g. `mwm.bytes_read`, `tiles.loaded`, `texture.upload_bytes`)
+/// are totals since process start, so compare two snapshots for a rate.
+/// Gauges (e.g. `memory.rss_bytes`, `gui.queue_depth`) are current values.
+/// Each histogram (e.g. `frame.interval_us`, `search.latency_us`) has `count`,
+/// `sum`, `max`, `p50`, `p90` and `p99`; percentiles are within a factor of
+/// two.
+Map<String, dynamic> getMetricsSnapshot() {
+  var size = 16 * 1024;
+  while (true) {
+    final buffer = calloc<Char>(size);
+    try {
+      final length = _bindings.comaps_metrics_snapshot(buffer, size);
+      if (length < size) {
+        return jsonDecode(buffer.cast<Utf8>().toDartString())
+            as Map<String, dynamic>;
+      }
+      // Metrics may be added between calls, so leave some room.
+      size = length + 1024;
+    } finally {
+      calloc.free(buffer);
+    }
+  }
+}
+
+/// How much of the engine is brought up before the first frame.
+enum StartupMode {
+  /// Every local map is registered before the first frame, by the engine's
+  /// own map registration.
+  full,
+
+  /// Only the world maps are registered before the first frame. Other maps
+  /// register as the viewport reaches them, and the remaining ones on an idle
+  /// task once the first frame is drawn (until then search and routing don't
+  /// see them). Search, routing and bookmarks are still set up before the
+  /// first frame.
+  renderFirst,
+}
+
+/// Selects the [StartupMode] of the next map engine startup. Call before the
+/// map widget is created.
+void setStartupMode(StartupMode mode) {
+  _bindings.comaps_set_startup_mode(mode.index);
+}
+
+/// Time to first frame and deferred work of the last map engine startup.
+class StartupReport {
+  final StartupMode mode;
+
+  /// From the start of Framework creation, null if no frame was drawn yet.
+  final Duration? firstFrame;
+
+  /// Framework construction, null if it wasn't traced.
+  final Duration? framework;
+
+  /// Work moved behind the first frame, finished so far.
+  final Duration deferred;
+  final int deferredTasks;
+
+  const StartupReport({
+    required this.mode,
+    required this.firstFrame,
+    required this.framework,
+    required this.deferred,
+    required this.deferredTasks,
+  });
+
+  @override
+  String toString() =>
+      'StartupReport(${mode.name}, firstFrame=${firstFrame?.inMilliseconds}ms, '
+      'framework=${framework?.inMilliseconds}ms, '
+      'deferred=${deferred.inMilliseconds}ms in $deferredTasks tasks)';
+}
+
+StartupReport getStartupReport() {
+  final report = calloc<ComapsStartupReport>();
+  try {
+    _bindings.comaps_get_startup_report(report);
+    Duration? micros(int value) =>
+        value < 0 ? null : Duration(microseconds: value);
+    return StartupReport(
+      mode: StartupMode.values[report.ref.mode],
+      firstFrame: micros(report.ref.first_frame_us),
+      framework: micros(report.ref.framework_us),
+      deferred: Duration(microseconds: report.ref.deferred_us),
+      deferredTasks: report.ref.deferred_tasks,
+    );
+  } finally {
+    calloc.free(report);
+  }
+}
+
+/// Usage of the descriptor pool shared by MWM file readers.
+class FilePoolStats {
+  final int limit;
+
+  /// Map files with live readers.
+  final int files;
+
+  /// Of [files], those holding a descriptor right now.
+  final int openDescriptors;
+  final int opens;
+
+  /// Opens of files that had been evicted before. A high share of [opens]
+  /// means the limit is below the working set of maps.
+  final int reopens;
+  final int evictions;
+
+  const FilePoolStats({
+    required this.limit,
+    required this.files,
+    required this.openDescriptors,
+    required this.opens,
+    required this.reopens,
+    required this.evictions,
+  });
+
+  double get reopenRate => opens == 0 ? 0 : reopens / opens;
+
+  @override
+  String toString() =>
+      'FilePoolStats(open=$openDescriptors/$limit, files=$files, '
+      'opens=$opens, reopens=$reopens, evictions=$evictions)';
+}
+
+/// Caps the file descriptors held by MWM readers. Least recently read map
+/// files are closed when the cap is reached and reopened on their next read.
+/// Android only.
+void setFilePoolLimit(int limit) {
+  _bindings.comaps_set_file_pool_limit(limit);
+}
+
+/// Descriptor pool counters, null on platforms without the pool.
+FilePoolStats? getFilePoolStats() {
+  final stats = calloc<ComapsFilePoolStats>();
+  try {
+    if (_bindings.comaps_get_file_pool_stats(stats) != 0) return null;
+    return FilePoolStats(
+      limit: stats.ref.limit,
+      files: stats.ref.files,
+      openDescriptors: stats.ref.open_descriptors,
+      opens: stats.ref.opens,
+      reopens: stats.ref.reopens,
+      evictions: stats.ref.evictions,
+    );
+  } finally {
+    calloc.free(stats);
+  }
+}
+
+/// Timing of the first frames after the map engine was created, or after
+/// a map was replaced (see [getMapReplaceFrameStats]).
+class FirstFrameStats {
+  /// Time until the first rendered frame, null if none yet.
+  final Duration? firstFrame;
+
+  /// Time until rendering went quiet with all tiles and labels in place,
+  /// null if the initial burst of frames is still going on.
+  final Duration? settledFrame;
+
+  /// Frames rendered until settled (or so far).
+  final int frames;
+
+  /// Longest wait for the next frame, i.e. the worst render stall.
+  final Duration maxFrameGap;
+
+  const FirstFrameStats({
+    this.firstFrame,
+    this.settledFrame,
+    required this.frames,
+    this.maxFrameGap = Duration.zero,
+  });
+
+  @override
+  String toString() =>
+      'FirstFrameStats(first=${firstFrame?.inMilliseconds}ms, '
+      'settled=${settledFrame?.inMilliseconds}ms, frames=$frames, '
+      'maxGap=${maxFrameGap.inMilliseconds}ms)';
+}
+
+FirstFrameStats _readFrameStats(
+  int Function(Pointer<ComapsFirstFrameStats>) query,
+) {
+  final stats = calloc<ComapsFirstFrameStats>();
+  try {
+    query(stats);
+    Duration? toDuration(int us) => us < 0 ? null : Duration(microseconds: us);
+    return FirstFrameStats(
+      firstFrame: toDuration(stats.ref.first_frame_us),
+      settledFrame: toDuration(stats.ref.settled_frame_us),
+      frames: stats.ref.frames,
+      maxFrameGap: Duration(microseconds: stats.ref.max_frame_gap_us),
+    );
+  } finally {
+    calloc.free(stats);
+  }
+}
+
+/// How long the first frames took after the map engine was created.
+FirstFrameStats getFirstFrameStats() =>
+    _readFrameStats(_bindings.comaps_get_first_frame_stats);
+
+/// How rendering recovered from the last [replaceMap]: time until the
+/// replaced region's tiles were drawn and the longest frame gap on the way,
+/// the render stall. Timed from the start of the swap.
+FirstFrameStats getMapReplaceFrameStats() =>
+    _readFrameStats(_bindings.comaps_get_map_replace_frame_stats);
+
+/// Keep the light and the dark style resources mapped so that [setMapStyle]
+/// opens no files: the drawing rules, the classificator and, once each style
+/// loaded them, its symbol textures. The switch still reloads the style in
+/// the engine and redraws every tile. Turning it off unmaps them. Android only.
+void setKeepStyleFilesMapped(bool enabled) =>
+    _bindings.comaps_set_keep_style_files_mapped(enabled ? 1 : 0);
+
+/// Outcome of a light/dark style switch.
+class StyleSwitchResult {
+  final bool dark;
+
+  /// Made with the style files kept mapped (see [setKeepStyleFilesMapped]).
+  final bool mapped;
+
+  /// False if the style was current already.
+  final bool changed;
+
+  /// Time the switch blocked: reloading the rules and handing the switch to
+  /// the renderer, which then redraws the visible tiles.
+  final Duration apply;
+
+  /// Style files kept mapped by [setKeepStyleFilesMapped].
+  final int mappedBytes;
+
+  /// Frames after the switch until the map was redrawn; only filled in by
+  /// [getStyleSwitchStats].
+  final FirstFrameStats? frames;
+
+  const StyleSwitchResult({
+    required this.dark,
+    required this.mapped,
+    required this.changed,
+    required this.apply,
+    required this.mappedBytes,
+    this.frames,
+  });
+
+  @override
+  String toString() =>
+      'StyleSwitchResult(${dark ? 'dark' : 'light'}, mapped=$mapped, '
+      'changed=$changed, apply=${apply.inMicroseconds}us, '
+      'mappedBytes=$mappedBytes, frames=$frames)';
+}
+
+StyleSwitchResult _toStyleSwitchResult(
+  ComapsStyleSwitchResult result, [
+  FirstFrameStats? frames,
+]) => StyleSwitchResult(
+  dark: result.dark != 0,
+  mapped: result.mapped != 0,
+  changed: result.changed != 0,
+  apply: Duration(microseconds: result.apply_us),
+  mappedBytes: result.mapped_bytes,
+  frames: frames,
+);
+
+/// Switch the map to the default light or [dark] style. Null if the map
+/// isn't created yet or the switch failed.
+StyleSwitchResult? setMapStyle({required bool dark}) {
+  final out = calloc<ComapsStyleSwitchResult>();
+  try {
+    if (_bindings.comaps_set_map_style(dark ? 1 : 0, out) != 0) {
+      return null;
+    }
+    return _toStyleSwitchResult(out.ref);
+  } finally {
+    calloc.free(out);
+  }
+}
+
+/// The last style switch made with ([mapped]) or without the style files kept
+/// mapped, including the frames it took to redraw the map. Switch once in
+/// each way and compare to see what keeping the files mapped saves. Null if
+/// there was no such switch.
+StyleSwitchResult? getStyleSwitchStats({required bool mapped}) {
+  final out = calloc<ComapsStyleSwitchResult>();
+  try {
+    final frames = _readFrameStats(
+      (stats) => _bindings.comaps_get_style_switch_stats(
+        mapped ? 1 : 0,
+        out,
+        stats,
+      ),
+    );
+    if (out.ref.changed == 0) {
+      return null;
+    }
+    return _toStyleSwitchResult(out.ref, frames);
+  } finally {
+    calloc.free(out);
+  }
+}
+
+/// SHA-256 of each file in [paths] as lowercase hex, null for a file that
+/// can't be read.
+///
+/// The files are memory-mapped and hashed natively in parallel on all cores,
+/// using the CPU's SHA instructions where it has them; the blocking call runs
+/// on a helper isolate. [onProgress] receives the number of files finished
+/// and the bytes hashed so far across all of them.
+Future<List<String?>> hashFiles(
+  List<String> paths, {
+  void Function(int filesDone, int total, int bytesHashed)? onProgress,
+}) async {
+  if (paths.isEmpty) return const [];
+
+  // Native threads post progress to this isolate through the listener's port.
+  final fileBytes = List<int>.filled(paths.length, 0);
+  var filesDone = 0;
+  var bytesHashed = 0;
+  final allReported = Completer<void>();
+  final callback =
+      NativeCallable<ComapsHashProgressCallbackFunction>.listener((
+        int index,
+        int status,
+        int bytes,
+      ) {
+        bytesHashed += bytes - fileBytes[index];
+        fileBytes[index] = bytes;
+        if (status != 0 && ++filesDone == paths.length) {
+          allReported.complete();
+        }
+        onProgress?.call(filesDone, paths.length, bytesHashed);
+      });
+  final callbackAddress = callback.nativeFunction.address;
+
+  try {
+    final digests = await Isolate.run(
+      () => _hashFilesBlocking(paths, callbackAddress),
+    );
+    // Every file reports once it is done; wait for those messages before
+    // closing the listener, which drops anything still queued.
+    await allReported.future;
+    return digests;
+  } finally {
+    callback.close();
+  }
+}
+
+List<String?> _hashFilesBlocking(List<String> paths, int callbackAddress) {
+  final pathPtrs = calloc<Pointer<Char>>(paths.length);
+  final digests = calloc<Uint8>(paths.length * 32);
+  try {
+    for (var i = 0; i < paths.length; i++) {
+      pathPtrs[i] = paths[i].toNativeUtf8().cast();
+    }
+    _bindings.comaps_hash_files(
+      pathPtrs,
+      paths.length,
+      digests,
+      Pointer.fromAddress(callbackAddress),
+    );
+    return List.generate(paths.length, (i) {
+      final digest = digests.asTypedList(paths.length * 32).sublist(
+        i * 32,
+        i * 32 + 32,
+      );
+      if (digest.every((b) => b == 0)) return null;
+      return digest.map((b) => b.toRadixString(16).padLeft(2, '0')).join();
+    });
+  } finally {
+    for (var i = 0; i < paths.length; i++) {
+      if (pathPtrs[i] != nullptr) malloc.free(pathPtrs[i]);
+    }
+    calloc.free(pathPtrs);
+    calloc.free(digests);
+  }
+}
+
+/// Declare the languages map labels will be shown in, e.g. the device locales
+/// and the regions the app is about to register.
+///
+/// When the map is created, only the fonts for these scripts, for maps registered
+/// in this or earlier sessions, and for Latin, Greek and Cyrillic are opened.
+/// This keeps the large CJK and Indic fonts out of memory when unused. Pass
+/// `['*']` to open every bundled font. Call it before the map is created: a map
+/// registered later in a script without fonts shows labels without those
+/// glyphs until the render surface is created again, e.g. when the app returns
+/// from the background.
+void setFontLanguages(List<String> languages) {
+  final languagesPtr = languages.join(',').toNativeUtf8();
+  try {
+    _bindings.comaps_set_font_languages(languagesPtr.cast());
+  } finally {
+    malloc.free(languagesPtr);
+  }
+}
+
+/// State of a native download started with [downloadFileNative].
+enum NativeDownloadStatus { inProgress, completed, failed, fileNotFound }
+
+/// Downloads [url] to [destination] in native code and completes with the
+/// number of bytes on disk.
+///
+/// [size] must be the exact size of the remote file. Up to [segments] byte
+/// ranges are fetched in parallel over keep-alive connections and written
+/// straight to disk. A partial file left by an earlier failed or cancelled
+/// download to the same [destination] is resumed rather than restarted.
+Future<int> downloadFileNative(
+  String url,
+  File destination, {
+  required int size,
+  int segments = 4,
+  void Function(int received, int total)? onProgress,
+  Duration pollInterval = const Duration(milliseconds: 250),
+}) async {
+  await destination.parent.create(recursive: true);
+
+  final urlPtr = url.toNativeUtf8();
+  final pathPtr = destination.path.toNativeUtf8();
+  final int id;
+  try {
+    id = _bindings.comaps_download_file(
+      urlPtr.cast(),
+      pathPtr.cast(),
+      size,
+      segments,
+    );
+  } finally {
+    malloc.free(urlPtr);
+    malloc.free(pathPtr);
+  }
+
+  final progress = calloc<ComapsDownloadProgress>();
+  try {
+    while (true) {
+      if (_bindings.comaps_download_get_progress(id, progress) != 0) {
+        throw StateError('Native download $id vanished');
+      }
+      final p = progress.ref;
+      onProgress?.call(p.bytes_downloaded, p.bytes_total);
+      switch (NativeDownloadStatus.values[p.status]) {
+        case NativeDownloadStatus.inProgress:
+          await Future<void>.delayed(pollInterval);
+        case NativeDownloadStatus.completed:
+          return p.bytes_downloaded;
+        case NativeDownloadStatus.failed:
+          throw Exception('Download failed: $url');
+        case NativeDownloadStatus.fileNotFound:
+          throw Exception('Download failed: HTTP 404 $url');
+      }
+    }
+  } finally {
+    calloc.free(progress);
+    _bindings.comaps_download_cancel(id);
+  }
+}
+
+/// What one mirror contributed to a [downloadFromMirrors] download.
+class MirrorDownloadStats {
+  final String url;
+  final int bytes;
+
+  /// [bytes] over the time from the start of the download to the mirror's
+  /// last byte.
+  final int bytesPerSecond;
+
+  /// Mean time from a range request to its first byte.
+  final Duration firstByte;
+  final int ranges;
+
+  /// Ranges taken over from the tail of a slower connection.
+  final int steals;
+  final int errors;
+
+  /// Dropped after repeated errors or a 404.
+  final bool disabled;
+
+  const MirrorDownloadStats({
+    required this.url,
+    required this.bytes,
+    required this.bytesPerSecond,
+    required this.firstByte,
+    required this.ranges,
+    required this.steals,
+    required this.errors,
+    required this.disabled,
+  });
+
+  @override
+  String toString() =>
+      'MirrorDownloadStats($url, bytes=$bytes, '
+      '${(bytesPerSecond / (1024 * 1024)).toStringAsFixed(2)} MB/s, '
+      'firstByte=${firstByte.inMilliseconds}ms, ranges=$ranges, '
+      'steals=$steals, errors=$errors${disabled ? ', disabled' : ''})';
+}
+
+/// Outcome of [downloadFromMirrors].
+class MirrorDownloadResult {
+  /// Bytes on disk.
+  final int bytes;
+  final Duration elapsed;
+
+  /// One entry per url, in the order given.
+  final List<MirrorDownloadStats> mirrors;
+
+  const MirrorDownloadResult({
+    required this.bytes,
+    required this.elapsed,
+    required this.mirrors,
+  });
+
+  @override
+  String toString() =>
+      'MirrorDownloadResult(bytes=$bytes, '
+      'elapsed=${elapsed.inMilliseconds}ms, mirrors=$mirrors)';
+}
+
+/// Downloads the same file from several mirrors at once in native code.
+///
+/// [urls] are the file on each mirror, lowest latency first (see
+/// [MirrorService.measureLatencies]). The file is split into byte ranges that
+/// [connectionsPerMirror] connections per mirror fetch concurrently, so faster
+/// mirrors fetch more of them; near the end, idle connections take over the
+/// tail of slower ones. Mirrors that keep failing are dropped and their ranges
+/// fetched from the others. [size] must be the exact size of the file, which
+/// only appears at [destination] once complete.
+///
+/// Android only; elsewhere this throws [UnsupportedError].
+Future<MirrorDownloadResult> downloadFromMirrors(
+  List<String> urls,
+  File destination, {
+  required int size,
+  int connectionsPerMirror = 2,
+  void Function(int received, int total)? onProgress,
+  Duration pollInterval = const Duration(milliseconds: 250),
+}) async {
+  if (!Platform.isAndroid) {
+    throw UnsupportedError('downloadFromMirrors is only available on Android');
+  }
+  await destination.parent.create(recursive: true);
+
+  final urlPtrs = calloc<Pointer<Char>>(urls.length);
+  final pathPtr = destination.path.toNativeUtf8();
+  final int id;
+  try {
+    for (var i = 0; i < urls.length; i++) {
+      urlPtrs[i] = urls[i].toNativeUtf8().cast();
+    }
+    id = _bindings.comaps_download_from_mirrors(
+      urlPtrs,
+      urls.length,
+      pathPtr.cast(),
+      size,
+      connectionsPerMirror,
+    );
+  } finally {
+    for (var i = 0; i < urls.length; i++) {
+      if (urlPtrs[i] != nullptr) malloc.free(urlPtrs[i]);
+    }
+    calloc.free(urlPtrs);
+    malloc.free(pathPtr);
+  }
+  if (id < 0) {
+    throw ArgumentError('No mirror urls or bad size for ${destination.path}');
+  }
+
+  final stopwatch = Stopwatch()..start();
+  final progress = calloc<ComapsDownloadProgress>();
+  final stats = calloc<ComapsMirrorStats>(urls.length);
+  try {
+    while (true) {
+      if (_bindings.comaps_mirror_download_get_progress(
+            id,
+            progress,
+            stats,
+            urls.length,
+          ) !=
+          0) {
+        throw StateError('Mirror download $id vanished');
+      }
+      final p = progress.ref;
+      onProgress?.call(p.bytes_downloaded, p.bytes_total);
+      switch (NativeDownloadStatus.values[p.status]) {
+        case NativeDownloadStatus.inProgress:
+          await Future<void>.delayed(pollInterval);
+        case NativeDownloadStatus.completed:
+          return MirrorDownloadResult(
+            bytes: p.bytes_downloaded,
+            elapsed: stopwatch.elapsed,
+            mirrors: [
+              for (var i = 0; i < urls.length; i++)
+                MirrorDownloadStats(
+                  url: urls[i],
+                  bytes: stats[i].bytes,
+                  bytesPerSecond: stats[i].bytes_per_second,
+                  firstByte: Duration(microseconds: stats[i].first_byte_us),
+                  ranges: stats[i].ranges,
+                  steals: stats[i].steals,
+                  errors: stats[i].errors,
+                  disabled: stats[i].disabled != 0,
+                ),
+            ],
+          );
+        case NativeDownloadStatus.failed:
+          throw Exception('Download failed from all mirrors: ${urls.first}');
+        case NativeDownloadStatus.fileNotFound:
+          throw Exception('Download failed: HTTP 404 on all mirrors ${urls.first}');
+      }
+    }
+  } finally {
+    calloc.free(progress);
+    calloc.free(stats);
+    _bindings.comaps_mirror_download_cancel(id);
+  }
+}
+
+/// How [updateMap] brought a map to its new version.
+enum MapUpdateStatus { updatedByDiff, updatedByFullDownload, failed, cancelled }
+
+/// Why [updateMap] didn't use the diff, if it didn't.
+enum DiffFailure { none, skipped, download, apply, verify }
+
+/// Outcome of [updateMap].
+class MapUpdateResult {
+  final MapUpdateStatus status;
+  final DiffFailure diffFailure;
+
+  /// Bytes downloaded: the diff, plus the full map after a fallback.
+  final int downloadedBytes;
+
+  /// Size of the new map, i.e. what a full download would have cost.
+  final int fullBytes;
+
+  /// [fullBytes] minus [downloadedBytes]; negative if a diff was downloaded
+  /// but couldn't be used.
+  final int bytesSaved;
+
+  /// Time spent applying the diff and verifying the result.
+  final Duration apply;
+  final Duration verify;
+  final Duration total;
+
+  const MapUpdateResult({
+    required this.status,
+    required this.diffFailure,
+    required this.downloadedBytes,
+    required this.fullBytes,
+    required this.bytesSaved,
+    required this.apply,
+    required this.verify,
+    required this.total,
+  });
+
+  bool get isUpdated =>
+      status == MapUpdateStatus.updatedByDiff ||
+      status == MapUpdateStatus.updatedByFullDownload;
+
+  @override
+  String toString() =>
+      'MapUpdateResult(${status.name}, diff=${diffFailure.name}, '
+      'downloaded=$downloadedBytes/$fullBytes, saved=$bytesSaved, '
+      'apply=${apply.inMilliseconds}ms, verify=${verify.inMilliseconds}ms, '
+      'total=${total.inMilliseconds}ms)';
+}
+
+/// Updates the registered map at [oldPath] to a new version written to
+/// [newPath] (same file name, another directory), preferring the diff at
+/// [diffUrl].
+///
+/// The diff is downloaded, applied to the old file natively on a background
+/// thread, verified against [sha256] (or, without it, checked to open as a
+/// map) and swapped in without restarting the engine. If any of that fails,
+/// or no diff is given, the full map at [fullUrl] is downloaded instead. The
+/// old file is left in place for the caller to delete.
+Future<MapUpdateResult> updateMap({
+  required String oldPath,
+  required String newPath,
+  String? diffUrl,
+  int diffSize = 0,
+  required String fullUrl,
+  required int fullSize,
+  String? sha256,
+  Duration pollInterval = const Duration(milliseconds: 250),
+}) async {
+  await File(newPath).parent.create(recursive: true);
+
+  final request = calloc<ComapsMapUpdateRequest>();
+  final strings = <Pointer<Utf8>>[];
+  Pointer<Char> toNative(String? value) {
+    if (value == null) return nullptr;
+    final ptr = value.toNativeUtf8();
+    strings.add(ptr);
+    return ptr.cast();
+  }
+
+  final int id;
+  try {
+    request.ref
+      ..old_path = toNative(oldPath)
+      ..new_path = toNative(newPath)
+      ..diff_url = toNative(diffUrl)
+      ..diff_size = diffSize
+      ..full_url = toNative(fullUrl)
+      ..full_size = fullSize
+      ..sha256 = toNative(sha256);
+    id = _bindings.comaps_update_map(request);
+  } finally {
+    strings.forEach(malloc.free);
+    calloc.free(request);
+  }
+  if (id < 0) {
+    throw StateError('Map engine not initialized');
+  }
+
+  final progress = calloc<ComapsMapUpdateProgress>();
+  try {
+    while (true) {
+      if (_bindings.comaps_get_map_update_progress(id, progress) != 0) {
+        throw StateError('Map update $id vanished');
+      }
+      final p = progress.ref;
+      if (p.status == 0) {
+        await Future<void>.delayed(pollInterval);
+        continue;
+      }
+      return MapUpdateResult(
+        status: MapUpdateStatus.values[p.status - 1],
+        diffFailure: DiffFailure.values[p.diff_failure],
+        downloadedBytes: p.downloaded_bytes,
+        fullBytes: p.full_bytes,
+        bytesSaved: p.bytes_saved,
+        apply: Duration(microseconds: p.apply_us),
+        verify: Duration(microseconds: p.verify_us),
+        total: Duration(microseconds: p.total_us),
+      );
+    }
+  } finally {
+    calloc.free(progress);
+    _bindings.comaps_cancel_map_update(id);
+  }
+}
+
+/// Sets the limits shared by all [fetchMap] calls.
+///
+/// [maxConcurrent] maps are downloaded at the same time (1-8), together using
+/// at most [maxBytesPerSecond] (0 for unlimited). Each fetch syncs its file
+/// every [maxUnsyncedBytes] written, which bounds dirty memory and keeps the
+/// final sync short. Applies to fetches already queued or running too.
+void setMapFetchBudget({
+  int maxConcurrent = 2,
+  int maxBytesPerSecond = 0,
+  int maxUnsyncedBytes = 16 * 1024 * 1024,
+}) {
+  final budget = calloc<ComapsMapFetchBudget>();
+  try {
+    budget.ref
+      ..max_concurrent = maxConcurrent
+      ..max_bytes_per_second = maxBytesPerSecond
+      ..max_unsynced_bytes = maxUnsyncedBytes;
+    _bindings.comaps_set_map_fetch_budget(budget);
+  } finally {
+    calloc.free(budget);
+  }
+}
+
+/// State of a [fetchMap] job.
+enum MapFetchStatus {
+  queued,
+  downloading,
+  syncing,
+  registering,
+  completed,
+  failed,
+  cancelled,
+}
+
+/// Why a [fetchMap] job failed.
+enum MapFetchFailure { none, network, fileNotFound, write, verify, register }
+
+/// Outcome of [fetchMap].
+class MapFetchResult {
+  final MapFetchStatus status;
+  final MapFetchFailure failure;
+
+  /// MwmSet::RegResult of the registration, -1 if it didn't happen.
+  final int regResult;
+
+  /// Size of the map on disk.
+  final int bytes;
+
+  /// Bytes kept from an earlier, interrupted fetch of the same map.
+  final int resumedBytes;
+
+  /// Hex SHA-256 of the downloaded map, computed while it streamed in; null
+  /// if the download didn't complete.
+  final String? sha256;
+
+  /// Time spent waiting for the bandwidth budget of [setMapFetchBudget].
+  final Duration throttled;
+  final Duration download;
+  final Duration sync;
+  final Duration register;
+  final Duration total;
+
+  const MapFetchResult({
+    required this.status,
+    required this.failure,
+    required this.regResult,
+    required this.bytes,
+    required this.resumedBytes,
+    required this.sha256,
+    required this.throttled,
+    required this.download,
+    required this.sync,
+    required this.register,
+    required this.total,
+  });
+
+  bool get isCompleted => status == MapFetchStatus.completed;
+
+  @override
+  String toString() =>
+      'MapFetchResult(${status.name}, failure=${failure.name}, '
+      'reg=$regResult, bytes=$bytes, resumed=$resumedBytes, '
+      'throttled=${throttled.inMilliseconds}ms, '
+      'download=${download.inMilliseconds}ms, sync=${sync.inMilliseconds}ms, '
+      'register=${register.inMilliseconds}ms, total=${total.inMilliseconds}ms)';
+}
+
+/// Downloads the map at [url] to [destination] and registers it, in one
+/// native job that reads each byte once.
+///
+/// The map is hashed while it streams to `<destination>.part`, then checked
+/// against [sha256] (or, without it, checked to open as a map), synced,
+/// renamed to [destination] and registered as by [registerSingleMap], without
+/// restarting the engine. Nothing is read back from disk, unlike downloading
+/// with [downloadFileNative] and then calling [hashFiles]. Fetches run
+/// concurrently under [setMapFetchBudget]. A `.part` file left by an
+/// interrupted fetch is resumed. [size] must be the exact size of the remote
+/// file. With [register] false the map is only downloaded and verified.
+///
+/// Android only; elsewhere this throws [UnsupportedError].
+Future<MapFetchResult> fetchMap(
+  String url,
+  File destination, {
+  required int size,
+  String? sha256,
+  bool register = true,
+  void Function(int written, int total)? onProgress,
+  Duration pollInterval = const Duration(milliseconds: 250),
+}) async {
+  if (!Platform.isAndroid) {
+    throw UnsupportedError('fetchMap is only available on Android');
+  }
+  await destination.parent.create(recursive: true);
+
+  final urlPtr = url.toNativeUtf8();
+  final pathPtr = destination.path.toNativeUtf8();
+  final shaPtr = sha256?.toNativeUtf8();
+  final int id;
+  try {
+    id = _bindings.comaps_fetch_map(
+      urlPtr.cast(),
+      pathPtr.cast(),
+      size,
+      shaPtr?.cast() ?? nullptr,
+      register ? 1 : 0,
+    );
+  } finally {
+    malloc.free(urlPtr);
+    malloc.free(pathPtr);
+    if (shaPtr != null) malloc.free(shaPtr);
+  }
+  if (id < 0) {
+    throw StateError('Can\'t fetch $url: map engine not initialized or bad size');
+  }
+
+  final progress = calloc<ComapsMapFetchProgress>();
+  try {
+    while (true) {
+      if (_bindings.comaps_get_map_fetch_progress(id, progress) != 0) {
+        throw StateError('Map fetch $id vanished');
+      }
+      final p = progress.ref;
+      onProgress?.call(p.bytes_written, p.bytes_total);
+      final status = MapFetchStatus.values[p.status];
+      if (status.index < MapFetchStatus.completed.index) {
+        await Future<void>.delayed(pollInterval);
+        continue;
+      }
+      final digest = _readFixedString(p.sha256, 65);
+      return MapFetchResult(
+        status: status,
+        failure: MapFetchFailure.values[p.failure],
+        regResult: p.reg_result,
+        bytes: p.bytes_written,
+        resumedBytes: p.resumed_bytes,
+        sha256: digest.isEmpty ? null : digest,
+        throttled: Duration(microseconds: p.throttled_us),
+        download: Duration(microseconds: p.download_us),
+        sync: Duration(microseconds: p.sync_us),
+        register: Duration(microseconds: p.register_us),
+        total: Duration(microseconds: p.total_us),
+      );
+    }
+  } finally {
+    calloc.free(progress);
+    _bindings.comaps_cancel_map_fetch(id);
+  }
+}
+
+/// Registered region map covering a point, see [findMwmsAt].
+class MwmHit {
+  /// Map name without extension, e.g. `Spain_Madrid`.
+  final String countryName;
+  final int version;
+
+  const MwmHit({required this.countryName, required this.version});
+
+  @override
+  String toString() => 'MwmHit($countryName, v$version)';
+}
+
+/// Looks up the registered region map covering each of [points], given as
+/// (latitude, longitude) pairs, in one native call.
+///
+/// Points are matched against the real region borders, not just map bounds.
+/// The result has one entry per point, null where no region map covers it
+/// (World maps are not reported) or the framework is not initialized yet.
+List<MwmHit?> findMwmsAt(List<(double, double)> points) {
+  if (points.isEmpty) return const [];
+  final nativePoints = calloc<ComapsLatLon>(points.length);
+  final hits = calloc<ComapsMwmHit>(points.length);
+  try {
+    for (var i = 0; i < points.length; i++) {
+      nativePoints[i]
+        ..lat = points[i].$1
+        ..lon = points[i].$2;
+    }
+    if (_bindings.comaps_find_mwms_at(nativePoints, points.length, hits) < 0) {
+      return List<MwmHit?>.filled(points.length, null);
+    }
+    return [
+      for (var i = 0; i < points.length; i++)
+        if (hits[i].country_name[0] == 0)
+          null
+        else
+          MwmHit(
+            countryName: _readFixedString(hits[i].country_name, 64),
+            version: hits[i].version,
+          ),
+    ];
+  } finally {
+    calloc.free(nativePoints);
+    calloc.free(hits);
+  }
+}
+
 /// Debug: List all registered MWMs and their bounds.
 /// Output goes to Android logcat (tag: AgusMapsFlutterNative).
 void debugListMwms() {
@@ -243,7 +1715,7 @@ class AgusMap extends StatefulWidget {
   State<AgusMap> createState() => _AgusMapState();
 }
 
-class _AgusMapState extends State<AgusMap> {
+class _AgusMapState extends State<AgusMap> with WidgetsBindingObserver {
   int? _textureId;
   Size? _currentSize; // Logical size
   bool _surfaceCreated = false;
@@ -256,6 +1728,23 @@ class _AgusMapState extends State<AgusMap> {
   @override
   void initState() {
     super.initState();
+    WidgetsBinding.instance.addObserver(this);
+  }
+
+  @override
+  void dispose() {
+    WidgetsBinding.instance.removeObserver(this);
+    super.dispose();
+  }
+
+  @override
+  void didHaveMemoryPressure() {
+    // Raised for Android onTrimMemory(RUNNING_LOW and above) and iOS memory
+    // warnings. Keep the GPU caches so the visible map does not flicker.
+    if (!_surfaceCreated) return;
+    onMemoryPressure(MemoryPressureLevel.low).then((report) {
+      debugPrint('[AgusMap] Memory pressure trim: $report');
+    });
   }
 
   @override
@@ -91,6 +91,65 @@ class AgusMapsFlutterBindings {
         void Function(ffi.Pointer<ffi.Char>, ffi.Pointer<ffi.Char>)
       >();
 
+  /// Same as comaps_init_paths, with an explicit thread budget (config may be NULL).
+  /// Platform pools are only resized on Android; other platforms honour search_threads.
+  void comaps_init_paths_with_config(
+    ffi.Pointer<ffi.Char> resourcePath,
+    ffi.Pointer<ffi.Char> writablePath,
+    ffi.Pointer<ComapsThreadConfig> config,
+  ) {
+    return _comaps_init_paths_with_config(resourcePath, writablePath, config);
+  }
+
+  late final _comaps_init_paths_with_configPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Void Function(
+            ffi.Pointer<ffi.Char>,
+            ffi.Pointer<ffi.Char>,
+            ffi.Pointer<ComapsThreadConfig>,
+          )
+        >
+      >('comaps_init_paths_with_config');
+  late final _comaps_init_paths_with_config = _comaps_init_paths_with_configPtr
+      .asFunction<
+        void Function(
+          ffi.Pointer<ffi.Char>,
+          ffi.Pointer<ffi.Char>,
+          ffi.Pointer<ComapsThreadConfig>,
+        )
+      >();
+
+  /// Write the effective (resolved) thread budget into out_config.
+  void comaps_get_thread_config(ffi.Pointer<ComapsThreadConfig> out_config) {
+    return _comaps_get_thread_config(out_config);
+  }
+
+  late final _comaps_get_thread_configPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Void Function(ffi.Pointer<ComapsThreadConfig>)>
+      >('comaps_get_thread_config');
+  late final _comaps_get_thread_config = _comaps_get_thread_configPtr
+      .asFunction<void Function(ffi.Pointer<ComapsThreadConfig>)>();
+
+  /// Fill up to max_pools entries of out_stats.
+  /// Returns: number of instrumented pools (may exceed max_pools)
+  int comaps_get_thread_pool_stats(
+    ffi.Pointer<ComapsThreadPoolStats> out_stats,
+    int max_pools,
+  ) {
+    return _comaps_get_thread_pool_stats(out_stats, max_pools);
+  }
+
+  late final _comaps_get_thread_pool_statsPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Pointer<ComapsThreadPoolStats>, ffi.Int)
+        >
+      >('comaps_get_thread_pool_stats');
+  late final _comaps_get_thread_pool_stats = _comaps_get_thread_pool_statsPtr
+      .asFunction<int Function(ffi.Pointer<ComapsThreadPoolStats>, int)>();
+
   void comaps_load_map_path(ffi.Pointer<ffi.Char> path) {
     return _comaps_load_map_path(path);
   }
@@ -164,6 +223,798 @@ class AgusMapsFlutterBindings {
   late final _comaps_register_single_map = _comaps_register_single_mapPtr
       .asFunction<int Function(ffi.Pointer<ffi.Char>)>();
 
+  /// Register an MWM stored uncompressed in a zip archive (e.g. an APK asset kept out
+  /// of compression with noCompress("mwm")) and read it in place, without extracting.
+  /// entryName is the path inside the archive, e.g. "assets/flutter_assets/assets/maps/World.mwm".
+  /// Android only; other platforms bundle maps as plain files.
+  /// Returns: as comaps_register_single_map, or -3 if the entry is missing or compressed
+  int comaps_register_map_in_archive(
+    ffi.Pointer<ffi.Char> archivePath,
+    ffi.Pointer<ffi.Char> entryName,
+  ) {
+    return _comaps_register_map_in_archive(archivePath, entryName);
+  }
+
+  late final _comaps_register_map_in_archivePtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Pointer<ffi.Char>, ffi.Pointer<ffi.Char>)
+        >
+      >('comaps_register_map_in_archive');
+  late final _comaps_register_map_in_archive =
+      _comaps_register_map_in_archivePtr
+          .asFunction<int Function(ffi.Pointer<ffi.Char>, ffi.Pointer<ffi.Char>)>();
+
+  /// Record an MWM file for lazy registration: only its bounds and version are read
+  /// now. It is registered (opened) in the background when the viewport first shows
+  /// it at a zoom where region maps are drawn, before a search that reads it, when a
+  /// route needs it, or when comaps_register_maps_in_rect covers it.
+  /// May be called before the map surface exists.
+  /// Returns: 0 on success, -2 if the file header can't be read
+  int comaps_register_map_lazy(ffi.Pointer<ffi.Char> fullPath) {
+    return _comaps_register_map_lazy(fullPath);
+  }
+
+  late final _comaps_register_map_lazyPtr =
+      _lookup<ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ffi.Char>)>>(
+        'comaps_register_map_lazy',
+      );
+  late final _comaps_register_map_lazy = _comaps_register_map_lazyPtr
+      .asFunction<int Function(ffi.Pointer<ffi.Char>)>();
+
+  /// comaps_register_map_lazy for count files at once. Bounds and versions of files
+  /// unchanged since an earlier launch (same path, size and mtime) come from a
+  /// snapshot in the writable directory, so no file is opened now; each is still read
+  /// in full when registered. use_snapshot=0 reads every header instead, e.g. to
+  /// benchmark a launch without the snapshot.
+  /// out_stats may be NULL.
+  /// Returns: number of maps recorded
+  int comaps_register_maps_lazy(
+    ffi.Pointer<ffi.Pointer<ffi.Char>> fullPaths,
+    int count,
+    int use_snapshot,
+    ffi.Pointer<ComapsLazyBatchStats> out_stats,
+  ) {
+    return _comaps_register_maps_lazy(fullPaths, count, use_snapshot, out_stats);
+  }
+
+  late final _comaps_register_maps_lazyPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(
+            ffi.Pointer<ffi.Pointer<ffi.Char>>,
+            ffi.Int,
+            ffi.Int,
+            ffi.Pointer<ComapsLazyBatchStats>,
+          )
+        >
+      >('comaps_register_maps_lazy');
+  late final _comaps_register_maps_lazy = _comaps_register_maps_lazyPtr
+      .asFunction<
+        int Function(
+          ffi.Pointer<ffi.Pointer<ffi.Char>>,
+          int,
+          int,
+          ffi.Pointer<ComapsLazyBatchStats>,
+        )
+      >();
+
+  /// Register the lazily recorded maps intersecting the given area on the calling
+  /// thread, e.g. to have them open before the viewport moves there.
+  /// Returns: number of maps registered, -1 if framework not ready
+  int comaps_register_maps_in_rect(
+    double min_lat,
+    double min_lon,
+    double max_lat,
+    double max_lon,
+  ) {
+    return _comaps_register_maps_in_rect(min_lat, min_lon, max_lat, max_lon);
+  }
+
+  late final _comaps_register_maps_in_rectPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Double, ffi.Double, ffi.Double, ffi.Double)
+        >
+      >('comaps_register_maps_in_rect');
+  late final _comaps_register_maps_in_rect = _comaps_register_maps_in_rectPtr
+      .asFunction<int Function(double, double, double, double)>();
+
+  /// Returns: number of lazily recorded maps not registered yet
+  int comaps_get_pending_maps_count() {
+    return _comaps_get_pending_maps_count();
+  }
+
+  late final _comaps_get_pending_maps_countPtr =
+      _lookup<ffi.NativeFunction<ffi.Int Function()>>(
+        'comaps_get_pending_maps_count',
+      );
+  late final _comaps_get_pending_maps_count = _comaps_get_pending_maps_countPtr
+      .asFunction<int Function()>();
+
+  /// Deregister the map of the country named by fullPath's file name (e.g. "Spain.mwm")
+  /// and re-render its tiles.
+  /// Returns: 0 on success, -1 if framework not ready or no such map is registered, -2 on exception
+  int comaps_deregister_map(ffi.Pointer<ffi.Char> fullPath) {
+    return _comaps_deregister_map(fullPath);
+  }
+
+  late final _comaps_deregister_mapPtr =
+      _lookup<ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ffi.Char>)>>(
+        'comaps_deregister_map',
+      );
+  late final _comaps_deregister_map = _comaps_deregister_mapPtr
+      .asFunction<int Function(ffi.Pointer<ffi.Char>)>();
+
+  /// Replace the registered map of the same country with the file at fullPath without
+  /// restarting the engine. A newer data version replaces the old one in one step; the
+  /// same or an older one is registered after the old one goes, and fails while reads
+  /// still hold the old file. Reads in flight keep the old version until they finish,
+  /// and only tiles within the old and new map bounds are re-rendered.
+  /// fullPath must differ from the registered file's path; delete the old file afterwards.
+  /// out_result may be NULL.
+  /// Returns: 0 on success, -1 if framework not ready, -2 on exception,
+  ///          -3 if fullPath is the registered file,
+  ///          or MwmSet::RegResult value on registration failure
+  int comaps_replace_map(
+    ffi.Pointer<ffi.Char> fullPath,
+    ffi.Pointer<ComapsMapReplaceResult> out_result,
+  ) {
+    return _comaps_replace_map(fullPath, out_result);
+  }
+
+  late final _comaps_replace_mapPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(
+            ffi.Pointer<ffi.Char>,
+            ffi.Pointer<ComapsMapReplaceResult>,
+          )
+        >
+      >('comaps_replace_map');
+  late final _comaps_replace_map = _comaps_replace_mapPtr
+      .asFunction<
+        int Function(ffi.Pointer<ffi.Char>, ffi.Pointer<ComapsMapReplaceResult>)
+      >();
+
+  /// Trim engine caches in graded steps, on the engine's threads; returns at once.
+  /// level: 1=moderate (search caches), 2=low (+ reader/feature caches),
+  /// 3=critical (+ Drape tile geometry, then glyph and symbol textures)
+  /// Drape steps are skipped while there is no render surface.
+  /// done may be NULL.
+  /// Returns: 0 if the trim was started, -1 if framework not ready (done is not called then)
+  int comaps_on_memory_pressure(int level, ComapsTrimCallback done) {
+    return _comaps_on_memory_pressure(level, done);
+  }
+
+  late final _comaps_on_memory_pressurePtr =
+      _lookup<ffi.NativeFunction<ffi.Int Function(ffi.Int, ComapsTrimCallback)>>(
+        'comaps_on_memory_pressure',
+      );
+  late final _comaps_on_memory_pressure = _comaps_on_memory_pressurePtr
+      .asFunction<int Function(int, ComapsTrimCallback)>();
+
+  /// Write a one-line RSS/PSS/GPU estimate/Drape texture summary into buffer (NUL-terminated).
+  /// Returns: length of the full summary, which may exceed buffer_size - 1
+  int comaps_get_memory_info(ffi.Pointer<ffi.Char> buffer, int buffer_size) {
+    return _comaps_get_memory_info(buffer, buffer_size);
+  }
+
+  late final _comaps_get_memory_infoPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ffi.Char>, ffi.Int)>
+      >('comaps_get_memory_info');
+  late final _comaps_get_memory_info = _comaps_get_memory_infoPtr
+      .asFunction<int Function(ffi.Pointer<ffi.Char>, int)>();
+
+  /// Write the timeline of the last map engine startup (Framework construction steps,
+  /// page cache warm-up reads, map registration, drape engine creation) into buffer
+  /// as Chrome trace event JSON (NUL-terminated), for chrome://tracing or Perfetto.
+  /// Returns: length of the full trace, which may exceed buffer_size - 1
+  int comaps_get_startup_trace(ffi.Pointer<ffi.Char> buffer, int buffer_size) {
+    return _comaps_get_startup_trace(buffer, buffer_size);
+  }
+
+  late final _comaps_get_startup_tracePtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ffi.Char>, ffi.Int)>
+      >('comaps_get_startup_trace');
+  late final _comaps_get_startup_trace = _comaps_get_startup_tracePtr
+      .asFunction<int Function(ffi.Pointer<ffi.Char>, int)>();
+
+  /// Startup mode for the next map engine startup (call before the map surface exists):
+  /// 0 = full: Framework::RegisterAllMaps registers every local map before the first frame.
+  /// 1 = render-first: only World/WorldCoasts are; other maps register as the viewport
+  /// reaches them, and the remaining ones on an idle task after the first frame.
+  /// The Framework constructor builds search, routing and bookmarks in both modes.
+  void comaps_set_startup_mode(int mode) {
+    return _comaps_set_startup_mode(mode);
+  }
+
+  late final _comaps_set_startup_modePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int)>>(
+        'comaps_set_startup_mode',
+      );
+  late final _comaps_set_startup_mode = _comaps_set_startup_modePtr
+      .asFunction<void Function(int)>();
+
+  /// Returns: 0 once the first frame was drawn, -1 before (out_report is filled either way)
+  int comaps_get_startup_report(ffi.Pointer<ComapsStartupReport> out_report) {
+    return _comaps_get_startup_report(out_report);
+  }
+
+  late final _comaps_get_startup_reportPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ComapsStartupReport>)>
+      >('comaps_get_startup_report');
+  late final _comaps_get_startup_report = _comaps_get_startup_reportPtr
+      .asFunction<int Function(ffi.Pointer<ComapsStartupReport>)>();
+
+  /// Cap the descriptors held by MWM readers; least recently read files are closed
+  /// and reopened on demand. Defaults to a quarter of RLIMIT_NOFILE (16..256).
+  /// Android only; other platforms use the readers of CoMaps' own Platform.
+  void comaps_set_file_pool_limit(int limit) {
+    return _comaps_set_file_pool_limit(limit);
+  }
+
+  late final _comaps_set_file_pool_limitPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int)>>(
+        'comaps_set_file_pool_limit',
+      );
+  late final _comaps_set_file_pool_limit = _comaps_set_file_pool_limitPtr
+      .asFunction<void Function(int)>();
+
+  /// Returns: 0 on success, -1 where the pool is not used (out_stats untouched)
+  int comaps_get_file_pool_stats(ffi.Pointer<ComapsFilePoolStats> out_stats) {
+    return _comaps_get_file_pool_stats(out_stats);
+  }
+
+  late final _comaps_get_file_pool_statsPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ComapsFilePoolStats>)>
+      >('comaps_get_file_pool_stats');
+  late final _comaps_get_file_pool_stats = _comaps_get_file_pool_statsPtr
+      .asFunction<int Function(ffi.Pointer<ComapsFilePoolStats>)>();
+
+  /// Serve read-only resources missing on disk (styles, fonts, classificator...) from a
+  /// pack built by scripts/build_resource_pack.py, mapped at |offset| in |path| (an
+  /// uncompressed APK asset or a standalone file). Call before the map is created.
+  /// Android only; other platforms use the readers of CoMaps' own Platform.
+  /// Returns: 0 on success, -1 if the pack can't be opened or is not supported
+  int comaps_set_resource_pack(ffi.Pointer<ffi.Char> path, int offset) {
+    return _comaps_set_resource_pack(path, offset);
+  }
+
+  late final _comaps_set_resource_packPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ffi.Char>, ffi.Int64)>
+      >('comaps_set_resource_pack');
+  late final _comaps_set_resource_pack = _comaps_set_resource_packPtr
+      .asFunction<int Function(ffi.Pointer<ffi.Char>, int)>();
+
+  /// Returns: 0 once the first frame was rendered, -1 before (out_stats is filled either way)
+  int comaps_get_first_frame_stats(
+    ffi.Pointer<ComapsFirstFrameStats> out_stats,
+  ) {
+    return _comaps_get_first_frame_stats(out_stats);
+  }
+
+  late final _comaps_get_first_frame_statsPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ComapsFirstFrameStats>)>
+      >('comaps_get_first_frame_stats');
+  late final _comaps_get_first_frame_stats = _comaps_get_first_frame_statsPtr
+      .asFunction<int Function(ffi.Pointer<ComapsFirstFrameStats>)>();
+
+  /// Timing of the frames from the start of the last comaps_replace_map, i.e. the render
+  /// stall it caused (max_frame_gap_us), the swap itself included.
+  /// Returns: 0 once a frame was rendered after the replacement, -1 before
+  int comaps_get_map_replace_frame_stats(
+    ffi.Pointer<ComapsFirstFrameStats> out_stats,
+  ) {
+    return _comaps_get_map_replace_frame_stats(out_stats);
+  }
+
+  late final _comaps_get_map_replace_frame_statsPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ComapsFirstFrameStats>)>
+      >('comaps_get_map_replace_frame_stats');
+  late final _comaps_get_map_replace_frame_stats =
+      _comaps_get_map_replace_frame_statsPtr
+          .asFunction<int Function(ffi.Pointer<ComapsFirstFrameStats>)>();
+
+  /// Keep the light and the dark style resources (drawing rules, classificator, symbol
+  /// textures once loaded) mapped, so switching between them opens no files. The switch
+  /// still reloads the style in the engine and redraws every tile. Disabling unmaps them.
+  /// Android only; other platforms use the readers of CoMaps' own Platform.
+  void comaps_set_keep_style_files_mapped(int enabled) {
+    return _comaps_set_keep_style_files_mapped(enabled);
+  }
+
+  late final _comaps_set_keep_style_files_mappedPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int)>>(
+        'comaps_set_keep_style_files_mapped',
+      );
+  late final _comaps_set_keep_style_files_mapped =
+      _comaps_set_keep_style_files_mappedPtr.asFunction<void Function(int)>();
+
+  /// Switch the map to the default light (dark = 0) or dark style. The re-rendering that
+  /// follows is tracked by comaps_get_style_switch_stats. out_result may be NULL.
+  /// Returns: 0 on success (also if the style was current already), -1 if framework not ready, -2 on exception
+  int comaps_set_map_style(
+    int dark,
+    ffi.Pointer<ComapsStyleSwitchResult> out_result,
+  ) {
+    return _comaps_set_map_style(dark, out_result);
+  }
+
+  late final _comaps_set_map_stylePtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Int, ffi.Pointer<ComapsStyleSwitchResult>)
+        >
+      >('comaps_set_map_style');
+  late final _comaps_set_map_style = _comaps_set_map_stylePtr
+      .asFunction<int Function(int, ffi.Pointer<ComapsStyleSwitchResult>)>();
+
+  /// Last switch made with (mapped = 1) or without the style files kept mapped and the frames
+  /// after it, to compare the two. Either output may be NULL.
+  /// Returns: 0 if there was such a switch, -1 otherwise
+  int comaps_get_style_switch_stats(
+    int mapped,
+    ffi.Pointer<ComapsStyleSwitchResult> out_result,
+    ffi.Pointer<ComapsFirstFrameStats> out_frames,
+  ) {
+    return _comaps_get_style_switch_stats(mapped, out_result, out_frames);
+  }
+
+  late final _comaps_get_style_switch_statsPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(
+            ffi.Int,
+            ffi.Pointer<ComapsStyleSwitchResult>,
+            ffi.Pointer<ComapsFirstFrameStats>,
+          )
+        >
+      >('comaps_get_style_switch_stats');
+  late final _comaps_get_style_switch_stats =
+      _comaps_get_style_switch_statsPtr
+          .asFunction<
+            int Function(
+              int,
+              ffi.Pointer<ComapsStyleSwitchResult>,
+              ffi.Pointer<ComapsFirstFrameStats>,
+            )
+          >();
+
+  /// SHA-256 of each of the count files in paths, written to out_digests (32 bytes per file,
+  /// zeros for a file that can't be read). The files are memory-mapped and hashed in parallel
+  /// on all cores, with the CPU's SHA instructions where it has them. Blocks until all are done,
+  /// so call it off the UI thread. progress may be NULL.
+  /// Returns: the number of files that couldn't be hashed, -1 on invalid arguments
+  int comaps_hash_files(
+    ffi.Pointer<ffi.Pointer<ffi.Char>> paths,
+    int count,
+    ffi.Pointer<ffi.Uint8> out_digests,
+    ComapsHashProgressCallback progress,
+  ) {
+    return _comaps_hash_files(paths, count, out_digests, progress);
+  }
+
+  late final _comaps_hash_filesPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(
+            ffi.Pointer<ffi.Pointer<ffi.Char>>,
+            ffi.Int,
+            ffi.Pointer<ffi.Uint8>,
+            ComapsHashProgressCallback,
+          )
+        >
+      >('comaps_hash_files');
+  late final _comaps_hash_files = _comaps_hash_filesPtr
+      .asFunction<
+        int Function(
+          ffi.Pointer<ffi.Pointer<ffi.Char>>,
+          int,
+          ffi.Pointer<ffi.Uint8>,
+          ComapsHashProgressCallback,
+        )
+      >();
+
+  /// Languages map labels are expected in, comma separated (e.g. "en,ja").
+  /// When the map is created, only fonts for these scripts, the scripts of maps
+  /// registered so far or in earlier sessions, and Latin, Greek and Cyrillic are
+  /// opened; "*" opens every bundled font. Call before creating the map: a map
+  /// registered later in a script without fonts shows labels without those glyphs until
+  /// the render surface is created again.
+  /// Android only; other platforms use the system font setup of CoMaps.
+  void comaps_set_font_languages(ffi.Pointer<ffi.Char> languages) {
+    return _comaps_set_font_languages(languages);
+  }
+
+  late final _comaps_set_font_languagesPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Pointer<ffi.Char>)>>(
+        'comaps_set_font_languages',
+      );
+  late final _comaps_set_font_languages = _comaps_set_font_languagesPtr
+      .asFunction<void Function(ffi.Pointer<ffi.Char>)>();
+
+  /// Download url to file_path natively, in up to `segments` parallel byte ranges
+  /// over keep-alive connections. Data streams straight to disk; a partial file
+  /// left by a previous (cancelled or failed) download of the same path is resumed.
+  /// file_size must be the exact size of the remote file.
+  /// Returns: download id for comaps_download_get_progress / comaps_download_cancel
+  int comaps_download_file(
+    ffi.Pointer<ffi.Char> url,
+    ffi.Pointer<ffi.Char> file_path,
+    int file_size,
+    int segments,
+  ) {
+    return _comaps_download_file(url, file_path, file_size, segments);
+  }
+
+  late final _comaps_download_filePtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int64 Function(
+            ffi.Pointer<ffi.Char>,
+            ffi.Pointer<ffi.Char>,
+            ffi.Int64,
+            ffi.Int,
+          )
+        >
+      >('comaps_download_file');
+  late final _comaps_download_file = _comaps_download_filePtr
+      .asFunction<
+        int Function(ffi.Pointer<ffi.Char>, ffi.Pointer<ffi.Char>, int, int)
+      >();
+
+  /// Once it reports a finished download, the id is released.
+  /// Returns: 0 and fills out_progress, or -1 if the id is unknown
+  int comaps_download_get_progress(
+    int id,
+    ffi.Pointer<ComapsDownloadProgress> out_progress,
+  ) {
+    return _comaps_download_get_progress(id, out_progress);
+  }
+
+  late final _comaps_download_get_progressPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Int64, ffi.Pointer<ComapsDownloadProgress>)
+        >
+      >('comaps_download_get_progress');
+  late final _comaps_download_get_progress = _comaps_download_get_progressPtr
+      .asFunction<int Function(int, ffi.Pointer<ComapsDownloadProgress>)>();
+
+  /// Stop a download (keeping the partial file resumable) and release its id.
+  /// Does nothing for a finished download whose result was read.
+  void comaps_download_cancel(int id) {
+    return _comaps_download_cancel(id);
+  }
+
+  late final _comaps_download_cancelPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int64)>>(
+        'comaps_download_cancel',
+      );
+  late final _comaps_download_cancel = _comaps_download_cancelPtr
+      .asFunction<void Function(int)>();
+
+  /// Update a registered map in the background: download the diff, apply it to the old file,
+  /// verify the result and swap it in (see comaps_replace_map), falling back to the full map
+  /// if any step fails. Updates run one at a time. The new file only appears at new_path once
+  /// complete and synced; the old file is left for the caller to delete.
+  /// Returns: update id for comaps_get_map_update_progress / comaps_cancel_map_update, -1 if framework not ready
+  int comaps_update_map(ffi.Pointer<ComapsMapUpdateRequest> request) {
+    return _comaps_update_map(request);
+  }
+
+  late final _comaps_update_mapPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int64 Function(ffi.Pointer<ComapsMapUpdateRequest>)>
+      >('comaps_update_map');
+  late final _comaps_update_map = _comaps_update_mapPtr
+      .asFunction<int Function(ffi.Pointer<ComapsMapUpdateRequest>)>();
+
+  /// Once it reports a finished download, the id is released.
+  /// Returns: 0 and fills out_progress, or -1 if the id is unknown
+  int comaps_get_map_update_progress(
+    int id,
+    ffi.Pointer<ComapsMapUpdateProgress> out_progress,
+  ) {
+    return _comaps_get_map_update_progress(id, out_progress);
+  }
+
+  late final _comaps_get_map_update_progressPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Int64, ffi.Pointer<ComapsMapUpdateProgress>)
+        >
+      >('comaps_get_map_update_progress');
+  late final _comaps_get_map_update_progress =
+      _comaps_get_map_update_progressPtr
+          .asFunction<int Function(int, ffi.Pointer<ComapsMapUpdateProgress>)>();
+
+  /// Stop an update, keeping the registered map, and release its id.
+  /// Must also be called once a finished update's result was read.
+  void comaps_cancel_map_update(int id) {
+    return _comaps_cancel_map_update(id);
+  }
+
+  late final _comaps_cancel_map_updatePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int64)>>(
+        'comaps_cancel_map_update',
+      );
+  late final _comaps_cancel_map_update = _comaps_cancel_map_updatePtr
+      .asFunction<void Function(int)>();
+
+  /// Apply budget to all queued and running fetches.
+  void comaps_set_map_fetch_budget(ffi.Pointer<ComapsMapFetchBudget> budget) {
+    return _comaps_set_map_fetch_budget(budget);
+  }
+
+  late final _comaps_set_map_fetch_budgetPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Void Function(ffi.Pointer<ComapsMapFetchBudget>)>
+      >('comaps_set_map_fetch_budget');
+  late final _comaps_set_map_fetch_budget = _comaps_set_map_fetch_budgetPtr
+      .asFunction<void Function(ffi.Pointer<ComapsMapFetchBudget>)>();
+
+  /// Download, verify and register a map in one background job: the body is hashed while it
+  /// is written to file_path.part, which is checked against sha256 (or, if NULL, checked to
+  /// open as a map), synced and renamed to file_path, then registered as by comaps_replace_map.
+  /// A .part file left by an interrupted fetch is resumed. file_size must be exact.
+  /// register_map: 0 to only download and verify. When registering, a file_path of a registered
+  /// map fails right away (status failed, failure register): write the new version elsewhere.
+  /// Returns: fetch id for comaps_get_map_fetch_progress / comaps_cancel_map_fetch,
+  /// -1 if framework not ready (when registering), arguments are invalid, or unsupported
+  int comaps_fetch_map(
+    ffi.Pointer<ffi.Char> url,
+    ffi.Pointer<ffi.Char> file_path,
+    int file_size,
+    ffi.Pointer<ffi.Char> sha256,
+    int register_map,
+  ) {
+    return _comaps_fetch_map(url, file_path, file_size, sha256, register_map);
+  }
+
+  late final _comaps_fetch_mapPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int64 Function(
+            ffi.Pointer<ffi.Char>,
+            ffi.Pointer<ffi.Char>,
+            ffi.Int64,
+            ffi.Pointer<ffi.Char>,
+            ffi.Int,
+          )
+        >
+      >('comaps_fetch_map');
+  late final _comaps_fetch_map = _comaps_fetch_mapPtr
+      .asFunction<
+        int Function(
+          ffi.Pointer<ffi.Char>,
+          ffi.Pointer<ffi.Char>,
+          int,
+          ffi.Pointer<ffi.Char>,
+          int,
+        )
+      >();
+
+  /// Once it reports a finished download, the id is released.
+  /// Returns: 0 and fills out_progress, or -1 if the id is unknown
+  int comaps_get_map_fetch_progress(
+    int id,
+    ffi.Pointer<ComapsMapFetchProgress> out_progress,
+  ) {
+    return _comaps_get_map_fetch_progress(id, out_progress);
+  }
+
+  late final _comaps_get_map_fetch_progressPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Int64, ffi.Pointer<ComapsMapFetchProgress>)
+        >
+      >('comaps_get_map_fetch_progress');
+  late final _comaps_get_map_fetch_progress = _comaps_get_map_fetch_progressPtr
+      .asFunction<int Function(int, ffi.Pointer<ComapsMapFetchProgress>)>();
+
+  /// Stop a fetch, keeping its .part file for a later one, and release its id.
+  /// Must also be called once a finished fetch's result was read.
+  void comaps_cancel_map_fetch(int id) {
+    return _comaps_cancel_map_fetch(id);
+  }
+
+  late final _comaps_cancel_map_fetchPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int64)>>(
+        'comaps_cancel_map_fetch',
+      );
+  late final _comaps_cancel_map_fetch = _comaps_cancel_map_fetchPtr
+      .asFunction<void Function(int)>();
+
+  /// Download a file from several mirrors at once: it is split into ranges that
+  /// connections_per_mirror connections per mirror pull from a shared queue, so faster
+  /// mirrors fetch more; idle connections take over the tail of slower ones near the end.
+  /// urls are the same file on each mirror, lowest latency first. file_size must be exact.
+  /// The file only appears at file_path once complete; failing or cancelling removes it.
+  /// Returns: download id for comaps_mirror_download_get_progress / comaps_mirror_download_cancel,
+  /// -1 if arguments are invalid or unsupported
+  int comaps_download_from_mirrors(
+    ffi.Pointer<ffi.Pointer<ffi.Char>> urls,
+    int url_count,
+    ffi.Pointer<ffi.Char> file_path,
+    int file_size,
+    int connections_per_mirror,
+  ) {
+    return _comaps_download_from_mirrors(
+      urls,
+      url_count,
+      file_path,
+      file_size,
+      connections_per_mirror,
+    );
+  }
+
+  late final _comaps_download_from_mirrorsPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int64 Function(
+            ffi.Pointer<ffi.Pointer<ffi.Char>>,
+            ffi.Int,
+            ffi.Pointer<ffi.Char>,
+            ffi.Int64,
+            ffi.Int,
+          )
+        >
+      >('comaps_download_from_mirrors');
+  late final _comaps_download_from_mirrors = _comaps_download_from_mirrorsPtr
+      .asFunction<
+        int Function(
+          ffi.Pointer<ffi.Pointer<ffi.Char>>,
+          int,
+          ffi.Pointer<ffi.Char>,
+          int,
+          int,
+        )
+      >();
+
+  /// Fill out_progress and, if not NULL, mirror_count entries of out_mirrors (one per url,
+  /// in the order given).
+  /// Returns: 0, or -1 if the id is unknown
+  int comaps_mirror_download_get_progress(
+    int id,
+    ffi.Pointer<ComapsDownloadProgress> out_progress,
+    ffi.Pointer<ComapsMirrorStats> out_mirrors,
+    int mirror_count,
+  ) {
+    return _comaps_mirror_download_get_progress(
+      id,
+      out_progress,
+      out_mirrors,
+      mirror_count,
+    );
+  }
+
+  late final _comaps_mirror_download_get_progressPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(
+            ffi.Int64,
+            ffi.Pointer<ComapsDownloadProgress>,
+            ffi.Pointer<ComapsMirrorStats>,
+            ffi.Int,
+          )
+        >
+      >('comaps_mirror_download_get_progress');
+  late final _comaps_mirror_download_get_progress =
+      _comaps_mirror_download_get_progressPtr
+          .asFunction<
+            int Function(
+              int,
+              ffi.Pointer<ComapsDownloadProgress>,
+              ffi.Pointer<ComapsMirrorStats>,
+              int,
+            )
+          >();
+
+  /// Stop a download and release its id.
+  /// Must also be called once a finished download's result was read.
+  void comaps_mirror_download_cancel(int id) {
+    return _comaps_mirror_download_cancel(id);
+  }
+
+  late final _comaps_mirror_download_cancelPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int64)>>(
+        'comaps_mirror_download_cancel',
+      );
+  late final _comaps_mirror_download_cancel = _comaps_mirror_download_cancelPtr
+      .asFunction<void Function(int)>();
+
+  /// Start recording trace spans (comaps_* calls, GUI and worker pool tasks, frame
+  /// presents, file reads, startup phases, Drape tile reads, searches) from every thread,
+  /// dropping any previous recording. Each thread keeps up to max_events_per_thread spans
+  /// (<= 0 for the default of 65536); later ones are dropped.
+  void comaps_trace_start(int max_events_per_thread) {
+    return _comaps_trace_start(max_events_per_thread);
+  }
+
+  late final _comaps_trace_startPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Int)>>(
+        'comaps_trace_start',
+      );
+  late final _comaps_trace_start = _comaps_trace_startPtr
+      .asFunction<void Function(int)>();
+
+  /// Stop recording; the recording is kept for comaps_trace_dump.
+  void comaps_trace_stop() {
+    return _comaps_trace_stop();
+  }
+
+  late final _comaps_trace_stopPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function()>>('comaps_trace_stop');
+  late final _comaps_trace_stop = _comaps_trace_stopPtr
+      .asFunction<void Function()>();
+
+  /// Write the recording to path as Chrome trace event JSON, for chrome://tracing or
+  /// ui.perfetto.dev. May be called while recording.
+  /// Returns: number of events written, or -1 if path can't be written
+  int comaps_trace_dump(ffi.Pointer<ffi.Char> path) {
+    return _comaps_trace_dump(path);
+  }
+
+  late final _comaps_trace_dumpPtr =
+      _lookup<ffi.NativeFunction<ffi.Int64 Function(ffi.Pointer<ffi.Char>)>>(
+        'comaps_trace_dump',
+      );
+  late final _comaps_trace_dump = _comaps_trace_dumpPtr
+      .asFunction<int Function(ffi.Pointer<ffi.Char>)>();
+
+  /// Write every engine metric into buffer as one JSON object (NUL-terminated):
+  /// {"uptime_us":N,"counters":{...},"gauges":{...},
+  /// "histograms":{name:{"count","sum","max","p50","p90","p99"},...}}
+  /// Counters are totals since process start; histogram values are microseconds
+  /// (names ending in _us), with percentiles rounded up to a power of two.
+  /// Returns: length of the full snapshot, which may exceed buffer_size - 1
+  int comaps_metrics_snapshot(ffi.Pointer<ffi.Char> buffer, int buffer_size) {
+    return _comaps_metrics_snapshot(buffer, buffer_size);
+  }
+
+  late final _comaps_metrics_snapshotPtr =
+      _lookup<
+        ffi.NativeFunction<ffi.Int Function(ffi.Pointer<ffi.Char>, ffi.Int)>
+      >('comaps_metrics_snapshot');
+  late final _comaps_metrics_snapshot = _comaps_metrics_snapshotPtr
+      .asFunction<int Function(ffi.Pointer<ffi.Char>, int)>();
+
+  /// Find the registered region map covering each of count points, writing count
+  /// entries to out_hits. Matches against the real region borders; World maps are
+  /// not reported.
+  /// Returns: number of points covered by a region map, -1 if framework not ready
+  int comaps_find_mwms_at(
+    ffi.Pointer<ComapsLatLon> points,
+    int count,
+    ffi.Pointer<ComapsMwmHit> out_hits,
+  ) {
+    return _comaps_find_mwms_at(points, count, out_hits);
+  }
+
+  late final _comaps_find_mwms_atPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(
+            ffi.Pointer<ComapsLatLon>,
+            ffi.Int,
+            ffi.Pointer<ComapsMwmHit>,
+          )
+        >
+      >('comaps_find_mwms_at');
+  late final _comaps_find_mwms_at = _comaps_find_mwms_atPtr
+      .asFunction<
+        int Function(ffi.Pointer<ComapsLatLon>, int, ffi.Pointer<ComapsMwmHit>)
+      >();
+
   /// Debug: List all registered MWMs and their bounds to logcat
   void comaps_debug_list_mwms() {
     return _comaps_debug_list_mwms();
@@ -188,3 +1039,339 @@ class AgusMapsFlutterBindings {
   late final _comaps_debug_check_point = _comaps_debug_check_pointPtr
       .asFunction<void Function(double, double)>();
 }
+
+/// Thread budget for search and platform worker pools.
+/// Any field <= 0 is sized automatically from the number of CPU cores.
+final class ComapsThreadConfig extends ffi.Struct {
+  @ffi.Int32()
+  external int search_threads;
+
+  @ffi.Int32()
+  external int network_threads;
+
+  @ffi.Int32()
+  external int file_threads;
+
+  @ffi.Int32()
+  external int background_threads;
+
+  @ffi.Int32()
+  external int read_threads;
+}
+
+/// Utilization counters of one worker pool.
+final class ComapsThreadPoolStats extends ffi.Struct {
+  @ffi.Array.multi([16])
+  external ffi.Array<ffi.Char> name;
+
+  @ffi.Int32()
+  external int threads;
+
+  @ffi.Int64()
+  external int tasks_completed;
+
+  @ffi.Int64()
+  external int tasks_pending;
+
+  @ffi.Int64()
+  external int busy_us;
+
+  @ffi.Int64()
+  external int uptime_us;
+}
+
+/// Progress of a native file download.
+/// status: 0=in progress, 1=completed, 2=failed, 3=file not found on server, -1=unknown id
+final class ComapsDownloadProgress extends ffi.Struct {
+  @ffi.Int32()
+  external int status;
+
+  @ffi.Int64()
+  external int bytes_downloaded;
+
+  @ffi.Int64()
+  external int bytes_total;
+}
+
+/// New version of a registered map, see comaps_update_map.
+final class ComapsMapUpdateRequest extends ffi.Struct {
+  external ffi.Pointer<ffi.Char> old_path;
+
+  external ffi.Pointer<ffi.Char> new_path;
+
+  external ffi.Pointer<ffi.Char> diff_url;
+
+  @ffi.Int64()
+  external int diff_size;
+
+  external ffi.Pointer<ffi.Char> full_url;
+
+  @ffi.Int64()
+  external int full_size;
+
+  external ffi.Pointer<ffi.Char> sha256;
+}
+
+/// Progress of a map update.
+/// status: 0=in progress, 1=updated by diff, 2=updated by full download, 3=failed, 4=cancelled, -1=unknown id
+/// diff_failure: 0=none, 1=skipped (no diff or too large), 2=download, 3=apply, 4=verify failed
+final class ComapsMapUpdateProgress extends ffi.Struct {
+  @ffi.Int32()
+  external int status;
+
+  @ffi.Int32()
+  external int diff_failure;
+
+  @ffi.Int32()
+  external int reg_result;
+
+  @ffi.Int64()
+  external int downloaded_bytes;
+
+  @ffi.Int64()
+  external int full_bytes;
+
+  @ffi.Int64()
+  external int bytes_saved;
+
+  @ffi.Int64()
+  external int apply_us;
+
+  @ffi.Int64()
+  external int verify_us;
+
+  @ffi.Int64()
+  external int total_us;
+}
+
+/// Limits shared by all map fetches, see comaps_fetch_map.
+final class ComapsMapFetchBudget extends ffi.Struct {
+  @ffi.Int32()
+  external int max_concurrent;
+
+  @ffi.Int64()
+  external int max_bytes_per_second;
+
+  @ffi.Int64()
+  external int max_unsynced_bytes;
+}
+
+/// Progress of a map fetch.
+/// status: 0=queued, 1=downloading, 2=syncing, 3=registering, 4=completed, 5=failed, 6=cancelled, -1=unknown id
+/// failure: 0=none, 1=network, 2=file not found, 3=write, 4=verify, 5=register
+final class ComapsMapFetchProgress extends ffi.Struct {
+  @ffi.Int32()
+  external int status;
+
+  @ffi.Int32()
+  external int failure;
+
+  @ffi.Int32()
+  external int reg_result;
+
+  @ffi.Int64()
+  external int bytes_written;
+
+  @ffi.Int64()
+  external int bytes_total;
+
+  @ffi.Int64()
+  external int resumed_bytes;
+
+  @ffi.Int64()
+  external int throttled_us;
+
+  @ffi.Int64()
+  external int download_us;
+
+  @ffi.Int64()
+  external int sync_us;
+
+  @ffi.Int64()
+  external int register_us;
+
+  @ffi.Int64()
+  external int total_us;
+
+  @ffi.Array.multi([65])
+  external ffi.Array<ffi.Char> sha256;
+}
+
+/// What one mirror contributed to a download from several mirrors.
+final class ComapsMirrorStats extends ffi.Struct {
+  @ffi.Int64()
+  external int bytes;
+
+  @ffi.Int64()
+  external int bytes_per_second;
+
+  @ffi.Int64()
+  external int first_byte_us;
+
+  @ffi.Int32()
+  external int ranges;
+
+  @ffi.Int32()
+  external int steals;
+
+  @ffi.Int32()
+  external int errors;
+
+  @ffi.Int32()
+  external int disabled;
+}
+
+/// Timing of the first frames after the map engine was created
+/// (or after a map was replaced, see comaps_get_map_replace_frame_stats).
+final class ComapsFirstFrameStats extends ffi.Struct {
+  @ffi.Int64()
+  external int first_frame_us;
+
+  @ffi.Int64()
+  external int settled_frame_us;
+
+  @ffi.Int32()
+  external int frames;
+
+  @ffi.Int64()
+  external int max_frame_gap_us;
+}
+
+/// Outcome of comaps_set_map_style.
+final class ComapsStyleSwitchResult extends ffi.Struct {
+  @ffi.Int32()
+  external int dark;
+
+  @ffi.Int32()
+  external int mapped;
+
+  @ffi.Int32()
+  external int changed;
+
+  @ffi.Int64()
+  external int apply_us;
+
+  @ffi.Int64()
+  external int mapped_bytes;
+}
+
+/// Outcome of comaps_replace_map.
+final class ComapsMapReplaceResult extends ffi.Struct {
+  @ffi.Int32()
+  external int result;
+
+  @ffi.Int64()
+  external int old_version;
+
+  @ffi.Int64()
+  external int new_version;
+
+  @ffi.Int64()
+  external int swap_us;
+
+  @ffi.Int64()
+  external int invalidate_us;
+}
+
+final class ComapsLatLon extends ffi.Struct {
+  @ffi.Double()
+  external double lat;
+
+  @ffi.Double()
+  external double lon;
+}
+
+/// Registered region map covering a point.
+final class ComapsMwmHit extends ffi.Struct {
+  @ffi.Array.multi([64])
+  external ffi.Array<ffi.Char> country_name;
+
+  @ffi.Int64()
+  external int version;
+}
+
+/// Outcome of comaps_register_maps_lazy.
+final class ComapsLazyBatchStats extends ffi.Struct {
+  @ffi.Int32()
+  external int recorded;
+
+  @ffi.Int32()
+  external int failed;
+
+  @ffi.Int32()
+  external int from_snapshot;
+
+  @ffi.Int64()
+  external int elapsed_us;
+}
+
+/// Descriptor pool shared by MWM file readers.
+final class ComapsFilePoolStats extends ffi.Struct {
+  @ffi.Int32()
+  external int limit;
+
+  @ffi.Int32()
+  external int files;
+
+  @ffi.Int32()
+  external int open_descriptors;
+
+  @ffi.Int64()
+  external int opens;
+
+  @ffi.Int64()
+  external int reopens;
+
+  @ffi.Int64()
+  external int evictions;
+}
+
+/// Outcome of the last map engine startup.
+final class ComapsStartupReport extends ffi.Struct {
+  @ffi.Int32()
+  external int mode;
+
+  @ffi.Int32()
+  external int deferred_tasks;
+
+  @ffi.Int64()
+  external int first_frame_us;
+
+  @ffi.Int64()
+  external int framework_us;
+
+  @ffi.Int64()
+  external int deferred_us;
+}
+
+/// Bytes released by each step of comaps_on_memory_pressure, reported once on an engine
+/// thread after the last step ran. Textures are counted by Drape, the rest is the
+/// resident set delta.
+typedef ComapsTrimCallback =
+    ffi.Pointer<ffi.NativeFunction<ComapsTrimCallbackFunction>>;
+typedef ComapsTrimCallbackFunction =
+    ffi.Void Function(
+      ffi.Int64 search_caches_freed,
+      ffi.Int64 reader_caches_freed,
+      ffi.Int64 drape_tiles_freed,
+      ffi.Int64 drape_textures_freed,
+      ffi.Int64 allocator_freed,
+    );
+typedef DartComapsTrimCallbackFunction =
+    void Function(
+      int search_caches_freed,
+      int reader_caches_freed,
+      int drape_tiles_freed,
+      int drape_textures_freed,
+      int allocator_freed,
+    );
+
+/// Progress of comaps_hash_files, called on its hashing threads. file_index is into paths;
+/// status is 0 while hashing (once per 64 MB), then 1 when done or -1 if the file can't be read;
+/// bytes is how much of that file was hashed so far.
+typedef ComapsHashProgressCallback =
+    ffi.Pointer<ffi.NativeFunction<ComapsHashProgressCallbackFunction>>;
+typedef ComapsHashProgressCallbackFunction =
+    ffi.Void Function(ffi.Int32 file_index, ffi.Int32 status, ffi.Int64 bytes);
+typedef DartComapsHashProgressCallbackFunction =
+    void Function(int file_index, int status, int bytes);
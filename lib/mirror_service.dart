@@ -3,6 +3,9 @@ import 'dart:io';
 import 'package:flutter/foundation.dart';
 import 'package:http/http.dart' as http;
 
+import 'agus_maps_flutter.dart'
+    show downloadFromMirrors, MirrorDownloadResult, MirrorDownloadStats;
+
 /// Represents a mirror server hosting MWM files.
 class Mirror {
   final String name;
@@ -10,15 +13,21 @@ class Mirror {
   int? latencyMs;
   bool isAvailable;
 
+  /// Throughput this mirror delivered in the last download it took part in.
+  int? bytesPerSecond;
+
   Mirror({
     required this.name,
     required this.baseUrl,
     this.latencyMs,
     this.isAvailable = true,
+    this.bytesPerSecond,
   });
 
   @override
-  String toString() => 'Mirror($name, ${latencyMs}ms, available=$isAvailable)';
+  String toString() =>
+      'Mirror($name, ${latencyMs}ms, available=$isAvailable'
+      '${bytesPerSecond != null ? ', ${(bytesPerSecond! / (1024 * 1024)).toStringAsFixed(2)} MB/s' : ''})';
 }
 
 /// Represents a snapshot (version) of MWM files.
@@ -290,6 +299,78 @@ class MirrorService {
     return received;
   }
 
+  /// Download a region from up to [maxMirrors] of the fastest available
+  /// mirrors at once.
+  ///
+  /// Mirrors are ordered by [Mirror.latencyMs] (call [measureLatencies]
+  /// first). On Android the file is fetched natively in byte ranges spread over
+  /// all of them, with slow connections' tails taken over by faster ones (see
+  /// [downloadFromMirrors]); elsewhere it is streamed from the fastest one with
+  /// [downloadToFile]. Each mirror's [Mirror.bytesPerSecond] is updated from
+  /// the result.
+  Future<MirrorDownloadResult> downloadFromFastestMirrors(
+    Snapshot snapshot,
+    MwmRegion region,
+    File destination, {
+    int maxMirrors = 3,
+    int connectionsPerMirror = 2,
+    void Function(int received, int total)? onProgress,
+  }) async {
+    final ranked = mirrors.where((m) => m.isAvailable).toList()
+      ..sort(
+        (a, b) => (a.latencyMs ?? 999999).compareTo(b.latencyMs ?? 999999),
+      );
+    if (ranked.isEmpty) {
+      throw Exception('No mirror available for ${region.fileName}');
+    }
+    final chosen = ranked.take(maxMirrors).toList();
+    final urls = [for (final m in chosen) getDownloadUrl(m, snapshot, region)];
+    final size = region.sizeBytes ?? await getFileSize(urls.first);
+
+    final MirrorDownloadResult result;
+    if (Platform.isAndroid && size != null && size > 0) {
+      result = await downloadFromMirrors(
+        urls,
+        destination,
+        size: size,
+        connectionsPerMirror: connectionsPerMirror,
+        onProgress: onProgress,
+      );
+    } else {
+      final stopwatch = Stopwatch()..start();
+      final bytes = await downloadToFile(
+        urls.first,
+        destination,
+        onProgress: onProgress,
+      );
+      final elapsed = stopwatch.elapsed;
+      result = MirrorDownloadResult(
+        bytes: bytes,
+        elapsed: elapsed,
+        mirrors: [
+          MirrorDownloadStats(
+            url: urls.first,
+            bytes: bytes,
+            bytesPerSecond: elapsed.inMicroseconds > 0
+                ? bytes * 1000000 ~/ elapsed.inMicroseconds
+                : 0,
+            firstByte: Duration.zero,
+            ranges: 1,
+            steals: 0,
+            errors: 0,
+            disabled: false,
+          ),
+        ],
+      );
+    }
+
+    for (var i = 0; i < chosen.length && i < result.mirrors.length; i++) {
+      final stats = result.mirrors[i];
+      if (stats.bytes > 0) chosen[i].bytesPerSecond = stats.bytesPerSecond;
+    }
+    return result;
+  }
+
   /// Download a file with progress callback (legacy in-memory version).
   ///
   /// **WARNING:** This method accumulates the entire file in memory.
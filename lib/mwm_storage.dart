@@ -3,6 +3,8 @@ import 'dart:io';
 import 'package:flutter/foundation.dart';
 import 'package:shared_preferences/shared_preferences.dart';
 
+import 'agus_maps_flutter.dart' show hashFiles;
+
 /// Metadata for a downloaded or bundled MWM map file.
 class MwmMetadata {
   /// Region/country name (e.g., "Gibraltar", "World")
@@ -217,15 +219,18 @@ class MwmStorage {
 
   /// Validate all stored metadata against actual files on disk.
   ///
-  /// Runs validation checks in parallel using [Isolate.run] for large
-  /// collections to avoid blocking the UI thread.
-  ///
   /// Returns a list of [FileValidationResult] for each stored region.
   /// Use [pruneOrphaned] parameter to automatically remove metadata
   /// for files that no longer exist.
+  ///
+  /// With [verifyHashes], files of the right size that have a stored
+  /// [MwmMetadata.sha256] are also hashed, natively and in parallel (see
+  /// [hashFiles]); [onHashProgress] follows that pass.
   Future<List<FileValidationResult>> validateAll({
     bool pruneOrphaned = false,
+    bool verifyHashes = false,
     void Function(int current, int total)? onProgress,
+    void Function(int filesDone, int total, int bytesHashed)? onHashProgress,
   }) async {
     final regions = List<MwmMetadata>.from(_cache);
     final results = <FileValidationResult>[];
@@ -243,6 +248,23 @@ class MwmStorage {
       onProgress?.call(i + 1, regions.length);
     }
 
+    if (verifyHashes) {
+      final toHash = <int>[
+        for (var i = 0; i < regions.length; i++)
+          if (regions[i].sha256 != null && results[i].isValid) i,
+      ];
+      final digests = await hashFiles(
+        [for (final i in toHash) regions[i].filePath],
+        onProgress: onHashProgress,
+      );
+      for (var k = 0; k < toHash.length; k++) {
+        final i = toHash[k];
+        results[i] = results[i].withHashMatches(
+          digests[k] == regions[i].sha256!.toLowerCase(),
+        );
+      }
+    }
+
     // Prune orphaned metadata if requested
     if (pruneOrphaned && orphanedRegions.isNotEmpty) {
       for (final region in orphanedRegions) {
@@ -323,6 +345,9 @@ class FileValidationResult {
   /// Whether actual size matches expected (null if file doesn't exist).
   final bool? sizeMatches;
 
+  /// Whether the file's SHA-256 matches the stored one (null if not checked).
+  final bool? hashMatches;
+
   const FileValidationResult({
     required this.regionName,
     required this.exists,
@@ -331,10 +356,23 @@ class FileValidationResult {
     this.actualSize,
     this.expectedSize,
     this.sizeMatches,
+    this.hashMatches,
   });
 
-  /// True if the file is valid (exists and size matches).
-  bool get isValid => exists && (sizeMatches ?? false);
+  FileValidationResult withHashMatches(bool matches) => FileValidationResult(
+    regionName: regionName,
+    exists: exists,
+    hasMetadata: hasMetadata,
+    expectedPath: expectedPath,
+    actualSize: actualSize,
+    expectedSize: expectedSize,
+    sizeMatches: sizeMatches,
+    hashMatches: matches,
+  );
+
+  /// True if the file is valid (exists, size and, if checked, hash match).
+  bool get isValid =>
+      exists && (sizeMatches ?? false) && (hashMatches ?? true);
 
   /// True if metadata exists but file is missing (orphaned).
   bool get isOrphaned => hasMetadata && !exists;
@@ -342,10 +380,16 @@ class FileValidationResult {
   /// True if file exists but size doesn't match (possibly corrupted).
   bool get isSizeMismatch => exists && !(sizeMatches ?? true);
 
+  /// True if the file has the right size but its contents differ.
+  bool get isHashMismatch => exists && !(hashMatches ?? true);
+
   @override
   String toString() {
     if (!hasMetadata) return 'FileValidationResult($regionName: no metadata)';
     if (!exists) return 'FileValidationResult($regionName: MISSING)';
+    if (isHashMismatch) {
+      return 'FileValidationResult($regionName: hash mismatch)';
+    }
     if (!isValid) {
       return 'FileValidationResult($regionName: size mismatch '
           '$actualSize != $expectedSize)';
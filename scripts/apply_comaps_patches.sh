@@ -5,11 +5,32 @@ set -euo pipefail
 #
 # Patch files are part of this repo's IP. They are only used if a clean bridge
 # is not possible.
+#
+# Usage:
+#   ./scripts/apply_comaps_patches.sh [--refresh]
+#
+# Options:
+#   --refresh    Commit each patch once applied and rewrite it from that commit with
+#                git format-patch, so its hunk offsets and index lines match the
+#                checkout. Run on a checkout at the tag the patches target
+#                (./scripts/fetch_comaps.sh), then review the patches with git diff.
+#                The checkout is left as without --refresh: patched, uncommitted.
 
 ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
 COMAPS_DIR="$ROOT_DIR/thirdparty/comaps"
 PATCH_DIR="$ROOT_DIR/patches/comaps"
 
+REFRESH=false
+case "${1:-}" in
+  "") ;;
+  --refresh) REFRESH=true ;;
+  *)
+    echo "[apply_comaps_patches] unknown option: $1"
+    echo "usage: $0 [--refresh]"
+    exit 1
+    ;;
+esac
+
 if [[ ! -d "$COMAPS_DIR/.git" ]]; then
   echo "[apply_comaps_patches] missing CoMaps checkout at $COMAPS_DIR"
   echo "[apply_comaps_patches] run: ./scripts/fetch_comaps.sh"
@@ -32,13 +53,29 @@ echo "[apply_comaps_patches] resetting working tree to HEAD..."
 git reset HEAD -- . >/dev/null 2>&1 || true
 git checkout -- .
 git clean -fd
+BASE="$(git rev-parse HEAD)"
 
 for patch in "${PATCHES[@]}"; do
   echo "[apply_comaps_patches] applying $(basename "$patch")"
   # --3way helps across tags when context is close; fail loudly if it can't apply.
   git apply --3way --whitespace=nowarn "$patch"
+
+  if $REFRESH; then
+    git add -A
+    git -c user.name=apply_comaps_patches -c user.email=apply_comaps_patches@localhost \
+      commit -q --no-verify -m "$(basename "$patch" .patch)"
+    # Only the diff is kept: patches are applied with git apply, not git am.
+    git format-patch -1 --stdout --no-stat --no-signature --abbrev=8 HEAD |
+      sed -n '/^diff --git /,$p' > "$patch"
+    echo "[apply_comaps_patches] refreshed $(basename "$patch")"
+  fi
 done
 
+if $REFRESH; then
+  # Drop the refresh commits, keeping their changes in the working tree.
+  git reset -q "$BASE"
+fi
+
 echo "[apply_comaps_patches] done"
 
 popd >/dev/null
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+Build a CoMaps resource pack from a data directory.
+
+The pack replaces the extracted copy of the data files: the plugin maps it once
+and serves every entry from the mapping (see src/agus_resource_pack.hpp for the
+layout). Entries start on page boundaries so that each one can be mapped on its
+own and stays page-aligned when the pack is stored uncompressed in an APK.
+
+Usage:
+  scripts/build_resource_pack.py <data_dir> <output.pack>
+
+Example:
+  scripts/build_resource_pack.py example/assets/comaps_data example/assets/packs/comaps_data.pack
+"""
+
+import os
+import struct
+import sys
+
+MAGIC = b"AGUSPACK"
+FORMAT_VERSION = 1
+PAGE_SIZE = 4096
+# magic, version, entry count, index offset, index size
+HEADER = struct.Struct("<8sIIQQ")
+
+
+def align(value):
+    return (value + PAGE_SIZE - 1) // PAGE_SIZE * PAGE_SIZE
+
+
+def collect(data_dir):
+    names = []
+    for root, dirs, files in os.walk(data_dir):
+        dirs.sort()
+        for name in sorted(files):
+            if name.startswith("."):
+                continue
+            path = os.path.join(root, name)
+            names.append(os.path.relpath(path, data_dir).replace(os.sep, "/"))
+    return names
+
+
+def build(data_dir, output):
+    names = collect(data_dir)
+    entries = []
+    tmp = output + ".tmp"
+    with open(tmp, "wb") as out:
+        out.write(b"\0" * PAGE_SIZE)  # header, written last
+        offset = PAGE_SIZE
+        for name in names:
+            with open(os.path.join(data_dir, name), "rb") as f:
+                data = f.read()
+            out.seek(offset)
+            out.write(data)
+            entries.append((name, offset, len(data)))
+            offset = align(offset + len(data))
+
+        index = bytearray()
+        for name, entry_offset, size in entries:
+            encoded = name.encode("utf-8")
+            index += struct.pack("<H", len(encoded)) + encoded + struct.pack("<QQ", entry_offset, size)
+        out.seek(offset)
+        out.write(index)
+
+        out.seek(0)
+        out.write(HEADER.pack(MAGIC, FORMAT_VERSION, len(entries), offset, len(index)))
+    os.replace(tmp, output)
+
+    total = sum(size for _, _, size in entries)
+    print(f"Packed {len(entries)} files ({total} bytes) into {output} ({os.path.getsize(output)} bytes)")
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip())
+        return 1
+    data_dir, output = sys.argv[1], sys.argv[2]
+    if not os.path.isdir(data_dir):
+        print(f"Not a directory: {data_dir}", file=sys.stderr)
+        return 1
+    build(data_dir, output)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
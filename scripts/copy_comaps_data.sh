@@ -69,6 +69,12 @@ if [ -d "$COMAPS_DATA/symbols" ]; then
     fi
 fi
 
+# Optionally bundle everything into one mmap-able pack (Android, see useResourcePack())
+if [ "${AGUS_RESOURCE_PACK:-0}" = "1" ]; then
+    python3 "$SCRIPT_DIR/build_resource_pack.py" "$DEST_DATA" "$ROOT_DIR/example/assets/packs/comaps_data.pack"
+    echo "  ✓ comaps_data.pack"
+fi
+
 echo ""
 echo "Data files copied to: $DEST_DATA"
 echo ""
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for a map server, to exercise map downloads and updates
+(updateMap, fetchMap, downloadFromMirrors in Dart) without the real mirrors.
+
+Serves the files of a directory over HTTP with byte-range support, which the
+native downloader needs for segmented and resumed downloads. On start it prints
+a manifest of the maps (.mwm) and diffs (.mwmdiff) found, with their sizes and
+the SHA-256 of each map, i.e. the values to pass to updateMap.
+
+Diffs are made with CoMaps' mwm_diff_tool (built along with the Android
+library), e.g.:
+  mwm_diff_tool make old/Spain_Madrid.mwm new/Spain_Madrid.mwm new/Spain_Madrid.mwmdiff
+
+Usage:
+  scripts/mwm_update_server.py <dir> [--port 8000] [--rate BYTES_PER_SEC]
+                               [--fail-diffs 404|corrupt]
+
+--fail-diffs makes every .mwmdiff request fail (404) or return damaged bytes,
+to check the fallback to the full download. Several instances on different
+ports with different --rate values stand in for mirrors of uneven speed.
+From the Android emulator the host is reachable as http://10.0.2.2:<port>/.
+"""
+
+import argparse
+import hashlib
+import http.server
+import json
+import os
+import re
+import sys
+import time
+
+CHUNK_SIZE = 64 * 1024
+
+
+def sha256_of(path):
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(1 << 20), b""):
+            digest.update(chunk)
+    return digest.hexdigest()
+
+
+def manifest(root):
+    entries = []
+    for dirpath, dirs, files in os.walk(root):
+        dirs.sort()
+        for name in sorted(files):
+            if not name.endswith((".mwm", ".mwmdiff")):
+                continue
+            path = os.path.join(dirpath, name)
+            entry = {
+                "url": "/" + os.path.relpath(path, root).replace(os.sep, "/"),
+                "size": os.path.getsize(path),
+            }
+            if name.endswith(".mwm"):
+                entry["sha256"] = sha256_of(path)
+            entries.append(entry)
+    return entries
+
+
+def make_handler(root, rate, fail_diffs):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def do_HEAD(self):
+            self.serve(send_body=False)
+
+        def do_GET(self):
+            self.serve(send_body=True)
+
+        def serve(self, send_body):
+            rel = self.path.split("?", 1)[0].lstrip("/")
+            path = os.path.realpath(os.path.join(root, rel))
+            if not path.startswith(os.path.realpath(root) + os.sep) or not os.path.isfile(path):
+                self.send_error(404)
+                return
+            is_diff = path.endswith(".mwmdiff")
+            if is_diff and fail_diffs == "404":
+                self.send_error(404)
+                return
+
+            size = os.path.getsize(path)
+            start, end = 0, size - 1
+            status = 200
+            match = re.fullmatch(r"bytes=(\d*)-(\d*)", self.headers.get("Range", ""))
+            if match and (match.group(1) or match.group(2)):
+                if match.group(1):
+                    start = int(match.group(1))
+                    end = min(int(match.group(2)), size - 1) if match.group(2) else size - 1
+                else:
+                    start = max(size - int(match.group(2)), 0)
+                if start > end:
+                    self.send_response(416)
+                    self.send_header("Content-Range", "bytes */%d" % size)
+                    self.send_header("Content-Length", "0")
+                    self.end_headers()
+                    return
+                status = 206
+
+            self.send_response(status)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(end - start + 1))
+            self.send_header("Accept-Ranges", "bytes")
+            if status == 206:
+                self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end, size))
+            self.end_headers()
+            if not send_body:
+                return
+
+            with open(path, "rb") as f:
+                f.seek(start)
+                remaining = end - start + 1
+                began = time.monotonic()
+                sent = 0
+                while remaining > 0:
+                    chunk = f.read(min(CHUNK_SIZE, remaining))
+                    if not chunk:
+                        break
+                    if is_diff and fail_diffs == "corrupt":
+                        chunk = bytes(b ^ 0x5A for b in chunk)
+                    self.wfile.write(chunk)
+                    remaining -= len(chunk)
+                    sent += len(chunk)
+                    if rate:
+                        # Sleep until the connection is back within its budget.
+                        ahead = sent / rate - (time.monotonic() - began)
+                        if ahead > 0:
+                            time.sleep(ahead)
+
+        def log_message(self, fmt, *args):
+            sys.stderr.write("%s %s\n" % (self.address_string(), fmt % args))
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("dir")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--rate", type=int, default=0, help="bytes per second per connection, 0 for unlimited")
+    parser.add_argument("--fail-diffs", choices=["404", "corrupt"])
+    args = parser.parse_args()
+
+    print(json.dumps(manifest(args.dir), indent=2))
+    server = http.server.ThreadingHTTPServer(("", args.port), make_handler(args.dir, args.rate, args.fail_diffs))
+    print("Serving %s on port %d" % (os.path.abspath(args.dir), args.port), file=sys.stderr)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
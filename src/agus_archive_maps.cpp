@@ -0,0 +1,221 @@
+#include "agus_archive_maps.hpp"
+
+#include "agus_file_pool.hpp"
+
+#include "coding/embedded_files.hpp"
+
+#include "defines.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace
+{
+uint32_t constexpr kEndOfCentralDirSignature = 0x06054b50;
+uint32_t constexpr kCentralDirSignature = 0x02014b50;
+uint32_t constexpr kLocalHeaderSignature = 0x04034b50;
+size_t constexpr kEndOfCentralDirSize = 22;
+size_t constexpr kCentralDirHeaderSize = 46;
+size_t constexpr kLocalHeaderSize = 30;
+/// The end record is followed by a comment of at most 64K.
+size_t constexpr kMaxCommentSize = 0xFFFF;
+/// Sizes and offsets of this value are in the zip64 extra field; maps don't get that large.
+uint32_t constexpr kZip64Marker = 0xFFFFFFFF;
+uint16_t constexpr kMethodStored = 0;
+
+template <typename T>
+T ReadLE(char const * p)
+{
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<T>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return value;
+}
+
+bool ReadAt(int fd, uint64_t pos, void * p, size_t size)
+{
+  auto * out = static_cast<char *>(p);
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t const n = pread(fd, out + done, size - done, static_cast<off_t>(pos + done));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+std::optional<ArchiveEntry> LocateInFile(int fd, uint64_t fileSize, std::string const & archivePath,
+                                         std::string const & entryName)
+{
+  if (fileSize < kEndOfCentralDirSize)
+    return {};
+
+  // The end of central directory record is the last signature in the tail.
+  size_t const tailSize = static_cast<size_t>(std::min<uint64_t>(fileSize, kEndOfCentralDirSize + kMaxCommentSize));
+  std::vector<char> tail(tailSize);
+  if (!ReadAt(fd, fileSize - tailSize, tail.data(), tailSize))
+    return {};
+  char const * end = nullptr;
+  for (size_t i = tailSize - kEndOfCentralDirSize + 1; i-- > 0;)
+  {
+    if (ReadLE<uint32_t>(tail.data() + i) == kEndOfCentralDirSignature)
+    {
+      end = tail.data() + i;
+      break;
+    }
+  }
+  if (!end)
+  {
+    LOG(LWARNING, (archivePath, "is not a zip archive"));
+    return {};
+  }
+
+  uint16_t const entries = ReadLE<uint16_t>(end + 10);
+  uint32_t const dirSize = ReadLE<uint32_t>(end + 12);
+  uint32_t const dirOffset = ReadLE<uint32_t>(end + 16);
+  if (dirOffset == kZip64Marker || static_cast<uint64_t>(dirOffset) + dirSize > fileSize)
+  {
+    LOG(LWARNING, ("Unsupported central directory in", archivePath));
+    return {};
+  }
+
+  std::vector<char> dir(dirSize);
+  if (!ReadAt(fd, dirOffset, dir.data(), dir.size()))
+    return {};
+
+  size_t pos = 0;
+  for (uint16_t i = 0; i < entries && pos + kCentralDirHeaderSize <= dir.size(); ++i)
+  {
+    char const * header = dir.data() + pos;
+    if (ReadLE<uint32_t>(header) != kCentralDirSignature)
+      break;
+    uint16_t const method = ReadLE<uint16_t>(header + 10);
+    uint32_t const compressedSize = ReadLE<uint32_t>(header + 20);
+    uint32_t const size = ReadLE<uint32_t>(header + 24);
+    uint16_t const nameSize = ReadLE<uint16_t>(header + 28);
+    uint16_t const extraSize = ReadLE<uint16_t>(header + 30);
+    uint16_t const commentSize = ReadLE<uint16_t>(header + 32);
+    uint32_t const localOffset = ReadLE<uint32_t>(header + 42);
+    if (pos + kCentralDirHeaderSize + nameSize > dir.size())
+      break;
+
+    if (entryName.size() == nameSize && std::memcmp(header + kCentralDirHeaderSize, entryName.data(), nameSize) == 0)
+    {
+      if (method != kMethodStored || compressedSize != size)
+      {
+        LOG(LWARNING, (entryName, "is compressed in", archivePath, "; store it uncompressed (noCompress)"));
+        return {};
+      }
+      if (size == kZip64Marker || localOffset == kZip64Marker)
+      {
+        LOG(LWARNING, (entryName, "in", archivePath, "needs zip64"));
+        return {};
+      }
+
+      // Data follows the local header, whose extra field (alignment padding in
+      // APKs) may differ from the central directory's.
+      char local[kLocalHeaderSize];
+      if (!ReadAt(fd, localOffset, local, sizeof(local)) || ReadLE<uint32_t>(local) != kLocalHeaderSignature)
+      {
+        LOG(LWARNING, ("Bad local header of", entryName, "in", archivePath));
+        return {};
+      }
+      ArchiveEntry entry;
+      entry.m_archive = archivePath;
+      entry.m_entry = entryName;
+      entry.m_offset = static_cast<uint64_t>(localOffset) + kLocalHeaderSize + ReadLE<uint16_t>(local + 26) +
+                       ReadLE<uint16_t>(local + 28);
+      entry.m_size = size;
+      if (entry.m_offset + entry.m_size > fileSize)
+        return {};
+      return entry;
+    }
+    pos += kCentralDirHeaderSize + nameSize + extraSize + commentSize;
+  }
+
+  LOG(LWARNING, ("No", entryName, "in", archivePath));
+  return {};
+}
+
+std::mutex g_mutex;
+std::unordered_map<std::string, ArchiveEntry> g_entries;
+}  // namespace
+
+std::string DebugPrint(ArchiveEntry const & entry)
+{
+  std::ostringstream out;
+  out << entry.m_archive << ":" << entry.m_entry << " @" << entry.m_offset << " size=" << entry.m_size;
+  return out.str();
+}
+
+std::optional<ArchiveEntry> LocateStoredEntry(std::string const & archivePath, std::string const & entryName)
+{
+  int const fd = open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG(LWARNING, ("Can't open archive", archivePath, strerror(errno)));
+    return {};
+  }
+  std::optional<ArchiveEntry> entry;
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+    entry = LocateInFile(fd, static_cast<uint64_t>(st.st_size), archivePath, entryName);
+  close(fd);
+  return entry;
+}
+
+std::string AddArchiveMap(ArchiveEntry entry)
+{
+  std::string path = entry.m_archive + "/" + entry.m_entry;
+  LOG(LINFO, ("Archive map", path, DebugPrint(entry)));
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_entries[path] = std::move(entry);
+  return path;
+}
+
+std::optional<ArchiveEntry> FindArchiveMap(std::string const & path)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto const it = g_entries.find(path);
+  if (it == g_entries.end())
+    return {};
+  return it->second;
+}
+
+std::unique_ptr<ModelReader> OpenArchiveMapReader(std::string const & path)
+{
+  auto const entry = FindArchiveMap(path);
+  if (!entry)
+    return nullptr;
+  return OpenPooledReader(path, entry->m_archive, entry->m_offset, entry->m_size, READER_CHUNK_LOG_SIZE,
+                          READER_CHUNK_LOG_COUNT);
+}
+
+void ServeArchiveMapsAsFiles()
+{
+  embedded_files::g_resolve = [](std::string const & path) -> std::optional<embedded_files::Location>
+  {
+    auto const entry = FindArchiveMap(path);
+    if (!entry)
+      return {};
+    return embedded_files::Location{entry->m_archive, entry->m_offset, entry->m_size};
+  };
+}
+}  // namespace agus
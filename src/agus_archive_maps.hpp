@@ -0,0 +1,44 @@
+#pragma once
+
+#include "coding/reader.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace agus
+{
+/// Byte range of a file stored uncompressed inside a zip archive (e.g. an APK asset
+/// listed in noCompress).
+struct ArchiveEntry
+{
+  std::string m_archive;
+  std::string m_entry;
+  uint64_t m_offset = 0;
+  uint64_t m_size = 0;
+};
+
+std::string DebugPrint(ArchiveEntry const & entry);
+
+/// Looks |entryName| up in the central directory of |archivePath|. Returns nullopt
+/// if the archive can't be read, has no such entry or the entry is compressed.
+std::optional<ArchiveEntry> LocateStoredEntry(std::string const & archivePath, std::string const & entryName);
+
+/// Makes |entry| readable in place through Platform::GetReader and returns the path
+/// it is known by: "<archive>/<entry>", which can't exist on disk since the archive
+/// is a file. Register maps with LocalCountryFile::MakeTemporary(path), synced with disk.
+std::string AddArchiveMap(ArchiveEntry entry);
+
+/// The archive entry added under |path|, if any.
+std::optional<ArchiveEntry> FindArchiveMap(std::string const & path);
+
+/// Reader over the archive entry added under |path|, nullptr if there is none.
+std::unique_ptr<ModelReader> OpenArchiveMapReader(std::string const & path);
+
+/// Resolves paths from AddArchiveMap for the engine code that goes around
+/// Platform::GetReader (CoMaps patch 0023): file sizes, so LocalCountryFile::SyncWithDisk
+/// finds the map, and FilesMappingContainer, which maps the entry's sections from the
+/// archive. Call once, before archive maps are added.
+void ServeArchiveMapsAsFiles();
+}  // namespace agus
@@ -0,0 +1,1120 @@
+// agus_bench: renders a fixed set of maps headless (EGL pbuffer, works on Mesa's
+// software rasterizer), replays scripted camera paths and prints per-script frame
+// times, time to tile-complete and memory peaks as JSON. Run without arguments for
+// usage. Exits with 1 when a script misses a --max-* limit or its tiles never
+// complete, so CI can use it as a regression gate. With --startup-runs it times
+// engine startup instead, phase by phase, in a fresh process per run and optionally
+// with a cold page cache. It runs on the plugin's own platform layer (agus_platform:
+// file pool, resource pack, fonts, thread pools), as the Android app does.
+
+#include "agus_frame_stats.hpp"
+#include "agus_headless_gl.hpp"
+#include "agus_lazy_maps.hpp"
+#include "agus_log.hpp"
+#include "agus_memory.hpp"
+#include "agus_metrics.hpp"
+#include "agus_platform.hpp"
+#include "agus_startup_trace.hpp"
+#include "agus_trace.hpp"
+
+#include "map/framework.hpp"
+
+#include "drape_frontend/active_frame_callback.hpp"
+#include "drape_frontend/user_event_stream.hpp"
+
+#include "drape/graphics_context_factory.hpp"
+
+#include "platform/local_country_file.hpp"
+#include "platform/platform.hpp"
+
+#include "geometry/mercator.hpp"
+
+#include "base/logging.hpp"
+#include "base/task_loop.hpp"
+
+#include "defines.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/// No active frame for this long ends a burst, as in agus_frame_stats.
+auto constexpr kQuietTime = std::chrono::milliseconds(500);
+/// A frame drawn for the graphics ready request itself doesn't reopen the burst.
+auto constexpr kReadyFrameSlack = std::chrono::milliseconds(100);
+/// Touch sampling rate of a phone screen.
+auto constexpr kInputInterval = std::chrono::milliseconds(16);
+
+int64_t MicrosBetween(Clock::time_point from, Clock::time_point to)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+/// Platform GUI thread served by the main thread whenever the bench waits, like
+/// the UI thread on Android: the Framework is created and driven there too.
+class MainThreadLoop : public base::TaskLoop
+{
+public:
+  PushResult Push(Task && task) override { return PushTask(std::move(task)); }
+  PushResult Push(Task const & task) override { return PushTask(Task(task)); }
+
+  /// Runs posted tasks until |done| returns true or |deadline| passes; returns the last
+  /// |done|. It's checked after Wake() and at least every kInputInterval.
+  template <typename Done>
+  bool RunUntil(Done const & done, Clock::time_point deadline)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+      while (!m_tasks.empty())
+      {
+        Task task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+      }
+      if (done())
+        return true;
+      if (Clock::now() >= deadline)
+        return false;
+      m_condition.wait_until(lock, std::min(deadline, Clock::now() + kInputInterval));
+    }
+  }
+
+  void RunFor(Clock::duration duration)
+  {
+    RunUntil([] { return false; }, Clock::now() + duration);
+  }
+
+  void Wake()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_condition.notify_all();
+  }
+
+private:
+  PushResult PushTask(Task && task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_all();
+    return {true, kNoId};
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::deque<Task> m_tasks;
+};
+
+/// Owned by the platform once installed; outlives the Framework.
+MainThreadLoop * g_loop = nullptr;
+
+/// The log handler comaps_init_paths installs: records go through agus_log's rings,
+/// CRITICAL aborts.
+void LogMessage(base::LogLevel level, base::SrcPoint const & src, std::string const & msg)
+{
+  agus::EnqueueLog(level, src, msg);
+  if (level >= base::LCRITICAL)
+    std::abort();
+}
+
+/// Reported by the render thread, read by the main thread.
+class RenderLog
+{
+public:
+  void OnFrame(int64_t frameMicros)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frameMicros.push_back(frameMicros);
+  }
+
+  void OnActiveFrame()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastActiveFrame = Clock::now();
+    if (!m_firstActiveFrame)
+      m_firstActiveFrame = m_lastActiveFrame;
+  }
+
+  /// Times of the frames presented since the last call.
+  std::vector<int64_t> TakeFrameTimes()
+  {
+    std::vector<int64_t> frames;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    frames.swap(m_frameMicros);
+    return frames;
+  }
+
+  Clock::time_point GetLastActiveFrame()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastActiveFrame;
+  }
+
+  std::optional<Clock::time_point> GetFirstActiveFrame()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_firstActiveFrame;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::vector<int64_t> m_frameMicros;
+  Clock::time_point m_lastActiveFrame;
+  std::optional<Clock::time_point> m_firstActiveFrame;
+};
+
+RenderLog g_renderLog;
+
+/// Waits until the camera came to rest with every tile of the viewport drawn and
+/// returns the time of the last active frame before that (|since| if there was
+/// none after it), nullopt on |deadline|. Quiet frames alone can't tell tiles
+/// still being read from tiles all drawn, so it's confirmed with
+/// Framework::NotifyGraphicsReady, as the desktop screenshot tool does.
+std::optional<Clock::time_point> WaitForTileComplete(Framework & framework, Clock::time_point since,
+                                                     Clock::time_point deadline)
+{
+  auto const lastFrame = [since] { return std::max(since, g_renderLog.GetLastActiveFrame()); };
+  while (true)
+  {
+    if (!g_loop->RunUntil([&] { return Clock::now() - lastFrame() >= kQuietTime; }, deadline))
+      return {};
+    auto const settled = lastFrame();
+
+    auto ready = std::make_shared<std::atomic<bool>>(false);
+    framework.NotifyGraphicsReady(
+        [ready]()
+        {
+          ready->store(true);
+          g_loop->Wake();
+        },
+        false /* needInvalidate */);
+    if (!g_loop->RunUntil([&ready] { return ready->load(); }, deadline))
+      return {};
+    // Tiles still missing at the first check come in with new frames.
+    if (lastFrame() <= settled + kReadyFrameSlack)
+      return settled;
+  }
+}
+
+/// Restarts the kernel's peak RSS (VmHWM), so the next peak belongs to the next script.
+void ResetPeakRss()
+{
+  if (FILE * f = fopen("/proc/self/clear_refs", "w"))
+  {
+    fputs("5", f);
+    fclose(f);
+  }
+}
+
+void SendTouch(Framework & framework, df::TouchEvent::ETouchType type, std::vector<m2::PointF> const & points)
+{
+  df::TouchEvent event;
+  event.SetTouchType(type);
+  df::Touch t1;
+  t1.m_id = 1;
+  t1.m_location = points[0];
+  event.SetFirstTouch(t1);
+  event.SetFirstMaskedPointer(0);
+  if (points.size() > 1)
+  {
+    df::Touch t2;
+    t2.m_id = 2;
+    t2.m_location = points[1];
+    event.SetSecondTouch(t2);
+    event.SetSecondMaskedPointer(1);
+  }
+  framework.TouchEvent(event);
+}
+
+/// Moves the touch points |at(t)| for t from 0 to 1 over |duration|, in real time.
+template <typename At>
+void Gesture(Framework & framework, Clock::duration duration, At const & at)
+{
+  auto const start = Clock::now();
+  SendTouch(framework, df::TouchEvent::TOUCH_DOWN, at(0.0));
+  while (true)
+  {
+    g_loop->RunFor(kInputInterval);
+    double const t = std::min(1.0, std::chrono::duration<double>(Clock::now() - start) / duration);
+    SendTouch(framework, t < 1.0 ? df::TouchEvent::TOUCH_MOVE : df::TouchEvent::TOUCH_UP, at(t));
+    if (t >= 1.0)
+      return;
+  }
+}
+
+void Drag(Framework & framework, m2::PointF from, m2::PointF to, Clock::duration duration)
+{
+  Gesture(framework, duration, [&](double t) { return std::vector<m2::PointF>{from + (to - from) * t}; });
+}
+
+struct Surface
+{
+  int m_width = 720;
+  int m_height = 1280;
+  float m_density = 2.0f;
+
+  m2::PointF Center() const { return {m_width / 2.0f, m_height / 2.0f}; }
+};
+
+/// Four slow drags (right, down, left, up), a third of the screen each.
+void PanScript(Framework & framework, Surface const & surface)
+{
+  auto const c = surface.Center();
+  float const dx = surface.m_width / 3.0f;
+  float const dy = surface.m_height / 3.0f;
+  for (auto const d : {m2::PointF(dx, 0), m2::PointF(0, dy), m2::PointF(-dx, 0), m2::PointF(0, -dy)})
+  {
+    Drag(framework, c - d * 0.5f, c + d * 0.5f, std::chrono::milliseconds(600));
+    g_loop->RunFor(std::chrono::milliseconds(100));
+  }
+}
+
+/// Four quick swipes released at speed, so the map keeps gliding after each.
+void FlingScript(Framework & framework, Surface const & surface)
+{
+  auto const c = surface.Center();
+  float const dx = surface.m_width / 2.0f;
+  float const dy = surface.m_height / 3.0f;
+  for (auto const d : {m2::PointF(dx, 0), m2::PointF(0, dy), m2::PointF(-dx, 0), m2::PointF(0, -dy)})
+  {
+    Drag(framework, c - d * 0.5f, c + d * 0.5f, std::chrono::milliseconds(120));
+    g_loop->RunFor(std::chrono::milliseconds(800));
+  }
+}
+
+/// Animated zoom in by six levels, one every 400 ms, then back out.
+void ZoomScript(Framework & framework, Surface const &)
+{
+  for (double const factor : {2.0, 0.5})
+  {
+    for (int i = 0; i < 6; ++i)
+    {
+      framework.Scale(factor, true /* isAnim */);
+      g_loop->RunFor(std::chrono::milliseconds(400));
+    }
+  }
+}
+
+/// Two-finger twist by 90 degrees and back, a second each way.
+void RotateScript(Framework & framework, Surface const & surface)
+{
+  auto const c = surface.Center();
+  float const radius = std::min(surface.m_width, surface.m_height) / 4.0f;
+  for (double const sign : {1.0, -1.0})
+  {
+    Gesture(framework, std::chrono::seconds(1),
+            [&](double t)
+            {
+              double const a = sign * t * M_PI / 2;
+              m2::PointF const r(static_cast<float>(radius * std::cos(a)), static_cast<float>(radius * std::sin(a)));
+              return std::vector<m2::PointF>{c + r, c - r};
+            });
+    g_loop->RunFor(std::chrono::milliseconds(100));
+  }
+}
+
+struct Script
+{
+  char const * m_name;
+  void (*m_run)(Framework &, Surface const &);
+};
+
+Script const kScripts[] = {
+    {"pan", &PanScript},
+    {"fling", &FlingScript},
+    {"zoom", &ZoomScript},
+    {"rotate", &RotateScript},
+};
+
+struct FrameTimes
+{
+  size_t m_frames = 0;
+  int64_t m_p50 = 0;
+  int64_t m_p90 = 0;
+  int64_t m_p99 = 0;
+  int64_t m_max = 0;
+};
+
+FrameTimes GetFrameTimes(std::vector<int64_t> micros)
+{
+  FrameTimes times;
+  times.m_frames = micros.size();
+  if (micros.empty())
+    return times;
+  std::sort(micros.begin(), micros.end());
+  // Nearest rank.
+  auto const percentile = [&](size_t permille) { return micros[(micros.size() * permille + 999) / 1000 - 1]; };
+  times.m_p50 = percentile(500);
+  times.m_p90 = percentile(900);
+  times.m_p99 = percentile(990);
+  times.m_max = micros.back();
+  return times;
+}
+
+struct ScriptResult
+{
+  std::string m_name;
+  int m_run = 0;
+  int64_t m_inputMicros = 0;
+  /// From the end of input to the last frame with all tiles, -1 if they never completed.
+  int64_t m_tileCompleteMicros = -1;
+  FrameTimes m_frameTimes;
+  uint64_t m_peakRssBytes = 0;
+  uint64_t m_rssBytes = 0;
+};
+
+struct Options
+{
+  std::string m_resourcePath;
+  std::string m_writablePath;
+  std::vector<std::string> m_maps;
+  std::optional<m2::PointD> m_center;
+  int m_zoom = 15;
+  Surface m_surface;
+  std::vector<Script> m_scripts;
+  int m_repeat = 1;
+  std::chrono::seconds m_timeout{60};
+  std::string m_outPath;
+  std::string m_tracePath;
+  bool m_verbose = false;
+  int64_t m_maxFrameP99Micros = 0;
+  int64_t m_maxTileCompleteMicros = 0;
+  uint64_t m_maxPeakRssBytes = 0;
+  int m_startupRuns = 0;
+  bool m_dropCaches = false;
+  /// Registers every map at startup instead of trusting the registration snapshot.
+  bool m_noSnapshot = false;
+  /// Set on the child processes of a --startup-runs bench.
+  bool m_startupOnly = false;
+  std::optional<Clock::time_point> m_spawnedAt;
+};
+
+void PrintUsage()
+{
+  std::cerr << "Usage: agus_bench --resources DIR --writable DIR --map FILE.mwm [--map ...] [options]\n"
+               "  --map-dir DIR           add every .mwm in DIR, e.g. a few hundred regions\n"
+               "  --center LAT,LON        start position (default: center of the first map)\n"
+               "  --zoom N                start zoom level (default 15)\n"
+               "  --size WxH              surface size in pixels (default 720x1280)\n"
+               "  --density D             visual scale (default 2)\n"
+               "  --scripts a,b,...       any of pan,fling,zoom,rotate (default all)\n"
+               "  --repeat N              run the scripts N times (default 1)\n"
+               "  --timeout SEC           wait for tiles at most this long (default 60)\n"
+               "  --out FILE              write the JSON report there instead of stdout\n"
+               "  --trace FILE            also write a Chrome trace of the scripts\n"
+               "  --max-frame-p99-us N    fail if a script's 99th percentile frame is slower\n"
+               "  --max-tile-complete-us N  fail if a script's tiles take longer after input\n"
+               "  --max-peak-rss-mb N     fail if the process peaks above this\n"
+               "  --startup-runs N        time N engine startups, each in a new process, instead of the scripts\n"
+               "  --drop-caches           with --startup-runs, precede each warm run by a cold one\n"
+               "  --no-snapshot           open every map at startup, ignoring the registration snapshot\n"
+               "  --verbose               engine log at INFO instead of WARNING\n";
+}
+
+bool ParseOptions(int argc, char ** argv, Options & options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string const arg = argv[i];
+    if (arg == "--verbose")
+    {
+      options.m_verbose = true;
+      continue;
+    }
+    if (arg == "--drop-caches")
+    {
+      options.m_dropCaches = true;
+      continue;
+    }
+    if (arg == "--no-snapshot")
+    {
+      options.m_noSnapshot = true;
+      continue;
+    }
+    if (arg == "--startup-only")
+    {
+      options.m_startupOnly = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      std::cerr << "Missing value for " << arg << "\n";
+      return false;
+    }
+    char const * value = argv[++i];
+    if (arg == "--resources")
+    {
+      options.m_resourcePath = value;
+    }
+    else if (arg == "--writable")
+    {
+      options.m_writablePath = value;
+    }
+    else if (arg == "--map")
+    {
+      options.m_maps.push_back(value);
+    }
+    else if (arg == "--map-dir")
+    {
+      std::vector<std::string> maps;
+      std::error_code error;
+      for (std::filesystem::directory_iterator it(value, error), end; !error && it != end; it.increment(error))
+      {
+        if (it->path().extension() == DATA_FILE_EXTENSION)
+          maps.push_back(it->path().string());
+      }
+      if (error || maps.empty())
+      {
+        std::cerr << "No maps in " << value << "\n";
+        return false;
+      }
+      std::sort(maps.begin(), maps.end());
+      options.m_maps.insert(options.m_maps.end(), maps.begin(), maps.end());
+    }
+    else if (arg == "--center")
+    {
+      double lat = 0;
+      double lon = 0;
+      if (sscanf(value, "%lf,%lf", &lat, &lon) != 2)
+      {
+        std::cerr << "Bad --center " << value << "\n";
+        return false;
+      }
+      options.m_center = mercator::FromLatLon(lat, lon);
+    }
+    else if (arg == "--zoom")
+    {
+      options.m_zoom = atoi(value);
+    }
+    else if (arg == "--size")
+    {
+      if (sscanf(value, "%dx%d", &options.m_surface.m_width, &options.m_surface.m_height) != 2 ||
+          options.m_surface.m_width <= 0 || options.m_surface.m_height <= 0)
+      {
+        std::cerr << "Bad --size " << value << "\n";
+        return false;
+      }
+    }
+    else if (arg == "--density")
+    {
+      options.m_surface.m_density = static_cast<float>(atof(value));
+    }
+    else if (arg == "--scripts")
+    {
+      std::stringstream names(value);
+      std::string name;
+      while (std::getline(names, name, ','))
+      {
+        auto const it = std::find_if(std::begin(kScripts), std::end(kScripts),
+                                     [&](Script const & s) { return name == s.m_name; });
+        if (it == std::end(kScripts))
+        {
+          std::cerr << "Unknown script " << name << "\n";
+          return false;
+        }
+        options.m_scripts.push_back(*it);
+      }
+    }
+    else if (arg == "--repeat")
+    {
+      options.m_repeat = std::max(1, atoi(value));
+    }
+    else if (arg == "--timeout")
+    {
+      options.m_timeout = std::chrono::seconds(std::max(1, atoi(value)));
+    }
+    else if (arg == "--out")
+    {
+      options.m_outPath = value;
+    }
+    else if (arg == "--trace")
+    {
+      options.m_tracePath = value;
+    }
+    else if (arg == "--max-frame-p99-us")
+    {
+      options.m_maxFrameP99Micros = atoll(value);
+    }
+    else if (arg == "--max-tile-complete-us")
+    {
+      options.m_maxTileCompleteMicros = atoll(value);
+    }
+    else if (arg == "--max-peak-rss-mb")
+    {
+      options.m_maxPeakRssBytes = static_cast<uint64_t>(atoll(value)) * 1024 * 1024;
+    }
+    else if (arg == "--startup-runs")
+    {
+      options.m_startupRuns = std::max(1, atoi(value));
+    }
+    else if (arg == "--spawned-at")
+    {
+      options.m_spawnedAt = Clock::time_point(std::chrono::nanoseconds(atoll(value)));
+    }
+    else
+    {
+      std::cerr << "Unknown option " << arg << "\n";
+      return false;
+    }
+  }
+  if (options.m_startupOnly)
+    options.m_scripts.clear();
+  else if (options.m_scripts.empty())
+    options.m_scripts.assign(std::begin(kScripts), std::end(kScripts));
+  return !options.m_resourcePath.empty() && !options.m_writablePath.empty() && !options.m_maps.empty();
+}
+
+void WriteFrameTimes(std::ostream & out, FrameTimes const & times)
+{
+  out << "\"frames\":" << times.m_frames << ",\"frame_us\":{\"p50\":" << times.m_p50 << ",\"p90\":" << times.m_p90
+      << ",\"p99\":" << times.m_p99 << ",\"max\":" << times.m_max << '}';
+}
+
+/// Startup phases in order, each starting where the previous one ended: what
+/// comaps_init_paths does on a device, Framework construction, map registration,
+/// creating the GL contexts and the Drape engine, then waiting for the first active
+/// frame and for the last one before every tile of the first view was drawn.
+char const * const kStartupPhases[] = {"init_paths",          "framework",   "register_maps",
+                                       "create_drape_engine", "first_frame", "tile_complete"};
+size_t constexpr kStartupPhaseCount = std::size(kStartupPhases);
+enum StartupPhaseIndex
+{
+  kInitPaths,
+  kFramework,
+  kRegisterMaps,
+  kCreateDrapeEngine,
+  kFirstFrame,
+  kTileComplete,
+};
+
+struct StartupTimes
+{
+  Clock::time_point m_start;
+  /// End of each of kStartupPhases; unset from the first one that never ended on.
+  std::array<std::optional<Clock::time_point>, kStartupPhaseCount> m_ends;
+};
+
+/// "exec" (from the parent's spawn to main) is only known in a --startup-runs child.
+void WriteStartupPhases(std::ostream & out, StartupTimes const & times, std::optional<Clock::time_point> spawnedAt)
+{
+  out << "\"phases_us\":{";
+  if (spawnedAt)
+    out << "\"exec\":" << MicrosBetween(*spawnedAt, times.m_start) << ',';
+  auto begin = times.m_start;
+  for (size_t i = 0; i < kStartupPhaseCount; ++i)
+  {
+    auto const & end = times.m_ends[i];
+    out << (i ? "," : "") << '"' << kStartupPhases[i] << "\":" << (end ? MicrosBetween(begin, *end) : -1);
+    if (end)
+      begin = *end;
+  }
+  out << '}';
+}
+
+bool WriteReport(std::string const & path, std::string const & report)
+{
+  if (path.empty())
+  {
+    std::cout << report;
+    return true;
+  }
+  std::ofstream file(path);
+  file << report;
+  if (!file)
+  {
+    std::cerr << "Can't write " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+/// Evicts what a startup reads from the page cache. Everything when allowed to (root
+/// outside a read-only /proc/sys), otherwise file by file with POSIX_FADV_DONTNEED:
+/// this binary, the resource and writable directories and the maps, but not the
+/// shared libraries. Returns which of the two it did.
+char const * DropPageCache(Options const & options)
+{
+  sync();
+  if (FILE * f = fopen("/proc/sys/vm/drop_caches", "w"))
+  {
+    bool const written = fputs("3", f) >= 0;
+    if (fclose(f) == 0 && written)
+      return "system";
+  }
+
+  std::vector<std::string> files = options.m_maps;
+  files.push_back("/proc/self/exe");
+  for (auto const & dir : {options.m_resourcePath, options.m_writablePath})
+  {
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(dir, error), end; !error && it != end; it.increment(error))
+    {
+      if (it->is_regular_file(error))
+        files.push_back(it->path().string());
+    }
+  }
+  for (auto const & file : files)
+  {
+    int const fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+  return "files";
+}
+
+/// The arguments for a child timing one startup: the parent keeps the report, the
+/// run count and the cache handling to itself.
+std::vector<std::string> GetChildArguments(int argc, char ** argv)
+{
+  std::vector<std::string> args = {argv[0]};
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string const arg = argv[i];
+    if (arg == "--drop-caches")
+      continue;
+    if (arg == "--startup-runs" || arg == "--out" || arg == "--trace" || arg == "--scripts" || arg == "--repeat")
+    {
+      ++i;
+      continue;
+    }
+    args.push_back(arg);
+  }
+  args.push_back("--startup-only");
+  return args;
+}
+
+/// Runs this binary with |args| and returns what it printed, nullopt if it couldn't
+/// report. Its log goes to our stderr.
+std::optional<std::string> RunChild(std::vector<std::string> args)
+{
+  int fds[2];
+  if (pipe(fds) != 0)
+    return {};
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addclose(&actions, fds[0]);
+  posix_spawn_file_actions_addclose(&actions, fds[1]);
+
+  // steady_clock is CLOCK_MONOTONIC, the same clock in every process.
+  args.push_back("--spawned-at");
+  args.push_back(std::to_string(std::chrono::nanoseconds(Clock::now().time_since_epoch()).count()));
+  std::vector<char *> argv;
+  for (auto & arg : args)
+    argv.push_back(arg.data());
+  argv.push_back(nullptr);
+
+  pid_t pid = 0;
+  int const error = posix_spawn(&pid, "/proc/self/exe", &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+
+  std::string output;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0)
+    output.append(buffer, static_cast<size_t>(n));
+  close(fds[0]);
+  if (error != 0)
+    return {};
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  // 1 is a startup whose tiles never completed, which its report shows.
+  if (!WIFEXITED(status) || WEXITSTATUS(status) > 1)
+    return {};
+  while (!output.empty() && isspace(static_cast<unsigned char>(output.back())))
+    output.pop_back();
+  return output;
+}
+
+/// Reads "phases_us" back from a child's report.
+std::map<std::string, int64_t> ReadStartupPhases(std::string const & report)
+{
+  std::map<std::string, int64_t> phases;
+  std::string const key = "\"phases_us\":{";
+  auto pos = report.find(key);
+  if (pos == std::string::npos)
+    return phases;
+  pos += key.size();
+  while (pos < report.size() && report[pos] == '"')
+  {
+    auto const nameEnd = report.find("\":", pos + 1);
+    if (nameEnd == std::string::npos)
+      break;
+    char * valueEnd = nullptr;
+    phases[report.substr(pos + 1, nameEnd - pos - 1)] = strtoll(report.c_str() + nameEnd + 2, &valueEnd, 10);
+    pos = static_cast<size_t>(valueEnd - report.c_str());
+    if (pos < report.size() && report[pos] == ',')
+      ++pos;
+  }
+  return phases;
+}
+
+/// Minimum, median and maximum of each phase and of their total over |runs|.
+void WriteStartupSummary(std::ostream & out, std::vector<std::map<std::string, int64_t>> const & runs)
+{
+  std::vector<std::string> names = {"exec"};
+  names.insert(names.end(), std::begin(kStartupPhases), std::end(kStartupPhases));
+  names.push_back("total");
+
+  out << "{\"runs\":" << runs.size() << ",\"phases_us\":{";
+  bool first = true;
+  for (auto const & name : names)
+  {
+    std::vector<int64_t> values;
+    for (auto const & phases : runs)
+    {
+      auto const it = phases.find(name);
+      if (it != phases.end() && it->second >= 0)
+        values.push_back(it->second);
+    }
+    if (values.empty())
+      continue;
+    std::sort(values.begin(), values.end());
+    out << (first ? "" : ",") << '"' << name << "\":{\"min\":" << values.front()
+        << ",\"median\":" << values[(values.size() - 1) / 2] << ",\"max\":" << values.back() << '}';
+    first = false;
+  }
+  out << "}}";
+}
+
+/// Times options.m_startupRuns startups, each in a new process, so that every one pays
+/// for loading the binary, static initialization and mapping files as an app launch
+/// does. With --drop-caches each run is made twice, right after evicting the page
+/// cache (cold) and again (warm). An untimed first run warms the cache and writes the
+/// registration snapshot, as a previous launch of the app would have.
+int RunStartupBench(int argc, char ** argv, Options const & options)
+{
+  auto const args = GetChildArguments(argc, argv);
+  if (!RunChild(args))
+  {
+    std::cerr << "Warm-up startup failed\n";
+    return 2;
+  }
+
+  struct Run
+  {
+    bool m_cold;
+    std::string m_report;
+    std::map<std::string, int64_t> m_phases;
+  };
+  std::vector<Run> runs;
+  char const * cacheDrop = "none";
+  std::vector<std::string> failures;
+  for (int i = 0; i < options.m_startupRuns; ++i)
+  {
+    for (bool const cold : {true, false})
+    {
+      if (cold && !options.m_dropCaches)
+        continue;
+      if (cold)
+        cacheDrop = DropPageCache(options);
+      auto report = RunChild(args);
+      if (!report)
+      {
+        std::cerr << "Startup run " << i << " failed\n";
+        return 2;
+      }
+      Run run{cold, std::move(*report), {}};
+      run.m_phases = ReadStartupPhases(run.m_report);
+      int64_t total = 0;
+      for (auto const & [name, micros] : run.m_phases)
+        total = (total < 0 || micros < 0) ? -1 : total + micros;
+      if (run.m_phases.empty() || total < 0)
+        failures.push_back("startup #" + std::to_string(i) + (cold ? " (cold)" : "") + ": tiles not complete");
+      else
+        run.m_phases["total"] = total;
+      runs.push_back(std::move(run));
+    }
+  }
+  if (options.m_dropCaches && strcmp(cacheDrop, "system") != 0)
+    std::cerr << "Evicted only the bench's own files from the page cache; run as root to drop it all\n";
+
+  std::vector<std::map<std::string, int64_t>> coldPhases;
+  std::vector<std::map<std::string, int64_t>> warmPhases;
+  for (auto const & run : runs)
+    (run.m_cold ? coldPhases : warmPhases).push_back(run.m_phases);
+
+  std::ostringstream out;
+  out << "{\"cache_drop\":\"" << cacheDrop << "\",\"summary\":{";
+  if (!coldPhases.empty())
+  {
+    out << "\"cold\":";
+    WriteStartupSummary(out, coldPhases);
+    out << ',';
+  }
+  out << "\"warm\":";
+  WriteStartupSummary(out, warmPhases);
+  out << "},\"runs\":[";
+  for (size_t i = 0; i < runs.size(); ++i)
+  {
+    out << (i ? ",\n" : "\n") << "{\"cold\":" << (runs[i].m_cold ? "true" : "false")
+        << ",\"report\":" << runs[i].m_report << '}';
+  }
+  out << "],\n\"failures\":[";
+  for (size_t i = 0; i < failures.size(); ++i)
+    out << (i ? "," : "") << '"' << failures[i] << '"';
+  out << "]}\n";
+
+  if (!WriteReport(options.m_outPath, out.str()))
+    return 2;
+  for (auto const & failure : failures)
+    std::cerr << "FAIL " << failure << "\n";
+  return failures.empty() ? 0 : 1;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  StartupTimes startup;
+  startup.m_start = Clock::now();
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage();
+    return 2;
+  }
+  if (options.m_startupRuns > 0)
+    return RunStartupBench(argc, argv, options);
+
+  // The app's startup order: comaps_init_paths, then the Framework, the maps and the
+  // Drape engine when the surface arrives.
+  agus::BeginStartupTrace();
+  {
+    // What comaps_init_paths does, through the same AgusPlatform_Start call. The worker
+    // pools live as long as the process, as in the app.
+    agus::ScopedStartupPhase phase("comaps_init_paths");
+    base::SetLogMessageFn(&LogMessage);
+    base::g_LogAbortLevel = base::LCRITICAL;
+    base::g_LogLevel = options.m_verbose ? base::LINFO : base::LWARNING;
+
+    std::error_code error;
+    std::filesystem::create_directories(options.m_writablePath, error);
+    AgusPlatform_Start(options.m_resourcePath.c_str(), options.m_writablePath.c_str(), agus::ThreadConfig());
+    // Off Android the platform leaves the GUI thread to the embedder: the main thread here.
+    auto loop = std::make_unique<MainThreadLoop>();
+    g_loop = loop.get();
+    GetPlatform().SetGuiThread(std::move(loop));
+  }
+  startup.m_ends[kInitPaths] = Clock::now();
+
+  std::unique_ptr<Framework> framework;
+  {
+    agus::ScopedStartupPhase phase("Framework");
+    agus::StartupPreloader preloader(Platform::CpuCores());
+    FrameworkParams params;
+    params.m_enableDiffs = false;
+    framework = std::make_unique<Framework>(params, false /* loadMaps */);
+  }
+  startup.m_ends[kFramework] = Clock::now();
+
+  agus::LazyBatchStats registration;
+  {
+    agus::ScopedStartupPhase phase("RegisterMaps");
+    registration = agus::RegisterMapsWithSnapshot(*framework, options.m_maps, !options.m_noSnapshot);
+  }
+  startup.m_ends[kRegisterMaps] = Clock::now();
+  if (registration.m_failed > 0)
+  {
+    std::cerr << "Can't register " << registration.m_failed << " maps\n";
+    return 2;
+  }
+  // Maps put off by the snapshot open as the app opens them, from the viewport.
+  agus::AttachLazyMaps(*framework, nullptr);
+  if (!options.m_center)
+  {
+    auto const info = agus::ReadLazyMapInfo(options.m_maps.front());
+    if (!info)
+      return 2;
+    options.m_center = info->m_rect.Center();
+  }
+
+  Surface const & surface = options.m_surface;
+  auto * contextFactory = new agus::HeadlessOGLContextFactory(surface.m_width, surface.m_height,
+                                                              [](int64_t micros) { g_renderLog.OnFrame(micros); });
+  if (!contextFactory->IsValid())
+  {
+    std::cerr << "No headless GL context; install Mesa's EGL and GL (llvmpipe) for software rendering\n";
+    delete contextFactory;
+    return 2;
+  }
+  auto factory = make_unique_dp<dp::ThreadSafeFactory>(contextFactory);
+
+  df::SetActiveFrameCallback(
+      []()
+      {
+        agus::OnActiveFrame();
+        agus::OnStartupFrame();
+        g_renderLog.OnActiveFrame();
+        g_loop->Wake();
+      });
+
+  Framework::DrapeCreationParams drapeParams;
+  drapeParams.m_apiVersion = dp::ApiVersion::OpenGLES3;
+  drapeParams.m_surfaceWidth = surface.m_width;
+  drapeParams.m_surfaceHeight = surface.m_height;
+  drapeParams.m_visualScale = surface.m_density;
+
+  ResetPeakRss();
+  agus::OnDrapeEngineCreating();
+  auto const engineStart = Clock::now();
+  {
+    agus::ScopedStartupPhase phase("CreateDrapeEngine");
+    framework->CreateDrapeEngine(make_ref(factory), std::move(drapeParams));
+    framework->SetViewportCenter(*options.m_center, options.m_zoom, false /* isAnim */);
+  }
+  auto const engineEnd = Clock::now();
+  startup.m_ends[kCreateDrapeEngine] = engineEnd;
+  auto const startupComplete = WaitForTileComplete(*framework, engineEnd, engineStart + options.m_timeout);
+  if (auto const firstFrame = g_renderLog.GetFirstActiveFrame())
+  {
+    // Drape may draw before CreateDrapeEngine returns.
+    startup.m_ends[kFirstFrame] = std::max(engineEnd, *firstFrame);
+    if (startupComplete)
+      startup.m_ends[kTileComplete] = std::max(*startup.m_ends[kFirstFrame], *startupComplete);
+  }
+  auto const startupFrames = GetFrameTimes(g_renderLog.TakeFrameTimes());
+  uint64_t const startupPeakRss = agus::GetMemoryStats().m_peakRssBytes;
+  uint64_t peakRss = startupPeakRss;
+  // Scripts pan beyond the first view; every map is open before they start.
+  if (!options.m_scripts.empty())
+    agus::RegisterLazyMapsIn(*framework, mercator::Bounds::FullRect());
+
+  if (!options.m_tracePath.empty())
+    agus::StartTrace();
+
+  std::vector<ScriptResult> results;
+  std::vector<std::string> failures;
+  if (!startupComplete)
+    failures.push_back("startup: tiles not complete");
+  for (int run = 0; run < options.m_repeat && startupComplete; ++run)
+  {
+    for (auto const & script : options.m_scripts)
+    {
+      // Every script starts from the same view with its tiles in place.
+      framework->SetViewportCenter(*options.m_center, options.m_zoom, false /* isAnim */);
+      auto const reset = Clock::now();
+      if (!WaitForTileComplete(*framework, reset, reset + options.m_timeout))
+      {
+        failures.push_back(std::string(script.m_name) + ": start view tiles not complete");
+        break;
+      }
+      g_renderLog.TakeFrameTimes();
+      ResetPeakRss();
+
+      ScriptResult result;
+      result.m_name = script.m_name;
+      result.m_run = run;
+      auto const start = Clock::now();
+      {
+        AGUS_TRACE_SCOPE("bench", script.m_name);
+        script.m_run(*framework, surface);
+      }
+      auto const inputEnd = Clock::now();
+      result.m_inputMicros = MicrosBetween(start, inputEnd);
+      if (auto const complete = WaitForTileComplete(*framework, inputEnd, inputEnd + options.m_timeout))
+        result.m_tileCompleteMicros = MicrosBetween(inputEnd, *complete);
+      result.m_frameTimes = GetFrameTimes(g_renderLog.TakeFrameTimes());
+      auto const memory = agus::GetMemoryStats();
+      result.m_peakRssBytes = memory.m_peakRssBytes;
+      result.m_rssBytes = memory.m_rssBytes;
+      peakRss = std::max(peakRss, memory.m_peakRssBytes);
+
+      std::string const name = result.m_name + (options.m_repeat > 1 ? " #" + std::to_string(run) : "");
+      if (result.m_tileCompleteMicros < 0)
+        failures.push_back(name + ": tiles not complete");
+      else if (options.m_maxTileCompleteMicros > 0 && result.m_tileCompleteMicros > options.m_maxTileCompleteMicros)
+        failures.push_back(name + ": tile complete " + std::to_string(result.m_tileCompleteMicros) + "us");
+      if (options.m_maxFrameP99Micros > 0 && result.m_frameTimes.m_p99 > options.m_maxFrameP99Micros)
+        failures.push_back(name + ": frame p99 " + std::to_string(result.m_frameTimes.m_p99) + "us");
+      results.push_back(std::move(result));
+    }
+  }
+  if (options.m_maxPeakRssBytes > 0 && peakRss > options.m_maxPeakRssBytes)
+    failures.push_back("peak RSS " + std::to_string(peakRss / (1024 * 1024)) + "MB");
+
+  if (!options.m_tracePath.empty())
+  {
+    agus::StopTrace();
+    agus::WriteTraceJson(options.m_tracePath);
+  }
+
+  // Map names, failures and script names are plain identifiers: no escaping needed.
+  std::ostringstream out;
+  out << "{\"surface\":{\"width\":" << surface.m_width << ",\"height\":" << surface.m_height
+      << ",\"density\":" << surface.m_density << "},\"maps\":[";
+  for (size_t i = 0; i < options.m_maps.size(); ++i)
+  {
+    auto const name = platform::LocalCountryFile::MakeTemporary(options.m_maps[i]).GetCountryName();
+    out << (i ? "," : "") << '"' << name << '"';
+  }
+  out << "],\"startup\":{";
+  WriteStartupPhases(out, startup, options.m_spawnedAt);
+  out << ",\"registration\":{\"registered\":" << registration.m_registered
+      << ",\"deferred\":" << registration.m_recorded << ",\"snapshot\":" << (options.m_noSnapshot ? "false" : "true")
+      << '}';
+  out << ",\"first_frame_us\":" << agus::GetFirstFrameStats().m_firstFrameMicros
+      << ",\"tile_complete_us\":" << (startupComplete ? MicrosBetween(engineStart, *startupComplete) : -1) << ',';
+  WriteFrameTimes(out, startupFrames);
+  out << ",\"peak_rss_bytes\":" << startupPeakRss << ",\n\"timeline\":" << agus::GetStartupTraceJson()
+      << "},\"scripts\":[";
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    auto const & r = results[i];
+    out << (i ? ",\n" : "\n") << "{\"name\":\"" << r.m_name << "\",\"run\":" << r.m_run
+        << ",\"input_us\":" << r.m_inputMicros << ",\"tile_complete_us\":" << r.m_tileCompleteMicros << ',';
+    WriteFrameTimes(out, r.m_frameTimes);
+    out << ",\"peak_rss_bytes\":" << r.m_peakRssBytes << ",\"rss_bytes\":" << r.m_rssBytes << '}';
+  }
+  out << "],\n\"peak_rss_bytes\":" << peakRss << ",\"failures\":[";
+  for (size_t i = 0; i < failures.size(); ++i)
+    out << (i ? "," : "") << '"' << failures[i] << '"';
+  out << "],\n\"metrics\":" << agus::GetMetricsSnapshotJson() << "}\n";
+
+  // The engine goes before the factory its contexts come from.
+  df::SetActiveFrameCallback(nullptr);
+  framework.reset();
+  agus::FlushLog();
+
+  if (!WriteReport(options.m_outPath, out.str()))
+    return 2;
+  for (auto const & failure : failures)
+    std::cerr << "FAIL " << failure << "\n";
+  return failures.empty() ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#include "agus_downloader.hpp"
+
+#include "platform/downloader_defines.hpp"
+#include "platform/http_request.hpp"
+#include "platform/platform.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace agus
+{
+namespace
+{
+int64_t constexpr kMinChunkSize = 512 * 1024;
+int64_t constexpr kMaxChunkSize = 8 * 1024 * 1024;
+
+struct FileDownload
+{
+  std::unique_ptr<downloader::HttpRequest> m_request;
+  FileDownloadProgress m_progress;
+  /// The finished status was read while the request was still held.
+  bool m_reported = false;
+};
+
+std::mutex g_downloadsMutex;
+std::map<int64_t, FileDownload> g_downloads;
+int64_t g_nextDownloadId = 1;
+
+FileDownloadStatus ToFileDownloadStatus(downloader::DownloadStatus status)
+{
+  switch (status)
+  {
+  case downloader::DownloadStatus::InProgress: return FileDownloadStatus::InProgress;
+  case downloader::DownloadStatus::Completed: return FileDownloadStatus::Completed;
+  case downloader::DownloadStatus::FileNotFound: return FileDownloadStatus::FileNotFound;
+  default: return FileDownloadStatus::Failed;
+  }
+}
+
+void UpdateProgress(int64_t id, downloader::HttpRequest & request)
+{
+  std::lock_guard<std::mutex> lock(g_downloadsMutex);
+  auto it = g_downloads.find(id);
+  if (it == g_downloads.end())
+    return;
+  auto const & progress = request.GetProgress();
+  it->second.m_progress.m_status = ToFileDownloadStatus(request.GetStatus());
+  it->second.m_progress.m_bytesDownloaded = progress.m_bytesDownloaded;
+  it->second.m_progress.m_bytesTotal = progress.m_bytesTotal;
+}
+
+/// HttpRequest objects are created, notified and destroyed on the GUI thread.
+void ReleaseRequest(int64_t id, bool forget)
+{
+  std::unique_ptr<downloader::HttpRequest> request;
+  {
+    std::lock_guard<std::mutex> lock(g_downloadsMutex);
+    auto it = g_downloads.find(id);
+    if (it == g_downloads.end())
+      return;
+    request = std::move(it->second.m_request);
+    if (forget || it->second.m_reported)
+      g_downloads.erase(it);
+  }
+}
+}  // namespace
+
+int64_t StartFileDownload(std::string const & url, std::string const & filePath, int64_t fileSize,
+                          unsigned segments)
+{
+  int64_t id;
+  {
+    std::lock_guard<std::mutex> lock(g_downloadsMutex);
+    id = g_nextDownloadId++;
+    auto & download = g_downloads[id];
+    download.m_progress.m_status = FileDownloadStatus::InProgress;
+    download.m_progress.m_bytesTotal = fileSize;
+  }
+
+  segments = std::clamp(segments, 1u, 16u);
+  GetPlatform().RunTask(Platform::Thread::Gui, [id, url, filePath, fileSize, segments]()
+  {
+    // Every url entry is one ChunksDownloadStrategy "server", i.e. one concurrent
+    // range request; repeating the url gives parallel segments from a single host.
+    // Several chunks per segment keep all of them busy until the end.
+    std::vector<std::string> const urls(segments, url);
+    int64_t const chunkSize = std::clamp(fileSize / (segments * 4), kMinChunkSize, kMaxChunkSize);
+
+    std::unique_ptr<downloader::HttpRequest> request(downloader::HttpRequest::GetFile(
+        urls, filePath, fileSize,
+        [id](downloader::HttpRequest & request)
+        {
+          UpdateProgress(id, request);
+          LOG(LINFO, ("Download", id, "finished:", request.GetFilePath(), DebugPrint(request.GetStatus())));
+          // Not from inside the request's own callback.
+          GetPlatform().RunTask(Platform::Thread::Gui, [id]() { ReleaseRequest(id, false /* forget */); });
+        },
+        [id](downloader::HttpRequest & request) { UpdateProgress(id, request); },
+        chunkSize, false /* doCleanOnCancel */));
+
+    std::lock_guard<std::mutex> lock(g_downloadsMutex);
+    auto it = g_downloads.find(id);
+    // Cancelled before it started.
+    if (it == g_downloads.end())
+      return;
+    // A finished request is released by the posted task above.
+    if (it->second.m_progress.m_status == FileDownloadStatus::InProgress)
+      it->second.m_request = std::move(request);
+  });
+
+  return id;
+}
+
+FileDownloadProgress GetFileDownloadProgress(int64_t id)
+{
+  std::lock_guard<std::mutex> lock(g_downloadsMutex);
+  auto it = g_downloads.find(id);
+  if (it == g_downloads.end())
+    return {};
+  FileDownloadProgress const progress = it->second.m_progress;
+  // A finished download is forgotten once reported, or by ReleaseRequest if it still holds
+  // its request, which is destroyed on the GUI thread.
+  if (progress.m_status != FileDownloadStatus::InProgress)
+  {
+    if (it->second.m_request)
+      it->second.m_reported = true;
+    else
+      g_downloads.erase(it);
+  }
+  return progress;
+}
+
+void CancelFileDownload(int64_t id)
+{
+  GetPlatform().RunTask(Platform::Thread::Gui, [id]() { ReleaseRequest(id, true /* forget */); });
+}
+}  // namespace agus
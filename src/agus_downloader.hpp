@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace agus
+{
+enum class FileDownloadStatus
+{
+  Unknown = -1,
+  InProgress = 0,
+  Completed = 1,
+  Failed = 2,
+  FileNotFound = 3,
+};
+
+struct FileDownloadProgress
+{
+  FileDownloadStatus m_status = FileDownloadStatus::Unknown;
+  int64_t m_bytesDownloaded = 0;
+  int64_t m_bytesTotal = 0;
+};
+
+/// Downloads |url| to |filePath| through CoMaps' downloader::HttpRequest::GetFile,
+/// fetching up to |segments| byte ranges in parallel. A partial download of the same
+/// file resumes from its .resume sidecar, and cancelling keeps it resumable.
+/// |fileSize| must be the exact size of the remote file.
+/// Returns an id for GetFileDownloadProgress and CancelFileDownload.
+int64_t StartFileDownload(std::string const & url, std::string const & filePath, int64_t fileSize,
+                          unsigned segments);
+
+/// Once this reports a finished download, |id| is forgotten: later calls return Unknown.
+FileDownloadProgress GetFileDownloadProgress(int64_t id);
+
+/// Stops a running download and forgets |id|.
+void CancelFileDownload(int64_t id);
+}  // namespace agus
@@ -0,0 +1,96 @@
+#include "agus_engine_hooks.hpp"
+
+#include "agus_metrics.hpp"
+#include "agus_trace.hpp"
+
+#include "drape/metrics_hooks.hpp"
+
+#include "drape_frontend/trace_hooks.hpp"
+
+#include "map/search_hooks.hpp"
+
+#include "search/result.hpp"
+#include "search/search_params.hpp"
+
+#include <chrono>
+#include <utility>
+
+namespace agus
+{
+namespace
+{
+int64_t ToTraceMicros(std::chrono::steady_clock::time_point t)
+{
+  // The clock of trace_internal::NowMicros.
+  return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+void OnDrapeSpan(char const * name, df::trace_hooks::Clock::time_point begin, df::trace_hooks::Clock::time_point end)
+{
+  if (IsTracing())
+    trace_internal::AddSpan("drape", name, ToTraceMicros(begin), ToTraceMicros(end));
+}
+
+void OnDrapeCount(dp::metrics_hooks::Count what, uint64_t n)
+{
+  using dp::metrics_hooks::Count;
+  static auto & tilesRequested = GetCounter("tiles.requested");
+  static auto & tilesLoaded = GetCounter("tiles.loaded");
+  static auto & tilesDropped = GetCounter("tiles.dropped");
+  static auto & textureUploadBytes = GetCounter("texture.upload_bytes");
+  static auto & textureAllocatedBytes = GetCounter("texture.allocated_bytes");
+  static auto & textureFreedBytes = GetCounter("texture.freed_bytes");
+  switch (what)
+  {
+  case Count::TileReadStarted: tilesRequested.Add(n); break;
+  case Count::TileReadCompleted: tilesLoaded.Add(n); break;
+  case Count::TileReadCancelled: tilesDropped.Add(n); break;
+  case Count::TextureUploadBytes: textureUploadBytes.Add(n); break;
+  case Count::TextureAllocatedBytes: textureAllocatedBytes.Add(n); break;
+  case Count::TextureFreedBytes: textureFreedBytes.Add(n); break;
+  }
+}
+
+/// Wraps the results callback of a search starting now, so its last results record
+/// its latency and close a span.
+void MeasureSearch(search::SearchParams & params)
+{
+  int64_t const begin = trace_internal::NowMicros();
+  params.m_onResults = [onResults = std::move(params.m_onResults), begin](search::Results const & results)
+  {
+    if (results.IsEndMarker())
+    {
+      static auto & latency = GetHistogram("search.latency_us");
+      int64_t const end = trace_internal::NowMicros();
+      latency.Record(static_cast<uint64_t>(end - begin));
+      if (IsTracing())
+        trace_internal::AddSpan("search", "search", begin, end);
+    }
+    if (onResults)
+      onResults(results);
+  };
+}
+}  // namespace
+
+void InstallEngineHooks()
+{
+  static bool installed = false;
+  if (installed)
+    return;
+  installed = true;
+
+  df::trace_hooks::g_onSpan = &OnDrapeSpan;
+  dp::metrics_hooks::g_onCount = &OnDrapeCount;
+  search_hooks::g_beforeSearch.push_back(&MeasureSearch);
+}
+
+uint64_t GetDrapeTextureBytes()
+{
+  static auto & allocated = GetCounter("texture.allocated_bytes");
+  static auto & freed = GetCounter("texture.freed_bytes");
+  // Read freed first: a texture destroyed in between is then at worst counted as still held.
+  uint64_t const freedBytes = freed.Get();
+  uint64_t const allocatedBytes = allocated.Get();
+  return allocatedBytes > freedBytes ? allocatedBytes - freedBytes : 0;
+}
+}  // namespace agus
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace agus
+{
+/// Connects the hooks CoMaps patches add to report engine work to agus_trace and agus_metrics:
+/// - tile reads on Drape's read pool (patch 0024), as "drape" spans;
+/// - tile reads and texture memory (patch 0025), as the "tiles.requested", "tiles.loaded",
+///   "tiles.dropped", "texture.upload_bytes", "texture.allocated_bytes" and
+///   "texture.freed_bytes" counters;
+/// - searches (patch 0021), as the "search.latency_us" histogram and a "search" span on the
+///   search thread, from the start of the query to its last results.
+/// Call once, on the GUI thread, before the Framework is created.
+void InstallEngineHooks();
+
+/// Storage of the textures Drape holds now: atlases, glyphs, symbols and render targets.
+/// Counted from texture creation on, so 0 before InstallEngineHooks.
+uint64_t GetDrapeTextureBytes();
+}  // namespace agus
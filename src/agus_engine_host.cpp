@@ -0,0 +1,116 @@
+#include "agus_engine_host.hpp"
+
+#include "agus_maps_flutter.h"
+
+#include "agus_engine_hooks.hpp"
+#include "agus_lazy_maps.hpp"
+#include "agus_memory.hpp"
+#include "agus_metrics.hpp"
+#include "agus_threads.hpp"
+#include "agus_trace.hpp"
+
+#include "map/framework.hpp"
+
+#include "platform/platform.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace agus
+{
+namespace
+{
+EngineHost g_host;
+
+void Report(ComapsTrimCallback done, TrimReport const & report)
+{
+  LOG(LINFO, ("comaps_on_memory_pressure:", DebugPrint(report)));
+  if (done)
+  {
+    done(report.m_searchCachesFreed, report.m_readerCachesFreed, report.m_drapeTilesFreed,
+         report.m_drapeTexturesFreed, report.m_allocatorFreed);
+  }
+}
+}  // namespace
+
+void SetEngineHost(EngineHost host) { g_host = std::move(host); }
+
+void RegisterMetricProviders()
+{
+  SetGaugeProvider("memory.rss_bytes", []() { return static_cast<int64_t>(GetMemoryStats().m_rssBytes); });
+  SetGaugeProvider("memory.peak_rss_bytes", []() { return static_cast<int64_t>(GetMemoryStats().m_peakRssBytes); });
+  SetGaugeProvider("texture.resident_bytes", []() { return static_cast<int64_t>(GetDrapeTextureBytes()); });
+  SetGaugeProvider("maps.pending_lazy", []() { return static_cast<int64_t>(GetPendingLazyMapsCount()); });
+  for (auto const & pool : GetThreadPoolStats())
+  {
+    SetGaugeProvider("pool." + pool.m_name + ".pending", [name = pool.m_name]() -> int64_t
+    {
+      for (auto const & stats : GetThreadPoolStats())
+        if (stats.m_name == name)
+          return static_cast<int64_t>(stats.m_tasksPending);
+      return 0;
+    });
+  }
+}
+}  // namespace agus
+
+// Trim engine caches in graded steps, see agus::TrimMemory. Runs on the background pool
+// and, for the textures, the GUI thread, so the caller is never blocked.
+FFI_PLUGIN_EXPORT int comaps_on_memory_pressure(int level, ComapsTrimCallback done)
+{
+  AGUS_TRACE_FUNCTION("ffi");
+  using agus::g_host;
+  using agus::Report;
+
+  if (!g_host.m_framework || !g_host.m_framework())
+  {
+    LOG(LWARNING, ("comaps_on_memory_pressure: Framework not initialized"));
+    return -1;
+  }
+
+  auto const pressure = static_cast<agus::MemoryPressure>(
+      std::clamp(level, static_cast<int>(agus::MemoryPressure::Moderate),
+                 static_cast<int>(agus::MemoryPressure::Critical)));
+  LOG(LDEBUG, ("comaps_on_memory_pressure: level", static_cast<int>(pressure)));
+
+  GetPlatform().RunTask(Platform::Thread::Background, [pressure, done]()
+  {
+    Framework * framework = g_host.m_framework();
+    if (!framework)
+    {
+      Report(done, {});
+      return;
+    }
+
+    // Tile geometry goes first, on the render thread, keeping the surface.
+    bool const trimSurface = pressure >= agus::MemoryPressure::Critical && g_host.m_hasSurface();
+    agus::TrimReport report = agus::TrimMemory(*framework, pressure, [framework, trimSurface](agus::TrimReport & r)
+    {
+      if (!trimSurface)
+        return;
+      r.m_drapeTilesFreed = agus::MeasureFreed([framework]()
+      {
+        if (!agus::TrimDrapeTiles(*framework, std::chrono::seconds(1)))
+          LOG(LWARNING, ("comaps_on_memory_pressure: Drape tiles not trimmed in time"));
+      });
+    });
+    if (!trimSurface)
+    {
+      Report(done, report);
+      return;
+    }
+
+    // Glyph and symbol textures only go with the surface, which is released and re-acquired
+    // on the GUI thread because the platform's surface callbacks change it there.
+    GetPlatform().RunTask(Platform::Thread::Gui, [report, done]() mutable
+    {
+      if (g_host.m_hasSurface())
+        report.m_drapeTexturesFreed = agus::TrimDrapeTextures([]() { g_host.m_recycleSurface(); });
+      Report(done, report);
+    });
+  });
+  return 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+
+class Framework;
+
+namespace agus
+{
+/// What the code shared by every platform needs from the platform source that owns the
+/// Framework and its render surface (agus_maps_flutter.cpp, agus_maps_flutter_ios.mm,
+/// agus_maps_flutter_macos.mm).
+struct EngineHost
+{
+  /// The Framework, or null before it is created and after shutdown.
+  std::function<Framework *()> m_framework;
+  /// True while a Drape engine renders to an attached surface.
+  std::function<bool()> m_hasSurface;
+  /// Releases and re-acquires the render surface; returns false if it was gone by then.
+  /// Runs on the GUI thread.
+  std::function<bool()> m_recycleSurface;
+};
+
+/// Called once by the platform source, before comaps_on_memory_pressure can be called.
+void SetEngineHost(EngineHost host);
+
+/// Gauges over state owned by other modules (memory, Drape textures, lazy maps, worker
+/// pools), read when a metrics snapshot is taken. Call once the worker pools exist.
+void RegisterMetricProviders();
+}  // namespace agus
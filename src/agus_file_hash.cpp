@@ -0,0 +1,392 @@
+#include "agus_file_hash.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AGUS_SHA_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+// The Android build compiles this file with +crypto for arm64-v8a; whether the CPU
+// has the extension is still checked at runtime.
+#define AGUS_SHA_ARM 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+#endif
+
+namespace agus
+{
+namespace
+{
+/// Mapped and hashed at a time; a multiple of any page size.
+size_t constexpr kWindowSize = 64 << 20;
+
+alignas(16) uint32_t constexpr kK[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+uint32_t constexpr kInitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+using ProcessBlocksFn = void (*)(uint32_t * state, uint8_t const * data, size_t blocks);
+
+uint32_t Rotr(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+uint32_t LoadBE32(uint8_t const * p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+void ProcessBlocksPortable(uint32_t * state, uint8_t const * data, size_t blocks)
+{
+  uint32_t w[64];
+  for (; blocks > 0; --blocks, data += 64)
+  {
+    for (int i = 0; i < 16; ++i)
+      w[i] = LoadBE32(data + 4 * i);
+    for (int i = 16; i < 64; ++i)
+    {
+      uint32_t const s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t const s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i)
+    {
+      uint32_t const t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + kK[i] + w[i];
+      uint32_t const t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#if defined(AGUS_SHA_X86)
+__attribute__((target("sha,sse4.1,ssse3"))) void ProcessBlocksShaNi(uint32_t * state, uint8_t const * data,
+                                                                     size_t blocks)
+{
+  __m128i const byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // The instructions keep the state as ABEF and CDGH.
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(state)), 0xB1);
+  __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(state + 4)), 0x1B);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+  for (; blocks > 0; --blocks, data += 64)
+  {
+    __m128i const saved0 = state0;
+    __m128i const saved1 = state1;
+    __m128i msg[4];
+    for (int i = 0; i < 4; ++i)
+      msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 16 * i)), byteSwap);
+
+    // Four rounds per step; steps 0-11 also extend the schedule by the four words
+    // used four steps later.
+    for (int i = 0; i < 16; ++i)
+    {
+      __m128i & current = msg[i & 3];
+      __m128i wk = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<__m128i const *>(kK + 4 * i)));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+      wk = _mm_shuffle_epi32(wk, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+      if (i < 12)
+      {
+        __m128i const next = _mm_sha256msg1_epu32(current, msg[(i + 1) & 3]);
+        __m128i const w9 = _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4);
+        current = _mm_sha256msg2_epu32(_mm_add_epi32(next, w9), msg[(i + 3) & 3]);
+      }
+    }
+
+    state0 = _mm_add_epi32(state0, saved0);
+    state1 = _mm_add_epi32(state1, saved1);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(tmp, state1, 0xF0));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+bool HasShaNi()
+{
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  bool const ssse3 = (ecx & (1u << 9)) != 0;
+  bool const sse41 = (ecx & (1u << 19)) != 0;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+  return ssse3 && sse41 && (ebx & (1u << 29)) != 0;
+}
+#endif
+
+#if defined(AGUS_SHA_ARM)
+void ProcessBlocksArm(uint32_t * state, uint8_t const * data, size_t blocks)
+{
+  uint32x4_t state0 = vld1q_u32(state);
+  uint32x4_t state1 = vld1q_u32(state + 4);
+
+  for (; blocks > 0; --blocks, data += 64)
+  {
+    uint32x4_t const saved0 = state0;
+    uint32x4_t const saved1 = state1;
+    uint32x4_t msg[4];
+    for (int i = 0; i < 4; ++i)
+      msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+    // Same schedule as ProcessBlocksShaNi.
+    for (int i = 0; i < 16; ++i)
+    {
+      uint32x4_t & current = msg[i & 3];
+      uint32x4_t const wk = vaddq_u32(current, vld1q_u32(kK + 4 * i));
+      if (i < 12)
+        current = vsha256su1q_u32(vsha256su0q_u32(current, msg[(i + 1) & 3]), msg[(i + 2) & 3], msg[(i + 3) & 3]);
+      uint32x4_t const abcd = state0;
+      state0 = vsha256hq_u32(state0, state1, wk);
+      state1 = vsha256h2q_u32(state1, abcd, wk);
+    }
+
+    state0 = vaddq_u32(state0, saved0);
+    state1 = vaddq_u32(state1, saved1);
+  }
+
+  vst1q_u32(state, state0);
+  vst1q_u32(state + 4, state1);
+}
+
+bool HasArmSha2()
+{
+#if defined(__APPLE__)
+  return true;
+#elif defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#else
+  return false;
+#endif
+}
+#endif
+
+struct Implementation
+{
+  ProcessBlocksFn m_processBlocks;
+  char const * m_name;
+};
+
+Implementation const & GetImplementation()
+{
+  static Implementation const impl = []() -> Implementation
+  {
+#if defined(AGUS_SHA_X86)
+    if (HasShaNi())
+      return {&ProcessBlocksShaNi, "sha-ni"};
+#elif defined(AGUS_SHA_ARM)
+    if (HasArmSha2())
+      return {&ProcessBlocksArm, "armv8-sha2"};
+#endif
+    return {&ProcessBlocksPortable, "portable"};
+  }();
+  return impl;
+}
+
+uint64_t GetFileSize(std::string const & path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+}  // namespace
+
+std::string DebugPrint(Sha256Digest const & digest)
+{
+  static char constexpr kHex[] = "0123456789abcdef";
+  std::string out;
+  out.reserve(digest.size() * 2);
+  for (uint8_t const byte : digest)
+  {
+    out += kHex[byte >> 4];
+    out += kHex[byte & 0xF];
+  }
+  return out;
+}
+
+Sha256::Sha256()
+{
+  std::copy(std::begin(kInitialState), std::end(kInitialState), m_state);
+}
+
+void Sha256::Update(void const * data, size_t size)
+{
+  auto const * p = static_cast<uint8_t const *>(data);
+  m_length += size;
+
+  if (m_buffered > 0)
+  {
+    size_t const n = std::min(size, sizeof(m_buffer) - m_buffered);
+    std::memcpy(m_buffer + m_buffered, p, n);
+    m_buffered += n;
+    p += n;
+    size -= n;
+    if (m_buffered < sizeof(m_buffer))
+      return;
+    GetImplementation().m_processBlocks(m_state, m_buffer, 1);
+    m_buffered = 0;
+  }
+
+  size_t const blocks = size / 64;
+  if (blocks > 0)
+  {
+    GetImplementation().m_processBlocks(m_state, p, blocks);
+    p += blocks * 64;
+    size -= blocks * 64;
+  }
+
+  std::memcpy(m_buffer, p, size);
+  m_buffered = size;
+}
+
+Sha256Digest Sha256::Finalize()
+{
+  uint64_t const bits = m_length * 8;
+  uint8_t padding[72] = {0x80};
+  size_t const padSize = (m_buffered < 56 ? 56 : 120) - m_buffered;
+  for (int i = 0; i < 8; ++i)
+    padding[padSize + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+  Update(padding, padSize + 8);
+
+  Sha256Digest digest;
+  for (int i = 0; i < 8; ++i)
+  {
+    for (int j = 0; j < 4; ++j)
+      digest[4 * i + j] = static_cast<uint8_t>(m_state[i] >> (24 - 8 * j));
+  }
+  return digest;
+}
+
+char const * GetSha256Implementation()
+{
+  return GetImplementation().m_name;
+}
+
+std::optional<Sha256Digest> HashFile(std::string const & path, std::function<void(uint64_t)> const & onWindow)
+{
+  int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG(LWARNING, ("Can't open", path, "for hashing:", strerror(errno)));
+    return {};
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    return {};
+  }
+
+  Sha256 hasher;
+  uint64_t const size = static_cast<uint64_t>(st.st_size);
+  for (uint64_t offset = 0; offset < size; offset += kWindowSize)
+  {
+    size_t const length = static_cast<size_t>(std::min<uint64_t>(kWindowSize, size - offset));
+    void * window = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+    if (window == MAP_FAILED)
+    {
+      LOG(LWARNING, ("Can't map", path, "at", offset, "for hashing:", strerror(errno)));
+      close(fd);
+      return {};
+    }
+    madvise(window, length, MADV_SEQUENTIAL);
+    hasher.Update(window, length);
+    munmap(window, length);
+    if (onWindow)
+      onWindow(offset + length);
+  }
+  close(fd);
+  return hasher.Finalize();
+}
+
+std::vector<std::optional<Sha256Digest>> HashFiles(std::vector<std::string> const & paths, unsigned threads,
+                                                   HashProgressFn const & progress)
+{
+  std::vector<std::optional<Sha256Digest>> digests(paths.size());
+
+  // Largest first, so a big map doesn't start last and leave the other threads idle.
+  std::vector<std::pair<uint64_t, size_t>> order;
+  order.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+    order.emplace_back(GetFileSize(paths[i]), i);
+  std::sort(order.begin(), order.end(), std::greater<>());
+
+  std::atomic<size_t> next{0};
+  auto const work = [&]()
+  {
+    for (size_t k = next++; k < order.size(); k = next++)
+    {
+      size_t const index = order[k].second;
+      uint64_t hashed = 0;
+      digests[index] = HashFile(paths[index], [&](uint64_t bytes)
+      {
+        hashed = bytes;
+        if (progress)
+          progress(index, HashStatus::Hashing, bytes);
+      });
+      if (progress)
+        progress(index, digests[index] ? HashStatus::Done : HashStatus::Failed, hashed);
+    }
+  };
+
+  threads = std::clamp<unsigned>(threads, 1, static_cast<unsigned>(std::max<size_t>(paths.size(), 1)));
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; ++i)
+    workers.emplace_back(work);
+  work();
+  for (auto & worker : workers)
+    worker.join();
+
+  LOG(LINFO, ("Hashed", paths.size(), "files on", threads, "threads with", GetSha256Implementation()));
+  return digests;
+}
+}  // namespace agus
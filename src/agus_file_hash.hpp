@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace agus
+{
+using Sha256Digest = std::array<uint8_t, 32>;
+
+/// Lowercase hex, as stored in the map metadata.
+std::string DebugPrint(Sha256Digest const & digest);
+
+/// Incremental SHA-256. Whole blocks go through the CPU's SHA instructions where it
+/// has them (SHA-NI on x86, the SHA2 extension on ARMv8), chosen once at runtime.
+class Sha256
+{
+public:
+  Sha256();
+
+  void Update(void const * data, size_t size);
+  Sha256Digest Finalize();
+
+private:
+  uint32_t m_state[8];
+  uint64_t m_length = 0;
+  uint8_t m_buffer[64];
+  size_t m_buffered = 0;
+};
+
+/// "sha-ni", "armv8-sha2" or "portable".
+char const * GetSha256Implementation();
+
+enum class HashStatus
+{
+  Hashing = 0,
+  Done = 1,
+  Failed = -1,
+};
+
+/// Called from the hashing threads with the index of a file and the bytes of it
+/// hashed so far: while hashing, once per mapped window, then once with Done or Failed.
+using HashProgressFn = std::function<void(size_t index, HashStatus status, uint64_t bytes)>;
+
+/// Hashes |path| through read-only mappings of 64 MB at a time, so
+/// multi-GB maps don't need as much address space on 32-bit devices.
+std::optional<Sha256Digest> HashFile(std::string const & path, std::function<void(uint64_t)> const & onWindow = {});
+
+/// Hashes |paths| on up to |threads| threads, largest files first. A digest is
+/// nullopt if its file couldn't be read.
+std::vector<std::optional<Sha256Digest>> HashFiles(std::vector<std::string> const & paths, unsigned threads,
+                                                   HashProgressFn const & progress = {});
+}  // namespace agus
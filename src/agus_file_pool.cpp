@@ -0,0 +1,373 @@
+#include "agus_file_pool.hpp"
+
+#include "agus_metrics.hpp"
+#include "agus_trace.hpp"
+
+#include "indexer/mwm_lock_hooks.hpp"
+
+#include "platform/local_country_file.hpp"
+
+#include "coding/reader_cache.hpp"
+
+#include "base/assert.hpp"
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace
+{
+/// A quarter of the soft descriptor limit, but at least 16 and at most 256.
+size_t DefaultLimit()
+{
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY)
+    return 256;
+  return std::clamp<size_t>(static_cast<size_t>(limit.rlim_cur / 4), 16, 256);
+}
+
+class FilePool
+{
+public:
+  struct File
+  {
+    /// Name the reader was opened under; differs from m_path for archive entries.
+    std::string m_name;
+    std::string m_path;
+    /// Identity at the first open; a reopen must find the same file.
+    dev_t m_dev = 0;
+    ino_t m_ino = 0;
+    uint64_t m_size = 0;
+    int m_fd = -1;
+    /// Reads in progress; a file is not evicted while they use the descriptor.
+    size_t m_users = 0;
+    std::list<File *>::iterator m_lruPos;
+  };
+
+  FilePool() : m_limit(DefaultLimit()) {}
+
+  std::shared_ptr<File> Open(std::string const & name, std::string const & path)
+  {
+    int const fd = OpenFd(path);
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+      close(fd);
+      MYTHROW(Reader::OpenException, ("fstat", path, strerror(errno)));
+    }
+
+    auto file = std::shared_ptr<File>(new File(), [this](File * f) { Release(f); });
+    file->m_name = name;
+    file->m_path = path;
+    file->m_dev = st.st_dev;
+    file->m_ino = st.st_ino;
+    file->m_size = static_cast<uint64_t>(st.st_size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_opens;
+    file->m_fd = fd;
+    m_lru.push_front(file.get());
+    file->m_lruPos = m_lru.begin();
+    ++m_open;
+    ++m_files;
+    EvictLocked();
+    return file;
+  }
+
+  void Read(File & file, uint64_t pos, void * p, size_t size)
+  {
+    // Reader cache misses only: hits never get here.
+    AGUS_TRACE_SCOPE("io", "FilePool::Read");
+    int fd = -1;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (file.m_fd < 0)
+      {
+        file.m_fd = ReopenFd(file);
+        ++m_opens;
+        ++m_reopens;
+        ++m_open;
+        m_lru.push_front(&file);
+        file.m_lruPos = m_lru.begin();
+      }
+      else
+      {
+        m_lru.splice(m_lru.begin(), m_lru, file.m_lruPos);
+      }
+      ++file.m_users;
+      fd = file.m_fd;
+      EvictLocked();
+    }
+
+    auto * out = static_cast<char *>(p);
+    size_t done = 0;
+    int error = 0;
+    while (done < size)
+    {
+      ssize_t const n = pread(fd, out + done, size - done, static_cast<off_t>(pos + done));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+      {
+        error = n < 0 ? errno : EIO;
+        break;
+      }
+      done += static_cast<size_t>(n);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --file.m_users;
+      EvictLocked();
+    }
+    static auto & reads = GetCounter("mwm.reads");
+    static auto & bytesRead = GetCounter("mwm.bytes_read");
+    reads.Add();
+    bytesRead.Add(done);
+    if (done < size)
+      MYTHROW(Reader::ReadException, (file.m_path, pos, size, strerror(error)));
+  }
+
+  void SetLimit(size_t limit)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_limit = std::max<size_t>(limit, 1);
+    EvictLocked();
+  }
+
+  /// Pinned files keep their descriptor however far over the limit the pool is.
+  void SetPinned(std::string const & name, bool pinned)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (pinned)
+    {
+      ++m_pins[name];
+      return;
+    }
+    auto const it = m_pins.find(name);
+    if (it == m_pins.end())
+      return;
+    if (--it->second == 0)
+      m_pins.erase(it);
+    EvictLocked();
+  }
+
+  FilePoolStats GetStats()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FilePoolStats stats;
+    stats.m_limit = m_limit;
+    stats.m_files = m_files;
+    stats.m_openDescriptors = m_open;
+    stats.m_opens = m_opens;
+    stats.m_reopens = m_reopens;
+    stats.m_evictions = m_evictions;
+    return stats;
+  }
+
+private:
+  static int OpenFd(std::string const & path)
+  {
+    int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      MYTHROW(Reader::OpenException, (path, strerror(errno)));
+    return fd;
+  }
+
+  /// Opens the evicted |file| again by path, refusing a different file found there
+  /// now: the map was replaced or truncated under a reader that still expects the old one.
+  static int ReopenFd(File const & file)
+  {
+    int const fd = OpenFd(file.m_path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_dev != file.m_dev || st.st_ino != file.m_ino ||
+        static_cast<uint64_t>(st.st_size) != file.m_size)
+    {
+      close(fd);
+      LOG(LWARNING, (file.m_path, "changed since it was opened; not reopening it"));
+      MYTHROW(Reader::OpenException, (file.m_path, "changed since it was opened"));
+    }
+    return fd;
+  }
+
+  /// Closes least recently read idle files while over the limit. Files in use or
+  /// locked by an MwmHandle stay open, so the limit can be exceeded: briefly under
+  /// heavy concurrency, and for as long as more maps than the limit are locked.
+  void EvictLocked()
+  {
+    for (auto it = m_lru.end(); m_open > m_limit && it != m_lru.begin();)
+    {
+      --it;
+      File * file = *it;
+      if (file->m_users > 0 || m_pins.count(file->m_name) > 0)
+        continue;
+      close(file->m_fd);
+      file->m_fd = -1;
+      it = m_lru.erase(it);
+      --m_open;
+      ++m_evictions;
+    }
+  }
+
+  /// Deleter of the last reader sharing |file|.
+  void Release(File * file)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ASSERT_EQUAL(file->m_users, 0, ());
+      if (file->m_fd >= 0)
+      {
+        close(file->m_fd);
+        m_lru.erase(file->m_lruPos);
+        --m_open;
+      }
+      --m_files;
+    }
+    delete file;
+  }
+
+  std::mutex m_mutex;
+  /// Files holding a descriptor, most recently read first.
+  std::list<File *> m_lru;
+  /// Lock counts of pinned files by reader name.
+  std::map<std::string, size_t> m_pins;
+  size_t m_limit;
+  size_t m_files = 0;
+  size_t m_open = 0;
+  uint64_t m_opens = 0;
+  uint64_t m_reopens = 0;
+  uint64_t m_evictions = 0;
+};
+
+/// Page loads by this thread's reader caches, to tell hits from misses.
+thread_local uint64_t t_pageLoads = 0;
+
+FilePool & GetPool()
+{
+  // Never destroyed: readers may outlive static destruction order.
+  static auto * pool = new FilePool();
+  return *pool;
+}
+
+class PooledReader : public ModelReader
+{
+  /// Adapts the pooled file to ReaderCache.
+  struct Source
+  {
+    std::shared_ptr<FilePool::File> m_file;
+
+    uint64_t Size() const { return m_file->m_size; }
+    void Read(uint64_t pos, void * p, size_t size) const
+    {
+      ++t_pageLoads;
+      GetPool().Read(*m_file, pos, p, size);
+    }
+  };
+
+  struct Shared
+  {
+    Shared(std::shared_ptr<FilePool::File> file, uint32_t logPageSize, uint32_t logPageCount)
+      : m_source{std::move(file)}, m_cache(logPageSize, logPageCount)
+    {}
+
+    Source m_source;
+    std::mutex m_mutex;
+    ReaderCache<Source> m_cache;
+  };
+
+public:
+  PooledReader(std::string const & path, std::shared_ptr<Shared> shared, uint64_t offset, uint64_t size)
+    : ModelReader(path), m_shared(std::move(shared)), m_offset(offset), m_size(size)
+  {}
+
+  static std::unique_ptr<ModelReader> Open(std::string const & name, std::string const & path, uint64_t offset,
+                                           std::optional<uint64_t> size, uint32_t logPageSize, uint32_t logPageCount)
+  {
+    auto shared = std::make_shared<Shared>(GetPool().Open(name, path), logPageSize, logPageCount);
+    uint64_t const fileSize = shared->m_source.Size();
+    if (offset > fileSize || (size && *size > fileSize - offset))
+      MYTHROW(Reader::OpenException, (name, "range", offset, size.value_or(0), "is past the end of", path, fileSize));
+    return std::make_unique<PooledReader>(name, std::move(shared), offset, size.value_or(fileSize - offset));
+  }
+
+  uint64_t Size() const override { return m_size; }
+
+  void Read(uint64_t pos, void * p, size_t size) const override
+  {
+    ASSERT_LESS_OR_EQUAL(pos + size, m_size, (GetName()));
+    static auto & reads = GetCounter("reader_cache.reads");
+    static auto & hits = GetCounter("reader_cache.hits");
+    uint64_t const loads = t_pageLoads;
+    {
+      std::lock_guard<std::mutex> lock(m_shared->m_mutex);
+      m_shared->m_cache.Read(m_shared->m_source, m_offset + pos, p, size);
+    }
+    reads.Add();
+    if (t_pageLoads == loads)
+      hits.Add();
+  }
+
+  std::unique_ptr<Reader> CreateSubReader(uint64_t pos, uint64_t size) const override
+  {
+    ASSERT_LESS_OR_EQUAL(pos + size, m_size, (GetName()));
+    return std::make_unique<PooledReader>(GetName(), m_shared, m_offset + pos, size);
+  }
+
+private:
+  std::shared_ptr<Shared> m_shared;
+  uint64_t m_offset;
+  uint64_t m_size;
+};
+}  // namespace
+
+std::string DebugPrint(FilePoolStats const & stats)
+{
+  std::ostringstream out;
+  out << "open=" << stats.m_openDescriptors << "/" << stats.m_limit << " files=" << stats.m_files
+      << " opens=" << stats.m_opens << " reopens=" << stats.m_reopens << " evictions=" << stats.m_evictions;
+  return out.str();
+}
+
+void SetFilePoolLimit(size_t limit)
+{
+  GetPool().SetLimit(limit);
+  LOG(LINFO, ("File pool:", DebugPrint(GetFilePoolStats())));
+}
+
+FilePoolStats GetFilePoolStats()
+{
+  return GetPool().GetStats();
+}
+
+void PinFilesOfLockedMaps()
+{
+  mwm_lock_hooks::g_onLockChanged = [](platform::LocalCountryFile const & file, bool locked)
+  {
+    GetPool().SetPinned(file.GetPath(MapFileType::Map), locked);
+  };
+}
+
+std::unique_ptr<ModelReader> OpenPooledReader(std::string const & path, uint32_t logPageSize, uint32_t logPageCount)
+{
+  return PooledReader::Open(path, path, 0, std::nullopt, logPageSize, logPageCount);
+}
+
+std::unique_ptr<ModelReader> OpenPooledReader(std::string const & name, std::string const & path, uint64_t offset,
+                                              uint64_t size, uint32_t logPageSize, uint32_t logPageCount)
+{
+  return PooledReader::Open(name, path, offset, size, logPageSize, logPageCount);
+}
+}  // namespace agus
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "coding/reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace agus
+{
+struct FilePoolStats
+{
+  size_t m_limit = 0;
+  /// Files readers are alive for, and how many of them hold a descriptor now.
+  size_t m_files = 0;
+  size_t m_openDescriptors = 0;
+  uint64_t m_opens = 0;
+  /// Opens of files whose descriptor had been evicted; a high share of m_opens
+  /// means the limit is too low for the working set.
+  uint64_t m_reopens = 0;
+  uint64_t m_evictions = 0;
+};
+
+std::string DebugPrint(FilePoolStats const & stats);
+
+/// Caps descriptors held by readers from OpenPooledReader. When the cap is hit the
+/// least recently read idle file is closed; its readers reopen it on next use, and
+/// fail to read if a different file is at its path by then.
+void SetFilePoolLimit(size_t limit);
+FilePoolStats GetFilePoolStats();
+
+/// Keeps the descriptors of maps locked by an MwmHandle out of eviction, through the
+/// MwmSet lock hook (CoMaps patch 0022). Call once, before maps are registered.
+void PinFilesOfLockedMaps();
+
+/// FileReader replacement whose descriptor is borrowed from the pool for each
+/// read. Reads go through a page cache shared by the reader and its sub-readers,
+/// configured like FileReader's.
+std::unique_ptr<ModelReader> OpenPooledReader(std::string const & path, uint32_t logPageSize,
+                                              uint32_t logPageCount);
+
+/// Same, over the |size| bytes at |offset| of |path| (e.g. an uncompressed archive
+/// entry), reported under |name|. Throws Reader::OpenException if the range is
+/// past the end of the file.
+std::unique_ptr<ModelReader> OpenPooledReader(std::string const & name, std::string const & path,
+                                              uint64_t offset, uint64_t size, uint32_t logPageSize,
+                                              uint32_t logPageCount);
+}  // namespace agus
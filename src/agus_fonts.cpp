@@ -0,0 +1,522 @@
+#include "agus_fonts.hpp"
+
+#include "agus_resource_pack.hpp"
+
+#include "platform/platform.hpp"
+
+#include "base/logging.hpp"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace agus
+{
+namespace
+{
+std::string_view constexpr kIndexHeader = "agus-font-index 1";
+char constexpr kIndexFile[] = "font_index.txt";
+char constexpr kLanguagesFile[] = "font_languages.txt";
+char constexpr kAllLanguages[] = "*";
+
+/// Always loaded: the scripts of the vast majority of labels plus the punctuation
+/// and symbol blocks shared by all of them.
+char const * const kBaseBlocks[] = {
+    "Basic_Latin", "Latin-1_Supplement", "Latin_Extended-A", "Latin_Extended-B",
+    "Latin_Extended_Additional", "IPA_Extensions", "Spacing_Modifier_Letters",
+    "Combining_Diacritical_Marks", "Greek_and_Coptic", "Greek_Extended", "Cyrillic",
+    "Cyrillic_Supplement", "General_Punctuation", "Superscripts_and_Subscripts",
+    "Currency_Symbols", "Letterlike_Symbols", "Number_Forms", "Arrows",
+    "Mathematical_Operators", "Geometric_Shapes",
+    "Miscellaneous_Symbols", "Dingbats", "Supplemental_Punctuation",
+};
+
+struct Script
+{
+  std::vector<char const *> m_languages;
+  /// Main block first, so that the font chosen for it also covers the rest.
+  std::vector<char const *> m_blocks;
+};
+
+Script const kScripts[] = {
+    {{"zh", "yue", "ja"},
+     {"CJK_Unified_Ideographs", "CJK_Unified_Ideographs_Extension_A", "CJK_Symbols_and_Punctuation",
+      "CJK_Compatibility_Ideographs", "Halfwidth_and_Fullwidth_Forms", "CJK_Compatibility"}},
+    {{"ja"}, {"Hiragana", "Katakana", "Katakana_Phonetic_Extensions"}},
+    {{"zh"}, {"Bopomofo", "Bopomofo_Extended"}},
+    {{"ko"},
+     {"Hangul_Syllables", "Hangul_Jamo", "Hangul_Compatibility_Jamo", "CJK_Symbols_and_Punctuation",
+      "Halfwidth_and_Fullwidth_Forms"}},
+    {{"ar", "fa", "ur", "ps", "ckb", "ug", "sd", "ks"},
+     {"Arabic", "Arabic_Supplement", "Arabic_Extended-A", "Arabic_Presentation_Forms-A",
+      "Arabic_Presentation_Forms-B"}},
+    {{"he", "yi"}, {"Hebrew", "Alphabetic_Presentation_Forms"}},
+    {{"syr"}, {"Syriac"}},
+    {{"dv"}, {"Thaana"}},
+    {{"hi", "mr", "ne", "sa", "mai", "bh"}, {"Devanagari", "Devanagari_Extended", "Common_Indic_Number_Forms"}},
+    {{"bn", "as"}, {"Bengali"}},
+    {{"pa"}, {"Gurmukhi"}},
+    {{"gu"}, {"Gujarati"}},
+    {{"or"}, {"Oriya"}},
+    {{"ta"}, {"Tamil"}},
+    {{"te"}, {"Telugu"}},
+    {{"kn"}, {"Kannada"}},
+    {{"ml"}, {"Malayalam"}},
+    {{"si"}, {"Sinhala"}},
+    {{"th"}, {"Thai"}},
+    {{"lo"}, {"Lao"}},
+    {{"bo", "dz"}, {"Tibetan"}},
+    {{"my"}, {"Myanmar", "Myanmar_Extended-A"}},
+    {{"km"}, {"Khmer", "Khmer_Symbols"}},
+    {{"ka"}, {"Georgian", "Georgian_Supplement"}},
+    {{"hy"}, {"Armenian"}},
+    {{"am", "ti"}, {"Ethiopic", "Ethiopic_Supplement", "Ethiopic_Extended"}},
+    {{"iu", "cr"}, {"Unified_Canadian_Aboriginal_Syllabics"}},
+    {{"chr"}, {"Cherokee"}},
+    {{"mn"}, {"Mongolian"}},
+};
+
+std::mutex g_mutex;
+std::set<std::string> g_explicitLanguages;
+std::set<std::string> g_learnedLanguages;
+bool g_learnedLoaded = false;
+/// Blocks handed to the running glyph manager; empty until it is created.
+std::set<std::string> g_activeBlocks;
+bool g_allFontsActive = false;
+
+/// Data of a resource that isn't on disk but in the resource pack.
+std::optional<std::string_view> FindInPack(std::string const & path)
+{
+  auto const pack = GetResourcePack();
+  std::string const & resourcesDir = GetPlatform().ResourcesDir();
+  if (!pack || path.compare(0, resourcesDir.size(), resourcesDir) != 0)
+    return {};
+  return pack->Find(path.substr(resourcesDir.size()));
+}
+
+/// Whole of |text| as a number; these files are written by hand or by an older
+/// version, so malformed entries must not throw.
+template <typename T>
+bool ParseNumber(std::string_view text, int base, T & value)
+{
+  auto const [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+  return error == std::errc() && end == text.data() + text.size() && !text.empty();
+}
+
+bool StatFile(std::string const & path, uint64_t & size, int64_t & mtime)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0)
+  {
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtime);
+    return true;
+  }
+  if (auto const data = FindInPack(path))
+  {
+    size = data->size();
+    mtime = GetResourcePack()->GetMtime();
+    return true;
+  }
+  return false;
+}
+
+std::unique_ptr<std::istream> OpenText(std::string const & path)
+{
+  auto file = std::make_unique<std::ifstream>(path);
+  if (file->is_open())
+    return file;
+  auto const data = FindInPack(path);
+  return std::make_unique<std::istringstream>(data ? std::string(*data) : std::string());
+}
+
+bool IsFontFile(std::string const & name)
+{
+  return name.size() > 4 && name.compare(name.size() - 4, 4, ".ttf") == 0;
+}
+
+std::vector<std::string> ListFonts(std::string const & fontsDir)
+{
+  std::vector<std::string> files;
+  if (DIR * dir = opendir(fontsDir.c_str()))
+  {
+    while (dirent * entry = readdir(dir))
+    {
+      std::string const name = entry->d_name;
+      if (IsFontFile(name))
+        files.push_back(name);
+    }
+    closedir(dir);
+  }
+  std::string const & resourcesDir = GetPlatform().ResourcesDir();
+  if (auto const pack = GetResourcePack(); pack && fontsDir.compare(0, resourcesDir.size(), resourcesDir) == 0)
+  {
+    for (auto & name : pack->List(fontsDir.substr(resourcesDir.size())))
+    {
+      if (IsFontFile(name))
+        files.push_back(std::move(name));
+    }
+  }
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+  return files;
+}
+
+bool ScanFont(FT_Library library, std::string const & path, std::vector<UnicodeBlock> const & blocks,
+              FontCoverage & coverage)
+{
+  FT_Face face = nullptr;
+  if (FT_New_Face(library, path.c_str(), 0, &face) != 0)
+  {
+    auto const data = FindInPack(path);
+    if (!data || FT_New_Memory_Face(library, reinterpret_cast<FT_Byte const *>(data->data()),
+                                    static_cast<FT_Long>(data->size()), 0, &face) != 0)
+    {
+      return false;
+    }
+  }
+
+  FT_UInt glyphIndex = 0;
+  for (FT_ULong code = FT_Get_First_Char(face, &glyphIndex); glyphIndex != 0;
+       code = FT_Get_Next_Char(face, code, &glyphIndex))
+  {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), static_cast<char32_t>(code),
+                               [](char32_t c, UnicodeBlock const & block) { return c < block.m_start; });
+    if (it == blocks.begin())
+      continue;
+    --it;
+    if (code <= it->m_end)
+      ++coverage.m_glyphsPerBlock[it->m_name];
+  }
+  FT_Done_Face(face);
+  return true;
+}
+
+/// Empty when the index is missing or any line of it is malformed (a torn write, an
+/// older format): every font is scanned again then and the index is rewritten.
+std::map<std::string, FontCoverage> ReadIndex(std::string const & indexPath)
+{
+  std::map<std::string, FontCoverage> index;
+  std::ifstream in(indexPath);
+  std::string line;
+  if (!std::getline(in, line) || line != kIndexHeader)
+    return index;
+
+  // file \t size \t mtime \t Block:count,Block:count
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    FontCoverage coverage;
+    std::string size, mtime, blocks;
+    if (!std::getline(fields, coverage.m_file, '\t') || !std::getline(fields, size, '\t') ||
+        !std::getline(fields, mtime, '\t') || !ParseNumber(size, 10, coverage.m_size) ||
+        !ParseNumber(mtime, 10, coverage.m_mtime))
+    {
+      LOG(LWARNING, ("Malformed font index", indexPath, "line", line, ", rebuilding it"));
+      return {};
+    }
+    std::getline(fields, blocks);
+    std::istringstream entries(blocks);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+      auto const colon = entry.rfind(':');
+      uint32_t count = 0;
+      if (colon == std::string::npos || !ParseNumber(std::string_view(entry).substr(colon + 1), 10, count))
+      {
+        LOG(LWARNING, ("Malformed font index", indexPath, "entry", entry, ", rebuilding it"));
+        return {};
+      }
+      coverage.m_glyphsPerBlock[entry.substr(0, colon)] = count;
+    }
+    index.emplace(coverage.m_file, std::move(coverage));
+  }
+  return index;
+}
+
+void WriteIndex(std::string const & indexPath, std::vector<FontCoverage> const & fonts)
+{
+  std::string const tmpPath = indexPath + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::trunc);
+    out << kIndexHeader << '\n';
+    for (auto const & font : fonts)
+    {
+      out << font.m_file << '\t' << font.m_size << '\t' << font.m_mtime << '\t';
+      bool first = true;
+      for (auto const & [block, count] : font.m_glyphsPerBlock)
+      {
+        out << (first ? "" : ",") << block << ':' << count;
+        first = false;
+      }
+      out << '\n';
+    }
+    if (!out)
+      return;
+  }
+  std::rename(tmpPath.c_str(), indexPath.c_str());
+}
+
+std::multimap<std::string, std::string> LoadWhitelist(std::string const & path)
+{
+  // Lines are "Block path"; only bundled fonts ("fonts/...") can be selected here.
+  std::multimap<std::string, std::string> whitelist;
+  auto in = OpenText(path);
+  std::string block, font;
+  while (*in >> block >> font)
+  {
+    if (font.rfind("fonts/", 0) == 0)
+      whitelist.emplace(block, font.substr(6));
+  }
+  return whitelist;
+}
+
+void LoadLearnedLanguages()
+{
+  if (g_learnedLoaded)
+    return;
+  g_learnedLoaded = true;
+  std::ifstream in(GetPlatform().WritableDir() + kLanguagesFile);
+  std::string language;
+  while (in >> language)
+    g_learnedLanguages.insert(language);
+}
+
+void SaveLearnedLanguages()
+{
+  std::ofstream out(GetPlatform().WritableDir() + kLanguagesFile, std::ios::trunc);
+  for (auto const & language : g_learnedLanguages)
+    out << language << '\n';
+}
+
+std::vector<std::string> AllFonts(std::string const & fontsDir)
+{
+  std::vector<std::string> result;
+  for (auto const & file : ListFonts(fontsDir))
+    result.push_back("fonts/" + file);
+  return result;
+}
+}  // namespace
+
+std::vector<UnicodeBlock> LoadUnicodeBlocks(std::string const & path)
+{
+  std::vector<UnicodeBlock> blocks;
+  auto in = OpenText(path);
+  std::string name, start, end;
+  while (*in >> name >> start >> end)
+  {
+    // "0x" prefixed hex code points
+    uint32_t startValue = 0;
+    uint32_t endValue = 0;
+    auto const digits = [](std::string const & text)
+    {
+      return std::string_view(text).substr(text.rfind("0x", 0) == 0 ? 2 : 0);
+    };
+    if (!ParseNumber(digits(start), 16, startValue) || !ParseNumber(digits(end), 16, endValue) || startValue > endValue)
+    {
+      LOG(LWARNING, ("Skipping malformed unicode block", name, start, end, "in", path));
+      continue;
+    }
+    UnicodeBlock block;
+    block.m_name = name;
+    block.m_start = static_cast<char32_t>(startValue);
+    block.m_end = static_cast<char32_t>(endValue);
+    blocks.push_back(std::move(block));
+  }
+  std::sort(blocks.begin(), blocks.end(),
+            [](UnicodeBlock const & a, UnicodeBlock const & b) { return a.m_start < b.m_start; });
+  return blocks;
+}
+
+bool FontIndex::Load(std::string const & fontsDir, std::vector<UnicodeBlock> const & blocks,
+                     std::string const & indexPath)
+{
+  auto cached = ReadIndex(indexPath);
+  m_fonts.clear();
+
+  FT_Library library = nullptr;
+  size_t scanned = 0;
+  auto const start = std::chrono::steady_clock::now();
+  for (auto const & file : ListFonts(fontsDir))
+  {
+    FontCoverage coverage;
+    coverage.m_file = file;
+    if (!StatFile(fontsDir + file, coverage.m_size, coverage.m_mtime))
+      continue;
+
+    auto it = cached.find(file);
+    if (it != cached.end() && it->second.m_size == coverage.m_size && it->second.m_mtime == coverage.m_mtime)
+    {
+      m_fonts.push_back(std::move(it->second));
+      continue;
+    }
+
+    if (library == nullptr && FT_Init_FreeType(&library) != 0)
+      return false;
+    if (!ScanFont(library, fontsDir + file, blocks, coverage))
+      LOG(LWARNING, ("Can't index font", file));
+    m_fonts.push_back(std::move(coverage));
+    ++scanned;
+  }
+  if (library != nullptr)
+    FT_Done_FreeType(library);
+
+  if (scanned > 0)
+  {
+    WriteIndex(indexPath, m_fonts);
+    LOG(LINFO, ("Indexed", scanned, "fonts in",
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(),
+                "ms"));
+  }
+  return !m_fonts.empty();
+}
+
+std::vector<std::string> FontIndex::SelectFonts(std::vector<std::string> const & blocks,
+                                                std::multimap<std::string, std::string> const & whitelist) const
+{
+  std::set<std::string> selected;
+  auto const glyphs = [this](std::string const & file, std::string const & block) -> uint32_t
+  {
+    for (auto const & font : m_fonts)
+    {
+      if (font.m_file != file)
+        continue;
+      auto const it = font.m_glyphsPerBlock.find(block);
+      return it == font.m_glyphsPerBlock.end() ? 0 : it->second;
+    }
+    return 0;
+  };
+
+  for (auto const & block : blocks)
+  {
+    bool whitelisted = false;
+    auto const range = whitelist.equal_range(block);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (glyphs(it->second, block) != 0)
+      {
+        selected.insert(it->second);
+        whitelisted = true;
+      }
+    }
+    if (whitelisted)
+      continue;
+
+    // Most glyphs wins; on a tie the smaller file is cheaper to open.
+    FontCoverage const * best = nullptr;
+    uint32_t bestCount = 0;
+    for (auto const & font : m_fonts)
+    {
+      auto const it = font.m_glyphsPerBlock.find(block);
+      if (it == font.m_glyphsPerBlock.end())
+        continue;
+      if (best == nullptr || it->second > bestCount || (it->second == bestCount && font.m_size < best->m_size))
+      {
+        best = &font;
+        bestCount = it->second;
+      }
+    }
+    if (best == nullptr)
+      continue;
+
+    // A font already selected for an earlier block is enough if it is nearly as complete;
+    // a few stray glyphs (e.g. a currency sign) don't make it cover the script.
+    if (std::none_of(selected.begin(), selected.end(),
+                     [&](std::string const & file) { return glyphs(file, block) * 10 >= bestCount * 9; }))
+      selected.insert(best->m_file);
+  }
+  return {selected.begin(), selected.end()};
+}
+
+std::vector<std::string> GetScriptBlocks(std::set<std::string> const & languages)
+{
+  std::vector<std::string> blocks(std::begin(kBaseBlocks), std::end(kBaseBlocks));
+  for (auto const & script : kScripts)
+  {
+    bool const used = std::any_of(script.m_languages.begin(), script.m_languages.end(),
+                                  [&](char const * language) { return languages.count(language) != 0; });
+    if (!used)
+      continue;
+    for (char const * block : script.m_blocks)
+    {
+      if (std::find(blocks.begin(), blocks.end(), block) == blocks.end())
+        blocks.emplace_back(block);
+    }
+  }
+  return blocks;
+}
+
+void SetFontLanguages(std::set<std::string> const & languages)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_explicitLanguages = languages;
+}
+
+bool RequireFontLanguages(std::vector<std::string> const & languages)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  LoadLearnedLanguages();
+
+  bool added = false;
+  for (auto const & language : languages)
+    added = g_learnedLanguages.insert(language).second || added;
+  if (added)
+    SaveLearnedLanguages();
+
+  if (g_activeBlocks.empty() || g_allFontsActive)
+    return false;
+  for (auto const & block : GetScriptBlocks({languages.begin(), languages.end()}))
+  {
+    if (g_activeBlocks.count(block) == 0)
+      return true;
+  }
+  return false;
+}
+
+std::vector<std::string> SelectSystemFonts(std::string const & resourcesDir, std::string const & writableDir)
+{
+  std::string const fontsDir = resourcesDir + "fonts/";
+
+  std::set<std::string> languages;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    LoadLearnedLanguages();
+    languages = g_learnedLanguages;
+    languages.insert(g_explicitLanguages.begin(), g_explicitLanguages.end());
+  }
+
+  // Nothing known yet (first launch): open everything and learn from the maps registered.
+  if (languages.empty() || languages.count(kAllLanguages) != 0)
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_allFontsActive = true;
+    return AllFonts(fontsDir);
+  }
+
+  FontIndex index;
+  if (!index.Load(fontsDir, LoadUnicodeBlocks(fontsDir + "unicode_blocks.txt"), writableDir + kIndexFile))
+    return AllFonts(fontsDir);
+
+  auto const blocks = GetScriptBlocks(languages);
+  std::vector<std::string> result;
+  for (auto const & file : index.SelectFonts(blocks, LoadWhitelist(fontsDir + "whitelist.txt")))
+    result.push_back("fonts/" + file);
+
+  LOG(LINFO, ("Fonts for languages", languages, ":", result, "of", index.GetFonts().size()));
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_activeBlocks = {blocks.begin(), blocks.end()};
+  g_allFontsActive = false;
+  return result;
+}
+}  // namespace agus
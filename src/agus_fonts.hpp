@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace agus
+{
+struct UnicodeBlock
+{
+  std::string m_name;
+  char32_t m_start = 0;
+  char32_t m_end = 0;
+};
+
+/// Parses fonts/unicode_blocks.txt ("Name 0xSTART 0xEND" per line), sorted by start.
+std::vector<UnicodeBlock> LoadUnicodeBlocks(std::string const & path);
+
+struct FontCoverage
+{
+  std::string m_file;
+  uint64_t m_size = 0;
+  int64_t m_mtime = 0;
+  /// Number of glyphs the font maps in each unicode block it touches.
+  std::map<std::string, uint32_t> m_glyphsPerBlock;
+};
+
+/// Unicode coverage of every font in the resource fonts/ directory.
+/// Scanning a face walks its whole charmap, so results are cached on disk
+/// and only fonts whose size or mtime changed are scanned again.
+class FontIndex
+{
+public:
+  /// Returns false if no font could be indexed.
+  bool Load(std::string const & fontsDir, std::vector<UnicodeBlock> const & blocks, std::string const & indexPath);
+
+  /// Smallest set of fonts covering |blocks|, processed in order: whitelisted fonts of a
+  /// block are always taken, otherwise the best covering font unless an already selected
+  /// one covers the block. Returns file names relative to the fonts directory.
+  std::vector<std::string> SelectFonts(std::vector<std::string> const & blocks,
+                                       std::multimap<std::string, std::string> const & whitelist) const;
+
+  std::vector<FontCoverage> const & GetFonts() const { return m_fonts; }
+
+private:
+  std::vector<FontCoverage> m_fonts;
+};
+
+/// Blocks needed for labels in |languages| (StringUtf8Multilang codes), Latin, Greek,
+/// Cyrillic and common punctuation/symbol blocks first.
+std::vector<std::string> GetScriptBlocks(std::set<std::string> const & languages);
+
+/// Languages labels are expected in, on top of those learned from registered maps.
+/// "*" requests every font.
+void SetFontLanguages(std::set<std::string> const & languages);
+
+/// Records languages of a registered map; they are persisted and used from the next
+/// glyph manager creation on. Returns true if they need fonts the running glyph
+/// manager was not given.
+bool RequireFontLanguages(std::vector<std::string> const & languages);
+
+/// Font list for Platform::GetSystemFontNames, as "fonts/<file>" relative paths.
+/// Falls back to every font when nothing is known about the languages in use yet
+/// (first launch) or the index can't be built.
+std::vector<std::string> SelectSystemFonts(std::string const & resourcesDir, std::string const & writableDir);
+}  // namespace agus
@@ -0,0 +1,147 @@
+#include "agus_frame_stats.hpp"
+
+#include "agus_metrics.hpp"
+#include "agus_trace.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+
+namespace agus
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/// Gap between active frames after which a burst is considered done.
+auto constexpr kSettleQuietTime = std::chrono::milliseconds(500);
+
+class FrameProbe
+{
+public:
+  explicit FrameProbe(char const * name) : m_name(name) {}
+
+  void Start()
+  {
+    m_started = true;
+    m_event = Clock::now();
+    m_lastFrame = m_event;
+    m_stats = {};
+  }
+
+  void OnFrame(Clock::time_point now)
+  {
+    if (!m_started)
+      return;
+    UpdateSettled(now);
+    if (m_stats.m_settledFrameMicros >= 0)
+      return;
+    if (m_stats.m_frames++ == 0)
+      m_stats.m_firstFrameMicros = MicrosSinceEvent(now);
+    m_stats.m_maxFrameGapMicros = std::max<int64_t>(
+        m_stats.m_maxFrameGapMicros, std::chrono::duration_cast<std::chrono::microseconds>(now - m_lastFrame).count());
+    m_lastFrame = now;
+  }
+
+  FirstFrameStats Get(Clock::time_point now)
+  {
+    if (m_started)
+      UpdateSettled(now);
+    return m_stats;
+  }
+
+private:
+  int64_t MicrosSinceEvent(Clock::time_point t) const
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - m_event).count();
+  }
+
+  /// Freezes m_settledFrameMicros once the quiet period after the last frame has passed.
+  void UpdateSettled(Clock::time_point now)
+  {
+    if (m_stats.m_settledFrameMicros >= 0 || m_stats.m_frames == 0 || now - m_lastFrame < kSettleQuietTime)
+      return;
+    m_stats.m_settledFrameMicros = MicrosSinceEvent(m_lastFrame);
+    LOG(LINFO, (m_name, "frames:", DebugPrint(m_stats)));
+  }
+
+  char const * const m_name;
+  bool m_started = false;
+  Clock::time_point m_event;
+  Clock::time_point m_lastFrame;
+  FirstFrameStats m_stats;
+};
+
+std::mutex g_mutex;
+FrameProbe g_engineProbe("Engine creation");
+FrameProbe g_mapReplaceProbe("Map replace");
+FrameProbe g_styleReloadProbe("Style switch (reload)");
+FrameProbe g_styleMappedProbe("Style switch (mapped files)");
+
+/// Gaps longer than this are the renderer idling between gestures, not slow frames.
+auto constexpr kMaxFrameInterval = std::chrono::seconds(1);
+Clock::time_point g_lastActiveFrame;
+}  // namespace
+
+std::string DebugPrint(FirstFrameStats const & stats)
+{
+  std::ostringstream out;
+  out << "first=" << stats.m_firstFrameMicros / 1000 << "ms settled=" << stats.m_settledFrameMicros / 1000
+      << "ms maxGap=" << stats.m_maxFrameGapMicros / 1000 << "ms frames=" << stats.m_frames;
+  return out.str();
+}
+
+void OnDrapeEngineCreating()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_engineProbe.Start();
+}
+
+void OnMapReplaced()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_mapReplaceProbe.Start();
+}
+
+void OnMapStyleSwitching(bool mapped)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  (mapped ? g_styleMappedProbe : g_styleReloadProbe).Start();
+}
+
+void OnActiveFrame()
+{
+  AGUS_TRACE_INSTANT("render", "active frame");
+  static auto & frameIntervals = GetHistogram("frame.interval_us");
+  auto const now = Clock::now();
+  std::lock_guard<std::mutex> lock(g_mutex);
+  if (now - g_lastActiveFrame < kMaxFrameInterval)
+    frameIntervals.Record(std::chrono::duration_cast<std::chrono::microseconds>(now - g_lastActiveFrame).count());
+  g_lastActiveFrame = now;
+  g_engineProbe.OnFrame(now);
+  g_mapReplaceProbe.OnFrame(now);
+  g_styleReloadProbe.OnFrame(now);
+  g_styleMappedProbe.OnFrame(now);
+}
+
+FirstFrameStats GetFirstFrameStats()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_engineProbe.Get(Clock::now());
+}
+
+FirstFrameStats GetMapReplaceFrameStats()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_mapReplaceProbe.Get(Clock::now());
+}
+
+FirstFrameStats GetStyleSwitchFrameStats(bool mapped)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return (mapped ? g_styleMappedProbe : g_styleReloadProbe).Get(Clock::now());
+}
+}  // namespace agus
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace agus
+{
+/// Timing of the burst of frames that follows an event (engine creation, map
+/// replacement), relative to the event. Glyph generation dominates the tail, so
+/// "settled" is the best available proxy for the first fully labeled frame.
+struct FirstFrameStats
+{
+  /// Microseconds until the first active frame, -1 if none yet.
+  int64_t m_firstFrameMicros = -1;
+  /// Microseconds until the last active frame before rendering went quiet for
+  /// kSettleQuietTime (all tiles and labels in place), -1 if not settled yet.
+  int64_t m_settledFrameMicros = -1;
+  /// Longest interval between the event or a frame and the next frame.
+  int64_t m_maxFrameGapMicros = 0;
+  /// Active frames counted until settled (or so far).
+  uint32_t m_frames = 0;
+};
+
+std::string DebugPrint(FirstFrameStats const & stats);
+
+/// Call right before Framework::CreateDrapeEngine; resets the stats.
+void OnDrapeEngineCreating();
+/// Call right before a registered map is swapped for a new file.
+void OnMapReplaced();
+/// Call right before switching the map style; |mapped| tells whether the switch
+/// was made with the style files kept mapped, each kind is tracked separately.
+void OnMapStyleSwitching(bool mapped);
+/// Call from the df::SetActiveFrameCallback callback (render thread).
+void OnActiveFrame();
+
+/// Frames after the last engine creation; default-constructed if there was none.
+FirstFrameStats GetFirstFrameStats();
+/// Frames after the last map replacement; default-constructed if there was none.
+FirstFrameStats GetMapReplaceFrameStats();
+/// Frames after the last style switch of the given kind; default-constructed if there was none.
+FirstFrameStats GetStyleSwitchFrameStats(bool mapped);
+}  // namespace agus
@@ -1,6 +1,10 @@
 #include "agus_gui_thread.hpp"
+#include "agus_log.hpp"
+#include "agus_metrics.hpp"
+#include "agus_tls_android.hpp"
+#include "agus_trace.hpp"
 #include "base/logging.hpp"
-#include <android/log.h>
+#include <chrono>
 #include <memory>
 #include <mutex>
 
@@ -13,18 +17,18 @@ static std::mutex g_jniMutex;
 
 extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
     g_javaVM = vm;
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "JNI_OnLoad: JavaVM stored");
+    AGUS_LOGD("AgusGuiThread", "JNI_OnLoad: JavaVM stored");
     
     // Initialize class and method references on load
     JNIEnv* env = nullptr;
     if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "JNI_OnLoad: Failed to get JNIEnv");
+        AGUS_LOGE("AgusGuiThread", "JNI_OnLoad: Failed to get JNIEnv");
         return JNI_VERSION_1_6;
     }
     
     jclass localClass = env->FindClass("app/agus/maps/agus_maps_flutter/UiThread");
     if (localClass == nullptr) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "JNI_OnLoad: Failed to find UiThread class");
+        AGUS_LOGE("AgusGuiThread", "JNI_OnLoad: Failed to find UiThread class");
         env->ExceptionClear();
         return JNI_VERSION_1_6;
     }
@@ -34,11 +38,14 @@ extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
     
     g_forwardMethod = env->GetStaticMethodID(g_uiThreadClass, "forwardToMainThread", "(J)V");
     if (g_forwardMethod == nullptr) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "JNI_OnLoad: Failed to find forwardToMainThread method");
+        AGUS_LOGE("AgusGuiThread", "JNI_OnLoad: Failed to find forwardToMainThread method");
         env->ExceptionClear();
     } else {
-        __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "JNI_OnLoad: UiThread class and method initialized");
+        AGUS_LOGD("AgusGuiThread", "JNI_OnLoad: UiThread class and method initialized");
     }
+
+    // HTTPS for the native downloader needs TlsSocket, resolvable only from here.
+    agus::InitTlsTransport(env);
     
     return JNI_VERSION_1_6;
 }
@@ -46,7 +53,7 @@ extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
 static JNIEnv* getJNIEnv() {
     JNIEnv* env = nullptr;
     if (g_javaVM == nullptr) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "JavaVM is null!");
+        AGUS_LOGE("AgusGuiThread", "JavaVM is null!");
         return nullptr;
     }
     
@@ -54,11 +61,11 @@ static JNIEnv* getJNIEnv() {
     if (result == JNI_EDETACHED) {
         // Thread not attached, attach it
         if (g_javaVM->AttachCurrentThread(&env, nullptr) != 0) {
-            __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "Failed to attach thread to JVM");
+            AGUS_LOGE("AgusGuiThread", "Failed to attach thread to JVM");
             return nullptr;
         }
     } else if (result != JNI_OK) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "Failed to get JNI env: %d", result);
+        AGUS_LOGE("AgusGuiThread", "Failed to get JNI env: %d", result);
         return nullptr;
     }
     return env;
@@ -68,16 +75,16 @@ namespace agus {
 
 AgusGuiThread::AgusGuiThread()
 {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "AgusGuiThread constructor");
+    AGUS_LOGD("AgusGuiThread", "AgusGuiThread constructor");
     
     // Use globally cached references
     m_class = g_uiThreadClass;
     m_method = g_forwardMethod;
     
     if (m_class == nullptr || m_method == nullptr) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "UiThread class/method not initialized - JNI_OnLoad may have failed");
+        AGUS_LOGE("AgusGuiThread", "UiThread class/method not initialized - JNI_OnLoad may have failed");
     } else {
-        __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "AgusGuiThread using cached JNI references");
+        AGUS_LOGD("AgusGuiThread", "AgusGuiThread using cached JNI references");
     }
 }
 
@@ -88,23 +95,37 @@ AgusGuiThread::~AgusGuiThread()
     m_method = nullptr;
 }
 
+namespace {
+// Tasks posted to the UI thread and not yet run.
+Gauge & QueueDepth() {
+    static auto & depth = GetGauge("gui.queue_depth");
+    return depth;
+}
+}  // namespace
+
 // static
 void AgusGuiThread::ProcessTask(jlong taskPointer)
 {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "ProcessTask: taskPointer=%ld", taskPointer);
+    AGUS_TRACE_SCOPE("gui", "ProcessTask");
+    AGUS_LOGD("AgusGuiThread", "ProcessTask: taskPointer=%ld", taskPointer);
+    static auto & taskTimes = GetHistogram("gui.task_us");
+    QueueDepth().Add(-1);
     std::unique_ptr<Task> task(reinterpret_cast<Task*>(taskPointer));
+    auto const start = std::chrono::steady_clock::now();
     (*task)();
+    taskTimes.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
 }
 
 base::TaskLoop::PushResult AgusGuiThread::Push(Task && task)
 {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "Push(&&) called");
+    AGUS_LOGD("AgusGuiThread", "Push(&&) called");
     
     std::lock_guard<std::mutex> lock(g_jniMutex);
     
     JNIEnv* env = getJNIEnv();
     if (env == nullptr || g_uiThreadClass == nullptr || g_forwardMethod == nullptr) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "Push failed - JNI not initialized, executing synchronously");
+        AGUS_LOGE("AgusGuiThread", "Push failed - JNI not initialized, executing synchronously");
         // Execute synchronously as fallback
         task();
         return {true, kNoId};
@@ -112,12 +133,15 @@ base::TaskLoop::PushResult AgusGuiThread::Push(Task && task)
 
     // Allocate task on heap - will be deleted in ProcessTask
     auto* taskPtr = new Task(std::move(task));
+    // Counted before posting: the UI thread may run it before the call returns
+    QueueDepth().Add(1);
     env->CallStaticVoidMethod(g_uiThreadClass, g_forwardMethod, reinterpret_cast<jlong>(taskPtr));
     
     // Check for exceptions
     if (env->ExceptionCheck()) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "JNI exception during Push");
+        AGUS_LOGE("AgusGuiThread", "JNI exception during Push");
         env->ExceptionClear();
+        QueueDepth().Add(-1);
         delete taskPtr;
         return {false, kNoId};
     }
@@ -127,13 +151,13 @@ base::TaskLoop::PushResult AgusGuiThread::Push(Task && task)
 
 base::TaskLoop::PushResult AgusGuiThread::Push(Task const & task)
 {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "Push(&) called");
+    AGUS_LOGD("AgusGuiThread", "Push(&) called");
     
     std::lock_guard<std::mutex> lock(g_jniMutex);
     
     JNIEnv* env = getJNIEnv();
     if (env == nullptr || g_uiThreadClass == nullptr || g_forwardMethod == nullptr) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "Push failed - JNI not initialized, executing synchronously");
+        AGUS_LOGE("AgusGuiThread", "Push failed - JNI not initialized, executing synchronously");
         // Execute synchronously as fallback
         task();
         return {true, kNoId};
@@ -141,12 +165,15 @@ base::TaskLoop::PushResult AgusGuiThread::Push(Task const & task)
 
     // Allocate task on heap - will be deleted in ProcessTask
     auto* taskPtr = new Task(task);
+    // Counted before posting: the UI thread may run it before the call returns
+    QueueDepth().Add(1);
     env->CallStaticVoidMethod(g_uiThreadClass, g_forwardMethod, reinterpret_cast<jlong>(taskPtr));
     
     // Check for exceptions
     if (env->ExceptionCheck()) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusGuiThread", "JNI exception during Push");
+        AGUS_LOGE("AgusGuiThread", "JNI exception during Push");
         env->ExceptionClear();
+        QueueDepth().Add(-1);
         delete taskPtr;
         return {false, kNoId};
     }
@@ -159,6 +186,6 @@ base::TaskLoop::PushResult AgusGuiThread::Push(Task const & task)
 // JNI callback from Java to execute the task
 extern "C" JNIEXPORT void JNICALL
 Java_app_agus_maps_agus_1maps_1flutter_UiThread_nativeProcessTask(JNIEnv* env, jclass clazz, jlong taskPointer) {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusGuiThread", "nativeProcessTask called: %ld", taskPointer);
+    AGUS_LOGD("AgusGuiThread", "nativeProcessTask called: %ld", taskPointer);
     agus::AgusGuiThread::ProcessTask(taskPointer);
 }
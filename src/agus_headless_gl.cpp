@@ -0,0 +1,205 @@
+#include "agus_headless_gl.hpp"
+
+#include "drape/gl_includes.hpp"
+
+#include "base/logging.hpp"
+
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace agus
+{
+namespace
+{
+EGLint const kConfigAttributes[] = {
+    EGL_RED_SIZE,        8,
+    EGL_GREEN_SIZE,      8,
+    EGL_BLUE_SIZE,       8,
+    EGL_ALPHA_SIZE,      0,
+    EGL_DEPTH_SIZE,      16,
+    EGL_STENCIL_SIZE,    0,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+    EGL_NONE,
+};
+
+// Drape's desktop GL path expects what the Qt desktop app asks for.
+EGLint const kContextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR,       3,
+    EGL_CONTEXT_MINOR_VERSION_KHR,       3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+    EGL_NONE,
+};
+
+bool HasClientExtension(char const * name)
+{
+  char const * extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  return extensions && strstr(extensions, name);
+}
+
+EGLDisplay OpenDisplay()
+{
+  if (HasClientExtension("EGL_MESA_platform_surfaceless"))
+  {
+    auto const getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay)
+    {
+      EGLDisplay const display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY)
+        return display;
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+}  // namespace
+
+HeadlessOGLContext::HeadlessOGLContext(EGLDisplay display, EGLSurface surface, EGLConfig config,
+                                       HeadlessOGLContext * contextToShareWith, FrameTimeListener listener)
+  : m_display(display)
+  , m_surface(surface)
+  , m_listener(std::move(listener))
+{
+  // The bound API is per thread, and Drape creates its contexts on the render threads.
+  eglBindAPI(EGL_OPENGL_API);
+  EGLContext const shared = contextToShareWith ? contextToShareWith->m_nativeContext : EGL_NO_CONTEXT;
+  m_nativeContext = eglCreateContext(m_display, config, shared, kContextAttributes);
+  if (m_nativeContext == EGL_NO_CONTEXT)
+    LOG(LERROR, ("eglCreateContext failed with error:", std::hex, eglGetError()));
+}
+
+HeadlessOGLContext::~HeadlessOGLContext()
+{
+  if (m_nativeContext != EGL_NO_CONTEXT)
+    eglDestroyContext(m_display, m_nativeContext);
+}
+
+void HeadlessOGLContext::MakeCurrent()
+{
+  eglBindAPI(EGL_OPENGL_API);
+  if (eglMakeCurrent(m_display, m_surface, m_surface, m_nativeContext) != EGL_TRUE)
+    LOG(LERROR, ("eglMakeCurrent failed with error:", std::hex, eglGetError()));
+}
+
+void HeadlessOGLContext::DoneCurrent()
+{
+  eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+bool HeadlessOGLContext::BeginRendering()
+{
+  m_frameStart = std::chrono::steady_clock::now();
+  return true;
+}
+
+void HeadlessOGLContext::Present()
+{
+  if (!m_presentAvailable)
+    return;
+  glFinish();
+  if (m_listener)
+  {
+    m_listener(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_frameStart)
+                   .count());
+  }
+}
+
+void HeadlessOGLContext::SetFramebuffer(ref_ptr<dp::BaseFramebuffer> framebuffer)
+{
+  if (framebuffer)
+    framebuffer->Bind();
+  else
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void HeadlessOGLContext::SetRenderingEnabled(bool enabled)
+{
+  if (enabled)
+    MakeCurrent();
+  else
+    DoneCurrent();
+}
+
+void HeadlessOGLContext::SetPresentAvailable(bool available)
+{
+  m_presentAvailable = available;
+}
+
+bool HeadlessOGLContext::Validate()
+{
+  return m_presentAvailable && eglGetCurrentContext() != EGL_NO_CONTEXT;
+}
+
+HeadlessOGLContextFactory::HeadlessOGLContextFactory(int width, int height, FrameTimeListener listener)
+  : m_listener(std::move(listener))
+{
+  m_display = OpenDisplay();
+  EGLint major = 0;
+  EGLint minor = 0;
+  if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, &major, &minor))
+  {
+    LOG(LERROR, ("No EGL display:", std::hex, eglGetError()));
+    m_display = EGL_NO_DISPLAY;
+    return;
+  }
+  LOG(LINFO, ("EGL", major, ".", minor, eglQueryString(m_display, EGL_VENDOR)));
+
+  EGLint count = 0;
+  if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(m_display, kConfigAttributes, &m_config, 1, &count) ||
+      count == 0)
+  {
+    LOG(LERROR, ("No desktop GL pbuffer config:", std::hex, eglGetError()));
+    return;
+  }
+
+  EGLint const drawAttributes[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+  EGLint const uploadAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  m_drawSurface = eglCreatePbufferSurface(m_display, m_config, drawAttributes);
+  m_uploadSurface = eglCreatePbufferSurface(m_display, m_config, uploadAttributes);
+  if (m_drawSurface == EGL_NO_SURFACE || m_uploadSurface == EGL_NO_SURFACE)
+    LOG(LERROR, ("eglCreatePbufferSurface failed with error:", std::hex, eglGetError()));
+}
+
+HeadlessOGLContextFactory::~HeadlessOGLContextFactory()
+{
+  delete m_drawContext;
+  delete m_uploadContext;
+  if (m_display == EGL_NO_DISPLAY)
+    return;
+  if (m_drawSurface != EGL_NO_SURFACE)
+    eglDestroySurface(m_display, m_drawSurface);
+  if (m_uploadSurface != EGL_NO_SURFACE)
+    eglDestroySurface(m_display, m_uploadSurface);
+  eglTerminate(m_display);
+}
+
+bool HeadlessOGLContextFactory::IsValid() const
+{
+  return m_drawSurface != EGL_NO_SURFACE && m_uploadSurface != EGL_NO_SURFACE;
+}
+
+dp::GraphicsContext * HeadlessOGLContextFactory::GetDrawContext()
+{
+  if (!m_drawContext)
+    m_drawContext = new HeadlessOGLContext(m_display, m_drawSurface, m_config, m_uploadContext, m_listener);
+  return m_drawContext;
+}
+
+dp::GraphicsContext * HeadlessOGLContextFactory::GetResourcesUploadContext()
+{
+  if (!m_uploadContext)
+    m_uploadContext = new HeadlessOGLContext(m_display, m_uploadSurface, m_config, m_drawContext, {});
+  return m_uploadContext;
+}
+
+void HeadlessOGLContextFactory::SetPresentAvailable(bool available)
+{
+  if (m_drawContext)
+    m_drawContext->SetPresentAvailable(available);
+}
+}  // namespace agus
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "drape/graphics_context_factory.hpp"
+#include "drape/oglcontext.hpp"
+
+#include <EGL/egl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace agus
+{
+/// Called on the render thread with the time from the start of a frame to the end
+/// of its Present, in microseconds.
+using FrameTimeListener = std::function<void(int64_t frameMicros)>;
+
+/// Desktop GL 3.3 core context on an EGL pbuffer, for rendering without a window
+/// (benchmarks on build machines, including Mesa's software rasterizer).
+class HeadlessOGLContext : public dp::OGLContext
+{
+public:
+  HeadlessOGLContext(EGLDisplay display, EGLSurface surface, EGLConfig config, HeadlessOGLContext * contextToShareWith,
+                     FrameTimeListener listener);
+  ~HeadlessOGLContext() override;
+
+  bool BeginRendering() override;
+  void MakeCurrent() override;
+  void DoneCurrent() override;
+  /// Waits for the frame to finish: a pbuffer swap doesn't, so frame times would
+  /// only count command submission.
+  void Present() override;
+  void SetFramebuffer(ref_ptr<dp::BaseFramebuffer> framebuffer) override;
+  void SetRenderingEnabled(bool enabled) override;
+  void SetPresentAvailable(bool available) override;
+  bool Validate() override;
+
+private:
+  EGLDisplay m_display;
+  EGLSurface m_surface;
+  EGLContext m_nativeContext = EGL_NO_CONTEXT;
+  std::atomic<bool> m_presentAvailable{true};
+  FrameTimeListener m_listener;
+  std::chrono::steady_clock::time_point m_frameStart;
+};
+
+/// Draw context on a |width| x |height| pbuffer, reporting its frames to |listener|,
+/// and upload context on a 1x1 one. Uses the surfaceless Mesa platform when the EGL client offers it, so no X or
+/// Wayland server is needed.
+class HeadlessOGLContextFactory : public dp::GraphicsContextFactory
+{
+public:
+  HeadlessOGLContextFactory(int width, int height, FrameTimeListener listener);
+  ~HeadlessOGLContextFactory() override;
+
+  /// False if EGL has no desktop GL pbuffer config; the reason is logged.
+  bool IsValid() const;
+
+  dp::GraphicsContext * GetDrawContext() override;
+  dp::GraphicsContext * GetResourcesUploadContext() override;
+  bool IsDrawContextCreated() const override { return m_drawContext != nullptr; }
+  bool IsUploadContextCreated() const override { return m_uploadContext != nullptr; }
+  void WaitForInitialization(dp::GraphicsContext *) override {}
+  void SetPresentAvailable(bool available) override;
+
+private:
+  EGLDisplay m_display = EGL_NO_DISPLAY;
+  EGLConfig m_config = nullptr;
+  EGLSurface m_drawSurface = EGL_NO_SURFACE;
+  EGLSurface m_uploadSurface = EGL_NO_SURFACE;
+  FrameTimeListener m_listener;
+  HeadlessOGLContext * m_drawContext = nullptr;
+  HeadlessOGLContext * m_uploadContext = nullptr;
+};
+}  // namespace agus
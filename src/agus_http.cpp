@@ -0,0 +1,639 @@
+#include "agus_http.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace http
+{
+namespace
+{
+size_t constexpr kReadBufferSize = 64 * 1024;
+size_t constexpr kMaxLineLength = 16 * 1024;
+auto constexpr kMaxIdleTime = std::chrono::seconds(30);
+
+std::mutex g_tlsMutex;
+StreamFactory g_tlsFactory;
+
+std::string ToLower(std::string s)
+{
+  std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+  return s;
+}
+
+std::string Trim(std::string const & s)
+{
+  size_t const b = s.find_first_not_of(" \t");
+  if (b == std::string::npos)
+    return {};
+  size_t const e = s.find_last_not_of(" \t");
+  return s.substr(b, e - b + 1);
+}
+
+class TcpStream : public Stream
+{
+public:
+  static std::unique_ptr<Stream> Open(Url const & url, int timeoutMs)
+  {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo * addrs = nullptr;
+    std::string const port = std::to_string(url.m_port);
+    if (getaddrinfo(url.m_host.c_str(), port.c_str(), &hints, &addrs) != 0 || !addrs)
+    {
+      LOG(LWARNING, ("Can't resolve", url.m_host));
+      return nullptr;
+    }
+
+    int fd = -1;
+    for (addrinfo * ai = addrs; ai && fd < 0; ai = ai->ai_next)
+    {
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0)
+        continue;
+      if (!Connect(fd, ai->ai_addr, ai->ai_addrlen, timeoutMs))
+      {
+        close(fd);
+        fd = -1;
+      }
+    }
+    freeaddrinfo(addrs);
+
+    if (fd < 0)
+    {
+      LOG(LWARNING, ("Can't connect to", url.m_host, url.m_port));
+      return nullptr;
+    }
+
+    timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return std::make_unique<TcpStream>(fd);
+  }
+
+  explicit TcpStream(int fd) : m_fd(fd) {}
+  ~TcpStream() override { close(m_fd); }
+
+  long Read(void * buffer, size_t size) override
+  {
+    while (true)
+    {
+      ssize_t const n = recv(m_fd, buffer, size, 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      return static_cast<long>(n);
+    }
+  }
+
+  bool WriteAll(void const * data, size_t size) override
+  {
+#ifdef MSG_NOSIGNAL
+    int constexpr kFlags = MSG_NOSIGNAL;
+#else
+    int constexpr kFlags = 0;
+#endif
+    auto const * p = static_cast<char const *>(data);
+    while (size > 0)
+    {
+      ssize_t const n = send(m_fd, p, size, kFlags);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+private:
+  static bool Connect(int fd, sockaddr const * addr, socklen_t len, int timeoutMs)
+  {
+    int const flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    bool ok = connect(fd, addr, len) == 0;
+    if (!ok && errno == EINPROGRESS)
+    {
+      pollfd pfd = {fd, POLLOUT, 0};
+      if (poll(&pfd, 1, timeoutMs) == 1)
+      {
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        ok = getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0;
+      }
+    }
+
+    fcntl(fd, F_SETFL, flags);
+    return ok;
+  }
+
+  int const m_fd;
+};
+
+std::string BuildRequestHead(Request const & request)
+{
+  std::string head = request.m_method + " " + request.m_url.m_path + " HTTP/1.1\r\n";
+  head += "Host: " + request.m_url.HostHeader() + "\r\n";
+  head += "Connection: keep-alive\r\n";
+  head += "Accept-Encoding: identity\r\n";
+
+  if (request.m_begRange >= 0)
+  {
+    head += "Range: bytes=" + std::to_string(request.m_begRange) + "-";
+    if (request.m_endRange >= 0)
+      head += std::to_string(request.m_endRange);
+    head += "\r\n";
+  }
+
+  bool hasUserAgent = false;
+  for (auto const & [key, value] : request.m_headers)
+  {
+    hasUserAgent = hasUserAgent || ToLower(key) == "user-agent";
+    head += key + ": " + value + "\r\n";
+  }
+  if (!hasUserAgent)
+    head += "User-Agent: AgusMaps\r\n";
+
+  if (!request.m_body.empty() || request.m_method == "POST" || request.m_method == "PUT")
+    head += "Content-Length: " + std::to_string(request.m_body.size()) + "\r\n";
+
+  head += "\r\n";
+  return head;
+}
+
+// Reads the status line and headers. Returns false if the connection produced nothing usable.
+bool ReadResponseHead(Connection & conn, Response & response, bool & keepAlive, bool & nonHttp)
+{
+  std::string line;
+  do
+  {
+    if (!conn.ReadLine(line))
+      return false;
+
+    // "HTTP/1.1 206 Partial Content"
+    if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12)
+    {
+      nonHttp = true;
+      return false;
+    }
+    keepAlive = line.compare(5, 3, "1.1") == 0;
+    response.m_status = std::atoi(line.c_str() + 9);
+    response.m_headers.clear();
+
+    while (true)
+    {
+      if (!conn.ReadLine(line))
+        return false;
+      if (line.empty())
+        break;
+      size_t const colon = line.find(':');
+      if (colon == std::string::npos)
+        continue;
+      response.m_headers[ToLower(Trim(line.substr(0, colon)))] = Trim(line.substr(colon + 1));
+    }
+  } while (response.m_status == 100);  // Skip interim "100 Continue".
+
+  auto const connection = response.m_headers.find("connection");
+  if (connection != response.m_headers.end())
+  {
+    std::string const value = ToLower(connection->second);
+    if (value.find("close") != std::string::npos)
+      keepAlive = false;
+    else if (value.find("keep-alive") != std::string::npos)
+      keepAlive = true;
+  }
+
+  auto const length = response.m_headers.find("content-length");
+  response.m_contentLength = length != response.m_headers.end() ? std::atoll(length->second.c_str()) : -1;
+
+  response.m_rangeBegin = 0;
+  auto const range = response.m_headers.find("content-range");
+  if (response.m_status == 206 && range != response.m_headers.end())
+  {
+    // "bytes 100-199/1000"
+    size_t const space = range->second.find(' ');
+    if (space != std::string::npos)
+      response.m_rangeBegin = std::atoll(range->second.c_str() + space + 1);
+  }
+  return true;
+}
+
+enum class BodyResult
+{
+  Complete,
+  Aborted,
+  Cancelled,
+  IOError,
+};
+
+BodyResult ReadBody(Connection & conn, Request const & request, Response const & response, bool & keepAlive,
+                    BodyFn const & onBody, std::atomic<bool> const * cancelled)
+{
+  if (request.m_method == "HEAD" || response.m_status == 204 || response.m_status == 304)
+    return BodyResult::Complete;
+
+  std::vector<char> buffer(kReadBufferSize);
+  auto const pump = [&](int64_t remaining) -> BodyResult {
+    // remaining < 0 means "until the server closes the connection".
+    while (remaining != 0)
+    {
+      if (cancelled && cancelled->load())
+        return BodyResult::Cancelled;
+      size_t const want = remaining < 0 ? buffer.size() : static_cast<size_t>(std::min<int64_t>(remaining, buffer.size()));
+      long const n = conn.Read(buffer.data(), want);
+      if (n == 0 && remaining < 0)
+        return BodyResult::Complete;
+      if (n <= 0)
+        return BodyResult::IOError;
+      if (!onBody(buffer.data(), static_cast<size_t>(n)))
+        return BodyResult::Aborted;
+      if (remaining > 0)
+        remaining -= n;
+    }
+    return BodyResult::Complete;
+  };
+
+  auto const te = response.m_headers.find("transfer-encoding");
+  if (te != response.m_headers.end() && ToLower(te->second).find("chunked") != std::string::npos)
+  {
+    std::string line;
+    while (true)
+    {
+      if (!conn.ReadLine(line))
+        return BodyResult::IOError;
+      int64_t const chunk = std::strtoll(line.c_str(), nullptr, 16);
+      if (chunk < 0)
+        return BodyResult::IOError;
+      if (chunk == 0)
+        break;
+      if (auto const r = pump(chunk); r != BodyResult::Complete)
+        return r;
+      if (!conn.ReadLine(line))  // CRLF after chunk data
+        return BodyResult::IOError;
+    }
+    // Trailers up to the terminating empty line.
+    do
+    {
+      if (!conn.ReadLine(line))
+        return BodyResult::IOError;
+    } while (!line.empty());
+    return BodyResult::Complete;
+  }
+
+  if (response.m_contentLength >= 0)
+    return pump(response.m_contentLength);
+
+  keepAlive = false;
+  return pump(-1);
+}
+
+std::string ResolveLocation(Url const & base, std::string const & location)
+{
+  if (location.find("://") != std::string::npos)
+    return location;
+  std::string const prefix = (base.m_tls ? "https://" : "http://") + base.HostHeader();
+  if (!location.empty() && location.front() == '/')
+    return prefix + location;
+  std::string dir = base.m_path.substr(0, base.m_path.find('?'));
+  dir = dir.substr(0, dir.rfind('/') + 1);
+  return prefix + dir + location;
+}
+}  // namespace
+
+// --- Url ---
+
+std::optional<Url> Url::Parse(std::string const & url)
+{
+  Url result;
+  size_t pos = url.find("://");
+  if (pos == std::string::npos)
+    return std::nullopt;
+
+  std::string const scheme = ToLower(url.substr(0, pos));
+  if (scheme == "https")
+  {
+    result.m_tls = true;
+    result.m_port = 443;
+  }
+  else if (scheme != "http")
+  {
+    return std::nullopt;
+  }
+
+  pos += 3;
+  size_t const pathBegin = url.find_first_of("/?", pos);
+  std::string authority = url.substr(pos, pathBegin == std::string::npos ? std::string::npos : pathBegin - pos);
+  if (size_t const at = authority.rfind('@'); at != std::string::npos)
+    authority = authority.substr(at + 1);
+
+  size_t const colon = authority.rfind(':');
+  if (colon != std::string::npos && authority.find(']', colon) == std::string::npos)
+  {
+    int const port = std::atoi(authority.c_str() + colon + 1);
+    if (port <= 0 || port > 65535)
+      return std::nullopt;
+    result.m_port = static_cast<uint16_t>(port);
+    authority.resize(colon);
+  }
+  if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']')
+    authority = authority.substr(1, authority.size() - 2);
+  if (authority.empty())
+    return std::nullopt;
+  result.m_host = authority;
+
+  if (pathBegin != std::string::npos)
+  {
+    result.m_path = url.substr(pathBegin);
+    if (result.m_path.front() == '?')
+      result.m_path.insert(result.m_path.begin(), '/');
+  }
+  return result;
+}
+
+std::string Url::PoolKey() const
+{
+  return (m_tls ? "https://" : "http://") + m_host + ":" + std::to_string(m_port);
+}
+
+std::string Url::HostHeader() const
+{
+  std::string const host = m_host.find(':') != std::string::npos ? "[" + m_host + "]" : m_host;
+  if ((m_tls && m_port == 443) || (!m_tls && m_port == 80))
+    return host;
+  return host + ":" + std::to_string(m_port);
+}
+
+void SetTlsStreamFactory(StreamFactory factory)
+{
+  std::lock_guard<std::mutex> lock(g_tlsMutex);
+  g_tlsFactory = std::move(factory);
+}
+
+// --- Connection ---
+
+Connection::Connection(std::string poolKey, std::unique_ptr<Stream> stream)
+  : m_poolKey(std::move(poolKey))
+  , m_stream(std::move(stream))
+  , m_buffer(kReadBufferSize)
+{}
+
+bool Connection::Fill()
+{
+  if (m_begin == m_end)
+    m_begin = m_end = 0;
+  if (m_end == m_buffer.size())
+  {
+    if (m_begin == 0)
+      return false;
+    std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+    m_end -= m_begin;
+    m_begin = 0;
+  }
+  long const n = m_stream->Read(m_buffer.data() + m_end, m_buffer.size() - m_end);
+  if (n <= 0)
+    return false;
+  m_end += static_cast<size_t>(n);
+  return true;
+}
+
+bool Connection::ReadLine(std::string & line)
+{
+  size_t scanned = m_begin;
+  while (true)
+  {
+    auto const * begin = m_buffer.data() + scanned;
+    auto const * nl = static_cast<char const *>(std::memchr(begin, '\n', m_end - scanned));
+    if (nl)
+    {
+      size_t const end = static_cast<size_t>(nl - m_buffer.data());
+      line.assign(m_buffer.data() + m_begin, end - m_begin);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      m_begin = end + 1;
+      return true;
+    }
+    if (m_end - m_begin > kMaxLineLength)
+      return false;
+    size_t const offset = m_end - m_begin;
+    if (!Fill())
+      return false;
+    scanned = m_begin + offset;
+  }
+}
+
+long Connection::Read(void * buffer, size_t size)
+{
+  if (m_begin < m_end)
+  {
+    size_t const n = std::min(size, m_end - m_begin);
+    std::memcpy(buffer, m_buffer.data() + m_begin, n);
+    m_begin += n;
+    return static_cast<long>(n);
+  }
+  // Large reads bypass the connection buffer.
+  return m_stream->Read(buffer, size);
+}
+
+// --- ConnectionPool ---
+
+std::unique_ptr<Connection> ConnectionPool::Acquire(Url const & url, int timeoutMs)
+{
+  std::string const key = url.PoolKey();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto const now = std::chrono::steady_clock::now();
+    m_idle.erase(std::remove_if(m_idle.begin(), m_idle.end(),
+                                [now](auto const & conn) { return now - conn->m_idleSince > kMaxIdleTime; }),
+                 m_idle.end());
+
+    for (auto it = m_idle.rbegin(); it != m_idle.rend(); ++it)
+    {
+      if ((*it)->PoolKey() != key)
+        continue;
+      std::unique_ptr<Connection> conn = std::move(*it);
+      m_idle.erase(std::next(it).base());
+      ++m_stats.m_reused;
+      return conn;
+    }
+  }
+
+  std::unique_ptr<Stream> stream;
+  if (url.m_tls)
+  {
+    StreamFactory factory;
+    {
+      std::lock_guard<std::mutex> lock(g_tlsMutex);
+      factory = g_tlsFactory;
+    }
+    if (!factory)
+    {
+      LOG(LWARNING, ("No TLS transport registered for", key));
+      return nullptr;
+    }
+    stream = factory(url, timeoutMs);
+  }
+  else
+  {
+    stream = TcpStream::Open(url, timeoutMs);
+  }
+
+  if (!stream)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_stats.m_opened;
+  return std::make_unique<Connection>(key, std::move(stream));
+}
+
+void ConnectionPool::Release(std::unique_ptr<Connection> connection)
+{
+  connection->m_reused = true;
+  connection->m_idleSince = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_idle.push_back(std::move(connection));
+  if (m_idle.size() > m_maxIdle)
+    m_idle.erase(m_idle.begin());
+}
+
+void ConnectionPool::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_idle.clear();
+}
+
+ConnectionPool::Stats ConnectionPool::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats stats = m_stats;
+  stats.m_idle = m_idle.size();
+  return stats;
+}
+
+ConnectionPool & GetConnectionPool()
+{
+  static ConnectionPool pool(8 /* maxIdle */);
+  return pool;
+}
+
+// --- Perform ---
+
+int Perform(Request request, BodyFn const & onBody, Response & response, std::atomic<bool> const * cancelled)
+{
+  auto & pool = GetConnectionPool();
+
+  for (int redirect = 0;; ++redirect)
+  {
+    std::unique_ptr<Connection> conn;
+    bool keepAlive = false;
+
+    // A pooled connection may have been closed by the server while idle;
+    // retry once on a fresh one if nothing was received.
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+      conn = pool.Acquire(request.m_url, request.m_timeoutMs);
+      if (!conn)
+        return kIOError;
+
+      bool const reused = conn->m_reused;
+      bool nonHttp = false;
+      bool ok = conn->WriteAll(BuildRequestHead(request));
+      if (ok && !request.m_body.empty())
+        ok = conn->WriteAll(request.m_body);
+      if (ok)
+        ok = ReadResponseHead(*conn, response, keepAlive, nonHttp);
+
+      if (ok)
+        break;
+      conn.reset();
+      if (nonHttp)
+        return kNonHttpResponse;
+      if (!reused)
+        return kIOError;
+    }
+    if (!conn)
+      return kIOError;
+
+    response.m_finalUrl = (request.m_url.m_tls ? "https://" : "http://") + request.m_url.HostHeader() + request.m_url.m_path;
+
+    bool const isRedirect = response.m_status == 301 || response.m_status == 302 || response.m_status == 303 ||
+                            response.m_status == 307 || response.m_status == 308;
+    auto const location = response.m_headers.find("location");
+    if (isRedirect && location != response.m_headers.end() && redirect < request.m_maxRedirects)
+    {
+      auto const target = Url::Parse(ResolveLocation(request.m_url, location->second));
+      if (!target)
+        return kInvalidUrl;
+      // Never follow https to plain http: the request, cookies included, would go out in clear.
+      if (request.m_url.m_tls && !target->m_tls)
+      {
+        LOG(LWARNING, ("Refusing redirect from", response.m_finalUrl, "to insecure", location->second));
+        return kInvalidUrl;
+      }
+
+      // Redirect bodies are tiny; drain them so the connection stays reusable.
+      if (ReadBody(*conn, request, response, keepAlive, [](void const *, size_t) { return true; }, cancelled) ==
+              BodyResult::Complete &&
+          keepAlive)
+      {
+        pool.Release(std::move(conn));
+      }
+
+      request.m_url = *target;
+      // 303 always continues as a GET; so do 301 and 302 after a POST, as browsers and curl
+      // do, rather than sending the body to wherever the server points.
+      bool const switchToGet = response.m_status == 303 ||
+                               ((response.m_status == 301 || response.m_status == 302) && request.m_method == "POST");
+      if (switchToGet)
+      {
+        request.m_method = "GET";
+        request.m_body.clear();
+        auto & headers = request.m_headers;
+        headers.erase(std::remove_if(headers.begin(), headers.end(), [](auto const & header)
+        {
+          std::string const key = ToLower(header.first);
+          return key == "content-type" || key == "content-encoding";
+        }), headers.end());
+      }
+      continue;
+    }
+
+    switch (ReadBody(*conn, request, response, keepAlive, onBody, cancelled))
+    {
+    case BodyResult::Complete:
+      if (keepAlive)
+        pool.Release(std::move(conn));
+      return response.m_status;
+    case BodyResult::Aborted: return kWriteError;
+    case BodyResult::Cancelled: return kCancelled;
+    case BodyResult::IOError: return kIOError;
+    }
+    return kIOError;
+  }
+}
+}  // namespace http
+}  // namespace agus
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace agus
+{
+namespace http
+{
+/// Error codes passed instead of an HTTP status, matching CoMaps' ChunkTask.
+int constexpr kInconsistentFileSize = -1;
+int constexpr kNonHttpResponse = -2;
+int constexpr kInvalidUrl = -3;
+int constexpr kIOError = -4;
+int constexpr kWriteError = -5;
+int constexpr kCancelled = -6;
+
+struct Url
+{
+  static std::optional<Url> Parse(std::string const & url);
+
+  /// "host:port" with the scheme prefix, used as the connection pool key.
+  std::string PoolKey() const;
+  /// Value of the Host header (port omitted when it is the default one).
+  std::string HostHeader() const;
+
+  std::string m_host;
+  std::string m_path = "/";
+  uint16_t m_port = 80;
+  bool m_tls = false;
+};
+
+/// Bidirectional byte stream under an HTTP connection.
+class Stream
+{
+public:
+  virtual ~Stream() = default;
+  /// Returns bytes read, 0 on orderly close, negative on error or timeout.
+  virtual long Read(void * buffer, size_t size) = 0;
+  virtual bool WriteAll(void const * data, size_t size) = 0;
+};
+
+using StreamFactory = std::function<std::unique_ptr<Stream>(Url const & url, int timeoutMs)>;
+
+/// Plain TCP is built in; TLS is supplied by the platform layer (see agus_tls_android.cpp).
+void SetTlsStreamFactory(StreamFactory factory);
+
+/// Persistent HTTP/1.1 connection with its own read buffer.
+class Connection
+{
+public:
+  Connection(std::string poolKey, std::unique_ptr<Stream> stream);
+
+  std::string const & PoolKey() const { return m_poolKey; }
+  bool WriteAll(std::string const & data) { return m_stream->WriteAll(data.data(), data.size()); }
+  /// Reads one CRLF-terminated line without the terminator.
+  bool ReadLine(std::string & line);
+  /// Reads up to |size| bytes, serving buffered bytes first.
+  long Read(void * buffer, size_t size);
+
+  /// True once a request was completed on this connection.
+  bool m_reused = false;
+  std::chrono::steady_clock::time_point m_idleSince;
+
+private:
+  bool Fill();
+
+  std::string const m_poolKey;
+  std::unique_ptr<Stream> m_stream;
+  std::vector<char> m_buffer;
+  size_t m_begin = 0;
+  size_t m_end = 0;
+};
+
+/// Keep-alive pool. Idle connections are kept per host:port, bounded in total.
+class ConnectionPool
+{
+public:
+  struct Stats
+  {
+    uint64_t m_opened = 0;
+    uint64_t m_reused = 0;
+    uint64_t m_idle = 0;
+  };
+
+  explicit ConnectionPool(size_t maxIdle) : m_maxIdle(maxIdle) {}
+
+  /// Returns an idle connection to |url|'s host, or opens a new one.
+  std::unique_ptr<Connection> Acquire(Url const & url, int timeoutMs);
+  /// Hands a connection whose last response was read completely back to the pool.
+  void Release(std::unique_ptr<Connection> connection);
+  void Clear();
+
+  Stats GetStats() const;
+
+private:
+  size_t const m_maxIdle;
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<Connection>> m_idle;
+  Stats m_stats;
+};
+
+ConnectionPool & GetConnectionPool();
+
+struct Request
+{
+  std::string m_method = "GET";
+  Url m_url;
+  std::vector<std::pair<std::string, std::string>> m_headers;
+  std::string m_body;
+  /// Byte range [m_begRange, m_endRange], inclusive. Negative m_begRange disables it,
+  /// negative m_endRange requests everything from m_begRange on.
+  int64_t m_begRange = -1;
+  int64_t m_endRange = -1;
+  int m_timeoutMs = 30000;
+  int m_maxRedirects = 5;
+};
+
+struct Response
+{
+  int m_status = 0;
+  /// -1 if the server did not send Content-Length.
+  int64_t m_contentLength = -1;
+  /// First byte of the body within the resource; non-zero only for 206 responses.
+  int64_t m_rangeBegin = 0;
+  std::string m_finalUrl;
+  /// Header names are lower-cased.
+  std::unordered_map<std::string, std::string> m_headers;
+};
+
+/// Receives body bytes as they arrive; return false to abort the transfer.
+using BodyFn = std::function<bool(void const * data, size_t size)>;
+
+/// Performs |request| on a pooled connection, following redirects, except from https to
+/// http (kInvalidUrl). A 303, or a 301/302 answering a POST, continues as a bodiless GET.
+/// Returns the final HTTP status, or one of the negative error codes above.
+/// |cancelled| is polled between reads and may be null.
+int Perform(Request request, BodyFn const & onBody, Response & response,
+            std::atomic<bool> const * cancelled = nullptr);
+}  // namespace http
+}  // namespace agus
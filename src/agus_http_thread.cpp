@@ -0,0 +1,287 @@
+// CoMaps downloader hooks backed by agus_http.
+//
+// HttpRequest (platform/http_request.cpp) drives segmented, resumable downloads
+// through ChunksDownloadStrategy and asks the platform for one HttpThread per
+// byte range. Each HttpThread here streams its range on a worker thread over a
+// pooled keep-alive connection. The bytes go to the callback on one shared disk
+// writer thread: FileHttpRequest::OnWrite seeks and writes through a single
+// FileWriter and expects every call on the same thread. Only OnFinish runs on
+// the GUI thread.
+
+#include "agus_http.hpp"
+#include "agus_threads.hpp"
+
+#include "platform/http_client.hpp"
+#include "platform/http_thread_callback.hpp"
+#include "platform/platform.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <thread>
+
+class HttpThread
+{
+public:
+  HttpThread(std::string const & url, downloader::IHttpThreadCallback & callback, int64_t begRange,
+             int64_t endRange, int64_t expectedSize, std::string const & postBody)
+    : m_state(std::make_shared<State>())
+  {
+    m_state->m_callback = &callback;
+    std::thread(&HttpThread::Run, m_state, url, begRange, endRange, expectedSize, postBody).detach();
+  }
+
+  /// Does not wait for the worker: it notices the flag on its next read and
+  /// the tasks it already posted become no-ops. Waits for a write in progress,
+  /// the callback is destroyed right after.
+  ~HttpThread()
+  {
+    std::lock_guard<std::mutex> writeLock(m_state->m_writeMutex);
+    std::lock_guard<std::mutex> lock(m_state->m_mutex);
+    m_state->m_cancelled = true;
+    m_state->m_callback = nullptr;
+    m_state->m_cv.notify_all();
+  }
+
+private:
+  /// Bytes posted to the writer thread but not yet written; bounds memory when the
+  /// network outpaces the disk.
+  static size_t constexpr kMaxInFlightBytes = 4 * 1024 * 1024;
+
+  struct State
+  {
+    std::atomic<bool> m_cancelled{false};
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    size_t m_inFlight = 0;
+    bool m_writeFailed = false;
+    /// Held by the writer thread while it calls OnWrite.
+    std::mutex m_writeMutex;
+    /// Used on the writer thread under m_writeMutex and on the GUI thread,
+    /// reset by the destructor (on the GUI thread).
+    downloader::IHttpThreadCallback * m_callback = nullptr;
+  };
+
+  /// Shared by every download so that all writes land on one thread, in the order
+  /// they were posted. Never destroyed: detached workers may still post to it at exit.
+  static base::TaskLoop & Writer()
+  {
+    static auto * writer = new agus::InstrumentedThreadPool("http_write", 1 /* threads */);
+    return *writer;
+  }
+
+  static void Run(std::shared_ptr<State> state, std::string url, int64_t begRange, int64_t endRange,
+                  int64_t expectedSize, std::string postBody)
+  {
+    int const code = Download(state, url, begRange, endRange, expectedSize, std::move(postBody));
+    GetPlatform().RunTask(Platform::Thread::Gui, [state, code, begRange, endRange]()
+    {
+      if (state->m_cancelled || state->m_callback == nullptr)
+        return;
+      state->m_callback->OnFinish(code, begRange, endRange);
+    });
+  }
+
+  static int Download(std::shared_ptr<State> const & state, std::string const & url, int64_t begRange,
+                      int64_t endRange, int64_t expectedSize, std::string postBody)
+  {
+    namespace http = agus::http;
+
+    auto parsed = http::Url::Parse(url);
+    if (!parsed)
+      return http::kInvalidUrl;
+
+    http::Request request;
+    request.m_url = std::move(*parsed);
+    if (!postBody.empty())
+    {
+      request.m_method = "POST";
+      request.m_body = std::move(postBody);
+      request.m_headers.emplace_back("Content-Type", "application/json");
+    }
+    if (begRange > 0 || endRange >= 0)
+    {
+      request.m_begRange = std::max<int64_t>(begRange, 0);
+      request.m_endRange = endRange;
+    }
+
+    http::Response response;
+    int64_t offset = std::max<int64_t>(begRange, 0);
+    int64_t toSkip = -1;
+    bool inconsistentSize = false;
+    bool segmentComplete = false;
+
+    auto const onBody = [&](void const * data, size_t size) -> bool
+    {
+      if (response.m_status < 200 || response.m_status >= 300)
+        return true;  // Drain the error body so the connection can be reused.
+
+      if (toSkip < 0)
+      {
+        // The server ignored Range: drop the bytes before our segment.
+        toSkip = (response.m_status == 200 && request.m_begRange > 0) ? request.m_begRange : 0;
+        if (response.m_status == 200 && request.m_begRange <= 0 && expectedSize > 0 &&
+            response.m_contentLength >= 0 && response.m_contentLength != expectedSize)
+        {
+          inconsistentSize = true;
+          return false;
+        }
+      }
+
+      auto const * bytes = static_cast<char const *>(data);
+      if (toSkip > 0)
+      {
+        auto const skipped = static_cast<size_t>(std::min<int64_t>(toSkip, static_cast<int64_t>(size)));
+        toSkip -= static_cast<int64_t>(skipped);
+        bytes += skipped;
+        size -= skipped;
+      }
+      if (size == 0)
+        return true;
+      // Stay within the requested segment when a 200 carries the whole file,
+      // and stop reading once it is complete.
+      if (endRange >= 0 && offset + static_cast<int64_t>(size) >= endRange + 1)
+      {
+        size = static_cast<size_t>(std::max<int64_t>(endRange + 1 - offset, 0));
+        segmentComplete = true;
+      }
+      if (size == 0)
+        return !segmentComplete;
+
+      {
+        std::unique_lock<std::mutex> lock(state->m_mutex);
+        state->m_cv.wait(lock, [&]() { return state->m_inFlight < kMaxInFlightBytes || state->m_cancelled; });
+        if (state->m_cancelled || state->m_writeFailed)
+          return false;
+        state->m_inFlight += size;
+      }
+
+      auto chunk = std::make_shared<std::vector<char>>(bytes, bytes + size);
+      Writer().Push([state, chunk, offset]()
+      {
+        bool ok = true;
+        {
+          std::lock_guard<std::mutex> writeLock(state->m_writeMutex);
+          if (!state->m_cancelled && state->m_callback != nullptr)
+            ok = state->m_callback->OnWrite(offset, chunk->data(), chunk->size());
+        }
+        std::lock_guard<std::mutex> lock(state->m_mutex);
+        state->m_inFlight -= chunk->size();
+        state->m_writeFailed = state->m_writeFailed || !ok;
+        state->m_cv.notify_all();
+      });
+      offset += static_cast<int64_t>(size);
+      return !segmentComplete || response.m_status != 200;
+    };
+
+    int code = http::Perform(std::move(request), onBody, response, &state->m_cancelled);
+    if (inconsistentSize)
+      return http::kInconsistentFileSize;
+    if (segmentComplete && response.m_status == 200)
+      code = 200;
+
+    // OnFinish may close the file, so every write of this range must be done
+    // before it is posted; a failed one becomes the result.
+    std::unique_lock<std::mutex> lock(state->m_mutex);
+    state->m_cv.wait(lock, [&]() { return state->m_inFlight == 0 || state->m_cancelled; });
+    if (state->m_writeFailed)
+      code = http::kWriteError;
+    if (code == 200 || code == 206)
+      LOG(LDEBUG, ("Downloaded", url, "range", begRange, endRange));
+    return code;
+  }
+
+  std::shared_ptr<State> m_state;
+};
+
+namespace downloader
+{
+__attribute__((visibility("default"))) ::HttpThread * CreateNativeHttpThread(
+    std::string const & url, IHttpThreadCallback & callback, int64_t begRange, int64_t endRange,
+    int64_t expectedSize, std::string const & postBody)
+{
+  return new ::HttpThread(url, callback, begRange, endRange, expectedSize, postBody);
+}
+
+__attribute__((visibility("default"))) void DeleteNativeHttpThread(::HttpThread * thread)
+{
+  delete thread;
+}
+}  // namespace downloader
+
+namespace platform
+{
+__attribute__((visibility("default"))) bool HttpClient::RunHttpRequest()
+{
+  namespace http = agus::http;
+
+  auto url = http::Url::Parse(m_urlRequested);
+  if (!url)
+  {
+    LOG(LWARNING, ("Unsupported URL", m_urlRequested));
+    m_errorCode = http::kInvalidUrl;
+    return false;
+  }
+
+  http::Request request;
+  request.m_method = m_httpMethod;
+  request.m_url = std::move(*url);
+  request.m_timeoutMs = static_cast<int>(m_timeoutSec * 1000);
+  request.m_maxRedirects = m_handleRedirects ? 5 : 0;
+  for (auto const & [name, value] : m_headers)
+    request.m_headers.emplace_back(name, value);
+
+  if (!m_inputFile.empty())
+  {
+    std::ifstream in(m_inputFile, std::ios::binary);
+    if (!in)
+    {
+      m_errorCode = http::kIOError;
+      return false;
+    }
+    request.m_body.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  else
+  {
+    request.m_body = m_bodyData;
+  }
+
+  std::ofstream out;
+  if (!m_outputFile.empty())
+  {
+    out.open(m_outputFile, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      m_errorCode = http::kWriteError;
+      return false;
+    }
+  }
+
+  m_serverResponse.clear();
+  http::Response response;
+  int const code = http::Perform(std::move(request), [&](void const * data, size_t size)
+  {
+    if (out.is_open())
+      return static_cast<bool>(out.write(static_cast<char const *>(data), static_cast<std::streamsize>(size)));
+    m_serverResponse.append(static_cast<char const *>(data), size);
+    return true;
+  }, response);
+
+  m_errorCode = code;
+  if (code < 0)
+    return false;
+
+  m_urlReceived = response.m_finalUrl;
+  if (m_loadHeaders)
+  {
+    m_headers.clear();
+    for (auto const & [name, value] : response.m_headers)
+      m_headers.emplace(name, value);
+  }
+  return true;
+}
+}  // namespace platform
@@ -0,0 +1,434 @@
+#include "agus_lazy_maps.hpp"
+
+#include "agus_mwm_snapshot.hpp"
+#include "agus_trace.hpp"
+
+#include "map/framework.hpp"
+#include "map/search_hooks.hpp"
+
+#include "routing/routing_callbacks.hpp"
+
+#include "search/search_params.hpp"
+
+#include "indexer/data_header.hpp"
+#include "indexer/scales.hpp"
+
+#include "storage/storage.hpp"
+#include "storage/storage_defines.hpp"
+
+#include "platform/local_country_file.hpp"
+#include "platform/mwm_version.hpp"
+#include "platform/platform.hpp"
+
+#include "coding/files_container.hpp"
+
+#include "geometry/mercator.hpp"
+#include "geometry/screenbase.hpp"
+
+#include "base/logging.hpp"
+
+#include "defines.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace agus
+{
+namespace
+{
+std::mutex g_mutex;
+std::vector<LazyMapInfo> g_pending;
+/// The newest viewport waiting for background registration; guarded by g_mutex.
+m2::RectD g_queuedRect;
+bool g_queued = false;
+/// Held while a batch is taken and registered, so ForgetLazyMap waits for a batch in flight
+/// instead of missing a map that is about to be registered.
+std::mutex g_registerMutex;
+/// Guards the registration snapshot, which is only touched here.
+std::mutex g_snapshotMutex;
+LazyMapRegisteredFn g_onRegistered;
+/// Framework of the search hook; both only touched on the GUI thread, which starts searches.
+Framework * g_searchFramework = nullptr;
+bool g_searchHookAdded = false;
+
+/// Removes and returns the pending maps matching |pred|.
+template <typename Pred>
+std::vector<LazyMapInfo> TakePending(Pred && pred)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto const it = std::stable_partition(g_pending.begin(), g_pending.end(),
+                                        [&pred](LazyMapInfo const & info) { return !pred(info); });
+  std::vector<LazyMapInfo> taken(std::make_move_iterator(it), std::make_move_iterator(g_pending.end()));
+  g_pending.erase(it, g_pending.end());
+  return taken;
+}
+
+/// Registers |pred|'s pending maps and re-renders their area. Runs on the calling thread.
+template <typename Pred>
+size_t RegisterPending(Framework & framework, Pred && pred)
+{
+  std::lock_guard<std::mutex> registerLock(g_registerMutex);
+  size_t registered = 0;
+  m2::RectD invalidated;
+  for (auto const & info : TakePending(std::forward<Pred>(pred)))
+  {
+    auto const temporary = platform::LocalCountryFile::MakeTemporary(info.m_path);
+    platform::LocalCountryFile file(temporary.GetDirectory(), temporary.GetCountryFile(), info.m_version);
+    try
+    {
+      file.SyncWithDisk();
+      auto const result = framework.RegisterMap(file);
+      if (result.second != MwmSet::RegResult::Success)
+      {
+        LOG(LWARNING, ("Lazy registration of", info.m_path, "failed:", result.second));
+        continue;
+      }
+      ++registered;
+      invalidated.Add(info.m_rect);
+      if (g_onRegistered)
+        g_onRegistered(result.first);
+    }
+    catch (RootException const & e)
+    {
+      LOG(LWARNING, ("Lazy registration of", info.m_path, "failed:", e.Msg()));
+    }
+  }
+
+  // Tiles of the area were read without these maps.
+  if (registered > 0)
+  {
+    framework.InvalidateRect(invalidated);
+    LOG(LINFO, ("Registered", registered, "maps on first use,", GetPendingLazyMapsCount(), "still pending"));
+  }
+  return registered;
+}
+
+/// Records |infos| as pending; a newer version of a pending country replaces it.
+/// Returns the number recorded.
+size_t AddPending(std::vector<LazyMapInfo> infos)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  for (auto & info : infos)
+  {
+    auto const it = std::find_if(g_pending.begin(), g_pending.end(), [&info](LazyMapInfo const & pending)
+    {
+      return pending.m_countryName == info.m_countryName;
+    });
+    if (it == g_pending.end())
+      g_pending.push_back(std::move(info));
+    else if (it->m_version <= info.m_version)
+      *it = std::move(info);
+  }
+  return infos.size();
+}
+
+bool IsWorldMap(std::string const & countryName)
+{
+  return countryName == WORLD_FILE_NAME || countryName == WORLD_COASTS_FILE_NAME;
+}
+
+/// What Framework::RegisterAllMaps does once the maps are in: the search loads city
+/// boundaries and caches the localities of the world maps, which it can't do lazily.
+void PrepareWorldSearch(Framework & framework)
+{
+  auto & searchAPI = framework.GetSearchAPI();
+  searchAPI.LoadCitiesBoundaries();
+  searchAPI.CacheWorldLocalities();
+}
+
+/// Registers |files| now, except maps other than the world ones that the registration
+/// snapshot has unchanged: those are recorded for lazy registration without opening them.
+/// Maps registered now are added to the snapshot, so the next launch puts them off.
+LazyBatchStats RegisterWithSnapshot(Framework & framework, std::vector<platform::LocalCountryFile> & files,
+                                    bool useSnapshot)
+{
+  auto const start = std::chrono::steady_clock::now();
+  LazyBatchStats stats;
+  std::vector<LazyMapInfo> deferred;
+  bool worldRegistered = false;
+  {
+    std::lock_guard<std::mutex> lock(g_snapshotMutex);
+    auto & snapshot = GetRegistrationSnapshot();
+    for (auto & file : files)
+    {
+      auto const path = file.GetPath(MapFileType::Map);
+      bool const world = IsWorldMap(file.GetCountryName());
+      if (useSnapshot && !world)
+      {
+        if (auto info = snapshot.FindUnchanged(path))
+        {
+          deferred.push_back(std::move(*info));
+          ++stats.m_fromSnapshot;
+          continue;
+        }
+      }
+
+      try
+      {
+        // Files found by the storage scan are already synced.
+        if (!file.OnDisk(MapFileType::Map))
+          file.SyncWithDisk();
+        auto const result = framework.RegisterMap(file);
+        if (result.second != MwmSet::RegResult::Success)
+        {
+          LOG(LWARNING, ("Registration of", path, "failed:", result.second));
+          ++stats.m_failed;
+          continue;
+        }
+        ++stats.m_registered;
+        if (world)
+        {
+          worldRegistered = true;
+          continue;
+        }
+        auto const & mwmInfo = *result.first.GetInfo();
+        LazyMapInfo info;
+        info.m_path = path;
+        info.m_countryName = mwmInfo.GetCountryName();
+        info.m_rect = mwmInfo.m_bordersRect;
+        info.m_version = mwmInfo.GetMwmVersion().GetVersion();
+        snapshot.Record(info);
+      }
+      catch (RootException const & e)
+      {
+        LOG(LWARNING, ("Registration of", path, "failed:", e.Msg()));
+        ++stats.m_failed;
+      }
+    }
+    snapshot.SaveIfChanged();
+  }
+  stats.m_recorded = AddPending(std::move(deferred));
+  if (worldRegistered)
+    PrepareWorldSearch(framework);
+
+  stats.m_elapsedMicros =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  LOG(LINFO, ("Registered maps with the snapshot:", DebugPrint(stats)));
+  return stats;
+}
+
+/// Queues registration of the maps in |rect| on the background pool. While a task is
+/// queued, newer viewports replace its rect instead of queueing more tasks.
+void RegisterInBackground(Framework & framework, m2::RectD const & rect)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_queuedRect = rect;
+    if (g_queued)
+      return;
+    g_queued = true;
+  }
+  GetPlatform().RunTask(Platform::Thread::Background, [&framework]()
+  {
+    m2::RectD rect;
+    {
+      std::lock_guard<std::mutex> lock(g_mutex);
+      rect = g_queuedRect;
+      g_queued = false;
+    }
+    RegisterLazyMapsIn(framework, rect);
+  });
+}
+}  // namespace
+
+std::optional<LazyMapInfo> ReadLazyMapInfo(std::string const & fullPath)
+{
+  try
+  {
+    FilesContainerR const container(fullPath);
+    LazyMapInfo info;
+    info.m_path = fullPath;
+    info.m_countryName = platform::LocalCountryFile::MakeTemporary(fullPath).GetCountryName();
+    info.m_rect = feature::DataHeader(container).GetBounds();
+    info.m_version = version::MwmVersion::Read(container).GetVersion();
+    return info;
+  }
+  catch (RootException const & e)
+  {
+    LOG(LWARNING, ("Can't read header of", fullPath, e.Msg()));
+    return {};
+  }
+}
+
+bool AddLazyMap(std::string const & fullPath)
+{
+  return AddLazyMaps({fullPath}).m_recorded == 1;
+}
+
+std::string DebugPrint(LazyBatchStats const & stats)
+{
+  std::ostringstream out;
+  out << "registered=" << stats.m_registered << " recorded=" << stats.m_recorded << " failed=" << stats.m_failed
+      << " fromSnapshot=" << stats.m_fromSnapshot << " elapsed=" << stats.m_elapsedMicros << "us";
+  return out.str();
+}
+
+LazyBatchStats AddLazyMaps(std::vector<std::string> const & fullPaths, bool useSnapshot)
+{
+  auto const start = std::chrono::steady_clock::now();
+  LazyBatchStats stats;
+
+  std::vector<LazyMapInfo> infos;
+  infos.reserve(fullPaths.size());
+  {
+    std::lock_guard<std::mutex> lock(g_snapshotMutex);
+    auto & snapshot = GetRegistrationSnapshot();
+    for (auto const & path : fullPaths)
+    {
+      bool fromSnapshot = false;
+      auto info = snapshot.GetMapInfo(path, useSnapshot, fromSnapshot);
+      if (!info)
+      {
+        ++stats.m_failed;
+        continue;
+      }
+      stats.m_fromSnapshot += fromSnapshot ? 1 : 0;
+      infos.push_back(std::move(*info));
+    }
+    snapshot.SaveIfChanged();
+  }
+
+  stats.m_recorded = AddPending(std::move(infos));
+
+  stats.m_elapsedMicros =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  if (fullPaths.size() > 1)
+    LOG(LINFO, ("Recorded maps for lazy registration:", DebugPrint(stats)));
+  return stats;
+}
+
+bool ForgetLazyMap(std::string const & countryName)
+{
+  std::lock_guard<std::mutex> registerLock(g_registerMutex);
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto const it = std::find_if(g_pending.begin(), g_pending.end(),
+                               [&countryName](LazyMapInfo const & info) { return info.m_countryName == countryName; });
+  if (it == g_pending.end())
+    return false;
+  g_pending.erase(it);
+  return true;
+}
+
+size_t RegisterLazyMapsIn(Framework & framework, m2::RectD const & rect)
+{
+  AGUS_TRACE_FUNCTION("maps");
+  return RegisterPending(framework, [&rect](LazyMapInfo const & info) { return info.m_rect.IsIntersect(rect); });
+}
+
+size_t RegisterLazyMaps(Framework & framework, std::vector<std::string> const & countryNames)
+{
+  AGUS_TRACE_FUNCTION("maps");
+  return RegisterPending(framework, [&countryNames](LazyMapInfo const & info)
+  {
+    return std::find(countryNames.begin(), countryNames.end(), info.m_countryName) != countryNames.end();
+  });
+}
+
+size_t RegisterWorldMapsOnly(Framework & framework)
+{
+  auto & storage = framework.GetStorage();
+  storage.RegisterAllLocalMaps(false /* enableDiffs */);
+  std::vector<std::shared_ptr<platform::LocalCountryFile>> maps;
+  storage.GetLocalMaps(maps);
+
+  std::vector<std::string> deferred;
+  for (auto const & file : maps)
+  {
+    auto const & name = file->GetCountryName();
+    if (!IsWorldMap(name))
+    {
+      deferred.push_back(file->GetPath(MapFileType::Map));
+      continue;
+    }
+    auto const result = framework.RegisterMap(*file);
+    if (result.second != MwmSet::RegResult::Success)
+      LOG(LWARNING, ("Registration of", name, "failed:", result.second));
+  }
+  PrepareWorldSearch(framework);
+
+  auto const stats = AddLazyMaps(deferred);
+  LOG(LINFO, ("World maps registered,", stats.m_recorded, "maps deferred:", DebugPrint(stats)));
+  return stats.m_recorded;
+}
+
+LazyBatchStats RegisterMapsWithSnapshot(Framework & framework, std::vector<std::string> const & fullPaths,
+                                        bool useSnapshot)
+{
+  AGUS_TRACE_FUNCTION("maps");
+  std::vector<platform::LocalCountryFile> files;
+  files.reserve(fullPaths.size());
+  for (auto const & path : fullPaths)
+    files.push_back(platform::LocalCountryFile::MakeTemporary(path));
+  return RegisterWithSnapshot(framework, files, useSnapshot);
+}
+
+size_t GetPendingLazyMapsCount()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_pending.size();
+}
+
+void AttachLazyMaps(Framework & framework, LazyMapRegisteredFn onRegistered)
+{
+  g_onRegistered = std::move(onRegistered);
+  framework.SetViewportListener([&framework](ScreenBase const & screen)
+  {
+    // Up to the upper World scale tiles come from the World maps only.
+    m2::RectD const & rect = screen.ClipRect();
+    if (scales::GetScaleLevel(rect) <= scales::GetUpperWorldScale())
+      return;
+    if (GetPendingLazyMapsCount() > 0)
+      RegisterInBackground(framework, rect);
+  });
+
+  // The hook runs on the GUI thread, so it only chains the registration into m_onStarted,
+  // which the search thread calls before the query reads the data source. A search
+  // everywhere needs every pending map. The hook is added once and follows the last
+  // framework attached.
+  g_searchFramework = &framework;
+  if (!g_searchHookAdded)
+  {
+    g_searchHookAdded = true;
+    search_hooks::g_beforeSearch.push_back([](search::SearchParams & params)
+    {
+      if (GetPendingLazyMapsCount() == 0)
+        return;
+      m2::RectD rect;
+      if (params.m_mode == search::Mode::Everywhere)
+        rect = mercator::Bounds::FullRect();
+      else if (params.m_mode == search::Mode::Viewport)
+        rect = params.m_viewport;
+      else
+        return;
+      params.m_onStarted = [onStarted = std::move(params.m_onStarted), rect]()
+      {
+        RegisterLazyMapsIn(*g_searchFramework, rect);
+        if (onStarted)
+          onStarted();
+      };
+    });
+  }
+
+  // The router reports the countries on the route it has no maps for. Those still pending
+  // are registered in the background and the route is built again.
+  framework.GetRoutingManager().SetRouteBuildingListener(
+      [&framework](routing::RouterResultCode code, storage::CountriesSet const & absentCountries)
+  {
+    if (code != routing::RouterResultCode::NeedMoreMaps || absentCountries.empty() ||
+        GetPendingLazyMapsCount() == 0)
+    {
+      return;
+    }
+    std::vector<std::string> names(absentCountries.begin(), absentCountries.end());
+    GetPlatform().RunTask(Platform::Thread::Background, [&framework, names = std::move(names)]()
+    {
+      if (RegisterLazyMaps(framework, names) == 0)
+        return;
+      GetPlatform().RunTask(Platform::Thread::Gui, [&framework]() { framework.GetRoutingManager().BuildRoute(); });
+    });
+  });
+}
+}  // namespace agus
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "indexer/mwm_set.hpp"
+
+#include "geometry/rect2d.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+class Framework;
+
+namespace agus
+{
+/// What lazy registration needs to know about a map before it is opened.
+struct LazyMapInfo
+{
+  std::string m_path;
+  std::string m_countryName;
+  m2::RectD m_rect;
+  int64_t m_version = 0;
+};
+
+/// Reads bounds and version from the container index and header section only,
+/// skipping region data, feature tables and everything else registration loads.
+std::optional<LazyMapInfo> ReadLazyMapInfo(std::string const & fullPath);
+
+/// Records the map at |fullPath| without registering it. It is registered (and
+/// its tiles re-rendered) once the viewport shows it at a scale that reads region
+/// maps, or when RegisterLazyMapsIn covers it. Returns false if the file can't
+/// be read.
+bool AddLazyMap(std::string const & fullPath);
+
+struct LazyBatchStats
+{
+  /// Maps opened and registered right away.
+  size_t m_registered = 0;
+  size_t m_recorded = 0;
+  size_t m_failed = 0;
+  /// Maps whose header data came from the registration snapshot, without opening them.
+  size_t m_fromSnapshot = 0;
+  uint64_t m_elapsedMicros = 0;
+};
+
+std::string DebugPrint(LazyBatchStats const & stats);
+
+/// AddLazyMap for many files; the registration snapshot is saved once at the end.
+/// With |useSnapshot| false every header is read (and the snapshot refreshed),
+/// which is what a launch without the snapshot costs.
+LazyBatchStats AddLazyMaps(std::vector<std::string> const & fullPaths, bool useSnapshot = true);
+
+/// Forgets a pending map by country name. Returns false if none was pending.
+/// Waits for a registration batch in flight, so the map is either forgotten or
+/// already registered when it returns.
+bool ForgetLazyMap(std::string const & countryName);
+
+/// Registers pending maps intersecting |rect| (mercator) on the calling thread.
+/// Returns the number of maps registered.
+size_t RegisterLazyMapsIn(Framework & framework, m2::RectD const & rect);
+
+/// Registers the pending maps of |countryNames| on the calling thread.
+size_t RegisterLazyMaps(Framework & framework, std::vector<std::string> const & countryNames);
+
+size_t GetPendingLazyMapsCount();
+
+/// Render-first replacement for Framework::RegisterAllMaps: registers the world maps,
+/// which are enough to draw the first frame at any position, loads the search's city
+/// boundaries and world localities from them, and records every other local map for
+/// lazy registration. Returns the number of maps deferred.
+size_t RegisterWorldMapsOnly(Framework & framework);
+
+/// Registers maps in a batch, trusting the registration snapshot after a stat() check:
+/// maps it has unchanged are recorded for lazy registration without being opened, the
+/// world maps and all other maps are registered now and added to the snapshot. With
+/// |useSnapshot| false every map is registered now. The snapshot only has bounds and
+/// versions, so it moves registration past startup rather than making it cheaper: a
+/// deferred map is opened and parsed in full once it is used. Once the world maps are
+/// registered, the search loads its city boundaries and world localities from them.
+LazyBatchStats RegisterMapsWithSnapshot(Framework & framework, std::vector<std::string> const & fullPaths,
+                                        bool useSnapshot = true);
+
+using LazyMapRegisteredFn = std::function<void(MwmSet::MwmId const & id)>;
+
+/// Installs the triggers that register pending maps on first use:
+/// - the viewport listener, which queues the maps coming into view on the background pool;
+/// - the search hook (CoMaps patch 0021), which registers the maps a search reads on the search
+///   thread, before the query runs;
+/// - the route building listener, which registers the missing maps of a route and builds it again.
+/// |onRegistered| runs after each lazy registration, on the registering thread. Call on the
+/// GUI thread.
+void AttachLazyMaps(Framework & framework, LazyMapRegisteredFn onRegistered);
+}  // namespace agus
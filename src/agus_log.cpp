@@ -0,0 +1,330 @@
+#include "agus_log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+namespace agus
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+size_t constexpr kRingSize = 32 * 1024;
+/// Longer messages are cut, so one record never takes more than a quarter of a ring.
+size_t constexpr kMaxMessage = kRingSize / 4 - 64;
+/// The flusher drains at least this often, even without being woken.
+auto constexpr kFlushInterval = std::chrono::milliseconds(500);
+
+/// Fixed part of a record; the message bytes follow it.
+struct Header
+{
+  int64_t m_time;
+  char const * m_tag;
+  /// SrcPoint strings, all string literals; m_file is null for LogPrintf records.
+  char const * m_file;
+  char const * m_function;
+  char const * m_postfix;
+  int32_t m_line;
+  uint32_t m_size;
+  int32_t m_level;
+};
+
+size_t RecordSize(size_t messageSize)
+{
+  return (sizeof(Header) + messageSize + 7) & ~size_t{7};
+}
+
+/// Single-producer single-consumer byte ring: the owning thread appends, the
+/// flusher consumes. m_head and m_tail only grow; positions are taken modulo kRingSize.
+struct Ring
+{
+  std::atomic<uint64_t> m_head{0};
+  std::atomic<uint64_t> m_tail{0};
+  std::atomic<uint64_t> m_dropped{0};
+  /// Set when the owning thread exits; the flusher frees the ring once drained.
+  std::atomic<bool> m_closed{false};
+  uint32_t m_number = 0;
+  char m_threadName[16] = {};
+  char m_data[kRingSize];
+
+  void CopyIn(uint64_t pos, void const * src, size_t size)
+  {
+    size_t const at = pos % kRingSize;
+    size_t const first = std::min(size, kRingSize - at);
+    memcpy(m_data + at, src, first);
+    memcpy(m_data, static_cast<char const *>(src) + first, size - first);
+  }
+
+  void CopyOut(uint64_t pos, void * dst, size_t size) const
+  {
+    size_t const at = pos % kRingSize;
+    size_t const first = std::min(size, kRingSize - at);
+    memcpy(dst, m_data + at, first);
+    memcpy(static_cast<char *>(dst) + first, m_data, size - first);
+  }
+
+  bool Push(Header header, char const * message)
+  {
+    header.m_size = static_cast<uint32_t>(std::min<size_t>(header.m_size, kMaxMessage));
+    size_t const size = RecordSize(header.m_size);
+    uint64_t const head = m_head.load(std::memory_order_relaxed);
+    if (head + size - m_tail.load(std::memory_order_acquire) > kRingSize)
+    {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    CopyIn(head, &header, sizeof(header));
+    CopyIn(head + sizeof(header), message, header.m_size);
+    m_head.store(head + size, std::memory_order_release);
+    return true;
+  }
+};
+
+struct Entry
+{
+  Header m_header;
+  uint32_t m_thread;
+  char const * m_threadName;
+  std::string m_message;
+};
+
+void DefaultSink(base::LogLevel level, char const * tag, char const * line)
+{
+#ifdef __ANDROID__
+  android_LogPriority priority = ANDROID_LOG_INFO;
+  switch (level)
+  {
+  case base::LDEBUG: priority = ANDROID_LOG_DEBUG; break;
+  case base::LINFO: priority = ANDROID_LOG_INFO; break;
+  case base::LWARNING: priority = ANDROID_LOG_WARN; break;
+  case base::LERROR: priority = ANDROID_LOG_ERROR; break;
+  default: priority = ANDROID_LOG_FATAL; break;
+  }
+  __android_log_write(priority, tag, line);
+#else
+  static char const * const kNames[] = {"DEBUG", "INFO", "WARN", "ERROR", "CRITICAL"};
+  fprintf(stderr, "%s %s %s\n", kNames[std::clamp(static_cast<int>(level), 0, 4)], tag, line);
+#endif
+}
+
+std::atomic<LogSink> g_sink{&DefaultSink};
+
+// Never destroyed: the detached flusher and exiting threads may still use them
+// while static destructors run.
+std::mutex & g_ringsMutex = *new std::mutex;
+std::vector<std::shared_ptr<Ring>> & g_rings = *new std::vector<std::shared_ptr<Ring>>;
+uint32_t g_nextRingNumber = 1;
+std::atomic<uint64_t> g_droppedTotal{0};
+
+/// Held while draining: the rings have a single consumer.
+std::mutex & g_drainMutex = *new std::mutex;
+std::mutex & g_wakeMutex = *new std::mutex;
+std::condition_variable & g_wake = *new std::condition_variable;
+std::atomic<bool> g_pending{false};
+std::once_flag g_flusherStarted;
+
+/// Owns the calling thread's ring and hands it to the flusher when the thread exits.
+struct ThreadRing
+{
+  std::shared_ptr<Ring> m_ring;
+
+  ThreadRing() : m_ring(std::make_shared<Ring>())
+  {
+    pthread_getname_np(pthread_self(), m_ring->m_threadName, sizeof(m_ring->m_threadName));
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    m_ring->m_number = g_nextRingNumber++;
+    g_rings.push_back(m_ring);
+  }
+
+  ~ThreadRing() { m_ring->m_closed.store(true, std::memory_order_release); }
+};
+
+std::string FormatLine(Entry const & entry)
+{
+  std::string line;
+  line.reserve(entry.m_message.size() + 96);
+  line += '[';
+  line += entry.m_threadName[0] ? entry.m_threadName : "t";
+  line += '#';
+  line += std::to_string(entry.m_thread);
+  line += "] ";
+  if (entry.m_header.m_file)
+  {
+    line += DebugPrint(base::SrcPoint(entry.m_header.m_file, entry.m_header.m_line, entry.m_header.m_function,
+                                      entry.m_header.m_postfix));
+  }
+  line += entry.m_message;
+  return line;
+}
+
+/// Moves every complete record out of the rings and writes them in time order.
+void Drain()
+{
+  std::lock_guard<std::mutex> drainLock(g_drainMutex);
+
+  std::vector<std::shared_ptr<Ring>> rings;
+  {
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    rings = g_rings;
+  }
+
+  std::vector<Entry> entries;
+  uint64_t dropped = 0;
+  for (auto const & ring : rings)
+  {
+    bool const closed = ring->m_closed.load(std::memory_order_acquire);
+    uint64_t tail = ring->m_tail.load(std::memory_order_relaxed);
+    uint64_t const head = ring->m_head.load(std::memory_order_acquire);
+    while (tail < head)
+    {
+      Entry entry;
+      ring->CopyOut(tail, &entry.m_header, sizeof(Header));
+      entry.m_message.resize(entry.m_header.m_size);
+      ring->CopyOut(tail + sizeof(Header), entry.m_message.data(), entry.m_header.m_size);
+      entry.m_thread = ring->m_number;
+      entry.m_threadName = ring->m_threadName;
+      entries.push_back(std::move(entry));
+      tail += RecordSize(entries.back().m_header.m_size);
+    }
+    ring->m_tail.store(tail, std::memory_order_release);
+    dropped += ring->m_dropped.exchange(0, std::memory_order_relaxed);
+
+    if (closed)
+    {
+      std::lock_guard<std::mutex> lock(g_ringsMutex);
+      g_rings.erase(std::remove(g_rings.begin(), g_rings.end(), ring), g_rings.end());
+    }
+  }
+
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](Entry const & a, Entry const & b) { return a.m_header.m_time < b.m_header.m_time; });
+  LogSink const sink = g_sink.load();
+  for (auto const & entry : entries)
+  {
+    sink(static_cast<base::LogLevel>(entry.m_header.m_level), entry.m_header.m_tag, FormatLine(entry).c_str());
+  }
+  if (dropped > 0)
+  {
+    g_droppedTotal.fetch_add(dropped, std::memory_order_relaxed);
+    std::string const line = std::to_string(dropped) + " log messages dropped: ring full";
+    sink(base::LWARNING, "AgusLog", line.c_str());
+  }
+}
+
+void RunFlusher()
+{
+  pthread_setname_np(
+#ifndef __APPLE__
+      pthread_self(),
+#endif
+      "AgusLogFlusher");
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(g_wakeMutex);
+      g_wake.wait_for(lock, kFlushInterval, []() { return g_pending.load(std::memory_order_acquire); });
+    }
+    g_pending.store(false, std::memory_order_release);
+    Drain();
+  }
+}
+
+Ring & GetThreadRing()
+{
+  thread_local ThreadRing ring;
+  return *ring.m_ring;
+}
+
+void Push(Header const & header, char const * message)
+{
+  std::call_once(g_flusherStarted, []() { std::thread(&RunFlusher).detach(); });
+  GetThreadRing().Push(header, message);
+  // Wakes the flusher once per batch; notify_one neither blocks nor takes a lock.
+  if (!g_pending.exchange(true, std::memory_order_acq_rel))
+    g_wake.notify_one();
+}
+
+int64_t Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+}  // namespace
+
+void SetLogSink(LogSink sink)
+{
+  g_sink.store(sink ? sink : &DefaultSink);
+}
+
+void EnqueueLog(base::LogLevel level, base::SrcPoint const & src, std::string const & msg)
+{
+  if (level < kLogFloor)
+    return;
+
+  Header header;
+  header.m_time = Now();
+  header.m_tag = "CoMaps";
+  header.m_file = src.FileName();
+  header.m_function = src.Function();
+  header.m_postfix = src.Postfix();
+  header.m_line = src.Line();
+  header.m_size = static_cast<uint32_t>(msg.size());
+  header.m_level = level;
+
+  if (level >= base::LCRITICAL)
+  {
+    // The caller aborts next: nothing may be left in the rings.
+    FlushLog();
+    Ring const & ring = GetThreadRing();
+    Entry entry{header, ring.m_number, ring.m_threadName, msg};
+    g_sink.load()(level, header.m_tag, FormatLine(entry).c_str());
+    return;
+  }
+  Push(header, msg.data());
+}
+
+void LogPrintf(base::LogLevel level, char const * tag, char const * format, ...)
+{
+  if (level < base::g_LogLevel)
+    return;
+
+  char message[kMaxMessage];
+  va_list args;
+  va_start(args, format);
+  int const n = vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  if (n < 0)
+    return;
+
+  Header header = {};
+  header.m_time = Now();
+  header.m_tag = tag;
+  header.m_size = static_cast<uint32_t>(std::min<size_t>(n, sizeof(message) - 1));
+  header.m_level = level;
+  Push(header, message);
+}
+
+void FlushLog()
+{
+  Drain();
+}
+
+uint64_t GetDroppedLogMessages()
+{
+  return g_droppedTotal.load(std::memory_order_relaxed);
+}
+}  // namespace agus
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "base/logging.hpp"
+#include "base/src_point.hpp"
+
+#include <cstdint>
+#include <string>
+
+/// Lowest level compiled into the bridge's own logging (0 = LDEBUG, 1 = LINFO, ...);
+/// also the lowest level CoMaps' LOG formats at runtime. LINFO in release builds.
+#ifndef AGUS_LOG_FLOOR
+#ifdef NDEBUG
+#define AGUS_LOG_FLOOR 1
+#else
+#define AGUS_LOG_FLOOR 0
+#endif
+#endif
+
+namespace agus
+{
+base::LogLevel constexpr kLogFloor = static_cast<base::LogLevel>(AGUS_LOG_FLOOR);
+
+/// Writes one finished line; called on the flusher thread only (and on the
+/// logging thread for LCRITICAL, right before it aborts).
+using LogSink = void (*)(base::LogLevel level, char const * tag, char const * line);
+
+/// Replaces the default sink (logcat on Android, stderr elsewhere).
+void SetLogSink(LogSink sink);
+
+/// Asynchronous logging: each thread appends records to its own lock-free ring,
+/// which a background thread drains, formats and writes to the sink in time order.
+/// Logging never blocks on I/O or on other threads; when a thread's ring is full
+/// its records are dropped and counted. LCRITICAL is written synchronously, after
+/// flushing everything before it.
+///
+/// For base::SetLogMessageFn: |src| is kept as pointers to its static strings and
+/// only printed on the flusher thread.
+void EnqueueLog(base::LogLevel level, base::SrcPoint const & src, std::string const & msg);
+
+/// Backs the AGUS_LOG* macros.
+void LogPrintf(base::LogLevel level, char const * tag, char const * format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/// Writes out everything logged so far; blocks until done.
+void FlushLog();
+
+uint64_t GetDroppedLogMessages();
+}  // namespace agus
+
+/// printf-style bridge logging; calls below AGUS_LOG_FLOOR compile to nothing.
+#define AGUS_LOG_AT(level, tag, ...)                             \
+  do                                                             \
+  {                                                              \
+    if constexpr (::base::level >= ::agus::kLogFloor)            \
+      ::agus::LogPrintf(::base::level, tag, __VA_ARGS__);        \
+  } while (false)
+
+#define AGUS_LOGD(tag, ...) AGUS_LOG_AT(LDEBUG, tag, __VA_ARGS__)
+#define AGUS_LOGI(tag, ...) AGUS_LOG_AT(LINFO, tag, __VA_ARGS__)
+#define AGUS_LOGW(tag, ...) AGUS_LOG_AT(LWARNING, tag, __VA_ARGS__)
+#define AGUS_LOGE(tag, ...) AGUS_LOG_AT(LERROR, tag, __VA_ARGS__)
@@ -0,0 +1,528 @@
+#include "agus_map_fetch.hpp"
+
+#include "agus_file_hash.hpp"
+#include "agus_http.hpp"
+#include "agus_map_swap.hpp"
+
+#include "map/framework.hpp"
+
+#include "platform/local_country_file.hpp"
+#include "platform/mwm_version.hpp"
+#include "platform/platform.hpp"
+
+#include "coding/files_container.hpp"
+
+#include "base/file_name_utils.hpp"
+#include "base/logging.hpp"
+#include "base/string_utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+char constexpr kPartExtension[] = ".part";
+int constexpr kMaxAttempts = 3;
+auto constexpr kRetryDelay = std::chrono::seconds(2);
+
+uint64_t MicrosSince(Clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+/// Token bucket shared by all fetches. Callers take what they need and sleep off
+/// any debt, so concurrent streams converge on equal shares of the rate.
+class RateLimiter
+{
+public:
+  void SetRate(int64_t bytesPerSecond)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rate = static_cast<double>(std::max<int64_t>(bytesPerSecond, 0));
+    m_available = 0;
+    m_last = Clock::now();
+  }
+
+  /// Returns the time slept, in microseconds.
+  uint64_t Acquire(size_t bytes)
+  {
+    std::chrono::duration<double> wait{0};
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_rate <= 0)
+        return 0;
+      auto const now = Clock::now();
+      // A burst of 1/8 s, but at least one read buffer.
+      double const burst = std::max(m_rate / 8, 64.0 * 1024);
+      m_available = std::min(m_available + m_rate * std::chrono::duration<double>(now - m_last).count(), burst);
+      m_last = now;
+      m_available -= static_cast<double>(bytes);
+      if (m_available < 0)
+        wait = std::chrono::duration<double>(-m_available / m_rate);
+    }
+    if (wait.count() <= 0)
+      return 0;
+    std::this_thread::sleep_for(wait);
+    return std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+  }
+
+private:
+  std::mutex m_mutex;
+  double m_rate = 0;
+  double m_available = 0;
+  Clock::time_point m_last = Clock::now();
+};
+
+struct Fetch
+{
+  Framework * m_framework = nullptr;
+  MapFetchRequest m_request;
+  MapFetchProgress m_progress;
+  std::atomic<bool> m_cancelled{false};
+};
+
+std::mutex g_mutex;
+std::map<int64_t, std::shared_ptr<Fetch>> g_fetches;
+std::deque<std::shared_ptr<Fetch>> g_queue;
+int64_t g_nextId = 1;
+unsigned g_workers = 0;
+MapFetchBudget g_budget;
+RateLimiter g_limiter;
+
+template <typename Fn>
+void Mutate(Fetch & fetch, Fn && fn)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  fn(fetch.m_progress);
+}
+
+void SetStatus(Fetch & fetch, MapFetchStatus status)
+{
+  Mutate(fetch, [status](MapFetchProgress & p) { p.m_status = status; });
+}
+
+bool WriteAt(int fd, void const * data, size_t size, int64_t offset)
+{
+  auto const * p = static_cast<char const *>(data);
+  while (size > 0)
+  {
+    ssize_t const n = pwrite(fd, p, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= static_cast<size_t>(n);
+    offset += n;
+  }
+  return true;
+}
+
+/// Hashes the first |size| bytes of |fd|, left by an interrupted fetch.
+bool HashPrefix(int fd, int64_t size, Sha256 & hasher)
+{
+  std::vector<char> buffer(1 << 20);
+  for (int64_t offset = 0; offset < size;)
+  {
+    size_t const want = static_cast<size_t>(std::min<int64_t>(buffer.size(), size - offset));
+    ssize_t const n = pread(fd, buffer.data(), want, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    hasher.Update(buffer.data(), static_cast<size_t>(n));
+    offset += n;
+  }
+  return true;
+}
+
+/// Streams the rest of the map into |fd| from |offset| on, hashing and
+/// periodically syncing what it writes.
+MapFetchFailure Download(Fetch & fetch, int fd, int64_t & offset, Sha256 & hasher)
+{
+  auto const & request = fetch.m_request;
+  // Complete, but an earlier fetch stopped before moving it into place.
+  if (offset == request.m_size)
+    return MapFetchFailure::None;
+  auto const url = http::Url::Parse(request.m_url);
+  if (!url)
+    return MapFetchFailure::Network;
+
+  int64_t const unsyncedLimit = std::max<int64_t>(GetMapFetchBudget().m_maxUnsyncedBytes, 1 << 20);
+  for (int attempt = 1;; ++attempt)
+  {
+    http::Request httpRequest;
+    httpRequest.m_url = *url;
+    if (offset > 0)
+      httpRequest.m_begRange = offset;
+
+    http::Response response;
+    bool first = true;
+    bool writeFailed = false;
+    bool tooLong = false;
+    int64_t unsynced = 0;
+    int64_t const attemptStart = offset;
+    auto const onBody = [&](void const * data, size_t size)
+    {
+      if (first)
+      {
+        first = false;
+        if (response.m_status / 100 != 2)
+          return false;
+        if (offset > 0 && (response.m_status != 206 || response.m_rangeBegin != offset))
+        {
+          // The server ignored the range: start over.
+          LOG(LINFO, ("No range support for", request.m_url, "- restarting from 0"));
+          hasher = Sha256();
+          offset = 0;
+          if (ftruncate(fd, 0) != 0)
+          {
+            writeFailed = true;
+            return false;
+          }
+        }
+      }
+      if (offset + static_cast<int64_t>(size) > request.m_size)
+      {
+        tooLong = true;
+        return false;
+      }
+
+      uint64_t const throttled = g_limiter.Acquire(size);
+      if (!WriteAt(fd, data, size, offset))
+      {
+        writeFailed = true;
+        return false;
+      }
+      hasher.Update(data, size);
+      offset += static_cast<int64_t>(size);
+      unsynced += static_cast<int64_t>(size);
+      if (unsynced >= unsyncedLimit)
+      {
+        fsync(fd);
+        unsynced = 0;
+      }
+      Mutate(fetch, [&](MapFetchProgress & p)
+      {
+        p.m_bytesWritten = offset;
+        p.m_throttledMicros += throttled;
+      });
+      return true;
+    };
+
+    int code = http::Perform(httpRequest, onBody, response, &fetch.m_cancelled);
+    // An error page was refused by onBody.
+    if (code == http::kWriteError && !writeFailed && !tooLong)
+      code = response.m_status;
+    if (fetch.m_cancelled)
+      return MapFetchFailure::None;
+    if (writeFailed)
+    {
+      LOG(LWARNING, ("Can't write", request.m_path, strerror(errno)));
+      return MapFetchFailure::Write;
+    }
+    if (code == 404)
+      return MapFetchFailure::FileNotFound;
+    if ((code == 200 || code == 206) && offset == request.m_size)
+      return MapFetchFailure::None;
+
+    LOG(LWARNING, ("Fetch of", request.m_url, "stopped at", offset, "of", request.m_size, "code", code,
+                   "attempt", attempt));
+    // A response of the wrong size won't get better by retrying.
+    if (tooLong || code == 200 || code == 206)
+      return MapFetchFailure::Network;
+    // Only consecutive attempts without progress count.
+    if (offset > attemptStart)
+      attempt = 0;
+    if (attempt >= kMaxAttempts)
+      return MapFetchFailure::Network;
+    std::this_thread::sleep_for(kRetryDelay);
+  }
+}
+
+bool Verify(Fetch & fetch, std::string const & path, std::string const & digest)
+{
+  auto const & request = fetch.m_request;
+  if (!request.m_sha256.empty())
+    return digest == request.m_sha256;
+  try
+  {
+    version::MwmVersion::Read(FilesContainerR(path));
+    return true;
+  }
+  catch (RootException const & e)
+  {
+    LOG(LWARNING, (path, "is not a valid map:", e.Msg()));
+    return false;
+  }
+}
+
+MapFetchFailure Run(Fetch & fetch)
+{
+  auto const & request = fetch.m_request;
+  std::string const partPath = request.m_path + kPartExtension;
+
+  int const fd = open(partPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    LOG(LWARNING, ("Can't open", partPath, strerror(errno)));
+    return MapFetchFailure::Write;
+  }
+
+  Sha256 hasher;
+  struct stat st;
+  int64_t offset = fstat(fd, &st) == 0 ? st.st_size : 0;
+  if (offset > request.m_size || !HashPrefix(fd, offset, hasher))
+  {
+    hasher = Sha256();
+    offset = 0;
+    if (ftruncate(fd, 0) != 0)
+    {
+      close(fd);
+      return MapFetchFailure::Write;
+    }
+  }
+  Mutate(fetch, [offset](MapFetchProgress & p)
+  {
+    p.m_status = MapFetchStatus::Downloading;
+    p.m_resumedBytes = offset;
+    p.m_bytesWritten = offset;
+  });
+
+  auto start = Clock::now();
+  MapFetchFailure failure = Download(fetch, fd, offset, hasher);
+  Mutate(fetch, [&](MapFetchProgress & p) { p.m_downloadMicros = MicrosSince(start); });
+  if (failure != MapFetchFailure::None || fetch.m_cancelled)
+  {
+    // Kept for a later fetch to resume from.
+    close(fd);
+    return failure;
+  }
+
+  std::string const digest = DebugPrint(hasher.Finalize());
+  Mutate(fetch, [&](MapFetchProgress & p)
+  {
+    p.m_status = MapFetchStatus::Syncing;
+    p.m_sha256 = digest;
+  });
+
+  start = Clock::now();
+  bool const synced = fsync(fd) == 0;
+  close(fd);
+  if (!Verify(fetch, partPath, digest))
+  {
+    LOG(LWARNING, ("Verification of", request.m_url, "failed, got", digest));
+    std::remove(partPath.c_str());
+    return MapFetchFailure::Verify;
+  }
+  if (!synced || std::rename(partPath.c_str(), request.m_path.c_str()) != 0)
+  {
+    LOG(LWARNING, ("Can't move", partPath, "into place"));
+    return MapFetchFailure::Write;
+  }
+  // The rename itself lives in the directory.
+  int const dirFd = open(base::GetDirectory(request.m_path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirFd >= 0)
+  {
+    fsync(dirFd);
+    close(dirFd);
+  }
+  Mutate(fetch, [&](MapFetchProgress & p) { p.m_syncMicros = MicrosSince(start); });
+
+  if (fetch.m_framework == nullptr)
+    return MapFetchFailure::None;
+
+  SetStatus(fetch, MapFetchStatus::Registering);
+  start = Clock::now();
+  // Registration changes go through the GUI thread, like the other map operations.
+  std::promise<MwmSet::RegResult> registered;
+  auto result = registered.get_future();
+  GetPlatform().RunTask(Platform::Thread::Gui, [&fetch, &registered]()
+  {
+    try
+    {
+      registered.set_value(ReplaceMap(*fetch.m_framework, fetch.m_request.m_path).m_result);
+    }
+    catch (RootException const & e)
+    {
+      LOG(LWARNING, ("Registering", fetch.m_request.m_path, "failed:", e.Msg()));
+      registered.set_value(MwmSet::RegResult::BadFile);
+    }
+  });
+  auto const regResult = result.get();
+  Mutate(fetch, [&](MapFetchProgress & p)
+  {
+    p.m_regResult = static_cast<int32_t>(regResult);
+    p.m_registerMicros = MicrosSince(start);
+  });
+  return regResult == MwmSet::RegResult::Success ? MapFetchFailure::None : MapFetchFailure::Register;
+}
+
+void RunWorker();
+
+/// Tops the workers up to the budget; call with g_mutex held.
+void StartWorkersLocked()
+{
+  size_t const wanted = std::min<size_t>(g_budget.m_maxConcurrent, g_queue.size());
+  for (; g_workers < wanted; ++g_workers)
+    std::thread(&RunWorker).detach();
+}
+
+void RunWorker()
+{
+  while (true)
+  {
+    std::shared_ptr<Fetch> fetch;
+    {
+      std::lock_guard<std::mutex> lock(g_mutex);
+      // A lowered budget retires workers as their fetches finish.
+      if (g_queue.empty() || g_workers > g_budget.m_maxConcurrent)
+      {
+        --g_workers;
+        return;
+      }
+      fetch = std::move(g_queue.front());
+      g_queue.pop_front();
+    }
+
+    auto const start = Clock::now();
+    MapFetchFailure const failure = fetch->m_cancelled ? MapFetchFailure::None : Run(*fetch);
+    MapFetchProgress progress;
+    Mutate(*fetch, [&](MapFetchProgress & p)
+    {
+      p.m_status = fetch->m_cancelled                ? MapFetchStatus::Cancelled
+                   : failure == MapFetchFailure::None ? MapFetchStatus::Completed
+                                                      : MapFetchStatus::Failed;
+      p.m_failure = failure;
+      p.m_totalMicros = MicrosSince(start);
+      progress = p;
+    });
+    LOG(LINFO, ("Map fetch of", fetch->m_request.m_path, DebugPrint(progress)));
+  }
+}
+}  // namespace
+
+std::string DebugPrint(MapFetchStatus status)
+{
+  switch (status)
+  {
+  case MapFetchStatus::Unknown: return "Unknown";
+  case MapFetchStatus::Queued: return "Queued";
+  case MapFetchStatus::Downloading: return "Downloading";
+  case MapFetchStatus::Syncing: return "Syncing";
+  case MapFetchStatus::Registering: return "Registering";
+  case MapFetchStatus::Completed: return "Completed";
+  case MapFetchStatus::Failed: return "Failed";
+  case MapFetchStatus::Cancelled: return "Cancelled";
+  }
+  return "Unknown";
+}
+
+std::string DebugPrint(MapFetchFailure failure)
+{
+  switch (failure)
+  {
+  case MapFetchFailure::None: return "None";
+  case MapFetchFailure::Network: return "Network";
+  case MapFetchFailure::FileNotFound: return "FileNotFound";
+  case MapFetchFailure::Write: return "Write";
+  case MapFetchFailure::Verify: return "Verify";
+  case MapFetchFailure::Register: return "Register";
+  }
+  return "Unknown";
+}
+
+std::string DebugPrint(MapFetchProgress const & progress)
+{
+  std::ostringstream out;
+  out << DebugPrint(progress.m_status) << " failure=" << DebugPrint(progress.m_failure)
+      << " bytes=" << progress.m_bytesWritten << "/" << progress.m_bytesTotal
+      << " resumed=" << progress.m_resumedBytes << " throttled=" << progress.m_throttledMicros
+      << "us download=" << progress.m_downloadMicros << "us sync=" << progress.m_syncMicros
+      << "us register=" << progress.m_registerMicros << "us total=" << progress.m_totalMicros << "us";
+  return out.str();
+}
+
+void SetMapFetchBudget(MapFetchBudget const & budget)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_budget = budget;
+  g_budget.m_maxConcurrent = std::clamp(budget.m_maxConcurrent, 1u, 8u);
+  g_limiter.SetRate(budget.m_maxBytesPerSecond);
+  StartWorkersLocked();
+}
+
+MapFetchBudget GetMapFetchBudget()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_budget;
+}
+
+int64_t StartMapFetch(Framework * framework, MapFetchRequest request)
+{
+  auto fetch = std::make_shared<Fetch>();
+  fetch->m_framework = framework;
+  fetch->m_progress.m_status = MapFetchStatus::Queued;
+  fetch->m_progress.m_bytesTotal = request.m_size;
+  fetch->m_request = std::move(request);
+  strings::AsciiToLower(fetch->m_request.m_sha256);
+
+  bool const registered = framework && IsRegisteredMapFile(*framework, fetch->m_request.m_path);
+  if (registered)
+  {
+    LOG(LWARNING, ("Can't fetch over the registered map", fetch->m_request.m_path));
+    fetch->m_progress.m_status = MapFetchStatus::Failed;
+    fetch->m_progress.m_failure = MapFetchFailure::Register;
+  }
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  int64_t const id = g_nextId++;
+  g_fetches[id] = fetch;
+  if (!registered)
+  {
+    g_queue.push_back(std::move(fetch));
+    StartWorkersLocked();
+  }
+  return id;
+}
+
+MapFetchProgress GetMapFetchProgress(int64_t id)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto const it = g_fetches.find(id);
+  if (it == g_fetches.end())
+    return {};
+  return it->second->m_progress;
+}
+
+void CancelMapFetch(int64_t id)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto const it = g_fetches.find(id);
+  if (it == g_fetches.end())
+    return;
+  // A queued fetch is skipped by the worker; a running one stops on its next read.
+  it->second->m_cancelled = true;
+  g_fetches.erase(it);
+}
+}  // namespace agus
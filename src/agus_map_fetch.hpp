@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Framework;
+
+namespace agus
+{
+/// A map to download and register.
+struct MapFetchRequest
+{
+  std::string m_url;
+  /// Where the map ends up. Must not be the path of a registered map (see ReplaceMap).
+  std::string m_path;
+  /// Exact size of the remote file.
+  int64_t m_size = 0;
+  /// Lowercase hex SHA-256 of the map; empty to only check that it opens as a map.
+  std::string m_sha256;
+};
+
+/// Limits shared by all fetches.
+struct MapFetchBudget
+{
+  /// Maps downloaded at the same time.
+  unsigned m_maxConcurrent = 2;
+  /// Network throughput of all fetches together, 0 for unlimited.
+  int64_t m_maxBytesPerSecond = 0;
+  /// Written bytes a fetch leaves to the page cache before syncing them, which
+  /// bounds dirty memory and keeps the final fsync short.
+  int64_t m_maxUnsyncedBytes = 16 << 20;
+};
+
+enum class MapFetchStatus
+{
+  Unknown = -1,
+  Queued = 0,
+  Downloading = 1,
+  Syncing = 2,
+  Registering = 3,
+  Completed = 4,
+  Failed = 5,
+  Cancelled = 6,
+};
+
+enum class MapFetchFailure
+{
+  None = 0,
+  Network = 1,
+  FileNotFound = 2,
+  Write = 3,
+  Verify = 4,
+  Register = 5,
+};
+
+std::string DebugPrint(MapFetchStatus status);
+std::string DebugPrint(MapFetchFailure failure);
+
+struct MapFetchProgress
+{
+  MapFetchStatus m_status = MapFetchStatus::Unknown;
+  MapFetchFailure m_failure = MapFetchFailure::None;
+  /// MwmSet::RegResult of the registration, -1 until it happened.
+  int32_t m_regResult = -1;
+  /// Bytes of the map on disk, including a resumed prefix.
+  int64_t m_bytesWritten = 0;
+  int64_t m_bytesTotal = 0;
+  /// Prefix kept from an earlier, interrupted fetch of the same map.
+  int64_t m_resumedBytes = 0;
+  /// Time spent waiting for the bandwidth budget.
+  uint64_t m_throttledMicros = 0;
+  uint64_t m_downloadMicros = 0;
+  uint64_t m_syncMicros = 0;
+  uint64_t m_registerMicros = 0;
+  uint64_t m_totalMicros = 0;
+  /// Lowercase hex SHA-256 of the map, computed while it streamed in; set once downloaded.
+  std::string m_sha256;
+};
+
+std::string DebugPrint(MapFetchProgress const & progress);
+
+void SetMapFetchBudget(MapFetchBudget const & budget);
+MapFetchBudget GetMapFetchBudget();
+
+/// Downloads a map and registers it in one background job, reading each byte once:
+/// the body is hashed as it is written to a .part file next to m_path, which is
+/// then verified, synced and atomically renamed to m_path before being
+/// registered through ReplaceMap on the GUI thread. Each map streams over a single
+/// connection, since hashing needs the bytes in order; concurrency comes from
+/// fetching several maps at once, under the global MapFetchBudget.
+///
+/// An interrupted or cancelled fetch keeps its .part file, and fetching the same
+/// path again rehashes that prefix and requests only the rest. |framework| may be
+/// null to download and verify without registering; otherwise a fetch to the path
+/// of a map registered in its data source fails right away, with MapFetchFailure::Register.
+/// Returns an id for GetMapFetchProgress and CancelMapFetch.
+int64_t StartMapFetch(Framework * framework, MapFetchRequest request);
+
+/// m_status is Unknown for an unknown id.
+MapFetchProgress GetMapFetchProgress(int64_t id);
+
+/// Stops a queued or running fetch and forgets |id|; also releases a finished one.
+void CancelMapFetch(int64_t id);
+}  // namespace agus
@@ -0,0 +1,120 @@
+#include "agus_map_swap.hpp"
+
+#include "agus_frame_stats.hpp"
+#include "agus_lazy_maps.hpp"
+
+#include "map/framework.hpp"
+
+#include "platform/local_country_file.hpp"
+#include "platform/mwm_version.hpp"
+
+#include "coding/files_container.hpp"
+
+#include "base/logging.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <system_error>
+
+namespace agus
+{
+namespace
+{
+uint64_t MicrosSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Re-renders tiles within |rect|. Search caches are left alone: they are keyed by
+/// MwmId, so entries of the replaced map are never hit again and the rest stay warm.
+uint64_t InvalidateRegion(Framework & framework, m2::RectD const & rect)
+{
+  auto const start = std::chrono::steady_clock::now();
+  if (!rect.IsEmptyInterior())
+    framework.InvalidateRect(rect);
+  return MicrosSince(start);
+}
+}  // namespace
+
+std::string DebugPrint(MapReplaceResult const & result)
+{
+  std::ostringstream out;
+  out << "result=" << ::DebugPrint(result.m_result) << " version=" << result.m_oldVersion << "->"
+      << result.m_newVersion << " swap=" << result.m_swapMicros
+      << "us invalidate=" << result.m_invalidateMicros << "us";
+  return out.str();
+}
+
+MapReplaceResult ReplaceMap(Framework & framework, std::string const & fullPath)
+{
+  MapReplaceResult result;
+
+  auto const temporary = platform::LocalCountryFile::MakeTemporary(fullPath);
+  result.m_newVersion = version::MwmVersion::Read(FilesContainerR(fullPath)).GetVersion();
+  // A pending lazy registration of the country would otherwise bring the old file back.
+  ForgetLazyMap(temporary.GetCountryName());
+
+  // The file is registered at its data version, so MwmSet compares real versions.
+  platform::LocalCountryFile file(temporary.GetDirectory(), temporary.GetCountryFile(), result.m_newVersion);
+  file.SyncWithDisk();
+
+  m2::RectD rect;
+  bool newer = true;
+  auto const oldId = framework.GetDataSource().GetMwmIdByCountryFile(file.GetCountryFile());
+  if (oldId.IsAlive())
+  {
+    auto const & oldInfo = *oldId.GetInfo();
+    result.m_oldVersion = oldInfo.GetMwmVersion().GetVersion();
+    rect = oldInfo.m_bordersRect;
+    newer = oldInfo.GetVersion() < file.GetVersion();
+  }
+
+  // The frame stats start before the swap, so the render stall includes it.
+  OnMapReplaced();
+  auto const start = std::chrono::steady_clock::now();
+  // MwmSet replaces a registered map with a newer one in the same transaction. The same
+  // or an older version only registers once the old one is gone, leaving the region
+  // without a map meanwhile.
+  if (!newer)
+    framework.DeregisterMap(file.GetCountryFile());
+  auto const reg = framework.RegisterMap(file);
+  result.m_result = reg.second;
+  result.m_swapMicros = MicrosSince(start);
+
+  if (reg.second == MwmSet::RegResult::Success)
+  {
+    rect.Add(reg.first.GetInfo()->m_bordersRect);
+    result.m_invalidateMicros = InvalidateRegion(framework, rect);
+  }
+
+  LOG(LINFO, ("Replaced", fullPath, DebugPrint(result)));
+  return result;
+}
+
+bool DeregisterMap(Framework & framework, std::string const & fullPath)
+{
+  auto const countryFile = platform::LocalCountryFile::MakeTemporary(fullPath).GetCountryFile();
+
+  bool const wasPending = ForgetLazyMap(countryFile.GetName());
+  auto const id = framework.GetDataSource().GetMwmIdByCountryFile(countryFile);
+  if (!id.IsAlive())
+    return wasPending;
+  m2::RectD const rect = id.GetInfo()->m_bordersRect;
+
+  framework.DeregisterMap(countryFile);
+  InvalidateRegion(framework, rect);
+  return true;
+}
+
+bool IsRegisteredMapFile(Framework const & framework, std::string const & fullPath)
+{
+  auto const countryFile = platform::LocalCountryFile::MakeTemporary(fullPath).GetCountryFile();
+  auto const id = framework.GetDataSource().GetMwmIdByCountryFile(countryFile);
+  if (!id.IsAlive())
+    return false;
+  std::string const registeredPath = id.GetInfo()->GetLocalFile().GetPath(MapFileType::Map);
+  std::error_code ec;
+  return registeredPath == fullPath || std::filesystem::equivalent(registeredPath, fullPath, ec);
+}
+}  // namespace agus
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "indexer/mwm_set.hpp"
+
+#include <cstdint>
+#include <string>
+
+class Framework;
+
+namespace agus
+{
+struct MapReplaceResult
+{
+  MwmSet::RegResult m_result = MwmSet::RegResult::BadFile;
+  /// Data version of the map that was replaced, -1 if none was registered.
+  int64_t m_oldVersion = -1;
+  /// Data version read from the new file's header.
+  int64_t m_newVersion = 0;
+  /// Time the swap held the data source, i.e. the stall seen by readers.
+  uint64_t m_swapMicros = 0;
+  /// Time spent invalidating the region's tiles.
+  uint64_t m_invalidateMicros = 0;
+};
+
+std::string DebugPrint(MapReplaceResult const & result);
+
+/// Registers the map at |fullPath|, at its data version, in place of the registered
+/// map of the same country without restarting the engine. A newer version replaces
+/// the old one within one data source transaction. The same or an older version is
+/// only registered after the old one is deregistered: while readers still hold the
+/// old file, that fails with VersionAlreadyExists or VersionTooOld. Readers holding
+/// the old version keep it until their handles are released, after which it is
+/// closed. Only tiles intersecting the old or new map bounds are re-rendered;
+/// GetMapReplaceFrameStats has the render stall, the swap included. |fullPath| must
+/// not be the registered file (see IsRegisteredMapFile): write the new version next
+/// to it and delete the old file afterwards.
+MapReplaceResult ReplaceMap(Framework & framework, std::string const & fullPath);
+
+/// Deregisters the map registered (or pending lazy registration) for the country
+/// named by |fullPath|'s file name and re-renders its tiles. Returns false if no
+/// such map is registered.
+bool DeregisterMap(Framework & framework, std::string const & fullPath);
+
+/// True if |fullPath| is the file registered for its country.
+bool IsRegisteredMapFile(Framework const & framework, std::string const & fullPath);
+}  // namespace agus
@@ -27,35 +27,53 @@ FFI_PLUGIN_EXPORT int sum_long_running(int a, int b) {
 #include <android/native_window_jni.h>
 #include <chrono>
 #include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include "base/logging.hpp"
 #include "map/framework.hpp"
 #include "platform/local_country_file.hpp"
+#include "platform/platform.hpp"
 #include "drape/graphics_context_factory.hpp"
 #include "drape_frontend/visual_params.hpp"
 #include "drape_frontend/user_event_stream.hpp"
 #include "drape_frontend/active_frame_callback.hpp"
 #include "geometry/mercator.hpp"
+#include "coding/string_utf8_multilang.hpp"
+#include "indexer/feature_meta.hpp"
 #include "agus_ogl.hpp"
+#include "agus_archive_maps.hpp"
+#include "agus_memory.hpp"
+#include "agus_threads.hpp"
+#include "agus_downloader.hpp"
+#include "agus_engine_host.hpp"
+#include "agus_file_hash.hpp"
+#include "agus_file_pool.hpp"
+#include "agus_frame_stats.hpp"
+#include "agus_lazy_maps.hpp"
+#include "agus_log.hpp"
+#include "agus_map_fetch.hpp"
+#include "agus_map_swap.hpp"
+#include "agus_metrics.hpp"
+#include "agus_mirror_download.hpp"
+#include "agus_mwm_index.hpp"
+#include "agus_mwm_update.hpp"
+#include "agus_platform.hpp"
+#include "agus_fonts.hpp"
+#include "agus_resource_pack.hpp"
+#include "agus_startup_trace.hpp"
+#include "agus_style_switch.hpp"
+#include "agus_trace.hpp"
 
-extern "C" void AgusPlatform_Init(const char* apkPath, const char* storagePath);
-extern "C" void AgusPlatform_InitPaths(const char* resourcePath, const char* writablePath);
-
-// Custom log handler that redirects to Android logcat without aborting on ERROR
+// Custom log handler that redirects to Android logcat without aborting on ERROR.
+// Messages go through agus_log's per-thread rings; formatting and the logcat
+// write happen on its flusher thread, so render threads never wait on logd.
 static void AgusLogMessage(base::LogLevel level, base::SrcPoint const & src, std::string const & msg) {
-    android_LogPriority pr = ANDROID_LOG_SILENT;
-    
-    switch (level) {
-    case base::LDEBUG: pr = ANDROID_LOG_DEBUG; break;
-    case base::LINFO: pr = ANDROID_LOG_INFO; break;
-    case base::LWARNING: pr = ANDROID_LOG_WARN; break;
-    case base::LERROR: pr = ANDROID_LOG_ERROR; break;
-    case base::LCRITICAL: pr = ANDROID_LOG_FATAL; break;
-    default: break;
-    }
-    
-    std::string out = DebugPrint(src) + msg;
-    __android_log_print(pr, "CoMaps", "%s", out.c_str());
+    agus::EnqueueLog(level, src, msg);
     
     // Only abort on CRITICAL, not ERROR
     if (level >= base::LCRITICAL) {
@@ -70,50 +88,118 @@ static drape_ptr<dp::ThreadSafeFactory> g_factory;
 static std::string g_resourcePath;
 static std::string g_writablePath;
 static bool g_platformInitialized = false;
+static agus::ThreadConfig g_threadConfig;
+
+// Gauges over Android-only modules; agus::RegisterMetricProviders has the shared ones
+static void registerMetricProviders() {
+    agus::RegisterMetricProviders();
+    agus::SetGaugeProvider("file_pool.open_descriptors", []() {
+        return static_cast<int64_t>(agus::GetFilePoolStats().m_openDescriptors);
+    });
+    agus::SetGaugeProvider("reader_cache.hit_rate_permille", []() -> int64_t {
+        uint64_t const reads = agus::GetCounter("reader_cache.reads").Get();
+        return reads == 0 ? 0 : static_cast<int64_t>(agus::GetCounter("reader_cache.hits").Get() * 1000 / reads);
+    });
+}
 
 // Old init function for backwards compatibility (uses APK path)
 FFI_PLUGIN_EXPORT void comaps_init(const char* apkPath, const char* storagePath) {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_init: apk=%s, storage=%s", apkPath, storagePath);
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative", "comaps_init: apk=%s, storage=%s", apkPath, storagePath);
     AgusPlatform_Init(apkPath, storagePath);
     
     // Note: Framework initialization requires many data files (categories.txt, etc.)
     // For now we just initialize the platform; full Framework will be created when surface is ready
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_init: Platform initialized, Framework deferred");
+    AGUS_LOGD("AgusMapsFlutterNative", "comaps_init: Platform initialized, Framework deferred");
 }
 
 // New init function with explicit resource and writable paths
 // NOTE: This just stores paths. Framework creation is deferred to nativeSetSurface
 // to ensure Framework and CreateDrapeEngine happen on the same thread.
 FFI_PLUGIN_EXPORT void comaps_init_paths(const char* resourcePath, const char* writablePath) {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_init_paths: resource=%s, writable=%s", resourcePath, writablePath);
+    // Traced once, by comaps_init_paths_with_config
+    comaps_init_paths_with_config(resourcePath, writablePath, nullptr);
+}
+
+FFI_PLUGIN_EXPORT void comaps_init_paths_with_config(const char* resourcePath, const char* writablePath,
+                                                     const ComapsThreadConfig* config) {
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative", "comaps_init_paths: resource=%s, writable=%s", resourcePath, writablePath);
     
     // Set up our custom log handler before doing anything else
     base::SetLogMessageFn(&AgusLogMessage);
     // Set abort level to LCRITICAL so ERROR logs don't crash
     base::g_LogAbortLevel = base::LCRITICAL;
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_init_paths: Custom logging initialized");
+    // LOG below the compile-time floor isn't even formatted
+    base::g_LogLevel = std::max<base::LogLevel>(base::g_LogLevel, agus::kLogFloor);
+    AGUS_LOGD("AgusMapsFlutterNative", "comaps_init_paths: Custom logging initialized");
     
     // Store paths for later use
     g_resourcePath = resourcePath;
     g_writablePath = writablePath;
     
-    // Initialize platform now (sets up directories, thread infrastructure)
-    AgusPlatform_InitPaths(resourcePath, writablePath);
+    // Size search and worker pools from the core count unless overridden
+    agus::ThreadConfig overrides;
+    if (config) {
+        overrides.m_searchThreads = static_cast<unsigned>(std::max(0, config->search_threads));
+        overrides.m_networkThreads = static_cast<unsigned>(std::max(0, config->network_threads));
+        overrides.m_fileThreads = static_cast<unsigned>(std::max(0, config->file_threads));
+        overrides.m_backgroundThreads = static_cast<unsigned>(std::max(0, config->background_threads));
+        overrides.m_readThreads = static_cast<unsigned>(std::max(0, config->read_threads));
+    }
+    // Initialize platform now (directories, GUI thread, worker pools, file pool, engine hooks).
+    // agus_bench times this same call as its comaps_init_paths phase.
+    g_threadConfig = AgusPlatform_Start(resourcePath, writablePath, overrides);
+    AGUS_LOGD("AgusMapsFlutterNative", "comaps_init_paths: Threads %s (cores=%u)",
+        agus::DebugPrint(g_threadConfig).c_str(), Platform::CpuCores());
+    
+    registerMetricProviders();
     g_platformInitialized = true;
     
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_init_paths: Platform initialized, Framework deferred to render thread");
+    AGUS_LOGD("AgusMapsFlutterNative", "comaps_init_paths: Platform initialized, Framework deferred to render thread");
+}
+
+FFI_PLUGIN_EXPORT void comaps_get_thread_config(ComapsThreadConfig* out_config) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!out_config) {
+        return;
+    }
+    out_config->search_threads = static_cast<int32_t>(g_threadConfig.m_searchThreads);
+    out_config->network_threads = static_cast<int32_t>(g_threadConfig.m_networkThreads);
+    out_config->file_threads = static_cast<int32_t>(g_threadConfig.m_fileThreads);
+    out_config->background_threads = static_cast<int32_t>(g_threadConfig.m_backgroundThreads);
+    out_config->read_threads = static_cast<int32_t>(g_threadConfig.m_readThreads);
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_thread_pool_stats(ComapsThreadPoolStats* out_stats, int max_pools) {
+    AGUS_TRACE_FUNCTION("ffi");
+    auto const pools = agus::GetThreadPoolStats();
+    int const count = out_stats ? std::min(max_pools, static_cast<int>(pools.size())) : 0;
+    for (int i = 0; i < count; ++i) {
+        auto const & pool = pools[i];
+        ComapsThreadPoolStats & out = out_stats[i];
+        memset(out.name, 0, sizeof(out.name));
+        strncpy(out.name, pool.m_name.c_str(), sizeof(out.name) - 1);
+        out.threads = static_cast<int32_t>(pool.m_threads);
+        out.tasks_completed = static_cast<int64_t>(pool.m_tasksCompleted);
+        out.tasks_pending = static_cast<int64_t>(pool.m_tasksPending);
+        out.busy_us = static_cast<int64_t>(pool.m_busyMicros);
+        out.uptime_us = static_cast<int64_t>(pool.m_uptimeMicros);
+    }
+    return static_cast<int>(pools.size());
 }
 
 FFI_PLUGIN_EXPORT void comaps_load_map_path(const char* path) {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_load_map_path: %s", path);
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative", "comaps_load_map_path: %s", path);
     
     if (g_framework) {
         // Register maps from the writable directory
         // The framework will scan the writable path for .mwm files
         g_framework->RegisterAllMaps();
-        __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_load_map_path: Maps registered");
+        AGUS_LOGD("AgusMapsFlutterNative", "comaps_load_map_path: Maps registered");
     } else {
-        __android_log_print(ANDROID_LOG_WARN, "AgusMapsFlutterNative", "comaps_load_map_path: Framework not yet initialized, maps will be loaded later");
+        AGUS_LOGW("AgusMapsFlutterNative", "comaps_load_map_path: Framework not yet initialized, maps will be loaded later");
     }
 }
 
@@ -122,6 +208,8 @@ static int g_surfaceWidth = 0;
 static int g_surfaceHeight = 0;
 static float g_density = 2.0f;
 static bool g_drapeEngineCreated = false;
+// Set and cleared on the main thread with the surface; read elsewhere to skip Drape work.
+static std::atomic<bool> g_surfaceAttached{false};
 
 // Frame notification timing for 60fps rate limiting (Option 2)
 static std::chrono::steady_clock::time_point g_lastFrameNotification;
@@ -181,28 +269,60 @@ static void notifyFlutterFrameReady() {
     g_frameNotificationPending.store(false);
 }
 
+// Languages of a registered map, used to pick the fonts its labels need.
+static std::vector<std::string> getMwmLanguages(MwmInfo const & info) {
+    std::vector<int8_t> codes;
+    info.GetRegionData().GetLanguages(codes);
+    std::vector<std::string> languages;
+    for (int8_t const code : codes)
+        languages.emplace_back(StringUtf8Multilang::GetLangByCode(code));
+    return languages;
+}
+
+// Records the fonts a map registered mid-session needs. Drape builds its glyph manager
+// with the rendering context, from Platform::GetSystemFontNames, so fonts the running one
+// lacks are only opened when the context is next created (new surface, next launch);
+// rebuilding it now would redraw the whole map for a few labels.
+static void noteMissingFonts(MwmInfo const & info) {
+    if (!agus::RequireFontLanguages(getMwmLanguages(info))) {
+        return;
+    }
+    AGUS_LOGW("AgusMapsFlutterNative",
+        "%s needs fonts not loaded yet; its labels lack glyphs until the render context is recreated",
+        info.GetCountryName().c_str());
+}
+
 static void createDrapeEngineIfNeeded(int width, int height, float density) {
     if (g_drapeEngineCreated || !g_framework) {
         return;
     }
+    AGUS_TRACE_SCOPE("startup", "CreateDrapeEngine");
     
     if (width <= 0 || height <= 0) {
-        __android_log_print(ANDROID_LOG_WARN, "AgusMapsFlutterNative", "createDrapeEngine: Invalid dimensions %dx%d", width, height);
+        AGUS_LOGW("AgusMapsFlutterNative", "createDrapeEngine: Invalid dimensions %dx%d", width, height);
         return;
     }
     
     if (!g_factory) {
-        __android_log_print(ANDROID_LOG_WARN, "AgusMapsFlutterNative", "createDrapeEngine: Factory not valid");
+        AGUS_LOGW("AgusMapsFlutterNative", "createDrapeEngine: Factory not valid");
         return;
     }
     
     // Register active frame callback BEFORE creating DrapeEngine
     // This callback is invoked only when isActiveFrame is true (Option 3)
     df::SetActiveFrameCallback([]() {
+        agus::OnActiveFrame();
+        agus::OnStartupFrame();
         notifyFlutterFrameReady();
     });
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "createDrapeEngine: Active frame callback registered");
+    AGUS_LOGD("AgusMapsFlutterNative", "createDrapeEngine: Active frame callback registered");
     
+    // The glyph manager only opens fonts for scripts known by now (see agus_fonts.hpp).
+    std::vector<std::shared_ptr<MwmInfo>> mwms;
+    g_framework->GetDataSource().GetMwmsInfo(mwms);
+    for (auto const & info : mwms)
+        agus::RequireFontLanguages(getMwmLanguages(*info));
+
     Framework::DrapeCreationParams p;
     p.m_apiVersion = dp::ApiVersion::OpenGLES3;
     p.m_surfaceWidth = width;
@@ -212,23 +332,28 @@ static void createDrapeEngineIfNeeded(int width, int height, float density) {
     // Disable all widgets for now (require symbols.sdf which needs Qt6 to generate)
     // TODO: Generate symbols.sdf and enable widgets
     
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "createDrapeEngine: Creating with %dx%d, scale=%.2f", width, height, density);
-    g_framework->CreateDrapeEngine(make_ref(g_factory), std::move(p));
+    AGUS_LOGD("AgusMapsFlutterNative", "createDrapeEngine: Creating with %dx%d, scale=%.2f", width, height, density);
+    agus::OnDrapeEngineCreating();
+    {
+        agus::ScopedStartupPhase phase("CreateDrapeEngine");
+        g_framework->CreateDrapeEngine(make_ref(g_factory), std::move(p));
+    }
     g_drapeEngineCreated = true;
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "createDrapeEngine: Drape engine created successfully");
+    AGUS_LOGD("AgusMapsFlutterNative", "createDrapeEngine: Drape engine created successfully");
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeSetSurface(
     JNIEnv* env, jobject thiz, jlong textureId, jobject surface, jint width, jint height, jfloat density) {
+    AGUS_TRACE_SCOPE("jni", "nativeSetSurface");
     
     ANativeWindow* window = ANativeWindow_fromSurface(env, surface);
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", 
+    AGUS_LOGD("AgusMapsFlutterNative", 
         "nativeSetSurface: textureId=%ld, window=%p, size=%dx%d, density=%.2f", 
         textureId, window, width, height, density);
     
     if (!g_platformInitialized) {
-       __android_log_print(ANDROID_LOG_ERROR, "AgusMapsFlutterNative", "Platform not initialized! Call comaps_init_paths first.");
+       AGUS_LOGE("AgusMapsFlutterNative", "Platform not initialized! Call comaps_init_paths first.");
        if (window) ANativeWindow_release(window);
        return;
     }
@@ -236,31 +361,73 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeSetSurface(
     g_surfaceWidth = width;
     g_surfaceHeight = height;
     g_density = density;
+    agus::SetRenderSurfaceSize(width, height);
 
     // Create Framework on this thread if not already created
     // This ensures Framework and CreateDrapeEngine are on the same thread,
     // avoiding ThreadChecker assertion failures in BookmarkManager etc.
     if (!g_framework) {
-        __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "nativeSetSurface: Creating Framework...");
+        AGUS_LOGD("AgusMapsFlutterNative", "nativeSetSurface: Creating Framework...");
         
         FrameworkParams params;
+        // Storage's own diff pipeline needs CoMaps' map servers; maps downloaded through
+        // the plugin are updated from diffs by agus::StartMwmUpdate instead.
         params.m_enableDiffs = false;
-        params.m_numSearchAPIThreads = 1;
+        params.m_numSearchAPIThreads = g_threadConfig.m_searchThreads;
         
-        // Create framework, defer map loading
-        g_framework = std::make_unique<Framework>(params, false /* loadMaps */);
+        agus::BeginStartupTrace();
+        {
+            // Data files are read into the page cache while the constructor runs
+            agus::ScopedStartupPhase phase("Framework");
+            agus::StartupPreloader preloader(Platform::CpuCores());
+
+            // Create framework, defer map loading
+            g_framework = std::make_unique<Framework>(params, false /* loadMaps */);
+        }
+        
+        AGUS_LOGD("AgusMapsFlutterNative", "nativeSetSurface: Framework created");
         
-        __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "nativeSetSurface: Framework created");
+        // Lets the shared comaps_on_memory_pressure reach the framework and the surface
+        agus::SetEngineHost({
+            []() { return g_framework.get(); },
+            []() { return g_surfaceAttached && g_drapeEngineCreated; },
+            []() {
+                if (!g_surfaceAttached || !g_framework || !g_factory) {
+                    return false;
+                }
+                g_framework->SetRenderingDisabled(true /* destroySurface */);
+                g_framework->SetRenderingEnabled(make_ref(g_factory));
+                return true;
+            },
+        });
         
         // Now register maps
-        g_framework->RegisterAllMaps();
-        __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "nativeSetSurface: Maps registered");
+        if (agus::GetStartupMode() == agus::StartupMode::RenderFirst) {
+            // World maps draw the first frame; the rest register in view, or once it's up
+            agus::ScopedStartupPhase phase("RegisterWorldMapsOnly");
+            agus::RegisterWorldMapsOnly(*g_framework);
+        } else {
+            agus::ScopedStartupPhase phase("RegisterAllMaps");
+            g_framework->RegisterAllMaps();
+        }
+        // Off the GUI thread: registering hundreds of maps would stall gestures
+        agus::RunInBackgroundAfterFirstFrame("Register deferred maps", []() {
+            if (g_framework) {
+                agus::RegisterLazyMapsIn(*g_framework, mercator::Bounds::FullRect());
+            }
+        });
+        AGUS_LOGD("AgusMapsFlutterNative", "nativeSetSurface: Maps registered");
+        
+        // Maps recorded with comaps_register_map_lazy open on first use: in view, searched or routed through
+        agus::AttachLazyMaps(*g_framework, [](MwmSet::MwmId const & id) {
+            noteMissingFonts(*id.GetInfo());
+        });
     }
 
     // Create the OGL context factory with the native window
     auto oglFactory = new agus::AgusOGLContextFactory(window);
     if (!oglFactory->IsValid()) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusMapsFlutterNative", "nativeSetSurface: Invalid OGL context");
+        AGUS_LOGE("AgusMapsFlutterNative", "nativeSetSurface: Invalid OGL context");
         delete oglFactory;
         return;
     }
@@ -273,13 +440,15 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeSetSurface(
     
     // Create DrapeEngine with proper dimensions
     createDrapeEngineIfNeeded(width, height, density);
+    g_surfaceAttached = true;
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeOnSurfaceChanged(
     JNIEnv* env, jobject thiz, jlong textureId, jobject surface, jint width, jint height, jfloat density) {
+    AGUS_TRACE_SCOPE("jni", "nativeOnSurfaceChanged");
     
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", 
+    AGUS_LOGD("AgusMapsFlutterNative", 
         "nativeOnSurfaceChanged: size=%dx%d", width, height);
     
     ANativeWindow* window = ANativeWindow_fromSurface(env, surface);
@@ -287,6 +456,7 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeOnSurfaceChan
     g_surfaceWidth = width;
     g_surfaceHeight = height;
     g_density = density;
+    agus::SetRenderSurfaceSize(width, height);
     
     if (g_factory && g_framework) {
         // Re-enable rendering with new surface
@@ -296,6 +466,7 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeOnSurfaceChan
             // Note: This is a simplified approach - may need more work for proper surface recreation
             g_framework->SetRenderingEnabled(make_ref(g_factory));
             g_framework->OnSize(width, height);
+            g_surfaceAttached = true;
         }
     }
     
@@ -304,22 +475,27 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeOnSurfaceChan
 
 extern "C" JNIEXPORT void JNICALL
 Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeOnSurfaceDestroyed(JNIEnv* env, jobject thiz) {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "nativeOnSurfaceDestroyed");
+    AGUS_TRACE_SCOPE("jni", "nativeOnSurfaceDestroyed");
+    AGUS_LOGD("AgusMapsFlutterNative", "nativeOnSurfaceDestroyed");
     
+    g_surfaceAttached = false;
     if (g_framework) {
         g_framework->SetRenderingDisabled(true /* destroySurface */);
     }
+    agus::SetRenderSurfaceSize(0, 0);
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeOnSizeChanged(
     JNIEnv* env, jobject thiz, jint width, jint height) {
+    AGUS_TRACE_SCOPE("jni", "nativeOnSizeChanged");
     
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", 
+    AGUS_LOGD("AgusMapsFlutterNative", 
         "nativeOnSizeChanged: %dx%d", width, height);
     
     g_surfaceWidth = width;
     g_surfaceHeight = height;
+    agus::SetRenderSurfaceSize(width, height);
     
     if (g_framework && g_drapeEngineCreated) {
         g_framework->OnSize(width, height);
@@ -327,7 +503,8 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeOnSizeChanged
 }
 
 FFI_PLUGIN_EXPORT void comaps_set_view(double lat, double lon, int zoom) {
-     __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", "comaps_set_view: lat=%f, lon=%f, zoom=%d", lat, lon, zoom);
+    AGUS_TRACE_FUNCTION("ffi");
+     AGUS_LOGD("AgusMapsFlutterNative", "comaps_set_view: lat=%f, lon=%f, zoom=%d", lat, lon, zoom);
      if (g_framework) {
          g_framework->SetViewportCenter(m2::PointD(mercator::FromLatLon(lat, lon)), zoom);
      }
@@ -335,6 +512,7 @@ FFI_PLUGIN_EXPORT void comaps_set_view(double lat, double lon, int zoom) {
 // Touch event types matching df::TouchEvent::ETouchType
 // 0 = TOUCH_NONE, 1 = TOUCH_DOWN, 2 = TOUCH_MOVE, 3 = TOUCH_UP, 4 = TOUCH_CANCEL
 FFI_PLUGIN_EXPORT void comaps_touch(int type, int id1, float x1, float y1, int id2, float x2, float y2) {
+    AGUS_TRACE_FUNCTION("ffi");
     if (!g_framework || !g_drapeEngineCreated) {
         return;
     }
@@ -372,11 +550,12 @@ FFI_PLUGIN_EXPORT void comaps_touch(int type, int id1, float x1, float y1, int i
 // This bypasses the version folder scanning and registers the map file
 // directly with the rendering engine using LocalCountryFile::MakeTemporary.
 FFI_PLUGIN_EXPORT int comaps_register_single_map(const char* fullPath) {
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", 
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative", 
         "comaps_register_single_map: %s", fullPath);
     
     if (!g_framework) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusMapsFlutterNative", 
+        AGUS_LOGE("AgusMapsFlutterNative", 
             "comaps_register_single_map: Framework not initialized");
         return -1;  // Error: Framework not ready
     }
@@ -387,29 +566,584 @@ FFI_PLUGIN_EXPORT int comaps_register_single_map(const char* fullPath) {
         
         auto result = g_framework->RegisterMap(file);
         if (result.second == MwmSet::RegResult::Success) {
-            __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+            AGUS_LOGI("AgusMapsFlutterNative", 
                 "comaps_register_single_map: Successfully registered %s", fullPath);
+            noteMissingFonts(*result.first.GetInfo());
             return 0;  // Success
         } else {
-            __android_log_print(ANDROID_LOG_WARN, "AgusMapsFlutterNative", 
+            AGUS_LOGW("AgusMapsFlutterNative", 
                 "comaps_register_single_map: Failed to register %s, result=%d", 
                 fullPath, static_cast<int>(result.second));
             return static_cast<int>(result.second);
         }
     } catch (std::exception const & e) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusMapsFlutterNative", 
+        AGUS_LOGE("AgusMapsFlutterNative", 
             "comaps_register_single_map: Exception: %s", e.what());
         return -2;  // Error: Exception
     }
 }
 
+FFI_PLUGIN_EXPORT int comaps_register_map_in_archive(const char* archivePath, const char* entryName) {
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative",
+        "comaps_register_map_in_archive: %s in %s", entryName, archivePath);
+
+    if (!g_framework) {
+        AGUS_LOGE("AgusMapsFlutterNative",
+            "comaps_register_map_in_archive: Framework not initialized");
+        return -1;
+    }
+
+    try {
+        auto entry = agus::LocateStoredEntry(archivePath, entryName);
+        if (!entry) {
+            AGUS_LOGW("AgusMapsFlutterNative",
+                "comaps_register_map_in_archive: %s is missing or compressed in %s", entryName, archivePath);
+            return -3;
+        }
+
+        // Platform::GetReader serves this path from the entry's byte range.
+        std::string const path = agus::AddArchiveMap(std::move(*entry));
+        platform::LocalCountryFile file = platform::LocalCountryFile::MakeTemporary(path);
+        file.SyncWithDisk();
+
+        auto result = g_framework->RegisterMap(file);
+        if (result.second == MwmSet::RegResult::Success) {
+            AGUS_LOGI("AgusMapsFlutterNative",
+                "comaps_register_map_in_archive: Successfully registered %s", path.c_str());
+            noteMissingFonts(*result.first.GetInfo());
+            return 0;
+        }
+        AGUS_LOGW("AgusMapsFlutterNative",
+            "comaps_register_map_in_archive: Failed to register %s, result=%d",
+            path.c_str(), static_cast<int>(result.second));
+        return static_cast<int>(result.second);
+    } catch (std::exception const & e) {
+        AGUS_LOGE("AgusMapsFlutterNative",
+            "comaps_register_map_in_archive: Exception: %s", e.what());
+        return -2;
+    }
+}
+
+FFI_PLUGIN_EXPORT int comaps_register_map_lazy(const char* fullPath) {
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative", 
+        "comaps_register_map_lazy: %s", fullPath);
+    return agus::AddLazyMap(fullPath) ? 0 : -2;
+}
+
+FFI_PLUGIN_EXPORT int comaps_register_maps_lazy(const char* const* fullPaths, int count, int use_snapshot,
+                                                ComapsLazyBatchStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::vector<std::string> paths;
+    for (int i = 0; fullPaths && i < count; ++i) {
+        if (fullPaths[i]) {
+            paths.emplace_back(fullPaths[i]);
+        }
+    }
+    
+    agus::LazyBatchStats const stats = agus::AddLazyMaps(paths, use_snapshot != 0);
+    if (out_stats) {
+        out_stats->recorded = static_cast<int32_t>(stats.m_recorded);
+        out_stats->failed = static_cast<int32_t>(stats.m_failed);
+        out_stats->from_snapshot = static_cast<int32_t>(stats.m_fromSnapshot);
+        out_stats->elapsed_us = static_cast<int64_t>(stats.m_elapsedMicros);
+    }
+    AGUS_LOGI("AgusMapsFlutterNative", 
+        "comaps_register_maps_lazy: %s", agus::DebugPrint(stats).c_str());
+    return static_cast<int>(stats.m_recorded);
+}
+
+FFI_PLUGIN_EXPORT int comaps_register_maps_in_rect(double min_lat, double min_lon, double max_lat, double max_lon) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_register_maps_in_rect: Framework not initialized");
+        return -1;
+    }
+    m2::RectD const rect(mercator::FromLatLon(min_lat, min_lon), mercator::FromLatLon(max_lat, max_lon));
+    return static_cast<int>(agus::RegisterLazyMapsIn(*g_framework, rect));
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_pending_maps_count(void) {
+    AGUS_TRACE_FUNCTION("ffi");
+    return static_cast<int>(agus::GetPendingLazyMapsCount());
+}
+
+FFI_PLUGIN_EXPORT int comaps_deregister_map(const char* fullPath) {
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative", 
+        "comaps_deregister_map: %s", fullPath);
+    
+    if (!g_framework) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_deregister_map: Framework not initialized");
+        return -1;
+    }
+    
+    try {
+        if (!agus::DeregisterMap(*g_framework, fullPath)) {
+            AGUS_LOGW("AgusMapsFlutterNative", 
+                "comaps_deregister_map: %s is not registered", fullPath);
+            return -1;
+        }
+        return 0;
+    } catch (std::exception const & e) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_deregister_map: Exception: %s", e.what());
+        return -2;
+    }
+}
+
+// Swap in a new version of a registered map, see agus::ReplaceMap.
+FFI_PLUGIN_EXPORT int comaps_replace_map(const char* fullPath, ComapsMapReplaceResult* out_result) {
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGD("AgusMapsFlutterNative", 
+        "comaps_replace_map: %s", fullPath);
+    
+    if (!g_framework) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_replace_map: Framework not initialized");
+        return -1;
+    }
+    
+    try {
+        // ReplaceMap registers the new file while the old one is still open: they can't be one file.
+        if (agus::IsRegisteredMapFile(*g_framework, fullPath)) {
+            AGUS_LOGE("AgusMapsFlutterNative",
+                "comaps_replace_map: %s is the registered file", fullPath);
+            return -3;
+        }
+        agus::MapReplaceResult const result = agus::ReplaceMap(*g_framework, fullPath);
+        if (out_result) {
+            out_result->result = static_cast<int32_t>(result.m_result);
+            out_result->old_version = result.m_oldVersion;
+            out_result->new_version = result.m_newVersion;
+            out_result->swap_us = static_cast<int64_t>(result.m_swapMicros);
+            out_result->invalidate_us = static_cast<int64_t>(result.m_invalidateMicros);
+        }
+        AGUS_LOGI("AgusMapsFlutterNative", 
+            "comaps_replace_map: %s %s", fullPath, agus::DebugPrint(result).c_str());
+        return static_cast<int>(result.m_result);
+    } catch (std::exception const & e) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_replace_map: Exception: %s", e.what());
+        return -2;
+    }
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_memory_info(char* buffer, int buffer_size) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::string const info = GetPlatform().GetMemoryInfo();
+    if (buffer && buffer_size > 0) {
+        size_t const n = std::min(info.size(), static_cast<size_t>(buffer_size - 1));
+        memcpy(buffer, info.data(), n);
+        buffer[n] = '\0';
+    }
+    return static_cast<int>(info.size());
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_startup_trace(char* buffer, int buffer_size) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::string const trace = agus::GetStartupTraceJson();
+    if (buffer && buffer_size > 0) {
+        size_t const n = std::min(trace.size(), static_cast<size_t>(buffer_size - 1));
+        memcpy(buffer, trace.data(), n);
+        buffer[n] = '\0';
+    }
+    return static_cast<int>(trace.size());
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_startup_mode(int mode) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::SetStartupMode(mode == 1 ? agus::StartupMode::RenderFirst : agus::StartupMode::Full);
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_startup_report(ComapsStartupReport* out_report) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::StartupReport const report = agus::GetStartupReport();
+    if (out_report) {
+        out_report->mode = static_cast<int32_t>(report.m_mode);
+        out_report->deferred_tasks = static_cast<int32_t>(report.m_deferredTasks);
+        out_report->first_frame_us = report.m_firstFrameMicros;
+        out_report->framework_us = report.m_frameworkMicros;
+        out_report->deferred_us = report.m_deferredMicros;
+    }
+    return report.m_firstFrameMicros >= 0 ? 0 : -1;
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_file_pool_limit(int limit) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::SetFilePoolLimit(static_cast<size_t>(std::max(limit, 1)));
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_file_pool_stats(ComapsFilePoolStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::FilePoolStats const stats = agus::GetFilePoolStats();
+    if (out_stats) {
+        out_stats->limit = static_cast<int32_t>(stats.m_limit);
+        out_stats->files = static_cast<int32_t>(stats.m_files);
+        out_stats->open_descriptors = static_cast<int32_t>(stats.m_openDescriptors);
+        out_stats->opens = static_cast<int64_t>(stats.m_opens);
+        out_stats->reopens = static_cast<int64_t>(stats.m_reopens);
+        out_stats->evictions = static_cast<int64_t>(stats.m_evictions);
+    }
+    return 0;
+}
+
+FFI_PLUGIN_EXPORT int comaps_set_resource_pack(const char* path, int64_t offset) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!path || offset < 0)
+        return -1;
+    return agus::SetResourcePack(path, static_cast<uint64_t>(offset)) ? 0 : -1;
+}
+
+static int fillFrameStats(agus::FirstFrameStats const & stats, ComapsFirstFrameStats* out_stats) {
+    if (out_stats) {
+        out_stats->first_frame_us = stats.m_firstFrameMicros;
+        out_stats->settled_frame_us = stats.m_settledFrameMicros;
+        out_stats->frames = static_cast<int32_t>(stats.m_frames);
+        out_stats->max_frame_gap_us = stats.m_maxFrameGapMicros;
+    }
+    return stats.m_firstFrameMicros >= 0 ? 0 : -1;
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_first_frame_stats(ComapsFirstFrameStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    return fillFrameStats(agus::GetFirstFrameStats(), out_stats);
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_map_replace_frame_stats(ComapsFirstFrameStats* out_stats) {
+    AGUS_TRACE_FUNCTION("ffi");
+    return fillFrameStats(agus::GetMapReplaceFrameStats(), out_stats);
+}
+
+static void fillStyleSwitchResult(agus::StyleSwitchResult const & result, ComapsStyleSwitchResult* out_result) {
+    if (out_result) {
+        out_result->dark = result.m_dark ? 1 : 0;
+        out_result->mapped = result.m_mapped ? 1 : 0;
+        out_result->changed = result.m_changed ? 1 : 0;
+        out_result->apply_us = static_cast<int64_t>(result.m_applyMicros);
+        out_result->mapped_bytes = static_cast<int64_t>(result.m_mappedBytes);
+    }
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_keep_style_files_mapped(int enabled) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::SetKeepStyleFilesMapped(enabled != 0);
+}
+
+FFI_PLUGIN_EXPORT int comaps_set_map_style(int dark, ComapsStyleSwitchResult* out_result) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_set_map_style: Framework not initialized");
+        return -1;
+    }
+    
+    try {
+        agus::StyleSwitchResult const result = agus::SwitchMapStyle(*g_framework, dark != 0);
+        fillStyleSwitchResult(result, out_result);
+        AGUS_LOGI("AgusMapsFlutterNative", 
+            "comaps_set_map_style: %s", agus::DebugPrint(result).c_str());
+        return 0;
+    } catch (std::exception const & e) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_set_map_style: Exception: %s", e.what());
+        return -2;
+    }
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_style_switch_stats(int mapped, ComapsStyleSwitchResult* out_result,
+                                                    ComapsFirstFrameStats* out_frames) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::StyleSwitchResult const result = agus::GetLastStyleSwitch(mapped != 0);
+    fillStyleSwitchResult(result, out_result);
+    fillFrameStats(agus::GetStyleSwitchFrameStats(mapped != 0), out_frames);
+    return result.m_changed ? 0 : -1;
+}
+
+FFI_PLUGIN_EXPORT int comaps_hash_files(const char* const* paths, int count, uint8_t* out_digests,
+                                        ComapsHashProgressCallback progress) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!paths || count < 0 || (count > 0 && !out_digests)) {
+        return -1;
+    }
+    std::vector<std::string> files;
+    files.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        files.emplace_back(paths[i] ? paths[i] : "");
+    }
+    
+    auto const digests = agus::HashFiles(files, std::thread::hardware_concurrency(),
+        [progress](size_t index, agus::HashStatus status, uint64_t bytes) {
+            if (progress) {
+                progress(static_cast<int32_t>(index), static_cast<int32_t>(status), static_cast<int64_t>(bytes));
+            }
+        });
+    
+    int failed = 0;
+    for (int i = 0; i < count; ++i) {
+        uint8_t* out = out_digests + static_cast<size_t>(i) * sizeof(agus::Sha256Digest);
+        if (digests[i]) {
+            std::memcpy(out, digests[i]->data(), digests[i]->size());
+        } else {
+            std::memset(out, 0, sizeof(agus::Sha256Digest));
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_font_languages(const char* languages) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::set<std::string> parsed;
+    std::string const list = languages ? languages : "";
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t const end = std::min(list.find(',', begin), list.size());
+        if (end > begin)
+            parsed.insert(list.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    agus::SetFontLanguages(parsed);
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_download_file(const char* url, const char* file_path, int64_t file_size,
+                                               int segments) {
+    AGUS_TRACE_FUNCTION("ffi");
+    return agus::StartFileDownload(url, file_path, file_size, static_cast<unsigned>(std::max(segments, 1)));
+}
+
+FFI_PLUGIN_EXPORT int comaps_download_get_progress(int64_t id, ComapsDownloadProgress* out_progress) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::FileDownloadProgress const progress = agus::GetFileDownloadProgress(id);
+    if (progress.m_status == agus::FileDownloadStatus::Unknown)
+        return -1;
+    if (out_progress) {
+        out_progress->status = static_cast<int32_t>(progress.m_status);
+        out_progress->bytes_downloaded = progress.m_bytesDownloaded;
+        out_progress->bytes_total = progress.m_bytesTotal;
+    }
+    return 0;
+}
+
+FFI_PLUGIN_EXPORT void comaps_download_cancel(int64_t id) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::CancelFileDownload(id);
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_update_map(const ComapsMapUpdateRequest* request) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework || !request || !request->old_path || !request->new_path || !request->full_url) {
+        return -1;
+    }
+    agus::MwmUpdateRequest update;
+    update.m_oldPath = request->old_path;
+    update.m_newPath = request->new_path;
+    update.m_diffUrl = request->diff_url ? request->diff_url : "";
+    update.m_diffSize = request->diff_size;
+    update.m_fullUrl = request->full_url;
+    update.m_fullSize = request->full_size;
+    update.m_sha256 = request->sha256 ? request->sha256 : "";
+    return agus::StartMwmUpdate(*g_framework, std::move(update));
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_map_update_progress(int64_t id, ComapsMapUpdateProgress* out_progress) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::MwmUpdateProgress const progress = agus::GetMwmUpdateProgress(id);
+    if (out_progress) {
+        out_progress->status = static_cast<int32_t>(progress.m_status);
+        out_progress->diff_failure = static_cast<int32_t>(progress.m_diffFailure);
+        out_progress->reg_result = progress.m_regResult;
+        out_progress->downloaded_bytes = progress.m_downloadedBytes;
+        out_progress->full_bytes = progress.m_fullBytes;
+        out_progress->bytes_saved = progress.m_bytesSaved;
+        out_progress->apply_us = static_cast<int64_t>(progress.m_applyMicros);
+        out_progress->verify_us = static_cast<int64_t>(progress.m_verifyMicros);
+        out_progress->total_us = static_cast<int64_t>(progress.m_totalMicros);
+    }
+    return progress.m_status == agus::MwmUpdateStatus::Unknown ? -1 : 0;
+}
+
+FFI_PLUGIN_EXPORT void comaps_cancel_map_update(int64_t id) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::CancelMwmUpdate(id);
+}
+
+FFI_PLUGIN_EXPORT void comaps_set_map_fetch_budget(const ComapsMapFetchBudget* budget) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!budget) {
+        return;
+    }
+    agus::MapFetchBudget limits;
+    limits.m_maxConcurrent = static_cast<unsigned>(std::max(budget->max_concurrent, 1));
+    limits.m_maxBytesPerSecond = budget->max_bytes_per_second;
+    limits.m_maxUnsyncedBytes = budget->max_unsynced_bytes;
+    agus::SetMapFetchBudget(limits);
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_fetch_map(const char* url, const char* file_path, int64_t file_size,
+                                           const char* sha256, int register_map) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!url || !file_path || file_size <= 0) {
+        return -1;
+    }
+    if (register_map && !g_framework) {
+        AGUS_LOGE("AgusMapsFlutterNative",
+            "comaps_fetch_map: Framework not initialized");
+        return -1;
+    }
+    agus::MapFetchRequest request;
+    request.m_url = url;
+    request.m_path = file_path;
+    request.m_size = file_size;
+    request.m_sha256 = sha256 ? sha256 : "";
+    return agus::StartMapFetch(register_map ? g_framework.get() : nullptr, std::move(request));
+}
+
+FFI_PLUGIN_EXPORT int comaps_get_map_fetch_progress(int64_t id, ComapsMapFetchProgress* out_progress) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::MapFetchProgress const progress = agus::GetMapFetchProgress(id);
+    if (out_progress) {
+        out_progress->status = static_cast<int32_t>(progress.m_status);
+        out_progress->failure = static_cast<int32_t>(progress.m_failure);
+        out_progress->reg_result = progress.m_regResult;
+        out_progress->bytes_written = progress.m_bytesWritten;
+        out_progress->bytes_total = progress.m_bytesTotal;
+        out_progress->resumed_bytes = progress.m_resumedBytes;
+        out_progress->throttled_us = static_cast<int64_t>(progress.m_throttledMicros);
+        out_progress->download_us = static_cast<int64_t>(progress.m_downloadMicros);
+        out_progress->sync_us = static_cast<int64_t>(progress.m_syncMicros);
+        out_progress->register_us = static_cast<int64_t>(progress.m_registerMicros);
+        out_progress->total_us = static_cast<int64_t>(progress.m_totalMicros);
+        size_t const n = std::min(progress.m_sha256.size(), sizeof(out_progress->sha256) - 1);
+        memcpy(out_progress->sha256, progress.m_sha256.data(), n);
+        out_progress->sha256[n] = '\0';
+    }
+    return progress.m_status == agus::MapFetchStatus::Unknown ? -1 : 0;
+}
+
+FFI_PLUGIN_EXPORT void comaps_cancel_map_fetch(int64_t id) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::CancelMapFetch(id);
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_download_from_mirrors(const char* const* urls, int url_count,
+                                                       const char* file_path, int64_t file_size,
+                                                       int connections_per_mirror) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!urls || url_count <= 0 || !file_path || file_size <= 0) {
+        return -1;
+    }
+    std::vector<std::string> mirrors;
+    for (int i = 0; i < url_count; ++i) {
+        mirrors.emplace_back(urls[i] ? urls[i] : "");
+    }
+    return agus::StartMirrorDownload(mirrors, file_path, file_size,
+                                     static_cast<unsigned>(std::max(connections_per_mirror, 1)));
+}
+
+FFI_PLUGIN_EXPORT int comaps_mirror_download_get_progress(int64_t id, ComapsDownloadProgress* out_progress,
+                                                          ComapsMirrorStats* out_mirrors, int mirror_count) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::vector<agus::MirrorStats> mirrors;
+    agus::FileDownloadProgress const progress = agus::GetMirrorDownloadProgress(id, &mirrors);
+    if (progress.m_status == agus::FileDownloadStatus::Unknown)
+        return -1;
+    if (out_progress) {
+        out_progress->status = static_cast<int32_t>(progress.m_status);
+        out_progress->bytes_downloaded = progress.m_bytesDownloaded;
+        out_progress->bytes_total = progress.m_bytesTotal;
+    }
+    for (int i = 0; out_mirrors && i < mirror_count && i < static_cast<int>(mirrors.size()); ++i) {
+        ComapsMirrorStats & out = out_mirrors[i];
+        out.bytes = mirrors[i].m_bytes;
+        out.bytes_per_second = mirrors[i].m_bytesPerSecond;
+        out.first_byte_us = static_cast<int64_t>(mirrors[i].m_firstByteMicros);
+        out.ranges = static_cast<int32_t>(mirrors[i].m_ranges);
+        out.steals = static_cast<int32_t>(mirrors[i].m_steals);
+        out.errors = static_cast<int32_t>(mirrors[i].m_errors);
+        out.disabled = mirrors[i].m_disabled ? 1 : 0;
+    }
+    return 0;
+}
+
+FFI_PLUGIN_EXPORT void comaps_mirror_download_cancel(int64_t id) {
+    AGUS_TRACE_FUNCTION("ffi");
+    agus::CancelMirrorDownload(id);
+}
+
+FFI_PLUGIN_EXPORT void comaps_trace_start(int max_events_per_thread) {
+    agus::StartTrace(max_events_per_thread > 0 ? static_cast<size_t>(max_events_per_thread)
+                                               : agus::kDefaultTraceEventsPerThread);
+}
+
+FFI_PLUGIN_EXPORT void comaps_trace_stop(void) {
+    agus::StopTrace();
+}
+
+FFI_PLUGIN_EXPORT int64_t comaps_trace_dump(const char* path) {
+    if (!path) {
+        return -1;
+    }
+    return agus::WriteTraceJson(path);
+}
+
+FFI_PLUGIN_EXPORT int comaps_metrics_snapshot(char* buffer, int buffer_size) {
+    AGUS_TRACE_FUNCTION("ffi");
+    std::string const snapshot = agus::GetMetricsSnapshotJson();
+    if (buffer && buffer_size > 0) {
+        size_t const n = std::min(snapshot.size(), static_cast<size_t>(buffer_size - 1));
+        memcpy(buffer, snapshot.data(), n);
+        buffer[n] = '\0';
+    }
+    return static_cast<int>(snapshot.size());
+}
+
+// Batch point lookup over registered region maps, see agus::FindMwmsAt.
+FFI_PLUGIN_EXPORT int comaps_find_mwms_at(const ComapsLatLon* points, int count, ComapsMwmHit* out_hits) {
+    AGUS_TRACE_FUNCTION("ffi");
+    if (!g_framework) {
+        AGUS_LOGE("AgusMapsFlutterNative", 
+            "comaps_find_mwms_at: Framework not initialized");
+        return -1;
+    }
+    if (!points || !out_hits || count <= 0) {
+        return 0;
+    }
+    
+    std::vector<m2::PointD> mercatorPoints;
+    mercatorPoints.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        mercatorPoints.push_back(mercator::FromLatLon(points[i].lat, points[i].lon));
+    }
+    
+    std::vector<agus::MwmHit> hits;
+    agus::FindMwmsAt(g_framework->GetDataSource(), mercatorPoints, hits);
+    
+    int covered = 0;
+    for (int i = 0; i < count; ++i) {
+        ComapsMwmHit & out = out_hits[i];
+        size_t const n = std::min(hits[i].m_countryName.size(), sizeof(out.country_name) - 1);
+        memcpy(out.country_name, hits[i].m_countryName.data(), n);
+        out.country_name[n] = '\0';
+        out.version = hits[i].m_version;
+        if (n > 0) {
+            ++covered;
+        }
+    }
+    return covered;
+}
+
 // Debug function to list all registered MWMs and their bounds
 FFI_PLUGIN_EXPORT void comaps_debug_list_mwms() {
-    __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGI("AgusMapsFlutterNative", 
         "=== DEBUG: Listing all registered MWMs ===");
     
     if (!g_framework) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusMapsFlutterNative", 
+        AGUS_LOGE("AgusMapsFlutterNative", 
             "comaps_debug_list_mwms: Framework not initialized");
         return;
     }
@@ -418,7 +1152,7 @@ FFI_PLUGIN_EXPORT void comaps_debug_list_mwms() {
     std::vector<std::shared_ptr<MwmInfo>> mwms;
     dataSource.GetMwmsInfo(mwms);
     
-    __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+    AGUS_LOGI("AgusMapsFlutterNative", 
         "Total registered MWMs: %zu", mwms.size());
     
     for (auto const & info : mwms) {
@@ -430,7 +1164,7 @@ FFI_PLUGIN_EXPORT void comaps_debug_list_mwms() {
             case MwmInfo::WORLD: typeStr = "WORLD"; break;
         }
         
-        __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+        AGUS_LOGI("AgusMapsFlutterNative", 
             "  MWM: %s [%s] version=%lld scales=[%d-%d] bounds=[%.4f,%.4f - %.4f,%.4f] status=%d",
             info->GetCountryName().c_str(),
             typeStr,
@@ -442,24 +1176,25 @@ FFI_PLUGIN_EXPORT void comaps_debug_list_mwms() {
             static_cast<int>(info->GetStatus()));
     }
     
-    __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+    AGUS_LOGI("AgusMapsFlutterNative", 
         "=== END MWM list ===");
 }
 
 // Debug function to check if a point is covered by any MWM
 FFI_PLUGIN_EXPORT void comaps_debug_check_point(double lat, double lon) {
-    __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+    AGUS_TRACE_FUNCTION("ffi");
+    AGUS_LOGI("AgusMapsFlutterNative", 
         "=== DEBUG: Checking point coverage lat=%.6f, lon=%.6f ===", lat, lon);
     
     if (!g_framework) {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusMapsFlutterNative", 
+        AGUS_LOGE("AgusMapsFlutterNative", 
             "comaps_debug_check_point: Framework not initialized");
         return;
     }
     
     // Convert to Mercator coordinates (what the engine uses internally)
     m2::PointD const pt = mercator::FromLatLon(lat, lon);
-    __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+    AGUS_LOGI("AgusMapsFlutterNative", 
         "Mercator coords: x=%.6f, y=%.6f", pt.x, pt.y);
     
     auto const & dataSource = g_framework->GetDataSource();
@@ -470,7 +1205,7 @@ FFI_PLUGIN_EXPORT void comaps_debug_check_point(double lat, double lon) {
     for (auto const & info : mwms) {
         if (info->m_bordersRect.IsPointInside(pt)) {
             coveringCount++;
-            __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+            AGUS_LOGI("AgusMapsFlutterNative", 
                 "  COVERS: %s [scales %d-%d]",
                 info->GetCountryName().c_str(),
                 info->m_minScale, info->m_maxScale);
@@ -478,14 +1213,14 @@ FFI_PLUGIN_EXPORT void comaps_debug_check_point(double lat, double lon) {
     }
     
     if (coveringCount == 0) {
-        __android_log_print(ANDROID_LOG_WARN, "AgusMapsFlutterNative", 
+        AGUS_LOGW("AgusMapsFlutterNative", 
             "  NO MWM covers this point!");
     } else {
-        __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+        AGUS_LOGI("AgusMapsFlutterNative", 
             "Point covered by %d MWMs", coveringCount);
     }
     
-    __android_log_print(ANDROID_LOG_INFO, "AgusMapsFlutterNative", 
+    AGUS_LOGI("AgusMapsFlutterNative", 
         "=== END point check ===");
 }
 
@@ -505,10 +1240,10 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeInitFrameCall
     g_notifyFrameReadyMethod = env->GetMethodID(cls, "onFrameReady", "()V");
     
     if (g_notifyFrameReadyMethod) {
-        __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", 
+        AGUS_LOGD("AgusMapsFlutterNative", 
             "nativeInitFrameCallback: Frame notification callback initialized");
     } else {
-        __android_log_print(ANDROID_LOG_ERROR, "AgusMapsFlutterNative", 
+        AGUS_LOGE("AgusMapsFlutterNative", 
             "nativeInitFrameCallback: Failed to find onFrameReady method");
     }
 }
@@ -527,6 +1262,6 @@ Java_app_agus_maps_agus_1maps_1flutter_AgusMapsFlutterPlugin_nativeCleanupFrameC
     // Clear the active frame callback
     df::SetActiveFrameCallback(nullptr);
     
-    __android_log_print(ANDROID_LOG_DEBUG, "AgusMapsFlutterNative", 
+    AGUS_LOGD("AgusMapsFlutterNative", 
         "nativeCleanupFrameCallback: Frame notification callback cleaned up");
 }
\ No newline at end of file
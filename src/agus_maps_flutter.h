@@ -35,6 +35,41 @@ FFI_PLUGIN_EXPORT int sum_long_running(int a, int b);
 
 FFI_PLUGIN_EXPORT void comaps_init(const char* apkPath, const char* storagePath);
 FFI_PLUGIN_EXPORT void comaps_init_paths(const char* resourcePath, const char* writablePath);
+
+// Thread budget for search, Drape's tile readers and platform worker pools.
+// Any field <= 0 is sized automatically from the number of CPU cores.
+// file_threads is always 1: the file pool runs its tasks serially.
+typedef struct {
+  int32_t search_threads;
+  int32_t network_threads;
+  int32_t file_threads;
+  int32_t background_threads;
+  int32_t read_threads;
+} ComapsThreadConfig;
+
+// Same as comaps_init_paths, with an explicit thread budget (config may be NULL).
+// Platform pools are only resized on Android; other platforms honour search_threads
+// and read_threads.
+FFI_PLUGIN_EXPORT void comaps_init_paths_with_config(const char* resourcePath, const char* writablePath,
+                                                     const ComapsThreadConfig* config);
+
+// Write the effective (resolved) thread budget into out_config.
+FFI_PLUGIN_EXPORT void comaps_get_thread_config(ComapsThreadConfig* out_config);
+
+// Utilization counters of one worker pool.
+typedef struct {
+  char name[16];
+  int32_t threads;
+  int64_t tasks_completed;
+  int64_t tasks_pending;
+  int64_t busy_us;
+  int64_t uptime_us;
+} ComapsThreadPoolStats;
+
+// Fill up to max_pools entries of out_stats.
+// Returns: number of instrumented pools (may exceed max_pools)
+FFI_PLUGIN_EXPORT int comaps_get_thread_pool_stats(ComapsThreadPoolStats* out_stats, int max_pools);
+
 FFI_PLUGIN_EXPORT void comaps_load_map_path(const char* path);
 
 FFI_PLUGIN_EXPORT void comaps_set_view(double lat, double lon, int zoom);
@@ -52,10 +87,394 @@ FFI_PLUGIN_EXPORT void comaps_touch(int type, int id1, float x1, float y1, int i
 //          or MwmSet::RegResult value on registration failure
 FFI_PLUGIN_EXPORT int comaps_register_single_map(const char* fullPath);
 
+// Register an MWM stored uncompressed in a zip archive (e.g. an APK asset kept out
+// of compression with noCompress("mwm")) and read it in place, without extracting.
+// entryName is the path inside the archive, e.g. "assets/flutter_assets/assets/maps/World.mwm".
+// Android only; other platforms bundle maps as plain files.
+// Returns: as comaps_register_single_map, or -3 if the entry is missing or compressed
+FFI_PLUGIN_EXPORT int comaps_register_map_in_archive(const char* archivePath, const char* entryName);
+
+// Record an MWM file for lazy registration: only its bounds and version are read
+// now. It is registered (opened) in the background when the viewport first shows
+// it at a zoom where region maps are drawn, before a search that reads it, when a
+// route needs it, or when comaps_register_maps_in_rect covers it.
+// May be called before the map surface exists.
+// Returns: 0 on success, -2 if the file header can't be read
+FFI_PLUGIN_EXPORT int comaps_register_map_lazy(const char* fullPath);
+
+// Outcome of comaps_register_maps_lazy.
+typedef struct {
+  int32_t recorded;
+  int32_t failed;           // files missing or with unreadable headers
+  int32_t from_snapshot;    // maps recorded from the registration snapshot without opening them
+  int64_t elapsed_us;
+} ComapsLazyBatchStats;
+
+// comaps_register_map_lazy for count files at once. Bounds and versions of files
+// unchanged since an earlier launch (same path, size and mtime) come from a
+// snapshot in the writable directory, so no file is opened now; each is still read
+// in full when registered. use_snapshot=0 reads every header instead, e.g. to
+// benchmark a launch without the snapshot.
+// out_stats may be NULL.
+// Returns: number of maps recorded
+FFI_PLUGIN_EXPORT int comaps_register_maps_lazy(const char* const* fullPaths, int count, int use_snapshot,
+                                                ComapsLazyBatchStats* out_stats);
+
+// Register the lazily recorded maps intersecting the given area on the calling
+// thread, e.g. to have them open before the viewport moves there.
+// Returns: number of maps registered, -1 if framework not ready
+FFI_PLUGIN_EXPORT int comaps_register_maps_in_rect(double min_lat, double min_lon, double max_lat, double max_lon);
+
+// Returns: number of lazily recorded maps not registered yet
+FFI_PLUGIN_EXPORT int comaps_get_pending_maps_count(void);
+
+// Deregister the map of the country named by fullPath's file name (e.g. "Spain.mwm")
+// and re-render its tiles.
+// Returns: 0 on success, -1 if framework not ready or no such map is registered, -2 on exception
+FFI_PLUGIN_EXPORT int comaps_deregister_map(const char* fullPath);
+
+// Outcome of comaps_replace_map.
+typedef struct {
+  int32_t result;          // MwmSet::RegResult, 0 on success
+  int64_t old_version;     // data version of the replaced map, -1 if none was registered
+  int64_t new_version;     // data version of the new file
+  int64_t swap_us;         // time map data access was blocked by the swap
+  int64_t invalidate_us;   // time spent invalidating the region's tiles
+} ComapsMapReplaceResult;
+
+// Replace the registered map of the same country with the file at fullPath without
+// restarting the engine. A newer data version replaces the old one in one step; the
+// same or an older one is registered after the old one goes, and fails while reads
+// still hold the old file. Reads in flight keep the old version until they finish,
+// and only tiles within the old and new map bounds are re-rendered.
+// fullPath must differ from the registered file's path; delete the old file afterwards.
+// out_result may be NULL.
+// Returns: 0 on success, -1 if framework not ready, -2 on exception,
+//          -3 if fullPath is the registered file,
+//          or MwmSet::RegResult value on registration failure
+FFI_PLUGIN_EXPORT int comaps_replace_map(const char* fullPath, ComapsMapReplaceResult* out_result);
+
 // Explicitly shutdown the CoMaps framework.
 // Call this before app termination to ensure clean shutdown and avoid crashes.
 FFI_PLUGIN_EXPORT void comaps_shutdown(void);
 
+// Bytes released by each step of comaps_on_memory_pressure, reported once on an engine
+// thread after the last step ran. Textures are counted by Drape, the rest is the
+// resident set delta.
+typedef void (*ComapsTrimCallback)(int64_t search_caches_freed, int64_t reader_caches_freed,
+                                   int64_t drape_tiles_freed, int64_t drape_textures_freed,
+                                   int64_t allocator_freed);
+
+// Trim engine caches in graded steps, on the engine's threads; returns at once.
+// level: 1=moderate (search caches), 2=low (+ reader/feature caches),
+//        3=critical (+ Drape tile geometry, then glyph and symbol textures)
+// Drape steps are skipped while there is no render surface.
+// done may be NULL.
+// Returns: 0 if the trim was started, -1 if framework not ready (done is not called then)
+FFI_PLUGIN_EXPORT int comaps_on_memory_pressure(int level, ComapsTrimCallback done);
+
+// Write a one-line RSS/PSS/GPU estimate/Drape texture summary into buffer (NUL-terminated).
+// Returns: length of the full summary, which may exceed buffer_size - 1
+FFI_PLUGIN_EXPORT int comaps_get_memory_info(char* buffer, int buffer_size);
+
+// Write the timeline of the last map engine startup (Framework construction steps,
+// page cache warm-up reads, map registration, drape engine creation) into buffer
+// as Chrome trace event JSON (NUL-terminated), for chrome://tracing or Perfetto.
+// Returns: length of the full trace, which may exceed buffer_size - 1
+FFI_PLUGIN_EXPORT int comaps_get_startup_trace(char* buffer, int buffer_size);
+
+// Startup mode for the next map engine startup (call before the map surface exists):
+// 0 = full: Framework::RegisterAllMaps registers every local map before the first frame.
+// 1 = render-first: only World/WorldCoasts are; other maps register as the viewport
+//     reaches them, and the remaining ones on an idle task after the first frame.
+// The Framework constructor builds search, routing and bookmarks in both modes.
+FFI_PLUGIN_EXPORT void comaps_set_startup_mode(int mode);
+
+// Outcome of the last map engine startup.
+typedef struct {
+  int32_t mode;            // as passed to comaps_set_startup_mode
+  int32_t deferred_tasks;  // tasks moved behind the first frame and finished so far
+  int64_t first_frame_us;  // from the start of Framework creation to the first frame, -1 if none yet
+  int64_t framework_us;    // Framework construction, -1 if not traced
+  int64_t deferred_us;     // time spent in those tasks
+} ComapsStartupReport;
+
+// Returns: 0 once the first frame was drawn, -1 before (out_report is filled either way)
+FFI_PLUGIN_EXPORT int comaps_get_startup_report(ComapsStartupReport* out_report);
+
+// Descriptor pool shared by MWM file readers.
+typedef struct {
+  int32_t limit;
+  int32_t files;             // map files with live readers
+  int32_t open_descriptors;  // of those, files holding a descriptor now
+  int64_t opens;
+  int64_t reopens;           // opens of files evicted before; a high share means the limit is too low
+  int64_t evictions;
+} ComapsFilePoolStats;
+
+// Cap the descriptors held by MWM readers; least recently read files are closed
+// and reopened on demand. Defaults to a quarter of RLIMIT_NOFILE (16..256).
+// Android only; other platforms use the readers of CoMaps' own Platform.
+FFI_PLUGIN_EXPORT void comaps_set_file_pool_limit(int limit);
+
+// Returns: 0 on success, -1 where the pool is not used (out_stats untouched)
+FFI_PLUGIN_EXPORT int comaps_get_file_pool_stats(ComapsFilePoolStats* out_stats);
+
+// Serve read-only resources missing on disk (styles, fonts, classificator...) from a
+// pack built by scripts/build_resource_pack.py, mapped at |offset| in |path| (an
+// uncompressed APK asset or a standalone file). Call before the map is created.
+// Android only; other platforms use the readers of CoMaps' own Platform.
+// Returns: 0 on success, -1 if the pack can't be opened or is not supported
+FFI_PLUGIN_EXPORT int comaps_set_resource_pack(const char* path, int64_t offset);
+
+// Timing of the first frames after the map engine was created
+// (or after a map was replaced, see comaps_get_map_replace_frame_stats).
+typedef struct {
+  int64_t first_frame_us;    // until the first rendered frame, -1 if none yet
+  int64_t settled_frame_us;  // until rendering went quiet (tiles and labels in place), -1 if not yet
+  int32_t frames;            // frames rendered until settled
+  int64_t max_frame_gap_us;  // longest wait for the next frame, i.e. the worst stall
+} ComapsFirstFrameStats;
+
+// Returns: 0 once the first frame was rendered, -1 before (out_stats is filled either way)
+FFI_PLUGIN_EXPORT int comaps_get_first_frame_stats(ComapsFirstFrameStats* out_stats);
+
+// Timing of the frames from the start of the last comaps_replace_map, i.e. the render
+// stall it caused (max_frame_gap_us), the swap itself included.
+// Returns: 0 once a frame was rendered after the replacement, -1 before
+FFI_PLUGIN_EXPORT int comaps_get_map_replace_frame_stats(ComapsFirstFrameStats* out_stats);
+
+// Keep the light and the dark style resources (drawing rules, classificator, symbol
+// textures once loaded) mapped, so switching between them opens no files. The switch
+// still reloads the style in the engine and redraws every tile. Disabling unmaps them.
+// Android only; other platforms use the readers of CoMaps' own Platform.
+FFI_PLUGIN_EXPORT void comaps_set_keep_style_files_mapped(int enabled);
+
+// Outcome of comaps_set_map_style.
+typedef struct {
+  int32_t dark;
+  int32_t mapped;          // 1 if made with the style files kept mapped
+  int32_t changed;         // 0 if the style was already current
+  int64_t apply_us;        // time the style switch blocked: rules reload and hand-off to the renderer
+  int64_t mapped_bytes;    // style files kept mapped by comaps_set_keep_style_files_mapped
+} ComapsStyleSwitchResult;
+
+// Switch the map to the default light (dark = 0) or dark style. The re-rendering that
+// follows is tracked by comaps_get_style_switch_stats. out_result may be NULL.
+// Returns: 0 on success (also if the style was current already), -1 if framework not ready, -2 on exception
+FFI_PLUGIN_EXPORT int comaps_set_map_style(int dark, ComapsStyleSwitchResult* out_result);
+
+// Last switch made with (mapped = 1) or without the style files kept mapped and the frames
+// after it, to compare the two. Either output may be NULL.
+// Returns: 0 if there was such a switch, -1 otherwise
+FFI_PLUGIN_EXPORT int comaps_get_style_switch_stats(int mapped, ComapsStyleSwitchResult* out_result,
+                                                    ComapsFirstFrameStats* out_frames);
+
+// Progress of comaps_hash_files, called on its hashing threads. file_index is into paths;
+// status is 0 while hashing (once per 64 MB), then 1 when done or -1 if the file can't be read;
+// bytes is how much of that file was hashed so far.
+typedef void (*ComapsHashProgressCallback)(int32_t file_index, int32_t status, int64_t bytes);
+
+// SHA-256 of each of the count files in paths, written to out_digests (32 bytes per file,
+// zeros for a file that can't be read). The files are memory-mapped and hashed in parallel
+// on all cores, with the CPU's SHA instructions where it has them. Blocks until all are done,
+// so call it off the UI thread. progress may be NULL.
+// Returns: the number of files that couldn't be hashed, -1 on invalid arguments
+FFI_PLUGIN_EXPORT int comaps_hash_files(const char* const* paths, int count, uint8_t* out_digests,
+                                        ComapsHashProgressCallback progress);
+
+// Languages map labels are expected in, comma separated (e.g. "en,ja").
+// When the map is created, only fonts for these scripts, the scripts of maps
+// registered so far or in earlier sessions, and Latin, Greek and Cyrillic are
+// opened; "*" opens every bundled font. Call before creating the map: a map
+// registered later in a script without fonts shows labels without those glyphs until
+// the render surface is created again.
+// Android only; other platforms use the system font setup of CoMaps.
+FFI_PLUGIN_EXPORT void comaps_set_font_languages(const char* languages);
+
+// Progress of a native file download.
+// status: 0=in progress, 1=completed, 2=failed, 3=file not found on server, -1=unknown id
+typedef struct {
+  int32_t status;
+  int64_t bytes_downloaded;
+  int64_t bytes_total;
+} ComapsDownloadProgress;
+
+// Download url to file_path natively, in up to `segments` parallel byte ranges
+// over keep-alive connections. Data streams straight to disk; a partial file
+// left by a previous (cancelled or failed) download of the same path is resumed.
+// file_size must be the exact size of the remote file.
+// Returns: download id for comaps_download_get_progress / comaps_download_cancel
+FFI_PLUGIN_EXPORT int64_t comaps_download_file(const char* url, const char* file_path, int64_t file_size,
+                                               int segments);
+
+// Once it reports a finished download, the id is released.
+// Returns: 0 and fills out_progress, or -1 if the id is unknown
+FFI_PLUGIN_EXPORT int comaps_download_get_progress(int64_t id, ComapsDownloadProgress* out_progress);
+
+// Stop a download (keeping the partial file resumable) and release its id.
+// Does nothing for a finished download whose result was read.
+FFI_PLUGIN_EXPORT void comaps_download_cancel(int64_t id);
+
+// New version of a registered map, see comaps_update_map.
+typedef struct {
+  const char* old_path;  // registered map
+  const char* new_path;  // where the new version goes: same file name, another directory
+  const char* diff_url;  // mwmdiff from the old to the new version, NULL to download the full map
+  int64_t diff_size;
+  const char* full_url;  // full new map, the fallback
+  int64_t full_size;
+  const char* sha256;    // hex SHA-256 of the new map, NULL to only check that it opens
+} ComapsMapUpdateRequest;
+
+// Progress of a map update.
+// status: 0=in progress, 1=updated by diff, 2=updated by full download, 3=failed, 4=cancelled, -1=unknown id
+// diff_failure: 0=none, 1=skipped (no diff or too large), 2=download, 3=apply, 4=verify failed
+typedef struct {
+  int32_t status;
+  int32_t diff_failure;
+  int32_t reg_result;        // MwmSet::RegResult of the swap, -1 until it happened
+  int64_t downloaded_bytes;  // diff, plus the full map after a fallback
+  int64_t full_bytes;        // what a full download costs
+  int64_t bytes_saved;       // full_bytes - downloaded_bytes once updated
+  int64_t apply_us;
+  int64_t verify_us;
+  int64_t total_us;
+} ComapsMapUpdateProgress;
+
+// Update a registered map in the background: download the diff, apply it to the old file,
+// verify the result and swap it in (see comaps_replace_map), falling back to the full map
+// if any step fails. Updates run one at a time. The new file only appears at new_path once
+// complete and synced; the old file is left for the caller to delete.
+// Returns: update id for comaps_get_map_update_progress / comaps_cancel_map_update, -1 if framework not ready
+FFI_PLUGIN_EXPORT int64_t comaps_update_map(const ComapsMapUpdateRequest* request);
+
+// Once it reports a finished download, the id is released.
+// Returns: 0 and fills out_progress, or -1 if the id is unknown
+FFI_PLUGIN_EXPORT int comaps_get_map_update_progress(int64_t id, ComapsMapUpdateProgress* out_progress);
+
+// Stop an update, keeping the registered map, and release its id.
+// Must also be called once a finished update's result was read.
+FFI_PLUGIN_EXPORT void comaps_cancel_map_update(int64_t id);
+
+// Limits shared by all map fetches, see comaps_fetch_map.
+typedef struct {
+  int32_t max_concurrent;         // maps downloaded at the same time, 1-8
+  int64_t max_bytes_per_second;   // network throughput of all fetches together, 0 for unlimited
+  int64_t max_unsynced_bytes;     // written bytes a fetch leaves to the page cache before syncing them
+} ComapsMapFetchBudget;
+
+// Progress of a map fetch.
+// status: 0=queued, 1=downloading, 2=syncing, 3=registering, 4=completed, 5=failed, 6=cancelled, -1=unknown id
+// failure: 0=none, 1=network, 2=file not found, 3=write, 4=verify, 5=register
+typedef struct {
+  int32_t status;
+  int32_t failure;
+  int32_t reg_result;       // MwmSet::RegResult of the registration, -1 until it happened
+  int64_t bytes_written;    // on disk, including a resumed prefix
+  int64_t bytes_total;
+  int64_t resumed_bytes;    // kept from an earlier, interrupted fetch
+  int64_t throttled_us;     // waiting for the bandwidth budget
+  int64_t download_us;
+  int64_t sync_us;
+  int64_t register_us;
+  int64_t total_us;
+  char sha256[65];          // hex SHA-256 computed while downloading; empty until downloaded
+} ComapsMapFetchProgress;
+
+// Apply budget to all queued and running fetches.
+FFI_PLUGIN_EXPORT void comaps_set_map_fetch_budget(const ComapsMapFetchBudget* budget);
+
+// Download, verify and register a map in one background job: the body is hashed while it
+// is written to file_path.part, which is checked against sha256 (or, if NULL, checked to
+// open as a map), synced and renamed to file_path, then registered as by comaps_replace_map.
+// A .part file left by an interrupted fetch is resumed. file_size must be exact.
+// register_map: 0 to only download and verify. When registering, a file_path of a registered
+// map fails right away (status failed, failure register): write the new version elsewhere.
+// Returns: fetch id for comaps_get_map_fetch_progress / comaps_cancel_map_fetch,
+//          -1 if framework not ready (when registering), arguments are invalid, or unsupported
+FFI_PLUGIN_EXPORT int64_t comaps_fetch_map(const char* url, const char* file_path, int64_t file_size,
+                                           const char* sha256, int register_map);
+
+// Once it reports a finished download, the id is released.
+// Returns: 0 and fills out_progress, or -1 if the id is unknown
+FFI_PLUGIN_EXPORT int comaps_get_map_fetch_progress(int64_t id, ComapsMapFetchProgress* out_progress);
+
+// Stop a fetch, keeping its .part file for a later one, and release its id.
+// Must also be called once a finished fetch's result was read.
+FFI_PLUGIN_EXPORT void comaps_cancel_map_fetch(int64_t id);
+
+// What one mirror contributed to a download from several mirrors.
+typedef struct {
+  int64_t bytes;
+  int64_t bytes_per_second;  // bytes over the time from the start to the mirror's last byte
+  int64_t first_byte_us;     // mean time from a range request to its first byte
+  int32_t ranges;
+  int32_t steals;            // ranges taken over from the tail of a slower connection
+  int32_t errors;
+  int32_t disabled;          // 1 if dropped after repeated errors or a 404
+} ComapsMirrorStats;
+
+// Download a file from several mirrors at once: it is split into ranges that
+// connections_per_mirror connections per mirror pull from a shared queue, so faster
+// mirrors fetch more; idle connections take over the tail of slower ones near the end.
+// urls are the same file on each mirror, lowest latency first. file_size must be exact.
+// The file only appears at file_path once complete; failing or cancelling removes it.
+// Returns: download id for comaps_mirror_download_get_progress / comaps_mirror_download_cancel,
+//          -1 if arguments are invalid or unsupported
+FFI_PLUGIN_EXPORT int64_t comaps_download_from_mirrors(const char* const* urls, int url_count,
+                                                       const char* file_path, int64_t file_size,
+                                                       int connections_per_mirror);
+
+// Fill out_progress and, if not NULL, mirror_count entries of out_mirrors (one per url,
+// in the order given).
+// Returns: 0, or -1 if the id is unknown
+FFI_PLUGIN_EXPORT int comaps_mirror_download_get_progress(int64_t id, ComapsDownloadProgress* out_progress,
+                                                          ComapsMirrorStats* out_mirrors, int mirror_count);
+
+// Stop a download and release its id.
+// Must also be called once a finished download's result was read.
+FFI_PLUGIN_EXPORT void comaps_mirror_download_cancel(int64_t id);
+
+// Start recording trace spans (comaps_* calls, GUI and worker pool tasks, frame
+// presents, file reads, startup phases, Drape tile reads, searches) from every thread,
+// dropping any previous recording. Each thread keeps up to max_events_per_thread spans
+// (<= 0 for the default of 65536); later ones are dropped.
+FFI_PLUGIN_EXPORT void comaps_trace_start(int max_events_per_thread);
+
+// Stop recording; the recording is kept for comaps_trace_dump.
+FFI_PLUGIN_EXPORT void comaps_trace_stop(void);
+
+// Write the recording to path as Chrome trace event JSON, for chrome://tracing or
+// ui.perfetto.dev. May be called while recording.
+// Returns: number of events written, or -1 if path can't be written
+FFI_PLUGIN_EXPORT int64_t comaps_trace_dump(const char* path);
+
+// Write every engine metric into buffer as one JSON object (NUL-terminated):
+//   {"uptime_us":N,"counters":{...},"gauges":{...},
+//    "histograms":{name:{"count","sum","max","p50","p90","p99"},...}}
+// Counters are totals since process start; histogram values are microseconds
+// (names ending in _us), with percentiles rounded up to a power of two.
+// Returns: length of the full snapshot, which may exceed buffer_size - 1
+FFI_PLUGIN_EXPORT int comaps_metrics_snapshot(char* buffer, int buffer_size);
+
+typedef struct {
+  double lat;
+  double lon;
+} ComapsLatLon;
+
+// Registered region map covering a point.
+typedef struct {
+  char country_name[64];  // e.g. "Spain_Madrid"; empty if no region map covers the point
+  int64_t version;
+} ComapsMwmHit;
+
+// Find the registered region map covering each of count points, writing count
+// entries to out_hits. Matches against the real region borders; World maps are
+// not reported.
+// Returns: number of points covered by a region map, -1 if framework not ready
+FFI_PLUGIN_EXPORT int comaps_find_mwms_at(const ComapsLatLon* points, int count, ComapsMwmHit* out_hits);
+
 // Debug: List all registered MWMs and their bounds to logcat
 FFI_PLUGIN_EXPORT void comaps_debug_list_mwms();
 
@@ -0,0 +1,186 @@
+#include "agus_memory.hpp"
+
+#include "agus_engine_hooks.hpp"
+#include "agus_metrics.hpp"
+
+#include "map/framework.hpp"
+
+#include "drape_frontend/memory_trim.hpp"
+
+#include "base/logging.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <sstream>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace agus
+{
+namespace
+{
+std::atomic<uint64_t> g_surfaceBytes{0};
+
+#if !defined(__APPLE__)
+// Reads "<key>: <value> kB" lines from a /proc file into |values|.
+// |keys| and |values| are parallel arrays of |count| elements.
+void ReadProcKb(char const * path, char const * const * keys, uint64_t * values, size_t count)
+{
+  FILE * f = fopen(path, "r");
+  if (!f)
+    return;
+
+  char line[256];
+  while (fgets(line, sizeof(line), f))
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      size_t const len = strlen(keys[i]);
+      if (strncmp(line, keys[i], len) == 0 && line[len] == ':')
+      {
+        unsigned long long kb = 0;
+        if (sscanf(line + len + 1, "%llu", &kb) == 1)
+          values[i] = static_cast<uint64_t>(kb) * 1024;
+      }
+    }
+  }
+  fclose(f);
+}
+#endif
+
+// Returns unused allocator pages to the OS so trim steps show up in RSS.
+void PurgeAllocator()
+{
+#if defined(__APPLE__)
+  malloc_zone_pressure_relief(nullptr, 0);
+#elif defined(M_PURGE)
+  mallopt(M_PURGE, 0);
+#elif defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+}
+}  // namespace
+
+int64_t MeasureFreed(std::function<void()> const & step)
+{
+  int64_t const before = static_cast<int64_t>(GetMemoryStats().m_rssBytes);
+  step();
+  PurgeAllocator();
+  int64_t const after = static_cast<int64_t>(GetMemoryStats().m_rssBytes);
+  return before > after ? before - after : 0;
+}
+
+MemoryStats GetMemoryStats()
+{
+  MemoryStats stats;
+
+#if defined(__APPLE__)
+  task_vm_info_data_t info;
+  mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+  if (task_info(mach_task_self(), TASK_VM_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+  {
+    stats.m_rssBytes = info.resident_size;
+    stats.m_peakRssBytes = info.resident_size_peak;
+    // phys_footprint is what jetsam accounts against, the closest analogue of PSS.
+    stats.m_pssBytes = info.phys_footprint;
+  }
+#else
+  char const * const statusKeys[] = {"VmRSS", "VmHWM"};
+  uint64_t statusValues[] = {0, 0};
+  ReadProcKb("/proc/self/status", statusKeys, statusValues, 2);
+  stats.m_rssBytes = statusValues[0];
+  stats.m_peakRssBytes = statusValues[1];
+
+  char const * const pssKeys[] = {"Pss"};
+  ReadProcKb("/proc/self/smaps_rollup", pssKeys, &stats.m_pssBytes, 1);
+#endif
+
+  stats.m_gpuEstimateBytes = g_surfaceBytes.load();
+  stats.m_textureBytes = GetDrapeTextureBytes();
+  return stats;
+}
+
+void SetRenderSurfaceSize(int width, int height)
+{
+  if (width <= 0 || height <= 0)
+  {
+    g_surfaceBytes = 0;
+    return;
+  }
+
+  // Triple-buffered RGBA8 swapchain plus a D24S8 depth/stencil buffer.
+  uint64_t const pixels = static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+  g_surfaceBytes = pixels * (4 * 3 + 4);
+}
+
+std::string DebugPrint(MemoryStats const & stats)
+{
+  std::ostringstream out;
+  out << "rss=" << stats.m_rssBytes / 1024 << "kB"
+      << " peak_rss=" << stats.m_peakRssBytes / 1024 << "kB"
+      << " pss=" << stats.m_pssBytes / 1024 << "kB"
+      << " gpu_est=" << stats.m_gpuEstimateBytes / 1024 << "kB"
+      << " textures=" << stats.m_textureBytes / 1024 << "kB";
+  return out.str();
+}
+
+std::string DebugPrint(TrimReport const & report)
+{
+  std::ostringstream out;
+  out << "search=" << report.m_searchCachesFreed / 1024 << "kB"
+      << " readers=" << report.m_readerCachesFreed / 1024 << "kB"
+      << " drape_tiles=" << report.m_drapeTilesFreed / 1024 << "kB"
+      << " drape_textures=" << report.m_drapeTexturesFreed / 1024 << "kB"
+      << " allocator=" << report.m_allocatorFreed / 1024 << "kB"
+      << " total=" << report.Total() / 1024 << "kB";
+  return out.str();
+}
+
+bool TrimDrapeTiles(Framework & framework, std::chrono::milliseconds timeout)
+{
+  auto trimmed = std::make_shared<std::promise<void>>();
+  auto result = trimmed->get_future();
+  df::RequestMemoryTrim([trimmed]() { trimmed->set_value(); });
+  // An idle renderer only wakes up for a frame when the scene changes.
+  framework.InvalidateRect(framework.GetCurrentViewport());
+  return result.wait_for(timeout) == std::future_status::ready;
+}
+
+int64_t TrimDrapeTextures(std::function<void()> const & recycleSurface)
+{
+  static auto & freed = GetCounter("texture.freed_bytes");
+  uint64_t const before = freed.Get();
+  recycleSurface();
+  return static_cast<int64_t>(freed.Get() - before);
+}
+
+TrimReport TrimMemory(Framework & framework, MemoryPressure level,
+                      std::function<void(TrimReport &)> const & trimDrapeTiles)
+{
+  TrimReport report;
+
+  // Freed pages that the allocator was already holding are reported separately,
+  // otherwise they would be attributed to whichever step runs first.
+  report.m_allocatorFreed = MeasureFreed([] {});
+
+  if (level >= MemoryPressure::Moderate)
+    report.m_searchCachesFreed = MeasureFreed([&framework] { framework.GetSearchAPI().ClearCaches(); });
+
+  if (level >= MemoryPressure::Low)
+    report.m_readerCachesFreed = MeasureFreed([&framework] { framework.ClearAllCaches(); });
+
+  if (level >= MemoryPressure::Critical && trimDrapeTiles)
+    trimDrapeTiles(report);
+
+  LOG(LINFO, ("TrimMemory level", static_cast<int>(level), DebugPrint(report), "now", DebugPrint(GetMemoryStats())));
+  return report;
+}
+}  // namespace agus
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class Framework;
+
+namespace agus
+{
+/// Process memory snapshot. Values that the OS cannot provide are left at 0.
+struct MemoryStats
+{
+  uint64_t m_rssBytes = 0;
+  uint64_t m_peakRssBytes = 0;
+  uint64_t m_pssBytes = 0;
+  /// Swapchain and depth/stencil buffers of the current render surface.
+  uint64_t m_gpuEstimateBytes = 0;
+  /// Drape's textures as Drape sized them (patch 0025), see GetDrapeTextureBytes.
+  uint64_t m_textureBytes = 0;
+};
+
+MemoryStats GetMemoryStats();
+
+/// Called by the surface owner whenever the render surface is (re)created or resized.
+void SetRenderSurfaceSize(int width, int height);
+
+std::string DebugPrint(MemoryStats const & stats);
+
+/// Graded memory pressure levels, ordered by severity.
+/// Values match the `level` argument of comaps_on_memory_pressure.
+enum class MemoryPressure
+{
+  Moderate = 1,  // drop search caches
+  Low = 2,       // + reader / feature caches
+  Critical = 3,  // + Drape tile geometry, then glyph and symbol textures
+};
+
+/// Bytes released by each trim step: the resident set delta, except for the textures,
+/// which are counted by Drape because their memory is often the driver's, not the process's.
+struct TrimReport
+{
+  int64_t m_searchCachesFreed = 0;
+  int64_t m_readerCachesFreed = 0;
+  int64_t m_drapeTilesFreed = 0;
+  int64_t m_drapeTexturesFreed = 0;
+  int64_t m_allocatorFreed = 0;
+
+  int64_t Total() const
+  {
+    return m_searchCachesFreed + m_readerCachesFreed + m_drapeTilesFreed + m_drapeTexturesFreed + m_allocatorFreed;
+  }
+};
+
+std::string DebugPrint(TrimReport const & report);
+
+/// Resident memory released by |step|, after returning free allocator pages to the OS.
+int64_t MeasureFreed(std::function<void()> const & step);
+
+/// Drops the geometry of every Drape tile but keeps the rendering surface and the textures
+/// (see df::RequestMemoryTrim); the visible tiles are read again. Waits up to |timeout|
+/// for the render thread to serve the request and returns false if it didn't.
+bool TrimDrapeTiles(Framework & framework, std::chrono::milliseconds timeout);
+
+/// Drape texture storage released by |recycleSurface|, which releases and re-acquires the
+/// render surface and with it the glyph and symbol textures. The textures are created again
+/// as the next frames need them. Call on the thread that owns the surface.
+int64_t TrimDrapeTextures(std::function<void()> const & recycleSurface);
+
+/// Runs every trim step up to |level| but the texture one (see TrimDrapeTextures), which
+/// needs the thread that owns the surface. At MemoryPressure::Critical, |trimDrapeTiles|
+/// runs TrimDrapeTiles and fills in m_drapeTilesFreed; it may be empty. Blocks while the
+/// render thread serves it, so call off the GUI thread.
+TrimReport TrimMemory(Framework & framework, MemoryPressure level,
+                      std::function<void(TrimReport &)> const & trimDrapeTiles);
+}  // namespace agus
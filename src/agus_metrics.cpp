@@ -0,0 +1,164 @@
+#include "agus_metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace agus
+{
+namespace
+{
+template <typename T>
+using Registry = std::map<std::string, std::unique_ptr<T>>;
+
+// Never destroyed: call sites hold references for the life of the process.
+std::mutex & g_mutex = *new std::mutex;
+Registry<Counter> & g_counters = *new Registry<Counter>;
+Registry<Gauge> & g_gauges = *new Registry<Gauge>;
+Registry<Histogram> & g_histograms = *new Registry<Histogram>;
+std::map<std::string, std::function<int64_t()>> & g_providers = *new std::map<std::string, std::function<int64_t()>>;
+
+auto const g_start = std::chrono::steady_clock::now();
+
+template <typename T>
+T & GetOrCreate(Registry<T> & registry, std::string const & name)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto & metric = registry[name];
+  if (!metric)
+    metric = std::make_unique<T>();
+  return *metric;
+}
+
+size_t BucketOf(uint64_t value)
+{
+  size_t bucket = 0;
+  while (value > 0 && bucket + 1 < Histogram::kBuckets)
+  {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+uint64_t UpperBound(size_t bucket)
+{
+  return bucket == 0 ? 0 : (uint64_t{1} << bucket) - 1;
+}
+}  // namespace
+
+void Histogram::Record(uint64_t value)
+{
+  m_buckets[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = m_max.load(std::memory_order_relaxed);
+  while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+HistogramSnapshot Histogram::GetSnapshot() const
+{
+  std::array<uint64_t, kBuckets> counts;
+  HistogramSnapshot snapshot;
+  for (size_t i = 0; i < kBuckets; ++i)
+  {
+    counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+    snapshot.m_count += counts[i];
+  }
+  snapshot.m_sum = m_sum.load(std::memory_order_relaxed);
+  snapshot.m_max = m_max.load(std::memory_order_relaxed);
+
+  auto const percentile = [&](uint64_t permille)
+  {
+    // Rank of the value, 1-based, rounded up.
+    uint64_t const rank = (snapshot.m_count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+      seen += counts[i];
+      if (seen >= rank && seen > 0)
+        return std::min(UpperBound(i), snapshot.m_max);
+    }
+    return snapshot.m_max;
+  };
+  snapshot.m_p50 = percentile(500);
+  snapshot.m_p90 = percentile(900);
+  snapshot.m_p99 = percentile(990);
+  return snapshot;
+}
+
+Counter & GetCounter(std::string const & name)
+{
+  return GetOrCreate(g_counters, name);
+}
+
+Gauge & GetGauge(std::string const & name)
+{
+  return GetOrCreate(g_gauges, name);
+}
+
+Histogram & GetHistogram(std::string const & name)
+{
+  return GetOrCreate(g_histograms, name);
+}
+
+void SetGaugeProvider(std::string const & name, std::function<int64_t()> provider)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_providers[name] = std::move(provider);
+}
+
+std::string GetMetricsSnapshotJson()
+{
+  std::map<std::string, uint64_t> counters;
+  std::map<std::string, int64_t> gauges;
+  std::map<std::string, HistogramSnapshot> histograms;
+  std::map<std::string, std::function<int64_t()>> providers;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (auto const & [name, counter] : g_counters)
+      counters[name] = counter->Get();
+    for (auto const & [name, gauge] : g_gauges)
+      gauges[name] = gauge->Get();
+    for (auto const & [name, histogram] : g_histograms)
+      histograms[name] = histogram->GetSnapshot();
+    providers = g_providers;
+  }
+  // Outside the lock: providers may take their owners' locks.
+  for (auto const & [name, provider] : providers)
+    gauges[name] = provider();
+
+  // Names are code-defined identifiers, no escaping needed.
+  std::ostringstream out;
+  out << "{\"uptime_us\":"
+      << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_start).count();
+  out << ",\"counters\":{";
+  char const * sep = "";
+  for (auto const & [name, value] : counters)
+  {
+    out << sep << '"' << name << "\":" << value;
+    sep = ",";
+  }
+  out << "},\"gauges\":{";
+  sep = "";
+  for (auto const & [name, value] : gauges)
+  {
+    out << sep << '"' << name << "\":" << value;
+    sep = ",";
+  }
+  out << "},\"histograms\":{";
+  sep = "";
+  for (auto const & [name, h] : histograms)
+  {
+    out << sep << '"' << name << "\":{\"count\":" << h.m_count << ",\"sum\":" << h.m_sum << ",\"max\":" << h.m_max
+        << ",\"p50\":" << h.m_p50 << ",\"p90\":" << h.m_p90 << ",\"p99\":" << h.m_p99 << '}';
+    sep = ",";
+  }
+  out << "}}";
+  return out.str();
+}
+}  // namespace agus
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace agus
+{
+/// Monotonic count since process start; monitoring takes deltas between snapshots.
+class Counter
+{
+public:
+  void Add(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t Get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> m_value{0};
+};
+
+/// Current level of something, e.g. a queue length.
+class Gauge
+{
+public:
+  void Set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+  void Add(int64_t delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+  int64_t Get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> m_value{0};
+};
+
+struct HistogramSnapshot
+{
+  uint64_t m_count = 0;
+  uint64_t m_sum = 0;
+  uint64_t m_max = 0;
+  /// Upper bounds of the buckets holding the percentile, so within 2x of the truth.
+  uint64_t m_p50 = 0;
+  uint64_t m_p90 = 0;
+  uint64_t m_p99 = 0;
+};
+
+/// Distribution of non-negative values (microseconds, bytes) in power-of-two
+/// buckets: recording is two relaxed increments and a max, with no lock.
+class Histogram
+{
+public:
+  /// Bucket 0 holds 0, bucket i holds [2^(i-1), 2^i); the last one everything above.
+  static size_t constexpr kBuckets = 40;
+
+  void Record(uint64_t value);
+  HistogramSnapshot GetSnapshot() const;
+
+private:
+  std::array<std::atomic<uint64_t>, kBuckets> m_buckets = {};
+  std::atomic<uint64_t> m_sum{0};
+  std::atomic<uint64_t> m_max{0};
+};
+
+/// Metrics are created on first use and live for the rest of the process, so
+/// call sites keep the reference, e.g.
+///   static auto & bytesRead = agus::GetCounter("mwm.bytes_read");
+/// Names are dotted, lower case; units go last ("_us", "_bytes").
+Counter & GetCounter(std::string const & name);
+Gauge & GetGauge(std::string const & name);
+Histogram & GetHistogram(std::string const & name);
+
+/// Gauge read from |provider| at snapshot time, for values owned elsewhere
+/// (pool queues, memory). Replaces a previous provider of the same name.
+void SetGaugeProvider(std::string const & name, std::function<int64_t()> provider);
+
+/// Every metric as one JSON object:
+///   {"uptime_us":N,"counters":{name:N,...},"gauges":{name:N,...},
+///    "histograms":{name:{"count":N,"sum":N,"max":N,"p50":N,"p90":N,"p99":N},...}}
+/// with names sorted.
+std::string GetMetricsSnapshotJson();
+}  // namespace agus
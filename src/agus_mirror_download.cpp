@@ -0,0 +1,431 @@
+#include "agus_mirror_download.hpp"
+
+#include "agus_http.hpp"
+
+#include "base/logging.hpp"
+
+#include "defines.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+int64_t constexpr kMinChunkSize = 512 * 1024;
+int64_t constexpr kMaxChunkSize = 8 * 1024 * 1024;
+/// Smallest tail worth another range request.
+int64_t constexpr kMinStealSize = 256 * 1024;
+/// Consecutive failed requests after which a mirror is dropped.
+uint32_t constexpr kMaxMirrorErrors = 3;
+/// How often an idle connection looks for a range to take over.
+auto constexpr kIdleRecheck = std::chrono::milliseconds(100);
+
+double Seconds(Clock::duration d)
+{
+  return std::chrono::duration<double>(d).count();
+}
+
+/// Bytes [m_pos, m_end) of the file.
+struct Range
+{
+  int64_t m_pos = 0;
+  int64_t m_end = 0;
+};
+
+struct Mirror
+{
+  http::Url m_url;
+  MirrorStats m_stats;
+  uint64_t m_firstByteTotal = 0;
+  uint32_t m_firstByteSamples = 0;
+  Clock::time_point m_lastByte;
+  uint32_t m_consecutiveErrors = 0;
+  unsigned m_connections = 0;
+  bool m_notFound = false;
+};
+
+struct Download
+{
+  std::string m_path;
+  std::string m_partPath;
+  int64_t m_size = 0;
+  int m_fd = -1;
+  Clock::time_point m_start = Clock::now();
+  std::atomic<bool> m_cancelled{false};
+
+  std::mutex m_mutex;
+  std::condition_variable m_changed;
+  std::vector<Mirror> m_mirrors;
+  std::deque<Range> m_pending;
+  /// Range in flight on each connection.
+  std::vector<std::optional<Range>> m_active;
+  std::vector<size_t> m_connectionMirror;
+  int64_t m_written = 0;
+  unsigned m_live = 0;
+  bool m_writeFailed = false;
+  FileDownloadStatus m_status = FileDownloadStatus::InProgress;
+};
+
+std::mutex g_downloadsMutex;
+std::map<int64_t, std::shared_ptr<Download>> g_downloads;
+int64_t g_nextDownloadId = 1;
+
+/// Throughput of one connection to |mirror| so far, 0 before its first byte.
+double ConnectionRate(Download const & download, Mirror const & mirror, Clock::time_point now)
+{
+  double const elapsed = Seconds(now - download.m_start);
+  if (mirror.m_stats.m_bytes == 0 || elapsed <= 0 || mirror.m_connections == 0)
+    return 0;
+  return mirror.m_stats.m_bytes / elapsed / mirror.m_connections;
+}
+
+/// Hands |connection| the next queued range or, with none left, the tail of the
+/// range that would otherwise finish last. Call with m_mutex held.
+bool TakeRange(Download & download, size_t connection, Range & range)
+{
+  if (!download.m_pending.empty())
+  {
+    range = download.m_pending.front();
+    download.m_pending.pop_front();
+    download.m_active[connection] = range;
+    return true;
+  }
+
+  auto const now = Clock::now();
+  Mirror & mine = download.m_mirrors[download.m_connectionMirror[connection]];
+  double const myRate = ConnectionRate(download, mine, now);
+  double const latency = mine.m_firstByteSamples == 0
+                             ? 0
+                             : mine.m_firstByteTotal / 1e6 / mine.m_firstByteSamples;
+
+  std::optional<size_t> victim;
+  int64_t bestSize = 0;
+  for (size_t i = 0; i < download.m_active.size(); ++i)
+  {
+    if (i == connection || !download.m_active[i])
+      continue;
+    int64_t const remaining = download.m_active[i]->m_end - download.m_active[i]->m_pos;
+    if (remaining < 2 * kMinStealSize)
+      continue;
+
+    double const theirRate = ConnectionRate(download, download.m_mirrors[download.m_connectionMirror[i]], now);
+    int64_t size = remaining / 2;
+    if (myRate > 0 && theirRate > 0)
+    {
+      // Both parts finish together when (remaining - size) / theirRate == latency + size / myRate.
+      size = static_cast<int64_t>((remaining - latency * theirRate) * myRate / (myRate + theirRate));
+    }
+    size = std::min(size, remaining);
+    if (size >= kMinStealSize && size > bestSize)
+    {
+      victim = i;
+      bestSize = size;
+    }
+  }
+  if (!victim)
+    return false;
+
+  Range & theirs = *download.m_active[*victim];
+  range.m_pos = theirs.m_end - bestSize;
+  range.m_end = theirs.m_end;
+  theirs.m_end = range.m_pos;
+  download.m_active[connection] = range;
+  ++mine.m_stats.m_steals;
+  return true;
+}
+
+/// Streams |range| from |mirror|. The range may shrink while in flight when its
+/// tail is taken over; the transfer is then cut short at the new end.
+void FetchRange(Download & download, size_t connection, Mirror const & mirror, Range const & range)
+{
+  http::Request request;
+  request.m_url = mirror.m_url;
+  request.m_begRange = range.m_pos;
+  request.m_endRange = range.m_end - 1;
+
+  http::Response response;
+  bool first = true;
+  auto const sent = Clock::now();
+  auto const onBody = [&](void const * data, size_t size)
+  {
+    if (first)
+    {
+      first = false;
+      bool const wholeFile = range.m_pos == 0 && range.m_end == download.m_size;
+      bool const ok = response.m_status == 206 ? response.m_rangeBegin == range.m_pos
+                                                : response.m_status == 200 && wholeFile;
+      if (!ok)
+        return false;
+    }
+
+    int64_t offset;
+    size_t take;
+    {
+      std::lock_guard<std::mutex> lock(download.m_mutex);
+      Range & active = *download.m_active[connection];
+      offset = active.m_pos;
+      take = static_cast<size_t>(std::min<int64_t>(size, active.m_end - active.m_pos));
+      // Reserved before writing, so a concurrent take-over never overlaps it.
+      active.m_pos += static_cast<int64_t>(take);
+      download.m_written += static_cast<int64_t>(take);
+
+      Mirror & stats = download.m_mirrors[download.m_connectionMirror[connection]];
+      auto const now = Clock::now();
+      if (offset == range.m_pos)
+      {
+        stats.m_firstByteTotal += std::chrono::duration_cast<std::chrono::microseconds>(now - sent).count();
+        ++stats.m_firstByteSamples;
+      }
+      stats.m_stats.m_bytes += static_cast<int64_t>(take);
+      stats.m_lastByte = now;
+    }
+
+    auto const * p = static_cast<char const *>(data);
+    for (size_t done = 0; done < take;)
+    {
+      ssize_t const n = pwrite(download.m_fd, p + done, take - done, offset + static_cast<int64_t>(done));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+      {
+        LOG(LWARNING, ("Can't write", download.m_partPath, strerror(errno)));
+        std::lock_guard<std::mutex> lock(download.m_mutex);
+        download.m_writeFailed = true;
+        return false;
+      }
+      done += static_cast<size_t>(n);
+    }
+    return take == size;
+  };
+
+  int const code = http::Perform(request, onBody, response, &download.m_cancelled);
+
+  std::lock_guard<std::mutex> lock(download.m_mutex);
+  Mirror & stats = download.m_mirrors[download.m_connectionMirror[connection]];
+  Range const left = *download.m_active[connection];
+  download.m_active[connection].reset();
+  if (left.m_pos >= left.m_end)
+  {
+    ++stats.m_stats.m_ranges;
+    stats.m_consecutiveErrors = 0;
+  }
+  else if (!download.m_cancelled && !download.m_writeFailed)
+  {
+    LOG(LWARNING, ("Range", left.m_pos, left.m_end, "from", stats.m_stats.m_url, "failed:", code,
+                   response.m_status));
+    download.m_pending.push_front(left);
+    ++stats.m_stats.m_errors;
+    stats.m_notFound = response.m_status == 404;
+    if (stats.m_notFound || ++stats.m_consecutiveErrors >= kMaxMirrorErrors)
+    {
+      LOG(LWARNING, ("Dropping mirror", stats.m_stats.m_url));
+      stats.m_stats.m_disabled = true;
+    }
+  }
+  download.m_changed.notify_all();
+}
+
+void Finish(Download & download)
+{
+  bool const complete = !download.m_cancelled && !download.m_writeFailed && download.m_written == download.m_size;
+  bool const synced = complete && fsync(download.m_fd) == 0;
+  close(download.m_fd);
+
+  FileDownloadStatus status = FileDownloadStatus::Failed;
+  if (synced && std::rename(download.m_partPath.c_str(), download.m_path.c_str()) == 0)
+  {
+    status = FileDownloadStatus::Completed;
+  }
+  else
+  {
+    std::remove(download.m_partPath.c_str());
+    if (std::all_of(download.m_mirrors.begin(), download.m_mirrors.end(),
+                    [](Mirror const & m) { return m.m_notFound; }))
+    {
+      status = FileDownloadStatus::FileNotFound;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(download.m_mutex);
+  download.m_status = status;
+  LOG(LINFO, ("Mirror download of", download.m_path, "finished:", static_cast<int>(status), "in",
+              Seconds(Clock::now() - download.m_start), "s"));
+  for (auto const & mirror : download.m_mirrors)
+  {
+    LOG(LINFO, (mirror.m_stats.m_url, mirror.m_stats.m_bytes, "bytes", mirror.m_stats.m_ranges, "ranges",
+                mirror.m_stats.m_steals, "steals", mirror.m_stats.m_errors, "errors"));
+  }
+}
+
+void RunConnection(std::shared_ptr<Download> download, size_t connection)
+{
+  Mirror const & mirror = download->m_mirrors[download->m_connectionMirror[connection]];
+  while (true)
+  {
+    Range range;
+    {
+      std::unique_lock<std::mutex> lock(download->m_mutex);
+      bool took = false;
+      while (!took)
+      {
+        if (download->m_cancelled || download->m_writeFailed || mirror.m_stats.m_disabled)
+          break;
+        took = TakeRange(*download, connection, range);
+        if (took)
+          break;
+        bool const busy = std::any_of(download->m_active.begin(), download->m_active.end(),
+                                      [](std::optional<Range> const & r) { return r.has_value(); });
+        if (!busy && download->m_pending.empty())
+          break;
+        // Rates change as the other connections progress; look again shortly.
+        download->m_changed.wait_for(lock, kIdleRecheck);
+      }
+      if (!took)
+        break;
+    }
+    FetchRange(*download, connection, mirror, range);
+  }
+
+  bool last;
+  {
+    std::lock_guard<std::mutex> lock(download->m_mutex);
+    --download->m_mirrors[download->m_connectionMirror[connection]].m_connections;
+    last = --download->m_live == 0;
+    download->m_changed.notify_all();
+  }
+  if (last)
+    Finish(*download);
+}
+}  // namespace
+
+int64_t StartMirrorDownload(std::vector<std::string> const & urls, std::string const & filePath, int64_t fileSize,
+                            unsigned connectionsPerMirror)
+{
+  auto download = std::make_shared<Download>();
+  download->m_path = filePath;
+  download->m_partPath = filePath + DOWNLOADING_FILE_EXTENSION;
+  download->m_size = fileSize;
+
+  connectionsPerMirror = std::clamp(connectionsPerMirror, 1u, 8u);
+  for (auto const & url : urls)
+  {
+    Mirror mirror;
+    mirror.m_stats.m_url = url;
+    if (auto parsed = http::Url::Parse(url))
+      mirror.m_url = std::move(*parsed);
+    else
+      mirror.m_stats.m_disabled = mirror.m_notFound = true;
+    download->m_mirrors.push_back(std::move(mirror));
+  }
+
+  // Connections interleave the mirrors, so the first ranges go to the first connection of each.
+  for (unsigned k = 0; k < connectionsPerMirror; ++k)
+  {
+    for (size_t i = 0; i < download->m_mirrors.size(); ++i)
+    {
+      if (download->m_mirrors[i].m_stats.m_disabled)
+        continue;
+      download->m_connectionMirror.push_back(i);
+      ++download->m_mirrors[i].m_connections;
+    }
+  }
+  download->m_active.resize(download->m_connectionMirror.size());
+
+  int64_t const chunkSize = std::clamp(
+      fileSize / static_cast<int64_t>(std::max<size_t>(download->m_connectionMirror.size(), 1) * 4), kMinChunkSize,
+      kMaxChunkSize);
+  for (int64_t pos = 0; pos < fileSize; pos += chunkSize)
+    download->m_pending.push_back({pos, std::min(pos + chunkSize, fileSize)});
+
+  download->m_fd = open(download->m_partPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (download->m_fd < 0 || ftruncate(download->m_fd, fileSize) != 0)
+  {
+    LOG(LWARNING, ("Can't create", download->m_partPath, strerror(errno)));
+    if (download->m_fd >= 0)
+      close(download->m_fd);
+    download->m_status = FileDownloadStatus::Failed;
+    download->m_connectionMirror.clear();
+  }
+  else if (download->m_connectionMirror.empty())
+  {
+    close(download->m_fd);
+    std::remove(download->m_partPath.c_str());
+    download->m_status = FileDownloadStatus::Failed;
+  }
+
+  int64_t id;
+  {
+    std::lock_guard<std::mutex> lock(g_downloadsMutex);
+    id = g_nextDownloadId++;
+    g_downloads[id] = download;
+  }
+
+  download->m_live = static_cast<unsigned>(download->m_connectionMirror.size());
+  for (size_t i = 0; i < download->m_connectionMirror.size(); ++i)
+    std::thread(&RunConnection, download, i).detach();
+  return id;
+}
+
+FileDownloadProgress GetMirrorDownloadProgress(int64_t id, std::vector<MirrorStats> * mirrors)
+{
+  std::shared_ptr<Download> download;
+  {
+    std::lock_guard<std::mutex> lock(g_downloadsMutex);
+    auto const it = g_downloads.find(id);
+    if (it == g_downloads.end())
+      return {};
+    download = it->second;
+  }
+
+  std::lock_guard<std::mutex> lock(download->m_mutex);
+  FileDownloadProgress progress;
+  progress.m_status = download->m_status;
+  progress.m_bytesDownloaded = download->m_written;
+  progress.m_bytesTotal = download->m_size;
+  if (mirrors)
+  {
+    mirrors->clear();
+    for (auto const & mirror : download->m_mirrors)
+    {
+      MirrorStats stats = mirror.m_stats;
+      double const elapsed = Seconds(mirror.m_lastByte - download->m_start);
+      if (stats.m_bytes > 0 && elapsed > 0)
+        stats.m_bytesPerSecond = static_cast<int64_t>(stats.m_bytes / elapsed);
+      if (mirror.m_firstByteSamples > 0)
+        stats.m_firstByteMicros = mirror.m_firstByteTotal / mirror.m_firstByteSamples;
+      mirrors->push_back(std::move(stats));
+    }
+  }
+  return progress;
+}
+
+void CancelMirrorDownload(int64_t id)
+{
+  std::lock_guard<std::mutex> lock(g_downloadsMutex);
+  auto const it = g_downloads.find(id);
+  if (it == g_downloads.end())
+    return;
+  // The connections notice on their next read; the last one out removes the file.
+  it->second->m_cancelled = true;
+  it->second->m_changed.notify_all();
+  g_downloads.erase(it);
+}
+}  // namespace agus
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "agus_downloader.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace agus
+{
+/// What one mirror contributed to a download.
+struct MirrorStats
+{
+  std::string m_url;
+  int64_t m_bytes = 0;
+  /// m_bytes over the time from the start of the download to the mirror's last byte.
+  int64_t m_bytesPerSecond = 0;
+  /// Mean time from sending a range request to the first byte of its body.
+  uint64_t m_firstByteMicros = 0;
+  uint32_t m_ranges = 0;
+  /// Ranges this mirror took over from the tail of a slower connection's range.
+  uint32_t m_steals = 0;
+  uint32_t m_errors = 0;
+  /// Dropped after repeated errors (or a 404); its unfinished ranges went to the others.
+  bool m_disabled = false;
+};
+
+/// Downloads one file from several mirrors at once over agus_http. The file is
+/// split into ranges which each connection pulls from a shared queue, so faster
+/// mirrors fetch more of them. Once the queue is empty, an idle connection takes
+/// over the tail of a slower one's range, sized from both mirrors' measured
+/// throughput and its own first-byte latency, so the download doesn't wait on
+/// the slowest connection. |urls| are the same file on each mirror, lowest
+/// latency first; ranges are handed out in that order.
+///
+/// The file is written to a .downloading file next to |filePath| and renamed once
+/// complete; a failed or cancelled download removes it. |fileSize| must be the
+/// exact size of the file. Returns an id for GetMirrorDownloadProgress and
+/// CancelMirrorDownload.
+int64_t StartMirrorDownload(std::vector<std::string> const & urls, std::string const & filePath, int64_t fileSize,
+                            unsigned connectionsPerMirror);
+
+/// Fills |mirrors|, if given, with one entry per url passed to StartMirrorDownload.
+FileDownloadProgress GetMirrorDownloadProgress(int64_t id, std::vector<MirrorStats> * mirrors = nullptr);
+
+/// Stops a running download and forgets |id|; also releases a finished one.
+void CancelMirrorDownload(int64_t id);
+}  // namespace agus
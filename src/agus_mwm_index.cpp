@@ -0,0 +1,183 @@
+#include "agus_mwm_index.hpp"
+
+#include "indexer/data_source.hpp"
+
+#include "storage/country_decl.hpp"
+
+#include "platform/platform.hpp"
+
+#include "coding/files_container.hpp"
+#include "coding/geometry_coding.hpp"
+#include "coding/read_write_utils.hpp"
+#include "coding/varint.hpp"
+
+#include "geometry/region2d.hpp"
+#include "geometry/tree4d.hpp"
+
+#include "base/logging.hpp"
+#include "base/string_utils.hpp"
+
+#include "defines.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace agus
+{
+namespace
+{
+/// Region borders from packed_polygons.bin, read per country on demand the way
+/// storage::CountryInfoReader does.
+class Borders
+{
+public:
+  /// Outer borders of |countryId|, nullptr if it has none (or the file is missing).
+  std::vector<m2::RegionD> const * Get(std::string const & countryId)
+  {
+    if (!m_loaded)
+      LoadInfo();
+
+    auto const cached = m_regions.find(countryId);
+    if (cached != m_regions.end())
+      return &cached->second;
+
+    auto const it = m_ids.find(countryId);
+    if (it == m_ids.end())
+      return nullptr;
+
+    std::vector<m2::RegionD> regions;
+    try
+    {
+      ReaderSource<ModelReaderPtr> src(m_container->GetReader(strings::to_string(it->second)));
+      uint32_t const count = ReadVarUint<uint32_t>(src);
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        std::vector<m2::PointD> points;
+        serial::LoadOuterPath(src, serial::GeometryCodingParams(), points);
+        regions.emplace_back(std::move(points));
+      }
+    }
+    catch (RootException const & e)
+    {
+      LOG(LWARNING, ("Can't read borders of", countryId, e.Msg()));
+      return nullptr;
+    }
+    return &m_regions.emplace(countryId, std::move(regions)).first->second;
+  }
+
+private:
+  void LoadInfo()
+  {
+    m_loaded = true;
+    try
+    {
+      m_container = std::make_unique<FilesContainerR>(GetPlatform().GetReader(PACKED_POLYGONS_FILE));
+      std::vector<storage::CountryDef> countries;
+      ReaderSource<ModelReaderPtr> src(m_container->GetReader(PACKED_POLYGONS_INFO_TAG));
+      rw::Read(src, countries);
+      for (size_t i = 0; i < countries.size(); ++i)
+        m_ids.emplace(countries[i].m_countryId, i);
+    }
+    catch (RootException const & e)
+    {
+      LOG(LWARNING, ("Can't read", PACKED_POLYGONS_FILE, e.Msg(), "- matching by map bounds only"));
+      m_container.reset();
+      m_ids.clear();
+    }
+  }
+
+  bool m_loaded = false;
+  std::unique_ptr<FilesContainerR> m_container;
+  std::map<std::string, size_t> m_ids;
+  std::map<std::string, std::vector<m2::RegionD>> m_regions;
+};
+
+struct Entry
+{
+  m2::RectD const & GetLimitRect() const { return m_rect; }
+  bool operator==(Entry const & rhs) const { return m_info == rhs.m_info && m_region == rhs.m_region; }
+
+  MwmInfo const * m_info = nullptr;
+  /// One outer border of the region, nullptr to match by m_rect alone.
+  m2::RegionD const * m_region = nullptr;
+  m2::RectD m_rect;
+};
+
+class CoverageIndex
+{
+public:
+  void Find(DataSource const & dataSource, std::vector<m2::PointD> const & points, std::vector<MwmHit> & hits)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    UpdateIfChanged(dataSource);
+
+    hits.assign(points.size(), {});
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+      m2::PointD const & pt = points[i];
+      MwmInfo const * found = nullptr;
+      m_tree.ForEachInRect(m2::RectD(pt, pt), [&](Entry const & e)
+      {
+        if (found == nullptr && (e.m_region == nullptr ? e.m_rect.IsPointInside(pt) : e.m_region->Contains(pt)))
+          found = e.m_info;
+      });
+      if (found != nullptr)
+      {
+        hits[i].m_countryName = found->GetCountryName();
+        hits[i].m_version = found->GetVersion();
+      }
+    }
+  }
+
+private:
+  /// MwmSet creates a new MwmInfo for every registration, so comparing the
+  /// registered infos with the indexed ones detects any change. The indexed
+  /// infos are held, so their addresses can't be reused meanwhile.
+  void UpdateIfChanged(DataSource const & dataSource)
+  {
+    std::vector<std::shared_ptr<MwmInfo>> infos;
+    dataSource.GetMwmsInfo(infos);
+    infos.erase(std::remove_if(infos.begin(), infos.end(),
+                               [](auto const & info) { return info->GetType() != MwmInfo::COUNTRY; }),
+                infos.end());
+    std::sort(infos.begin(), infos.end());
+    if (infos == m_infos)
+      return;
+
+    m_infos = std::move(infos);
+    m_tree.Clear();
+    size_t entries = 0;
+    for (auto const & info : m_infos)
+    {
+      auto const * regions = m_borders.Get(info->GetCountryName());
+      if (regions == nullptr || regions->empty())
+      {
+        m_tree.Add(Entry{info.get(), nullptr, info->m_bordersRect});
+        ++entries;
+        continue;
+      }
+      for (auto const & region : *regions)
+      {
+        m_tree.Add(Entry{info.get(), &region, region.GetRect()});
+        ++entries;
+      }
+    }
+    LOG(LINFO, ("Coverage index:", m_infos.size(), "maps,", entries, "entries"));
+  }
+
+  std::mutex m_mutex;
+  std::vector<std::shared_ptr<MwmInfo>> m_infos;
+  Borders m_borders;
+  m4::Tree<Entry> m_tree;
+};
+
+CoverageIndex g_index;
+}  // namespace
+
+void FindMwmsAt(DataSource const & dataSource, std::vector<m2::PointD> const & points, std::vector<MwmHit> & hits)
+{
+  g_index.Find(dataSource, points, hits);
+}
+}  // namespace agus
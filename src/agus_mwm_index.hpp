@@ -0,0 +1,28 @@
+#pragma once
+
+#include "geometry/point2d.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class DataSource;
+
+namespace agus
+{
+struct MwmHit
+{
+  /// Empty if no registered region map covers the point.
+  std::string m_countryName;
+  int64_t m_version = 0;
+};
+
+/// Finds the registered region map covering each of |points| (mercator).
+/// Candidates come from a tree over the region bounds and are confirmed against
+/// the borders in packed_polygons.bin, so neighbouring regions whose bounding
+/// rects overlap are told apart. World and coast maps are not reported; maps
+/// without borders in packed_polygons.bin match by bounding rect.
+/// The index follows registrations: it is rebuilt when the registered set changed.
+void FindMwmsAt(DataSource const & dataSource, std::vector<m2::PointD> const & points,
+                std::vector<MwmHit> & hits);
+}  // namespace agus
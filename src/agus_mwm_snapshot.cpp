@@ -0,0 +1,202 @@
+#include "agus_mwm_snapshot.hpp"
+
+#include "platform/local_country_file.hpp"
+#include "platform/platform.hpp"
+
+#include "coding/file_reader.hpp"
+#include "coding/file_writer.hpp"
+#include "coding/read_write_utils.hpp"
+#include "coding/reader.hpp"
+#include "coding/write_to_sink.hpp"
+
+#include "base/logging.hpp"
+
+#include <cstdio>
+
+#include <sys/stat.h>
+
+namespace agus
+{
+namespace
+{
+char constexpr kSnapshotFile[] = "mwm_registration.bin";
+uint32_t constexpr kMagic = 0x534D4741;  // "AGMS"
+uint32_t constexpr kFormatVersion = 1;
+
+bool StatFile(std::string const & path, uint64_t & size, int64_t & mtime)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+  size = static_cast<uint64_t>(st.st_size);
+  mtime = static_cast<int64_t>(st.st_mtime);
+  return true;
+}
+
+template <typename Sink>
+void WriteDouble(Sink & sink, double value)
+{
+  sink.Write(&value, sizeof(value));
+}
+
+template <typename Source>
+double ReadDouble(Source & src)
+{
+  double value;
+  src.Read(&value, sizeof(value));
+  return value;
+}
+}  // namespace
+
+bool RegistrationSnapshot::Load()
+{
+  m_entries.clear();
+  m_changed = false;
+  if (!Platform::IsFileExistsByFullPath(m_path))
+    return false;
+
+  try
+  {
+    FileReader reader(m_path);
+    ReaderSource<FileReader> src(reader);
+    if (ReadPrimitiveFromSource<uint32_t>(src) != kMagic ||
+        ReadPrimitiveFromSource<uint32_t>(src) != kFormatVersion)
+    {
+      LOG(LWARNING, ("Ignoring snapshot of an unknown format", m_path));
+      return false;
+    }
+
+    auto const count = ReadPrimitiveFromSource<uint32_t>(src);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      std::string path;
+      rw::Read(src, path);
+      Entry entry;
+      entry.m_size = ReadPrimitiveFromSource<uint64_t>(src);
+      entry.m_mtime = ReadPrimitiveFromSource<int64_t>(src);
+      entry.m_version = ReadPrimitiveFromSource<int64_t>(src);
+      double const minX = ReadDouble(src);
+      double const minY = ReadDouble(src);
+      double const maxX = ReadDouble(src);
+      double const maxY = ReadDouble(src);
+      entry.m_rect = m2::RectD(minX, minY, maxX, maxY);
+      m_entries.emplace(std::move(path), entry);
+    }
+  }
+  catch (RootException const & e)
+  {
+    LOG(LWARNING, ("Can't read snapshot", m_path, e.Msg()));
+    m_entries.clear();
+    return false;
+  }
+  return true;
+}
+
+bool RegistrationSnapshot::SaveIfChanged()
+{
+  if (!m_changed)
+    return true;
+
+  std::string const tmpPath = m_path + ".tmp";
+  try
+  {
+    FileWriter writer(tmpPath);
+    WriteToSink(writer, kMagic);
+    WriteToSink(writer, kFormatVersion);
+    WriteToSink(writer, static_cast<uint32_t>(m_entries.size()));
+    for (auto const & [path, entry] : m_entries)
+    {
+      rw::Write(writer, path);
+      WriteToSink(writer, entry.m_size);
+      WriteToSink(writer, entry.m_mtime);
+      WriteToSink(writer, entry.m_version);
+      WriteDouble(writer, entry.m_rect.minX());
+      WriteDouble(writer, entry.m_rect.minY());
+      WriteDouble(writer, entry.m_rect.maxX());
+      WriteDouble(writer, entry.m_rect.maxY());
+    }
+  }
+  catch (RootException const & e)
+  {
+    LOG(LWARNING, ("Can't write snapshot", tmpPath, e.Msg()));
+    return false;
+  }
+
+  if (std::rename(tmpPath.c_str(), m_path.c_str()) != 0)
+  {
+    LOG(LWARNING, ("Can't replace snapshot", m_path));
+    return false;
+  }
+  m_changed = false;
+  return true;
+}
+
+std::optional<LazyMapInfo> RegistrationSnapshot::GetMapInfo(std::string const & fullPath, bool useSnapshot,
+                                                            bool & fromSnapshot)
+{
+  fromSnapshot = false;
+  if (useSnapshot)
+  {
+    if (auto info = FindUnchanged(fullPath))
+    {
+      fromSnapshot = true;
+      return info;
+    }
+  }
+
+  auto info = ReadLazyMapInfo(fullPath);
+  if (!info)
+  {
+    m_changed = m_entries.erase(fullPath) > 0 || m_changed;
+    return {};
+  }
+  Record(*info);
+  return info;
+}
+
+std::optional<LazyMapInfo> RegistrationSnapshot::FindUnchanged(std::string const & fullPath) const
+{
+  auto const it = m_entries.find(fullPath);
+  if (it == m_entries.end())
+    return {};
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  if (!StatFile(fullPath, size, mtime) || it->second.m_size != size || it->second.m_mtime != mtime)
+    return {};
+
+  LazyMapInfo info;
+  info.m_path = fullPath;
+  info.m_countryName = platform::LocalCountryFile::MakeTemporary(fullPath).GetCountryName();
+  info.m_rect = it->second.m_rect;
+  info.m_version = it->second.m_version;
+  return info;
+}
+
+void RegistrationSnapshot::Record(LazyMapInfo const & info)
+{
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  if (!StatFile(info.m_path, size, mtime))
+  {
+    m_changed = m_entries.erase(info.m_path) > 0 || m_changed;
+    return;
+  }
+
+  Entry const entry{size, mtime, info.m_rect, info.m_version};
+  auto & stored = m_entries[info.m_path];
+  m_changed = m_changed || stored.m_size != size || stored.m_mtime != mtime || stored.m_version != entry.m_version ||
+              !(stored.m_rect == entry.m_rect);
+  stored = entry;
+}
+
+RegistrationSnapshot & GetRegistrationSnapshot()
+{
+  static RegistrationSnapshot snapshot = []()
+  {
+    RegistrationSnapshot s(GetPlatform().WritableDir() + kSnapshotFile);
+    s.Load();
+    return s;
+  }();
+  return snapshot;
+}
+}  // namespace agus
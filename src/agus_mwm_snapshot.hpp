@@ -0,0 +1,56 @@
+#pragma once
+
+#include "agus_lazy_maps.hpp"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace agus
+{
+/// Header data of maps seen before, so registering an unchanged file can be put off
+/// with a stat() instead of opening it. Only what lazy registration needs to pick a
+/// map (bounds, version) is kept; MwmSet still reads the file in full when it is
+/// registered. Entries are keyed by full path and trusted only while the file's size
+/// and mtime match.
+class RegistrationSnapshot
+{
+public:
+  explicit RegistrationSnapshot(std::string const & path) : m_path(path) {}
+
+  /// Returns false if there is no snapshot or it is unreadable (then it is empty).
+  bool Load();
+  /// Writes the snapshot if entries were added or dropped since Load.
+  bool SaveIfChanged();
+
+  /// Bounds and version of |fullPath| from the snapshot when the file is unchanged
+  /// and |useSnapshot| is set, otherwise read from its header and recorded.
+  /// |fromSnapshot| tells which.
+  std::optional<LazyMapInfo> GetMapInfo(std::string const & fullPath, bool useSnapshot, bool & fromSnapshot);
+
+  /// Bounds and version of |fullPath| if the snapshot has them and the file is unchanged.
+  std::optional<LazyMapInfo> FindUnchanged(std::string const & fullPath) const;
+  /// Records |info| under its path with the file's current size and mtime, e.g. after
+  /// registering the file opened it anyway.
+  void Record(LazyMapInfo const & info);
+
+  size_t GetCount() const { return m_entries.size(); }
+
+private:
+  struct Entry
+  {
+    uint64_t m_size = 0;
+    int64_t m_mtime = 0;
+    m2::RectD m_rect;
+    int64_t m_version = 0;
+  };
+
+  std::string m_path;
+  std::map<std::string, Entry> m_entries;
+  bool m_changed = false;
+};
+
+/// Snapshot under the writable directory, loaded on first use.
+RegistrationSnapshot & GetRegistrationSnapshot();
+}  // namespace agus
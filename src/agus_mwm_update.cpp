@@ -0,0 +1,433 @@
+#include "agus_mwm_update.hpp"
+
+#include "agus_downloader.hpp"
+#include "agus_file_hash.hpp"
+#include "agus_map_swap.hpp"
+#include "agus_threads.hpp"
+
+#include "mwm_diff/diff.hpp"
+
+#include "platform/mwm_version.hpp"
+#include "platform/platform.hpp"
+
+#include "coding/file_reader.hpp"
+#include "coding/files_container.hpp"
+#include "coding/zlib.hpp"
+
+#include "base/cancellable.hpp"
+#include "base/file_name_utils.hpp"
+#include "base/logging.hpp"
+#include "base/string_utils.hpp"
+
+#include "defines.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/// Applying a diff reads all of it, then inflates all of it into memory; diffs past either
+/// size are not applied.
+int64_t constexpr kMaxDiffSize = 64 << 20;
+uint64_t constexpr kMaxInflatedDiffSize = 256 << 20;
+/// The diff file starts with its format version, then the deflated diff.
+uint64_t constexpr kDiffHeaderSize = sizeof(uint32_t);
+unsigned constexpr kDownloadSegments = 4;
+auto constexpr kPollInterval = std::chrono::milliseconds(100);
+/// How long the GUI thread gets to start the swap before the update gives up on it.
+auto constexpr kSwapTimeout = std::chrono::seconds(30);
+
+struct Update
+{
+  Framework * m_framework = nullptr;
+  MwmUpdateRequest m_request;
+  MwmUpdateProgress m_progress;
+  base::Cancellable m_cancellable;
+};
+
+std::mutex g_mutex;
+std::condition_variable g_queueChanged;
+std::map<int64_t, std::shared_ptr<Update>> g_updates;
+std::deque<std::shared_ptr<Update>> g_queue;
+int64_t g_nextId = 1;
+bool g_workerStarted = false;
+
+uint64_t MicrosSince(Clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+template <typename Fn>
+void Mutate(Update & update, Fn && fn)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  fn(update.m_progress);
+}
+
+bool SyncPath(std::string const & path, int flags)
+{
+  int const fd = open(path.c_str(), flags | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  bool const ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+}
+
+/// Makes |tmpPath| durable, then atomically moves it to |path|.
+bool Commit(std::string const & tmpPath, std::string const & path)
+{
+  if (!SyncPath(tmpPath, O_RDONLY) || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    return false;
+  // The rename itself lives in the directory.
+  SyncPath(base::GetDirectory(path), O_RDONLY | O_DIRECTORY);
+  return true;
+}
+
+/// Runs a download of agus_downloader to completion on the calling thread.
+bool Download(Update & update, std::string const & url, std::string const & path, int64_t size)
+{
+  int64_t const id = StartFileDownload(url, path, size, kDownloadSegments);
+  while (true)
+  {
+    if (update.m_cancellable.IsCancelled())
+    {
+      CancelFileDownload(id);
+      return false;
+    }
+    auto const progress = GetFileDownloadProgress(id);
+    if (progress.m_status != FileDownloadStatus::InProgress)
+    {
+      Mutate(update, [&](MwmUpdateProgress & p) { p.m_downloadedBytes += progress.m_bytesDownloaded; });
+      if (progress.m_status != FileDownloadStatus::Completed)
+        LOG(LWARNING, ("Download of", url, "failed:", static_cast<int>(progress.m_status)));
+      return progress.m_status == FileDownloadStatus::Completed;
+    }
+    std::this_thread::sleep_for(kPollInterval);
+  }
+}
+
+struct InflatedSizeExceeded
+{
+};
+
+/// Output iterator counting inflated bytes, without keeping them.
+class InflatedSizeCounter
+{
+public:
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = void;
+  using pointer = void;
+  using reference = void;
+
+  explicit InflatedSizeCounter(uint64_t & size) : m_size(&size) {}
+
+  InflatedSizeCounter & operator*() { return *this; }
+  InflatedSizeCounter & operator++() { return *this; }
+  InflatedSizeCounter & operator++(int) { return *this; }
+
+  template <typename T>
+  InflatedSizeCounter & operator=(T const &)
+  {
+    if (++*m_size > kMaxInflatedDiffSize)
+      throw InflatedSizeExceeded();
+    return *this;
+  }
+
+private:
+  uint64_t * m_size;
+};
+
+/// True if the diff at |path| inflates to at most kMaxInflatedDiffSize, i.e. applying it
+/// stays in the memory budget. Inflates it once to count, holding only the deflated diff.
+bool FitsInflatedBudget(std::string const & path)
+{
+  uint64_t inflated = 0;
+  try
+  {
+    FileReader const reader(path);
+    if (reader.Size() < kDiffHeaderSize)
+      return false;
+    std::vector<uint8_t> deflated(static_cast<size_t>(reader.Size() - kDiffHeaderSize));
+    reader.Read(kDiffHeaderSize, deflated.data(), deflated.size());
+    using Inflate = coding::ZLib::Inflate;
+    Inflate const inflate(Inflate::Format::ZLib);
+    if (!inflate(deflated.data(), deflated.size(), InflatedSizeCounter(inflated)))
+      return false;
+  }
+  catch (InflatedSizeExceeded const &)
+  {
+    LOG(LWARNING, (path, "inflates to more than", kMaxInflatedDiffSize, "bytes"));
+    return false;
+  }
+  catch (Reader::Exception const & e)
+  {
+    LOG(LWARNING, ("Can't read", path, e.Msg()));
+    return false;
+  }
+  return true;
+}
+
+bool Verify(Update & update, std::string const & path)
+{
+  auto const start = Clock::now();
+  auto const & request = update.m_request;
+  bool ok = false;
+  if (!request.m_sha256.empty())
+  {
+    auto const digest = HashFile(path);
+    ok = digest && DebugPrint(*digest) == request.m_sha256;
+  }
+  else
+  {
+    try
+    {
+      version::MwmVersion::Read(FilesContainerR(path));
+      ok = true;
+    }
+    catch (RootException const & e)
+    {
+      LOG(LWARNING, (path, "is not a valid map:", e.Msg()));
+    }
+  }
+  Mutate(update, [&](MwmUpdateProgress & p) { p.m_verifyMicros += MicrosSince(start); });
+  if (!ok)
+    LOG(LWARNING, ("Verification of", path, "failed"));
+  return ok;
+}
+
+DiffFailure UpdateByDiff(Update & update, std::string const & tmpPath)
+{
+  auto const & request = update.m_request;
+  if (request.m_diffUrl.empty() || request.m_diffSize <= 0 || request.m_diffSize > kMaxDiffSize ||
+      (request.m_fullSize > 0 && request.m_diffSize * 2 > request.m_fullSize))
+  {
+    return DiffFailure::Skipped;
+  }
+
+  std::string const diffPath = request.m_newPath + DIFF_FILE_EXTENSION;
+  if (!Download(update, request.m_diffUrl, diffPath, request.m_diffSize))
+    return DiffFailure::Download;
+  if (!FitsInflatedBudget(diffPath))
+  {
+    std::remove(diffPath.c_str());
+    return DiffFailure::Skipped;
+  }
+
+  auto const start = Clock::now();
+  auto const result = mwm_diff::ApplyDiff(request.m_oldPath, tmpPath, diffPath, update.m_cancellable);
+  Mutate(update, [&](MwmUpdateProgress & p) { p.m_applyMicros = MicrosSince(start); });
+  std::remove(diffPath.c_str());
+  if (result != mwm_diff::DiffApplicationResult::Ok)
+  {
+    LOG(LWARNING, ("Applying", request.m_diffUrl, "to", request.m_oldPath, "failed:", mwm_diff::DebugPrint(result)));
+    return DiffFailure::Apply;
+  }
+  return Verify(update, tmpPath) ? DiffFailure::None : DiffFailure::Verify;
+}
+
+MwmUpdateStatus Run(Update & update)
+{
+  auto const & request = update.m_request;
+  if (request.m_newPath == request.m_oldPath)
+  {
+    // ReplaceMap registers the new file while the old one is still open: they can't be one file.
+    LOG(LWARNING, ("Can't update", request.m_oldPath, "in place"));
+    return MwmUpdateStatus::Failed;
+  }
+  std::string const tmpPath = request.m_newPath + ".tmp";
+
+  MwmUpdateStatus status = MwmUpdateStatus::Failed;
+  DiffFailure const diffFailure = UpdateByDiff(update, tmpPath);
+  Mutate(update, [&](MwmUpdateProgress & p) { p.m_diffFailure = diffFailure; });
+  if (diffFailure == DiffFailure::None)
+  {
+    status = MwmUpdateStatus::UpdatedByDiff;
+  }
+  else if (!update.m_cancellable.IsCancelled())
+  {
+    std::remove(tmpPath.c_str());
+    if (Download(update, request.m_fullUrl, tmpPath, request.m_fullSize) && Verify(update, tmpPath))
+      status = MwmUpdateStatus::UpdatedByFullDownload;
+  }
+
+  if (update.m_cancellable.IsCancelled())
+    status = MwmUpdateStatus::Cancelled;
+  if (status == MwmUpdateStatus::Failed || status == MwmUpdateStatus::Cancelled)
+  {
+    std::remove(tmpPath.c_str());
+    return status;
+  }
+
+  if (!Commit(tmpPath, request.m_newPath))
+  {
+    LOG(LWARNING, ("Can't move", tmpPath, "into place"));
+    std::remove(tmpPath.c_str());
+    return MwmUpdateStatus::Failed;
+  }
+
+  // Registration changes go through the GUI thread, like the other map operations. If it
+  // doesn't start the swap in time, the swap is abandoned: whichever of the task and the
+  // timeout claims it first wins. The new file stays at m_newPath either way.
+  struct Swap
+  {
+    std::atomic<bool> m_claimed{false};
+    std::promise<MwmSet::RegResult> m_result;
+  };
+  auto swap = std::make_shared<Swap>();
+  auto result = swap->m_result.get_future();
+  bool const done = RunOnGuiThreadAndWait([swap, framework = update.m_framework, path = request.m_newPath]()
+  {
+    if (swap->m_claimed.exchange(true))
+      return;
+    try
+    {
+      swap->m_result.set_value(ReplaceMap(*framework, path).m_result);
+    }
+    catch (RootException const & e)
+    {
+      LOG(LWARNING, ("Swapping in", path, "failed:", e.Msg()));
+      swap->m_result.set_value(MwmSet::RegResult::BadFile);
+    }
+  }, kSwapTimeout);
+  if (!done && !swap->m_claimed.exchange(true))
+  {
+    LOG(LWARNING, ("GUI thread didn't get to swapping in", request.m_newPath, "in time"));
+    return MwmUpdateStatus::Failed;
+  }
+  // Claimed by the task: the swap ran or is running.
+  auto const regResult = result.get();
+  Mutate(update, [&](MwmUpdateProgress & p) { p.m_regResult = static_cast<int32_t>(regResult); });
+  return regResult == MwmSet::RegResult::Success ? status : MwmUpdateStatus::Failed;
+}
+
+void RunWorker()
+{
+  while (true)
+  {
+    std::shared_ptr<Update> update;
+    {
+      std::unique_lock<std::mutex> lock(g_mutex);
+      g_queueChanged.wait(lock, []() { return !g_queue.empty(); });
+      update = std::move(g_queue.front());
+      g_queue.pop_front();
+    }
+
+    auto const start = Clock::now();
+    MwmUpdateStatus const status =
+        update->m_cancellable.IsCancelled() ? MwmUpdateStatus::Cancelled : Run(*update);
+    MwmUpdateProgress progress;
+    Mutate(*update, [&](MwmUpdateProgress & p)
+    {
+      p.m_status = status;
+      p.m_totalMicros = MicrosSince(start);
+      if (status == MwmUpdateStatus::UpdatedByDiff || status == MwmUpdateStatus::UpdatedByFullDownload)
+        p.m_bytesSaved = p.m_fullBytes - p.m_downloadedBytes;
+      progress = p;
+    });
+    LOG(LINFO, ("Map update of", update->m_request.m_oldPath, DebugPrint(progress)));
+  }
+}
+}  // namespace
+
+std::string DebugPrint(MwmUpdateStatus status)
+{
+  switch (status)
+  {
+  case MwmUpdateStatus::Unknown: return "Unknown";
+  case MwmUpdateStatus::InProgress: return "InProgress";
+  case MwmUpdateStatus::UpdatedByDiff: return "UpdatedByDiff";
+  case MwmUpdateStatus::UpdatedByFullDownload: return "UpdatedByFullDownload";
+  case MwmUpdateStatus::Failed: return "Failed";
+  case MwmUpdateStatus::Cancelled: return "Cancelled";
+  }
+  return "Unknown";
+}
+
+std::string DebugPrint(DiffFailure failure)
+{
+  switch (failure)
+  {
+  case DiffFailure::None: return "None";
+  case DiffFailure::Skipped: return "Skipped";
+  case DiffFailure::Download: return "Download";
+  case DiffFailure::Apply: return "Apply";
+  case DiffFailure::Verify: return "Verify";
+  }
+  return "Unknown";
+}
+
+std::string DebugPrint(MwmUpdateProgress const & progress)
+{
+  std::ostringstream out;
+  out << DebugPrint(progress.m_status) << " diff=" << DebugPrint(progress.m_diffFailure)
+      << " downloaded=" << progress.m_downloadedBytes << "B saved=" << progress.m_bytesSaved
+      << "B apply=" << progress.m_applyMicros << "us verify=" << progress.m_verifyMicros
+      << "us total=" << progress.m_totalMicros << "us";
+  return out.str();
+}
+
+int64_t StartMwmUpdate(Framework & framework, MwmUpdateRequest request)
+{
+  auto update = std::make_shared<Update>();
+  update->m_framework = &framework;
+  update->m_progress.m_status = MwmUpdateStatus::InProgress;
+  update->m_progress.m_fullBytes = request.m_fullSize;
+  update->m_request = std::move(request);
+  strings::AsciiToLower(update->m_request.m_sha256);
+
+  int64_t id;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    id = g_nextId++;
+    g_updates[id] = update;
+    g_queue.push_back(std::move(update));
+    if (!g_workerStarted)
+    {
+      g_workerStarted = true;
+      std::thread(&RunWorker).detach();
+    }
+  }
+  g_queueChanged.notify_one();
+  return id;
+}
+
+MwmUpdateProgress GetMwmUpdateProgress(int64_t id)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto const it = g_updates.find(id);
+  if (it == g_updates.end())
+    return {};
+  return it->second->m_progress;
+}
+
+void CancelMwmUpdate(int64_t id)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto const it = g_updates.find(id);
+  if (it == g_updates.end())
+    return;
+  // The worker holds its own reference until it notices.
+  it->second->m_cancellable.Cancel();
+  g_updates.erase(it);
+}
+}  // namespace agus
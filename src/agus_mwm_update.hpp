@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Framework;
+
+namespace agus
+{
+/// Where to get the new version of a registered map.
+struct MwmUpdateRequest
+{
+  /// Path of the registered map.
+  std::string m_oldPath;
+  /// Path the new version is written to; must differ from m_oldPath (see ReplaceMap).
+  std::string m_newPath;
+  /// mwmdiff turning the old version into the new one; empty to download the full map.
+  std::string m_diffUrl;
+  int64_t m_diffSize = 0;
+  std::string m_fullUrl;
+  int64_t m_fullSize = 0;
+  /// Lowercase hex SHA-256 of the new map; empty to only check that it opens as a map.
+  std::string m_sha256;
+};
+
+enum class MwmUpdateStatus
+{
+  Unknown = -1,
+  InProgress = 0,
+  UpdatedByDiff = 1,
+  UpdatedByFullDownload = 2,
+  Failed = 3,
+  Cancelled = 4,
+};
+
+/// Why the diff wasn't used, if it wasn't.
+enum class DiffFailure
+{
+  None = 0,
+  /// No diff offered, or too large to be worth it (see StartMwmUpdate).
+  Skipped = 1,
+  Download = 2,
+  Apply = 3,
+  Verify = 4,
+};
+
+std::string DebugPrint(MwmUpdateStatus status);
+std::string DebugPrint(DiffFailure failure);
+
+struct MwmUpdateProgress
+{
+  MwmUpdateStatus m_status = MwmUpdateStatus::Unknown;
+  DiffFailure m_diffFailure = DiffFailure::None;
+  /// MwmSet::RegResult of the swap, -1 until it happened.
+  int32_t m_regResult = -1;
+  /// Bytes fetched for this update: the diff, plus the full map after a fallback.
+  int64_t m_downloadedBytes = 0;
+  /// Size of the new map, i.e. what a full download costs.
+  int64_t m_fullBytes = 0;
+  /// m_fullBytes - m_downloadedBytes once updated; negative after a failed diff.
+  int64_t m_bytesSaved = 0;
+  uint64_t m_applyMicros = 0;
+  uint64_t m_verifyMicros = 0;
+  uint64_t m_totalMicros = 0;
+};
+
+std::string DebugPrint(MwmUpdateProgress const & progress);
+
+/// Updates a registered map in the background, preferring the diff: downloads
+/// it, applies it to the old file with CoMaps' mwm_diff, verifies the result and
+/// swaps it in with ReplaceMap. Any failure on the diff path falls back to
+/// downloading m_fullUrl. A diff larger than half the map, or than the memory
+/// budget for applying it, is skipped: applying holds the whole inflated diff in
+/// memory, so its inflated size is counted (without keeping it) before applying.
+/// Fails if m_newPath is m_oldPath, and if the GUI thread doesn't get to the swap
+/// within 30 seconds; the new file is then left at m_newPath.
+///
+/// Updates run one at a time on a dedicated thread, which bounds memory to one
+/// diff and I/O to one map. The new file is written next to the target, synced
+/// and renamed into place, so m_newPath never holds a partial map.
+/// Returns an id for GetMwmUpdateProgress and CancelMwmUpdate.
+int64_t StartMwmUpdate(Framework & framework, MwmUpdateRequest request);
+
+/// m_status is Unknown for an unknown id.
+MwmUpdateProgress GetMwmUpdateProgress(int64_t id);
+
+/// Stops a pending or running update, keeping the registered map, and forgets
+/// |id|; also releases a finished one.
+void CancelMwmUpdate(int64_t id);
+}  // namespace agus
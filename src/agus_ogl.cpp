@@ -1,7 +1,10 @@
 #include "agus_ogl.hpp"
+#include "agus_metrics.hpp"
+#include "agus_trace.hpp"
 #include "base/assert.hpp"
 #include "base/logging.hpp"
 #include <algorithm>
+#include <chrono>
 #include <vector>
 
 #define CHECK_EGL_CALL() \
@@ -48,6 +51,7 @@ namespace agus
 
   void AgusOGLContext::MakeCurrent()
   {
+    AGUS_TRACE_SCOPE("render", "MakeCurrent");
     if (m_surface != EGL_NO_SURFACE) {
       EGLBoolean result = eglMakeCurrent(m_display, m_surface, m_surface, m_nativeContext);
       if (result != EGL_TRUE) {
@@ -69,8 +73,15 @@ namespace agus
 
   void AgusOGLContext::Present()
   {
+    AGUS_TRACE_SCOPE("render", "Present");
+    static auto & presentTimes = GetHistogram("render.present_us");
     if (m_presentAvailable && m_surface != EGL_NO_SURFACE)
+    {
+      auto const start = std::chrono::steady_clock::now();
       eglSwapBuffers(m_display, m_surface);
+      presentTimes.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count());
+    }
   }
 
   void AgusOGLContext::SetFramebuffer(ref_ptr<dp::BaseFramebuffer> framebuffer)
@@ -8,7 +8,21 @@
 #include "base/file_name_utils.hpp"
 #include "base/logging.hpp"
 #include "base/task_loop.hpp"
+#include "drape_frontend/read_threads.hpp"
+#include "defines.hpp"
+#include "agus_platform.hpp"
+#ifdef __ANDROID__
 #include "agus_gui_thread.hpp"
+#endif
+#include "agus_memory.hpp"
+#include "agus_archive_maps.hpp"
+#include "agus_engine_hooks.hpp"
+#include "agus_file_pool.hpp"
+#include "agus_threads.hpp"
+#include "agus_fonts.hpp"
+#include "agus_resource_pack.hpp"
+#include "agus_style_switch.hpp"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -80,9 +94,27 @@ public:
       if (!m_settingsDir.empty() && m_settingsDir.back() != '/') m_settingsDir += '/';
       if (!m_tmpDir.empty() && m_tmpDir.back() != '/') m_tmpDir += '/';
       
+#ifdef __ANDROID__
       // Initialize the GUI thread to post tasks to Android main thread
       // This ensures thread affinity for BookmarkManager and other GUI-thread components
       SetGuiThread(std::make_unique<agus::AgusGuiThread>());
+#endif
+  }
+
+  // Replaces the default single-threaded network/file/background pools with
+  // instrumented ones sized by |config|. Must run before any task is posted.
+  void StartWorkerThreads(agus::ThreadConfig const & config)
+  {
+      if (m_networkThread || m_fileThread || m_backgroundThread)
+      {
+          LOG(LWARNING, ("Worker threads already running, thread config ignored:", agus::DebugPrint(config)));
+          return;
+      }
+
+      m_networkThread = std::make_unique<agus::InstrumentedThreadPool>("network", config.m_networkThreads);
+      m_fileThread = std::make_unique<agus::InstrumentedThreadPool>("file", config.m_fileThreads);
+      m_backgroundThread = std::make_unique<agus::InstrumentedThreadPool>("background", config.m_backgroundThreads);
+      LOG(LINFO, ("Worker threads started:", agus::DebugPrint(config)));
   }
 };
 
@@ -103,12 +135,31 @@ extern "C" void AgusPlatform_InitPaths(const char* resourcePath, const char* wri
     g_platform.InitPaths(resourcePath, writablePath);
 }
 
+agus::ThreadConfig AgusPlatform_Start(const char* resourcePath, const char* writablePath,
+                                      agus::ThreadConfig const & overrides)
+{
+    g_platform.InitPaths(resourcePath, writablePath);
+
+    // Counts not overridden follow the core count
+    agus::ThreadConfig const config = agus::ResolveThreadConfig(overrides, Platform::CpuCores());
+    df::SetReadThreadsCount(config.m_readThreads);
+    g_platform.StartWorkerThreads(config);
+
+    // Descriptors of maps in use by an MwmHandle are never evicted from the file pool
+    agus::PinFilesOfLockedMaps();
+    // Maps registered in place from an archive look like files to the engine
+    agus::ServeArchiveMapsAsFiles();
+    // Tile reads and searches show up in comaps_trace_start recordings
+    agus::InstallEngineHooks();
+    return config;
+}
+
 // Stubs for missing Platform methods
 uint8_t Platform::GetBatteryLevel() { return 100; }
 Platform::ChargingStatus Platform::GetChargingStatus() { return Platform::ChargingStatus::Plugged; }
 Platform::EConnectionType Platform::ConnectionStatus() { return Platform::EConnectionType::CONNECTION_WIFI; }
 
-std::string Platform::GetMemoryInfo() const { return ""; }
+std::string Platform::GetMemoryInfo() const { return agus::DebugPrint(agus::GetMemoryStats()); }
 std::string Platform::DeviceName() const { return "AgusMap"; }
 std::string Platform::DeviceModel() const { return "Android"; }
 std::string Platform::Version() const { return "1.0.0"; }
@@ -123,22 +174,7 @@ __attribute__((visibility("default"))) std::vector<std::string> GetAndroidSystem
   return {"en"};
 }
 
-// Forward declarations for HTTP (HttpThread is declared at file scope)
-class HttpThread;
-
-namespace downloader {
-  class IHttpThreadCallback;
-  
-  // HTTP thread stubs - in downloader namespace as expected by http_request.cpp
-  __attribute__((visibility("default"))) void DeleteNativeHttpThread(::HttpThread*) {}
-
-  __attribute__((visibility("default"))) ::HttpThread * CreateNativeHttpThread(
-      std::string const & url, IHttpThreadCallback & callback, int64_t begRange,
-      int64_t endRange, int64_t expectedSize, std::string const & postBody) {
-    // Return nullptr - no HTTP support in headless mode
-    return nullptr;
-  }
-}
+// HttpThread, CreateNativeHttpThread and HttpClient::RunHttpRequest live in agus_http_thread.cpp
 
 namespace platform {
   __attribute__((visibility("default"))) std::string GetLocalizedTypeName(std::string const & type) { return type; }
@@ -158,12 +194,6 @@ namespace platform {
     return locale;
   }
 
-  // HttpClient stub
-  __attribute__((visibility("default"))) bool HttpClient::RunHttpRequest() {
-    // No HTTP support in headless mode
-    return false;
-  }
-
   // SecureStorage stubs
   __attribute__((visibility("default"))) void SecureStorage::Save(std::string const & key, std::string const & value) {
     // No-op in headless mode
@@ -194,13 +224,49 @@ namespace platform {
     return false;
   }
 }
+namespace
+{
+// Resource pack entries are named relative to the resources directory.
+std::string GetPackEntryName(std::string const & file, std::string const & resourcesDir)
+{
+  if (file.compare(0, resourcesDir.size(), resourcesDir) == 0)
+    return file.substr(resourcesDir.size());
+  return file;
+}
+}  // namespace
+
 // Override GetReader to use filesystem-only (no ZIP/APK reader)
 // This is necessary because our data files are extracted to the filesystem
 std::unique_ptr<ModelReader> Platform::GetReader(std::string const & file, std::string searchScope) const
 {
+  // Maps registered in place from an uncompressed archive entry.
+  if (auto reader = agus::OpenArchiveMapReader(file))
+    return reader;
+
+  // Style resources kept in memory for light/dark switches.
+  if (auto reader = agus::OpenMappedStyleReader(file))
+    return reader;
+
   // Use ReadPathForFile which handles all scopes via filesystem
-  return std::make_unique<FileReader>(ReadPathForFile(file, std::move(searchScope)), READER_CHUNK_LOG_SIZE,
-                                      READER_CHUNK_LOG_COUNT);
+  std::string path;
+  try
+  {
+    path = ReadPathForFile(file, std::move(searchScope));
+  }
+  catch (FileAbsentException const &)
+  {
+    // Not extracted: serve it from the resource pack, if one is in use.
+    if (auto reader = agus::OpenPackReader(GetPackEntryName(file, m_resourcesDir)))
+      return reader;
+    throw;
+  }
+
+  // Map files stay open as long as their MwmValue lives; bound their descriptors.
+  if (base::GetFileExtension(path) == DATA_FILE_EXTENSION)
+    return agus::OpenPooledReader(path, READER_CHUNK_LOG_SIZE, READER_CHUNK_LOG_COUNT);
+
+  return agus::KeepStyleFileMapped(file, path,
+                                   std::make_unique<FileReader>(path, READER_CHUNK_LOG_SIZE, READER_CHUNK_LOG_COUNT));
 }
 
 bool Platform::GetFileSizeByName(std::string const & fileName, uint64_t & size) const
@@ -211,24 +277,49 @@ bool Platform::GetFileSizeByName(std::string const & fileName, uint64_t & size)
   }
   catch (RootException const &)
   {
+    if (auto const pack = agus::GetResourcePack())
+    {
+      if (auto const data = pack->Find(GetPackEntryName(fileName, m_resourcesDir)))
+      {
+        size = data->size();
+        return true;
+      }
+    }
     return false;
   }
 }
 
 void Platform::GetFilesByRegExp(std::string const & directory, boost::regex const & regexp, FilesList & outFiles)
 {
-  DIR * dir = opendir(directory.c_str());
-  if (!dir)
+  size_t const first = outFiles.size();
+  if (DIR * dir = opendir(directory.c_str()))
+  {
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+      std::string name(entry->d_name);
+      if (name != "." && name != ".." && boost::regex_search(name.begin(), name.end(), regexp))
+        outFiles.push_back(std::move(name));
+    }
+    closedir(dir);
+  }
+
+  // Entries of the resource pack under the same resources subdirectory.
+  auto const pack = agus::GetResourcePack();
+  std::string const & resourcesDir = GetPlatform().ResourcesDir();
+  if (!pack || directory.compare(0, resourcesDir.size(), resourcesDir) != 0)
     return;
-  
-  struct dirent * entry;
-  while ((entry = readdir(dir)) != nullptr)
+  std::string packDir = directory.substr(resourcesDir.size());
+  if (!packDir.empty() && packDir.back() != '/')
+    packDir += '/';
+  for (auto & name : pack->List(packDir))
   {
-    std::string name(entry->d_name);
-    if (name != "." && name != ".." && boost::regex_search(name.begin(), name.end(), regexp))
+    if (boost::regex_search(name.begin(), name.end(), regexp) &&
+        std::find(outFiles.begin() + first, outFiles.end(), name) == outFiles.end())
+    {
       outFiles.push_back(std::move(name));
+    }
   }
-  closedir(dir);
 }
 
 void Platform::GetAllFiles(std::string const & directory, FilesList & outFiles)
@@ -269,13 +360,9 @@ Platform::EError Platform::MkDir(std::string const & dirName)
 
 void Platform::GetSystemFontNames(FilesList & res) const
 {
-  // Return fonts from the data directory
-  // Use RELATIVE paths (like "fonts/filename.ttf") so ReadPathForFile can resolve them
-  std::string const fontsDir = m_resourcesDir + "fonts/";
-  FilesList fontFiles;
-  GetFilesByRegExp(fontsDir, boost::regex(".*\\.ttf$"), fontFiles);
-  
-  // Prepend "fonts/" prefix (relative path) to each font file
-  for (auto const & font : fontFiles)
-    res.push_back("fonts/" + font);
+  // Fonts from the data directory, as RELATIVE paths (like "fonts/filename.ttf") so
+  // ReadPathForFile can resolve them. Only fonts for the scripts expected in labels
+  // are returned; see agus::SelectSystemFonts.
+  for (auto & font : agus::SelectSystemFonts(m_resourcesDir, m_writableDir))
+    res.push_back(std::move(font));
 }
\ No newline at end of file
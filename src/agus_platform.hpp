@@ -0,0 +1,18 @@
+#pragma once
+
+#include "agus_threads.hpp"
+
+/// Entry points of the plugin's Platform implementation (agus_platform.cpp), which
+/// replaces CoMaps' own on Android and in agus_bench on Linux.
+
+extern "C" void AgusPlatform_Init(const char* apkPath, const char* storagePath);
+
+/// Sets the resource and writable directories. On Android it also posts GUI tasks to
+/// the app's main thread; elsewhere the embedder calls Platform::SetGuiThread.
+extern "C" void AgusPlatform_InitPaths(const char* resourcePath, const char* writablePath);
+
+/// The platform part of comaps_init_paths: AgusPlatform_InitPaths, then the worker and
+/// Drape read pools sized from |overrides| and the core count, the file pool's pinning
+/// of locked maps, archive maps and the engine hooks. Returns the resolved config.
+agus::ThreadConfig AgusPlatform_Start(const char* resourcePath, const char* writablePath,
+                                      agus::ThreadConfig const & overrides);
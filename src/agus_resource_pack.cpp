@@ -0,0 +1,201 @@
+#include "agus_resource_pack.hpp"
+
+#include "base/assert.hpp"
+#include "base/logging.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace
+{
+char constexpr kMagic[] = "AGUSPACK";
+size_t constexpr kMagicSize = sizeof(kMagic) - 1;
+uint32_t constexpr kFormatVersion = 1;
+size_t constexpr kHeaderSize = kMagicSize + 4 + 4 + 8 + 8;
+
+template <typename T>
+T ReadLE(char const * p)
+{
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<T>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return value;
+}
+
+std::mutex g_mutex;
+std::shared_ptr<ResourcePack const> g_pack;
+
+class PackReader : public ModelReader
+{
+public:
+  PackReader(std::string const & name, std::shared_ptr<ResourcePack const> pack, std::string_view data)
+    : ModelReader(name), m_pack(std::move(pack)), m_data(data)
+  {}
+
+  uint64_t Size() const override { return m_data.size(); }
+
+  void Read(uint64_t pos, void * p, size_t size) const override
+  {
+    if (pos + size > m_data.size())
+      MYTHROW(Reader::ReadException, (GetName(), pos, size, m_data.size()));
+    std::memcpy(p, m_data.data() + pos, size);
+  }
+
+  std::unique_ptr<Reader> CreateSubReader(uint64_t pos, uint64_t size) const override
+  {
+    ASSERT_LESS_OR_EQUAL(pos + size, m_data.size(), (GetName()));
+    return std::make_unique<PackReader>(GetName(), m_pack, m_data.substr(pos, size));
+  }
+
+private:
+  std::shared_ptr<ResourcePack const> m_pack;
+  std::string_view m_data;
+};
+}  // namespace
+
+std::unique_ptr<ResourcePack> ResourcePack::Open(std::string const & path, uint64_t offset)
+{
+  int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG(LWARNING, ("Can't open resource pack", path, strerror(errno)));
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < offset + kHeaderSize)
+  {
+    LOG(LWARNING, ("Resource pack", path, "is truncated"));
+    close(fd);
+    return nullptr;
+  }
+
+  // mmap offsets must be page-aligned; an archive entry generally isn't.
+  uint64_t const pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  uint64_t const mapOffset = offset / pageSize * pageSize;
+  size_t const mapSize = static_cast<size_t>(st.st_size - mapOffset);
+  void * mapping = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(mapOffset));
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    LOG(LWARNING, ("Can't map resource pack", path, strerror(errno)));
+    return nullptr;
+  }
+
+  std::unique_ptr<ResourcePack> pack(new ResourcePack());
+  pack->m_path = path;
+  pack->m_mtime = static_cast<int64_t>(st.st_mtime);
+  pack->m_mapping = mapping;
+  pack->m_mappingSize = mapSize;
+
+  char const * base = static_cast<char const *>(mapping) + (offset - mapOffset);
+  uint64_t const packSize = static_cast<uint64_t>(st.st_size) - offset;
+  if (std::memcmp(base, kMagic, kMagicSize) != 0 || ReadLE<uint32_t>(base + kMagicSize) != kFormatVersion)
+  {
+    LOG(LWARNING, ("Not a resource pack of version", kFormatVersion, ":", path));
+    return nullptr;
+  }
+
+  uint32_t const count = ReadLE<uint32_t>(base + kMagicSize + 4);
+  uint64_t const indexOffset = ReadLE<uint64_t>(base + kMagicSize + 8);
+  uint64_t const indexSize = ReadLE<uint64_t>(base + kMagicSize + 16);
+  if (indexOffset > packSize || indexSize > packSize - indexOffset)
+  {
+    LOG(LWARNING, ("Corrupted resource pack index", path));
+    return nullptr;
+  }
+
+  char const * p = base + indexOffset;
+  char const * const end = p + indexSize;
+  pack->m_entries.reserve(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    if (end - p < 2)
+      break;
+    auto const nameSize = ReadLE<uint16_t>(p);
+    p += 2;
+    if (static_cast<size_t>(end - p) < nameSize + 16u)
+      break;
+    std::string name(p, nameSize);
+    p += nameSize;
+    uint64_t const entryOffset = ReadLE<uint64_t>(p);
+    uint64_t const entrySize = ReadLE<uint64_t>(p + 8);
+    p += 16;
+    if (entryOffset > packSize || entrySize > packSize - entryOffset)
+      break;
+    pack->m_entries.emplace(std::move(name), std::string_view(base + entryOffset, entrySize));
+  }
+  if (pack->m_entries.size() != count)
+  {
+    LOG(LWARNING, ("Corrupted resource pack index", path, "entries:", pack->m_entries.size(), "of", count));
+    return nullptr;
+  }
+  return pack;
+}
+
+ResourcePack::~ResourcePack()
+{
+  if (m_mapping != nullptr)
+    munmap(m_mapping, m_mappingSize);
+}
+
+std::optional<std::string_view> ResourcePack::Find(std::string const & name) const
+{
+  auto const it = m_entries.find(name);
+  if (it == m_entries.end())
+    return {};
+  return it->second;
+}
+
+std::vector<std::string> ResourcePack::List(std::string const & dir) const
+{
+  std::vector<std::string> names;
+  for (auto const & entry : m_entries)
+  {
+    std::string const & name = entry.first;
+    if (name.size() > dir.size() && name.compare(0, dir.size(), dir) == 0 &&
+        name.find('/', dir.size()) == std::string::npos)
+    {
+      names.push_back(name.substr(dir.size()));
+    }
+  }
+  return names;
+}
+
+bool SetResourcePack(std::string const & path, uint64_t offset)
+{
+  std::shared_ptr<ResourcePack const> pack = ResourcePack::Open(path, offset);
+  if (!pack)
+    return false;
+  LOG(LINFO, ("Resource pack", path, "at", offset, "with", pack->GetCount(), "entries"));
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_pack = std::move(pack);
+  return true;
+}
+
+std::shared_ptr<ResourcePack const> GetResourcePack()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_pack;
+}
+
+std::unique_ptr<ModelReader> OpenPackReader(std::string const & name)
+{
+  auto pack = GetResourcePack();
+  if (!pack)
+    return nullptr;
+  auto const data = pack->Find(name);
+  if (!data)
+    return nullptr;
+  return std::make_unique<PackReader>(name, std::move(pack), *data);
+}
+}  // namespace agus
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "coding/reader.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace agus
+{
+/// Read-only bundle of resource files, mapped into memory once and served
+/// entry by entry without copying them out. Built by scripts/build_resource_pack.py.
+///
+/// Layout (little-endian):
+///   header:  "AGUSPACK" | u32 version | u32 entry count | u64 index offset | u64 index size
+///   data:    entries, each starting on a 4096-byte boundary
+///   index:   per entry: u16 name length | name | u64 offset | u64 size
+/// Names are '/'-separated paths relative to the resources directory, e.g.
+/// "symbols/xhdpi/symbols.png". Offsets are relative to the start of the pack.
+class ResourcePack
+{
+public:
+  /// Maps the pack stored at |offset| of |path| (non-zero when it is an
+  /// uncompressed entry of an archive). Returns nullptr if it isn't a valid pack.
+  static std::unique_ptr<ResourcePack> Open(std::string const & path, uint64_t offset);
+
+  ~ResourcePack();
+
+  /// Bytes of the entry named |name|, valid while the pack lives.
+  std::optional<std::string_view> Find(std::string const & name) const;
+
+  /// File names of the entries directly inside |dir| ("" for the top level,
+  /// otherwise with a trailing '/', e.g. "fonts/").
+  std::vector<std::string> List(std::string const & dir) const;
+
+  std::string const & GetPath() const { return m_path; }
+  /// Modification time of the file holding the pack, stands in for the entries' mtime.
+  int64_t GetMtime() const { return m_mtime; }
+  size_t GetCount() const { return m_entries.size(); }
+
+private:
+  ResourcePack() = default;
+
+  std::string m_path;
+  int64_t m_mtime = 0;
+  void * m_mapping = nullptr;
+  size_t m_mappingSize = 0;
+  std::unordered_map<std::string, std::string_view> m_entries;
+};
+
+/// Serves resources from the pack at |offset| of |path| from now on, in addition
+/// to files found on disk (which take precedence). Returns false if it can't be opened.
+bool SetResourcePack(std::string const & path, uint64_t offset);
+
+/// The active pack, nullptr if none. Readers keep it alive.
+std::shared_ptr<ResourcePack const> GetResourcePack();
+
+/// Reader over the entry named |name| of the active pack, nullptr if there is none.
+std::unique_ptr<ModelReader> OpenPackReader(std::string const & name);
+}  // namespace agus
@@ -0,0 +1,291 @@
+#include "agus_startup_trace.hpp"
+
+#include "agus_trace.hpp"
+
+#include "map/startup_hooks.hpp"
+
+#include "platform/platform.hpp"
+
+#include "coding/reader.hpp"
+
+#include "base/logging.hpp"
+
+#include "defines.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace agus
+{
+namespace
+{
+std::mutex g_mutex;
+std::chrono::steady_clock::time_point g_origin = std::chrono::steady_clock::now();
+std::vector<StartupPhase> g_phases;
+std::unordered_map<std::thread::id, uint32_t> g_threads;
+std::once_flag g_hooksOnce;
+
+std::atomic<StartupMode> g_mode{StartupMode::Full};
+StartupMode g_traceMode = StartupMode::Full;
+/// Set by the first frame of the current trace, read on the render thread.
+std::atomic<bool> g_firstFrameSeen{false};
+int64_t g_firstFrameMicros = -1;
+struct DeferredTask
+{
+  std::string m_name;
+  std::function<void()> m_task;
+  Platform::Thread m_thread;
+};
+std::vector<DeferredTask> g_deferred;
+int64_t g_deferredMicros = 0;
+uint32_t g_deferredTasks = 0;
+
+char const kFrameworkPhase[] = "Framework";
+
+int64_t ToMicros(std::chrono::steady_clock::time_point t)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(t - g_origin).count();
+}
+
+int64_t NowMicros()
+{
+  return ToMicros(std::chrono::steady_clock::now());
+}
+
+void AddPhaseLocked(std::string name, int64_t beginMicros, int64_t endMicros)
+{
+  if (IsTracing())
+  {
+    // Phases also show up in a running trace, on the thread they ran on.
+    int64_t const shift = trace_internal::NowMicros() - NowMicros();
+    trace_internal::AddSpan("startup", InternTraceName(name), beginMicros + shift, endMicros + shift);
+  }
+  auto const thread = g_threads.emplace(std::this_thread::get_id(), static_cast<uint32_t>(g_threads.size())).first;
+  g_phases.push_back({std::move(name), beginMicros, std::max<int64_t>(endMicros - beginMicros, 0), thread->second});
+}
+
+void Preload(std::string const & file)
+{
+  ScopedStartupPhase phase("preload " + file);
+  try
+  {
+    auto const reader = GetPlatform().GetReader(file);
+    std::vector<char> buffer(1 << 20);
+    uint64_t const size = reader->Size();
+    for (uint64_t pos = 0; pos < size; pos += buffer.size())
+      reader->Read(pos, buffer.data(), static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - pos)));
+  }
+  catch (RootException const & e)
+  {
+    LOG(LDEBUG, ("Can't preload", file, e.Msg()));
+  }
+}
+
+void PostDeferred(DeferredTask deferred)
+{
+  GetPlatform().RunTask(deferred.m_thread, [name = std::move(deferred.m_name), task = std::move(deferred.m_task)]()
+  {
+    int64_t const begin = NowMicros();
+    {
+      ScopedStartupPhase phase(name);
+      task();
+    }
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_deferredMicros += NowMicros() - begin;
+    ++g_deferredTasks;
+  });
+}
+
+void DeferUntilFirstFrame(std::string name, std::function<void()> task, Platform::Thread thread)
+{
+  DeferredTask deferred{std::move(name), std::move(task), thread};
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_firstFrameMicros < 0)
+    {
+      g_deferred.push_back(std::move(deferred));
+      return;
+    }
+  }
+  PostDeferred(std::move(deferred));
+}
+
+std::string JsonEscape(std::string const & s)
+{
+  std::ostringstream out;
+  for (char const c : s)
+  {
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+    else
+      out << c;
+  }
+  return out.str();
+}
+}  // namespace
+
+std::string DebugPrint(StartupMode mode)
+{
+  switch (mode)
+  {
+  case StartupMode::Full: return "Full";
+  case StartupMode::RenderFirst: return "RenderFirst";
+  }
+  return "Unknown";
+}
+
+void SetStartupMode(StartupMode mode)
+{
+  g_mode = mode;
+}
+
+StartupMode GetStartupMode()
+{
+  return g_mode;
+}
+
+void BeginStartupTrace()
+{
+  // Steps of Framework::Framework, timed by the scopes CoMaps patch 0005 adds.
+  std::call_once(g_hooksOnce, []()
+  {
+    using TimePoint = startup_hooks::Clock::time_point;
+    startup_hooks::g_onPhase = [](char const * name, TimePoint begin, TimePoint end)
+    {
+      std::lock_guard<std::mutex> lock(g_mutex);
+      AddPhaseLocked(name, ToMicros(begin), ToMicros(end));
+    };
+  });
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_origin = std::chrono::steady_clock::now();
+  g_phases.clear();
+  g_threads.clear();
+  g_threads.emplace(std::this_thread::get_id(), 0);
+  g_traceMode = g_mode;
+  g_firstFrameSeen = false;
+  g_firstFrameMicros = -1;
+  g_deferred.clear();
+  g_deferredMicros = 0;
+  g_deferredTasks = 0;
+}
+
+void OnStartupFrame()
+{
+  if (g_firstFrameSeen.load(std::memory_order_relaxed) || g_firstFrameSeen.exchange(true))
+    return;
+
+  decltype(g_deferred) deferred;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_firstFrameMicros = NowMicros();
+    AddPhaseLocked("first frame", g_firstFrameMicros, g_firstFrameMicros);
+    deferred.swap(g_deferred);
+  }
+  for (auto & task : deferred)
+    PostDeferred(std::move(task));
+}
+
+void RunAfterFirstFrame(std::string name, std::function<void()> task)
+{
+  DeferUntilFirstFrame(std::move(name), std::move(task), Platform::Thread::Gui);
+}
+
+void RunInBackgroundAfterFirstFrame(std::string name, std::function<void()> task)
+{
+  DeferUntilFirstFrame(std::move(name), std::move(task), Platform::Thread::Background);
+}
+
+std::string DebugPrint(StartupReport const & report)
+{
+  std::ostringstream out;
+  out << DebugPrint(report.m_mode) << " first frame=" << report.m_firstFrameMicros
+      << "us framework=" << report.m_frameworkMicros << "us deferred=" << report.m_deferredMicros << "us in "
+      << report.m_deferredTasks << " tasks";
+  return out.str();
+}
+
+StartupReport GetStartupReport()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  StartupReport report;
+  report.m_mode = g_traceMode;
+  report.m_firstFrameMicros = g_firstFrameMicros;
+  report.m_deferredMicros = g_deferredMicros;
+  report.m_deferredTasks = g_deferredTasks;
+  for (auto const & phase : g_phases)
+  {
+    if (phase.m_name == kFrameworkPhase)
+      report.m_frameworkMicros = phase.m_durationMicros;
+  }
+  return report;
+}
+
+ScopedStartupPhase::ScopedStartupPhase(std::string name) : m_name(std::move(name)), m_beginMicros(NowMicros()) {}
+
+ScopedStartupPhase::~ScopedStartupPhase()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  AddPhaseLocked(std::move(m_name), m_beginMicros, NowMicros());
+}
+
+StartupPreloader::StartupPreloader(unsigned threads)
+{
+  // Raw reads only: parsing any of these needs the classificator the constructor loads.
+  std::vector<std::string> const files = {
+      "classificator.txt",
+      "types.txt",
+      SEARCH_CATEGORIES_FILE_NAME,
+      COUNTRIES_FILE,
+      PACKED_POLYGONS_FILE,
+  };
+
+  threads = std::max(threads, 1u);
+  for (unsigned i = 0; i < threads && i < files.size(); ++i)
+  {
+    m_workers.push_back(std::async(std::launch::async, [files, i, threads]()
+    {
+      for (size_t j = i; j < files.size(); j += threads)
+        Preload(files[j]);
+    }));
+  }
+}
+
+StartupPreloader::~StartupPreloader()
+{
+  for (auto & worker : m_workers)
+    worker.wait();
+}
+
+std::vector<StartupPhase> GetStartupPhases()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_phases;
+}
+
+std::string GetStartupTraceJson()
+{
+  auto const phases = GetStartupPhases();
+  std::ostringstream out;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < phases.size(); ++i)
+  {
+    auto const & phase = phases[i];
+    if (i > 0)
+      out << ',';
+    out << "{\"name\":\"" << JsonEscape(phase.m_name) << "\",\"cat\":\"startup\",\"ph\":\"X\",\"ts\":"
+        << phase.m_beginMicros << ",\"dur\":" << phase.m_durationMicros << ",\"pid\":1,\"tid\":" << phase.m_thread
+        << '}';
+  }
+  out << "]}";
+  return out.str();
+}
+}  // namespace agus
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace agus
+{
+struct StartupPhase
+{
+  std::string m_name;
+  /// Microseconds since BeginStartupTrace.
+  int64_t m_beginMicros = 0;
+  int64_t m_durationMicros = 0;
+  /// Small per-trace index of the thread the phase ran on, 0 for the first one.
+  uint32_t m_thread = 0;
+};
+
+/// Full: the Framework and every local map are brought up before the first frame.
+/// RenderFirst: only the world maps are registered before it; other maps register
+/// as the viewport reaches them, and the rest on the background pool after the first frame.
+enum class StartupMode
+{
+  Full = 0,
+  RenderFirst = 1,
+};
+
+std::string DebugPrint(StartupMode mode);
+
+/// Takes effect on the next map engine startup.
+void SetStartupMode(StartupMode mode);
+StartupMode GetStartupMode();
+
+/// Starts a new startup timeline, dropping the previous one. Steps of Framework::Framework
+/// (timed through map/startup_hooks.hpp, CoMaps patch 0005) are recorded as its phases.
+void BeginStartupTrace();
+
+/// Call from the active frame callback. The first call after BeginStartupTrace marks
+/// the time to first frame and posts the tasks deferred by RunAfterFirstFrame and
+/// RunInBackgroundAfterFirstFrame.
+void OnStartupFrame();
+
+/// Runs |task| on the GUI thread once the first frame of the current startup was
+/// drawn (right away if it already was), timed as a phase named |name|.
+void RunAfterFirstFrame(std::string name, std::function<void()> task);
+
+/// RunAfterFirstFrame on the background pool, for work that doesn't need the GUI thread.
+void RunInBackgroundAfterFirstFrame(std::string name, std::function<void()> task);
+
+struct StartupReport
+{
+  StartupMode m_mode = StartupMode::Full;
+  /// Microseconds from BeginStartupTrace to the first frame, -1 if none yet.
+  int64_t m_firstFrameMicros = -1;
+  /// Framework construction, -1 if not traced.
+  int64_t m_frameworkMicros = -1;
+  /// Work moved behind the first frame, finished so far.
+  int64_t m_deferredMicros = 0;
+  uint32_t m_deferredTasks = 0;
+};
+
+std::string DebugPrint(StartupReport const & report);
+
+StartupReport GetStartupReport();
+
+/// Times the enclosing scope as a phase of the current startup timeline.
+class ScopedStartupPhase
+{
+public:
+  explicit ScopedStartupPhase(std::string name);
+  ~ScopedStartupPhase();
+
+  ScopedStartupPhase(ScopedStartupPhase const &) = delete;
+  ScopedStartupPhase & operator=(ScopedStartupPhase const &) = delete;
+
+private:
+  std::string m_name;
+  int64_t m_beginMicros;
+};
+
+/// Reads the data files Framework construction loads (classificator, types, categories,
+/// countries) so the constructor finds them in the page cache. This only warms the cache:
+/// every parse needs the classificator, so the constructor still loads them one by one.
+/// The destructor waits for the reads.
+class StartupPreloader
+{
+public:
+  explicit StartupPreloader(unsigned threads);
+  ~StartupPreloader();
+
+  StartupPreloader(StartupPreloader const &) = delete;
+  StartupPreloader & operator=(StartupPreloader const &) = delete;
+
+private:
+  std::vector<std::future<void>> m_workers;
+};
+
+/// Phases of the current timeline, in order of completion.
+std::vector<StartupPhase> GetStartupPhases();
+
+/// The timeline in Chrome trace event format, for chrome://tracing or Perfetto.
+std::string GetStartupTraceJson();
+}  // namespace agus
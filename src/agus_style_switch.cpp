@@ -0,0 +1,250 @@
+#include "agus_style_switch.hpp"
+
+#include "agus_frame_stats.hpp"
+
+#include "map/framework.hpp"
+
+#include "indexer/map_style.hpp"
+
+#include "platform/platform.hpp"
+
+#include "base/assert.hpp"
+#include "base/logging.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace agus
+{
+namespace
+{
+std::atomic<bool> g_keepMapped{false};
+
+std::mutex g_mutex;
+std::unordered_map<std::string, std::shared_ptr<MappedFile const>> g_mapped;
+uint64_t g_mappedBytes = 0;
+StyleSwitchResult g_lastReload;
+StyleSwitchResult g_lastMapped;
+
+bool StartsWith(std::string_view s, std::string_view prefix)
+{
+  return s.size() >= prefix.size() && s.substr(0, prefix.size()) == prefix;
+}
+
+/// Files reloaded by a style switch.
+bool IsStyleResource(std::string_view file)
+{
+  return StartsWith(file, "drules_proto") || StartsWith(file, "symbols/") || file == "classificator.txt" ||
+         file == "types.txt" || file == "colors.txt" || file == "patterns.txt";
+}
+
+/// Read-only mapping of a style resource. Pages come from the page cache and are
+/// shared with it, so nothing is copied onto the heap.
+class MappedFile
+{
+public:
+  static std::shared_ptr<MappedFile const> Map(std::string const & path)
+  {
+    int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      close(fd);
+      return nullptr;
+    }
+    size_t const size = static_cast<size_t>(st.st_size);
+    void * mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+      LOG(LDEBUG, ("Can't map", path, strerror(errno)));
+      return nullptr;
+    }
+    return std::shared_ptr<MappedFile const>(new MappedFile(mapping, size));
+  }
+
+  ~MappedFile() { munmap(m_mapping, m_size); }
+
+  MappedFile(MappedFile const &) = delete;
+  MappedFile & operator=(MappedFile const &) = delete;
+
+  std::string_view GetData() const { return {static_cast<char const *>(m_mapping), m_size}; }
+
+private:
+  MappedFile(void * mapping, size_t size) : m_mapping(mapping), m_size(size) {}
+
+  void * m_mapping;
+  size_t m_size;
+};
+
+class MappedFileReader : public ModelReader
+{
+public:
+  MappedFileReader(std::string const & name, std::shared_ptr<MappedFile const> file, std::string_view range)
+    : ModelReader(name), m_file(std::move(file)), m_range(range)
+  {}
+
+  uint64_t Size() const override { return m_range.size(); }
+
+  void Read(uint64_t pos, void * p, size_t size) const override
+  {
+    if (pos + size > m_range.size())
+      MYTHROW(Reader::ReadException, (GetName(), pos, size, m_range.size()));
+    std::memcpy(p, m_range.data() + pos, size);
+  }
+
+  std::unique_ptr<Reader> CreateSubReader(uint64_t pos, uint64_t size) const override
+  {
+    ASSERT_LESS_OR_EQUAL(pos + size, m_range.size(), (GetName()));
+    return std::make_unique<MappedFileReader>(GetName(), m_file, m_range.substr(pos, size));
+  }
+
+private:
+  /// Keeps the mapping alive after SetKeepStyleFilesMapped(false).
+  std::shared_ptr<MappedFile const> m_file;
+  std::string_view m_range;
+};
+
+std::unique_ptr<ModelReader> MakeReader(std::string const & file, std::shared_ptr<MappedFile const> mapped)
+{
+  std::string_view const range = mapped->GetData();
+  return std::make_unique<MappedFileReader>(file, std::move(mapped), range);
+}
+
+void WarmUp()
+{
+  // Goes through KeepStyleFileMapped.
+  for (auto const * file : {"drules_proto_default_light.bin", "drules_proto_default_dark.bin", "classificator.txt",
+                            "types.txt"})
+  {
+    try
+    {
+      GetPlatform().GetReader(file);
+    }
+    catch (RootException const & e)
+    {
+      LOG(LDEBUG, ("Can't keep", file, "mapped:", e.Msg()));
+    }
+  }
+}
+}  // namespace
+
+void SetKeepStyleFilesMapped(bool enabled)
+{
+  if (g_keepMapped.exchange(enabled) == enabled)
+    return;
+
+  if (enabled)
+  {
+    WarmUp();
+  }
+  else
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mapped.clear();
+    g_mappedBytes = 0;
+  }
+  LOG(LINFO, ("Keep style files mapped", enabled ? "on," : "off,", GetMappedStyleBytes(), "bytes mapped"));
+}
+
+bool AreStyleFilesKeptMapped()
+{
+  return g_keepMapped;
+}
+
+uint64_t GetMappedStyleBytes()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_mappedBytes;
+}
+
+std::unique_ptr<ModelReader> OpenMappedStyleReader(std::string const & file)
+{
+  if (!g_keepMapped)
+    return nullptr;
+  std::shared_ptr<MappedFile const> data;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto const it = g_mapped.find(file);
+    if (it == g_mapped.end())
+      return nullptr;
+    data = it->second;
+  }
+  return MakeReader(file, std::move(data));
+}
+
+std::unique_ptr<ModelReader> KeepStyleFileMapped(std::string const & file, std::string const & path,
+                                                 std::unique_ptr<ModelReader> reader)
+{
+  if (!g_keepMapped || !IsStyleResource(file))
+    return reader;
+
+  auto mapped = MappedFile::Map(path);
+  if (!mapped)
+    return reader;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto const [it, inserted] = g_mapped.emplace(file, mapped);
+    if (inserted)
+      g_mappedBytes += mapped->GetData().size();
+    else
+      mapped = it->second;
+  }
+  return MakeReader(file, std::move(mapped));
+}
+
+std::string DebugPrint(StyleSwitchResult const & result)
+{
+  std::ostringstream out;
+  out << (result.m_dark ? "dark" : "light") << (result.m_mapped ? " mapped" : " reload");
+  if (!result.m_changed)
+    out << " (unchanged)";
+  out << " apply=" << result.m_applyMicros << "us mapped=" << result.m_mappedBytes << "B";
+  return out.str();
+}
+
+StyleSwitchResult SwitchMapStyle(Framework & framework, bool dark)
+{
+  StyleSwitchResult result;
+  result.m_dark = dark;
+  result.m_mapped = AreStyleFilesKeptMapped();
+
+  MapStyle const style = dark ? MapStyleDefaultDark : MapStyleDefaultLight;
+  if (framework.GetMapStyle() == style)
+    return result;
+
+  OnMapStyleSwitching(result.m_mapped);
+  auto const start = std::chrono::steady_clock::now();
+  framework.SetMapStyle(style);
+  result.m_applyMicros =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  result.m_changed = true;
+  result.m_mappedBytes = GetMappedStyleBytes();
+
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    (result.m_mapped ? g_lastMapped : g_lastReload) = result;
+  }
+  LOG(LINFO, ("Switched style:", DebugPrint(result)));
+  return result;
+}
+
+StyleSwitchResult GetLastStyleSwitch(bool mapped)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return mapped ? g_lastMapped : g_lastReload;
+}
+}  // namespace agus
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "coding/reader.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class Framework;
+
+namespace agus
+{
+/// Keeps the style resources a light/dark switch reloads (drawing rules, classificator,
+/// symbol textures) mapped once read, so a switch reads them without opening files.
+/// The mappings share the page cache; nothing is copied onto the heap.
+/// Resources served from the resource pack are mapped already and are left alone.
+/// Symbol textures are mapped the first time each style loads them.
+///
+/// The switch itself is still the engine's full style reload (Framework::SetMapStyle):
+/// the rules are parsed again and every visible tile is read and rendered again.
+/// Restyling the render buckets in place is deferred, see
+/// docs/ISSUE-style-switch-restyle.md.
+void SetKeepStyleFilesMapped(bool enabled);
+bool AreStyleFilesKeptMapped();
+
+/// Bytes of the style resources mapped for style switches.
+uint64_t GetMappedStyleBytes();
+
+/// Platform::GetReader hooks. OpenMappedStyleReader serves |file| from its mapping if
+/// it was kept, nullptr otherwise. KeepStyleFileMapped takes the reader just opened for
+/// |file| at |path| and, while style files are kept mapped and for a style resource,
+/// maps the file and returns a reader over the mapping; otherwise (or if it can't be
+/// mapped) returns |reader|.
+std::unique_ptr<ModelReader> OpenMappedStyleReader(std::string const & file);
+std::unique_ptr<ModelReader> KeepStyleFileMapped(std::string const & file, std::string const & path,
+                                                 std::unique_ptr<ModelReader> reader);
+
+struct StyleSwitchResult
+{
+  bool m_dark = false;
+  /// Made with the style files kept mapped.
+  bool m_mapped = false;
+  /// False if the style was already current and nothing was done.
+  bool m_changed = false;
+  /// Time Framework::SetMapStyle took: reloading the rules and handing the switch
+  /// to the render threads, which drop the tiles and reload the symbol textures.
+  /// The re-rendering that follows is tracked by GetStyleSwitchFrameStats.
+  uint64_t m_applyMicros = 0;
+  uint64_t m_mappedBytes = 0;
+};
+
+std::string DebugPrint(StyleSwitchResult const & result);
+
+/// Switches the map to the default light or dark style. The result is also kept
+/// per kind (style files kept mapped or not), so the two can be compared, see
+/// GetLastStyleSwitch.
+StyleSwitchResult SwitchMapStyle(Framework & framework, bool dark);
+
+/// Last switch made with (|mapped|) or without the style files kept mapped; m_changed
+/// is false if there was none.
+StyleSwitchResult GetLastStyleSwitch(bool mapped);
+}  // namespace agus
@@ -0,0 +1,169 @@
+#include "agus_threads.hpp"
+
+#include "agus_metrics.hpp"
+#include "agus_trace.hpp"
+
+#include "platform/platform.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#if defined(__APPLE__)
+#include <pthread.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace agus
+{
+namespace
+{
+std::mutex g_poolsMutex;
+std::vector<InstrumentedThreadPool const *> g_pools;
+}  // namespace
+
+ThreadConfig ResolveThreadConfig(ThreadConfig const & overrides, unsigned cpuCores)
+{
+  unsigned const cores = std::max(1u, cpuCores);
+  ThreadConfig config = overrides;
+
+  // Search queries are CPU bound but share cores with both renderer threads.
+  if (config.m_searchThreads == 0)
+    config.m_searchThreads = std::clamp(cores / 4, 1u, 8u);
+  // Network tasks mostly wait on sockets.
+  if (config.m_networkThreads == 0)
+    config.m_networkThreads = std::clamp(cores / 4, 2u, 4u);
+  // The file thread serializes writes (bookmarks, settings) and tasks posted to it
+  // assume they never run concurrently, so it can't be widened.
+  if (config.m_fileThreads > 1)
+    LOG(LWARNING, ("File pool is serial, ignoring", config.m_fileThreads, "threads"));
+  config.m_fileThreads = 1;
+  if (config.m_backgroundThreads == 0)
+    config.m_backgroundThreads = std::clamp(cores / 4, 1u, 4u);
+  // Tile reads are CPU bound as well; Drape's own default (cores - 2) starves
+  // search and the renderers on big phones.
+  if (config.m_readThreads == 0)
+    config.m_readThreads = std::clamp(cores / 2, 2u, 8u);
+
+  return config;
+}
+
+std::string DebugPrint(ThreadConfig const & config)
+{
+  std::ostringstream out;
+  out << "search=" << config.m_searchThreads << " network=" << config.m_networkThreads
+      << " file=" << config.m_fileThreads << " background=" << config.m_backgroundThreads
+      << " read=" << config.m_readThreads;
+  return out.str();
+}
+
+double ThreadPoolStats::Utilization() const
+{
+  if (m_threads == 0 || m_uptimeMicros == 0)
+    return 0.0;
+  return std::min(1.0, static_cast<double>(m_busyMicros) / (static_cast<double>(m_uptimeMicros) * m_threads));
+}
+
+InstrumentedThreadPool::InstrumentedThreadPool(std::string name, unsigned threads)
+  : base::DelayedThreadPool(std::max(1u, threads))
+  , m_name(std::move(name))
+  , m_threads(std::max(1u, threads))
+  , m_started(std::chrono::steady_clock::now())
+  , m_traceName(InternTraceName(m_name))
+  , m_waitTimes(GetHistogram("pool." + m_name + ".wait_us"))
+  , m_taskTimes(GetHistogram("pool." + m_name + ".task_us"))
+{
+  std::lock_guard<std::mutex> lock(g_poolsMutex);
+  g_pools.push_back(this);
+}
+
+InstrumentedThreadPool::~InstrumentedThreadPool()
+{
+  std::lock_guard<std::mutex> lock(g_poolsMutex);
+  g_pools.erase(std::remove(g_pools.begin(), g_pools.end(), this), g_pools.end());
+}
+
+base::TaskLoop::Task InstrumentedThreadPool::Wrap(Task && task)
+{
+  m_pushed.fetch_add(1, std::memory_order_relaxed);
+  return [this, task = std::move(task), pushed = std::chrono::steady_clock::now()]() {
+    AGUS_TRACE_SCOPE("task", m_traceName);
+    auto const start = std::chrono::steady_clock::now();
+    m_waitTimes.Record(std::chrono::duration_cast<std::chrono::microseconds>(start - pushed).count());
+    task();
+    auto const busy = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    m_taskTimes.Record(static_cast<uint64_t>(busy.count()));
+    m_busyMicros.fetch_add(static_cast<uint64_t>(busy.count()), std::memory_order_relaxed);
+    m_completed.fetch_add(1, std::memory_order_relaxed);
+  };
+}
+
+base::TaskLoop::PushResult InstrumentedThreadPool::Push(Task && task)
+{
+  return base::DelayedThreadPool::Push(Wrap(std::move(task)));
+}
+
+base::TaskLoop::PushResult InstrumentedThreadPool::Push(Task const & task)
+{
+  return base::DelayedThreadPool::Push(Wrap(Task(task)));
+}
+
+ThreadPoolStats InstrumentedThreadPool::GetStats() const
+{
+  ThreadPoolStats stats;
+  stats.m_name = m_name;
+  stats.m_threads = m_threads;
+  stats.m_tasksCompleted = m_completed.load(std::memory_order_relaxed);
+  uint64_t const pushed = m_pushed.load(std::memory_order_relaxed);
+  stats.m_tasksPending = pushed > stats.m_tasksCompleted ? pushed - stats.m_tasksCompleted : 0;
+  stats.m_busyMicros = m_busyMicros.load(std::memory_order_relaxed);
+  stats.m_uptimeMicros = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_started).count());
+  return stats;
+}
+
+std::vector<ThreadPoolStats> GetThreadPoolStats()
+{
+  std::lock_guard<std::mutex> lock(g_poolsMutex);
+  std::vector<ThreadPoolStats> result;
+  result.reserve(g_pools.size());
+  for (auto const * pool : g_pools)
+    result.push_back(pool->GetStats());
+  return result;
+}
+
+bool IsGuiThread()
+{
+#if defined(__APPLE__)
+  return pthread_main_np() != 0;
+#elif defined(__linux__)
+  // The main thread's tid is the process id, on Android as in agus_bench.
+  return gettid() == getpid();
+#else
+  return false;
+#endif
+}
+
+bool RunOnGuiThreadAndWait(std::function<void()> task, std::chrono::milliseconds timeout)
+{
+  if (IsGuiThread())
+  {
+    task();
+    return true;
+  }
+
+  auto done = std::make_shared<std::promise<void>>();
+  auto result = done->get_future();
+  GetPlatform().RunTask(Platform::Thread::Gui, [task = std::move(task), done]()
+  {
+    task();
+    done->set_value();
+  });
+  return result.wait_for(timeout) == std::future_status::ready;
+}
+}  // namespace agus
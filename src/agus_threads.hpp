@@ -0,0 +1,87 @@
+#pragma once
+
+#include "base/thread_pool_delayed.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace agus
+{
+class Histogram;
+
+/// Thread budget for the engine. Zero means "size from Platform::CpuCores()".
+struct ThreadConfig
+{
+  unsigned m_searchThreads = 0;
+  unsigned m_networkThreads = 0;
+  /// Always resolved to 1, see ResolveThreadConfig.
+  unsigned m_fileThreads = 0;
+  unsigned m_backgroundThreads = 0;
+  /// Drape's backend read pool, which reads tile geometry (patch 0020).
+  unsigned m_readThreads = 0;
+};
+
+/// Fills every zero field of |overrides| from |cpuCores| and clamps the file pool to 1.
+ThreadConfig ResolveThreadConfig(ThreadConfig const & overrides, unsigned cpuCores);
+
+std::string DebugPrint(ThreadConfig const & config);
+
+struct ThreadPoolStats
+{
+  std::string m_name;
+  unsigned m_threads = 0;
+  uint64_t m_tasksCompleted = 0;
+  uint64_t m_tasksPending = 0;
+  uint64_t m_busyMicros = 0;
+  uint64_t m_uptimeMicros = 0;
+
+  /// Fraction of available thread time spent running tasks, in [0, 1].
+  double Utilization() const;
+};
+
+/// DelayedThreadPool that accounts queueing and busy time of immediate tasks.
+/// Delayed tasks go through the base class untouched: PushDelayed is not virtual.
+class InstrumentedThreadPool : public base::DelayedThreadPool
+{
+public:
+  InstrumentedThreadPool(std::string name, unsigned threads);
+  ~InstrumentedThreadPool() override;
+
+  // TaskLoop overrides:
+  PushResult Push(Task && task) override;
+  PushResult Push(Task const & task) override;
+
+  ThreadPoolStats GetStats() const;
+
+private:
+  Task Wrap(Task && task);
+
+  std::string const m_name;
+  unsigned const m_threads;
+  std::chrono::steady_clock::time_point const m_started;
+  /// m_name for trace spans, which must outlive the pool.
+  char const * const m_traceName;
+  /// "pool.<name>.wait_us" (push to start) and "pool.<name>.task_us".
+  Histogram & m_waitTimes;
+  Histogram & m_taskTimes;
+  std::atomic<uint64_t> m_pushed{0};
+  std::atomic<uint64_t> m_completed{0};
+  std::atomic<uint64_t> m_busyMicros{0};
+};
+
+/// Stats of every live InstrumentedThreadPool, in creation order.
+std::vector<ThreadPoolStats> GetThreadPoolStats();
+
+/// True on the thread that runs Platform::Thread::Gui tasks, the app's main thread,
+/// which also owns the render surface.
+bool IsGuiThread();
+
+/// Runs |task| on the GUI thread (inline when already on it) and waits up to |timeout|.
+/// Returns false on timeout. |task| still runs later then, so it must not capture
+/// anything by reference.
+bool RunOnGuiThreadAndWait(std::function<void()> task, std::chrono::milliseconds timeout);
+}  // namespace agus
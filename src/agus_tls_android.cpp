@@ -0,0 +1,159 @@
+#include "agus_tls_android.hpp"
+#include "agus_http.hpp"
+#include <android/log.h>
+#include <algorithm>
+
+extern JavaVM* g_javaVM;
+
+namespace {
+
+jclass g_tlsClass = nullptr;
+jmethodID g_openMethod = nullptr;
+jmethodID g_readMethod = nullptr;
+jmethodID g_writeMethod = nullptr;
+jmethodID g_closeMethod = nullptr;
+
+// Attaches HTTP worker threads to the JVM once and detaches them on thread exit.
+struct ScopedThreadEnv {
+    JNIEnv* m_env = nullptr;
+    bool m_attached = false;
+
+    ~ScopedThreadEnv() {
+        if (m_attached && g_javaVM != nullptr)
+            g_javaVM->DetachCurrentThread();
+    }
+};
+
+JNIEnv* GetThreadEnv() {
+    thread_local ScopedThreadEnv threadEnv;
+    if (threadEnv.m_env != nullptr)
+        return threadEnv.m_env;
+    if (g_javaVM == nullptr)
+        return nullptr;
+
+    JNIEnv* env = nullptr;
+    jint result = g_javaVM->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6);
+    if (result == JNI_EDETACHED) {
+        if (g_javaVM->AttachCurrentThread(&env, nullptr) != 0) {
+            __android_log_print(ANDROID_LOG_ERROR, "AgusTls", "Failed to attach thread to JVM");
+            return nullptr;
+        }
+        threadEnv.m_attached = true;
+    } else if (result != JNI_OK) {
+        return nullptr;
+    }
+    threadEnv.m_env = env;
+    return env;
+}
+
+bool ClearException(JNIEnv* env) {
+    if (!env->ExceptionCheck())
+        return false;
+    env->ExceptionDescribe();
+    env->ExceptionClear();
+    return true;
+}
+
+class JavaTlsStream : public agus::http::Stream {
+public:
+    static constexpr jint kChunkSize = 64 * 1024;
+
+    JavaTlsStream(JNIEnv* env, jobject socket)
+        : m_socket(env->NewGlobalRef(socket)) {
+        jbyteArray buffer = env->NewByteArray(kChunkSize);
+        m_buffer = static_cast<jbyteArray>(env->NewGlobalRef(buffer));
+        env->DeleteLocalRef(buffer);
+    }
+
+    ~JavaTlsStream() override {
+        JNIEnv* env = GetThreadEnv();
+        if (env == nullptr)
+            return;
+        env->CallVoidMethod(m_socket, g_closeMethod);
+        ClearException(env);
+        env->DeleteGlobalRef(m_buffer);
+        env->DeleteGlobalRef(m_socket);
+    }
+
+    long Read(void* buffer, size_t size) override {
+        JNIEnv* env = GetThreadEnv();
+        if (env == nullptr)
+            return -1;
+        jint const toRead = static_cast<jint>(std::min<size_t>(size, kChunkSize));
+        jint const n = env->CallIntMethod(m_socket, g_readMethod, m_buffer, toRead);
+        if (ClearException(env) || n < 0)
+            return -1;
+        if (n > 0)
+            env->GetByteArrayRegion(m_buffer, 0, n, static_cast<jbyte*>(buffer));
+        return n;
+    }
+
+    bool WriteAll(void const* data, size_t size) override {
+        JNIEnv* env = GetThreadEnv();
+        if (env == nullptr)
+            return false;
+        auto const* bytes = static_cast<jbyte const*>(data);
+        while (size > 0) {
+            jint const chunk = static_cast<jint>(std::min<size_t>(size, kChunkSize));
+            env->SetByteArrayRegion(m_buffer, 0, chunk, bytes);
+            jboolean const ok = env->CallBooleanMethod(m_socket, g_writeMethod, m_buffer, chunk);
+            if (ClearException(env) || !ok)
+                return false;
+            bytes += chunk;
+            size -= static_cast<size_t>(chunk);
+        }
+        return true;
+    }
+
+private:
+    jobject m_socket;
+    jbyteArray m_buffer;
+};
+
+std::unique_ptr<agus::http::Stream> OpenTlsStream(agus::http::Url const& url, int timeoutMs) {
+    JNIEnv* env = GetThreadEnv();
+    if (env == nullptr)
+        return nullptr;
+
+    jstring host = env->NewStringUTF(url.m_host.c_str());
+    jobject socket = env->CallStaticObjectMethod(g_tlsClass, g_openMethod, host,
+                                                 static_cast<jint>(url.m_port), static_cast<jint>(timeoutMs));
+    env->DeleteLocalRef(host);
+    if (ClearException(env) || socket == nullptr)
+        return nullptr;
+
+    auto stream = std::make_unique<JavaTlsStream>(env, socket);
+    env->DeleteLocalRef(socket);
+    return stream;
+}
+
+}  // namespace
+
+namespace agus {
+
+void InitTlsTransport(JNIEnv* env) {
+    jclass localClass = env->FindClass("app/agus/maps/agus_maps_flutter/TlsSocket");
+    if (localClass == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, "AgusTls", "Failed to find TlsSocket class, HTTPS disabled");
+        env->ExceptionClear();
+        return;
+    }
+    g_tlsClass = static_cast<jclass>(env->NewGlobalRef(localClass));
+    env->DeleteLocalRef(localClass);
+
+    g_openMethod = env->GetStaticMethodID(g_tlsClass, "open",
+                                          "(Ljava/lang/String;II)Lapp/agus/maps/agus_maps_flutter/TlsSocket;");
+    g_readMethod = env->GetMethodID(g_tlsClass, "read", "([BI)I");
+    g_writeMethod = env->GetMethodID(g_tlsClass, "write", "([BI)Z");
+    g_closeMethod = env->GetMethodID(g_tlsClass, "close", "()V");
+    if (!g_openMethod || !g_readMethod || !g_writeMethod || !g_closeMethod) {
+        __android_log_print(ANDROID_LOG_ERROR, "AgusTls", "Failed to find TlsSocket methods, HTTPS disabled");
+        env->ExceptionClear();
+        return;
+    }
+
+    agus::http::SetTlsStreamFactory(&OpenTlsStream);
+    __android_log_print(ANDROID_LOG_DEBUG, "AgusTls", "TLS transport initialized");
+}
+
+}  // namespace agus
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <jni.h>
+
+namespace agus {
+
+/**
+ * Registers the TlsSocket.java backed transport with agus::http.
+ * Must be called from JNI_OnLoad: classes of the app class loader can't be
+ * found from native worker threads later on.
+ */
+void InitTlsTransport(JNIEnv* env);
+
+}  // namespace agus
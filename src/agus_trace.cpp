@@ -0,0 +1,258 @@
+#include "agus_trace.hpp"
+
+#include "base/logging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <pthread.h>
+
+namespace agus
+{
+namespace trace_internal
+{
+std::atomic<bool> g_enabled{false};
+}  // namespace trace_internal
+
+namespace
+{
+/// An instant event when m_durationMicros is negative.
+struct Event
+{
+  char const * m_category;
+  char const * m_name;
+  int64_t m_beginMicros;
+  int64_t m_durationMicros;
+};
+
+/// Events of one thread. The mutex is only contended while a trace starts or is
+/// written out.
+struct ThreadEvents
+{
+  std::mutex m_mutex;
+  std::vector<Event> m_events;
+  /// Trace the events belong to; older ones are dropped on the next event.
+  uint64_t m_generation = 0;
+  uint64_t m_dropped = 0;
+  uint32_t m_number = 0;
+  char m_threadName[16] = {};
+  std::atomic<bool> m_exited{false};
+};
+
+// Never destroyed: threads may record while static destructors run.
+std::mutex & g_threadsMutex = *new std::mutex;
+std::vector<std::shared_ptr<ThreadEvents>> & g_threads = *new std::vector<std::shared_ptr<ThreadEvents>>;
+uint32_t g_nextThreadNumber = 1;
+
+std::atomic<uint64_t> g_generation{0};
+std::atomic<size_t> g_maxEvents{kDefaultTraceEventsPerThread};
+std::atomic<int64_t> g_originMicros{0};
+
+/// Registers the calling thread's events and marks them orphaned when it exits.
+struct ThreadHolder
+{
+  std::shared_ptr<ThreadEvents> m_events;
+
+  ThreadHolder() : m_events(std::make_shared<ThreadEvents>())
+  {
+    std::lock_guard<std::mutex> lock(g_threadsMutex);
+    m_events->m_number = g_nextThreadNumber++;
+    g_threads.push_back(m_events);
+  }
+
+  ~ThreadHolder() { m_events->m_exited.store(true, std::memory_order_release); }
+};
+
+void Add(Event const & event)
+{
+  thread_local ThreadHolder holder;
+  ThreadEvents & thread = *holder.m_events;
+  std::lock_guard<std::mutex> lock(thread.m_mutex);
+  uint64_t const generation = g_generation.load(std::memory_order_acquire);
+  if (thread.m_generation != generation)
+  {
+    size_t const maxEvents = g_maxEvents.load(std::memory_order_relaxed);
+    thread.m_events.clear();
+    thread.m_events.reserve(std::min<size_t>(maxEvents, 1024));
+    thread.m_dropped = 0;
+    thread.m_generation = generation;
+    // Threads are often named after they start, so look again for every trace.
+    pthread_getname_np(pthread_self(), thread.m_threadName, sizeof(thread.m_threadName));
+  }
+  if (thread.m_events.size() >= g_maxEvents.load(std::memory_order_relaxed))
+    ++thread.m_dropped;
+  else
+    thread.m_events.push_back(event);
+}
+
+void WriteJsonString(std::ostream & out, char const * s)
+{
+  out << '"';
+  for (; *s; ++s)
+  {
+    auto const c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\')
+    {
+      out << '\\' << *s;
+    }
+    else if (c < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    }
+    else
+    {
+      out << *s;
+    }
+  }
+  out << '"';
+}
+}  // namespace
+
+namespace trace_internal
+{
+int64_t NowMicros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void AddSpan(char const * category, char const * name, int64_t beginMicros, int64_t endMicros)
+{
+  Add({category, name, beginMicros, std::max<int64_t>(endMicros - beginMicros, 0)});
+}
+
+void AddInstant(char const * category, char const * name)
+{
+  Add({category, name, NowMicros(), -1});
+}
+}  // namespace trace_internal
+
+void StartTrace(size_t maxEventsPerThread)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_threadsMutex);
+    g_threads.erase(std::remove_if(g_threads.begin(), g_threads.end(),
+                                   [](std::shared_ptr<ThreadEvents> const & t)
+                                   { return t->m_exited.load(std::memory_order_acquire); }),
+                    g_threads.end());
+  }
+  g_maxEvents = std::max<size_t>(maxEventsPerThread, 1);
+  g_originMicros = trace_internal::NowMicros();
+  g_generation.fetch_add(1, std::memory_order_acq_rel);
+  trace_internal::g_enabled.store(true, std::memory_order_release);
+  LOG(LINFO, ("Tracing started,", maxEventsPerThread, "events per thread"));
+}
+
+void StopTrace()
+{
+  trace_internal::g_enabled.store(false, std::memory_order_release);
+}
+
+int64_t WriteTraceJson(std::string const & path)
+{
+  struct Track
+  {
+    uint32_t m_number;
+    std::string m_name;
+    std::vector<Event> m_events;
+  };
+
+  std::vector<std::shared_ptr<ThreadEvents>> threads;
+  {
+    std::lock_guard<std::mutex> lock(g_threadsMutex);
+    threads = g_threads;
+  }
+
+  // Copied out first, so threads aren't held up by the file write.
+  uint64_t const generation = g_generation.load(std::memory_order_acquire);
+  std::vector<Track> tracks;
+  uint64_t dropped = 0;
+  for (auto const & thread : threads)
+  {
+    std::lock_guard<std::mutex> lock(thread->m_mutex);
+    if (thread->m_generation != generation || thread->m_events.empty())
+      continue;
+    tracks.push_back({thread->m_number, thread->m_threadName, thread->m_events});
+    dropped += thread->m_dropped;
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out)
+  {
+    LOG(LWARNING, ("Can't write trace to", path));
+    return -1;
+  }
+
+  int64_t const origin = g_originMicros.load();
+  int64_t count = 0;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"agus_maps_flutter\"}}";
+  for (auto const & track : tracks)
+  {
+    std::string const name = (track.m_name.empty() ? "thread" : track.m_name) + " #" + std::to_string(track.m_number);
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.m_number << ",\"args\":{\"name\":";
+    WriteJsonString(out, name.c_str());
+    out << "}}";
+    for (auto const & event : track.m_events)
+    {
+      out << ",\n{\"name\":";
+      WriteJsonString(out, event.m_name);
+      out << ",\"cat\":";
+      WriteJsonString(out, event.m_category);
+      out << ",\"ts\":" << event.m_beginMicros - origin;
+      if (event.m_durationMicros < 0)
+        out << ",\"ph\":\"i\",\"s\":\"t\"";
+      else
+        out << ",\"ph\":\"X\",\"dur\":" << event.m_durationMicros;
+      out << ",\"pid\":1,\"tid\":" << track.m_number << '}';
+      ++count;
+    }
+  }
+  out << "]}\n";
+  out.close();
+  if (!out)
+  {
+    LOG(LWARNING, ("Can't write trace to", path));
+    return -1;
+  }
+
+  LOG(LINFO, ("Wrote", count, "trace events from", tracks.size(), "threads to", path, "; dropped", dropped));
+  return count;
+}
+
+uint64_t GetDroppedTraceEvents()
+{
+  std::vector<std::shared_ptr<ThreadEvents>> threads;
+  {
+    std::lock_guard<std::mutex> lock(g_threadsMutex);
+    threads = g_threads;
+  }
+  uint64_t const generation = g_generation.load(std::memory_order_acquire);
+  uint64_t dropped = 0;
+  for (auto const & thread : threads)
+  {
+    std::lock_guard<std::mutex> lock(thread->m_mutex);
+    if (thread->m_generation == generation)
+      dropped += thread->m_dropped;
+  }
+  return dropped;
+}
+
+char const * InternTraceName(std::string const & name)
+{
+  static std::mutex mutex;
+  // Never destroyed, like the events pointing into it.
+  static auto * names = new std::unordered_set<std::string>();
+  std::lock_guard<std::mutex> lock(mutex);
+  return names->insert(name).first->c_str();
+}
+}  // namespace agus
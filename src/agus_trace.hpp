@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// Set to 0 to compile every AGUS_TRACE_* macro out.
+#ifndef AGUS_TRACE_ENABLED
+#define AGUS_TRACE_ENABLED 1
+#endif
+
+namespace agus
+{
+namespace trace_internal
+{
+extern std::atomic<bool> g_enabled;
+
+int64_t NowMicros();
+void AddSpan(char const * category, char const * name, int64_t beginMicros, int64_t endMicros);
+void AddInstant(char const * category, char const * name);
+}  // namespace trace_internal
+
+/// Whether spans are being recorded. One relaxed load: this is all a span costs
+/// while tracing is off.
+inline bool IsTracing()
+{
+  return trace_internal::g_enabled.load(std::memory_order_relaxed);
+}
+
+size_t constexpr kDefaultTraceEventsPerThread = 64 * 1024;
+
+/// Starts recording spans from every thread, dropping the previous recording.
+/// Each thread keeps up to |maxEventsPerThread| events; later ones are counted
+/// as dropped, so a forgotten trace can't grow without bound.
+void StartTrace(size_t maxEventsPerThread = kDefaultTraceEventsPerThread);
+
+/// Stops recording; what was recorded is kept for WriteTraceJson.
+void StopTrace();
+
+/// Writes the recording in Chrome trace event format (chrome://tracing,
+/// ui.perfetto.dev), one track per thread, named after the thread. Can be called
+/// while recording. Returns the number of events written, -1 if |path| can't be
+/// written.
+int64_t WriteTraceJson(std::string const & path);
+
+/// Events dropped because a thread's buffer was full, since StartTrace.
+uint64_t GetDroppedTraceEvents();
+
+/// Span and event names are kept as pointers and only read when writing the trace,
+/// so they must be string literals or come from here; the copy is never freed.
+char const * InternTraceName(std::string const & name);
+
+/// Records the enclosing scope as a complete ("X") event on the calling thread.
+class ScopedTraceSpan
+{
+public:
+  ScopedTraceSpan(char const * category, char const * name)
+    : m_category(category), m_name(IsTracing() ? name : nullptr), m_beginMicros(m_name ? trace_internal::NowMicros() : 0)
+  {}
+
+  ~ScopedTraceSpan()
+  {
+    if (m_name)
+      trace_internal::AddSpan(m_category, m_name, m_beginMicros, trace_internal::NowMicros());
+  }
+
+  ScopedTraceSpan(ScopedTraceSpan const &) = delete;
+  ScopedTraceSpan & operator=(ScopedTraceSpan const &) = delete;
+
+private:
+  char const * m_category;
+  /// Null when tracing was off at the start of the scope.
+  char const * m_name;
+  int64_t m_beginMicros;
+};
+}  // namespace agus
+
+#define AGUS_TRACE_CONCAT_IMPL(a, b) a##b
+#define AGUS_TRACE_CONCAT(a, b) AGUS_TRACE_CONCAT_IMPL(a, b)
+
+#if AGUS_TRACE_ENABLED
+/// |category| and |name| must outlive the trace; see InternTraceName.
+#define AGUS_TRACE_SCOPE(category, name) \
+  ::agus::ScopedTraceSpan AGUS_TRACE_CONCAT(agusTraceSpan, __LINE__)(category, name)
+#define AGUS_TRACE_FUNCTION(category) AGUS_TRACE_SCOPE(category, __func__)
+#define AGUS_TRACE_INSTANT(category, name)                 \
+  do                                                       \
+  {                                                        \
+    if (::agus::IsTracing())                               \
+      ::agus::trace_internal::AddInstant(category, name);  \
+  } while (false)
+#else
+#define AGUS_TRACE_SCOPE(category, name) static_cast<void>(0)
+#define AGUS_TRACE_FUNCTION(category) static_cast<void>(0)
+#define AGUS_TRACE_INSTANT(category, name) static_cast<void>(0)
+#endif